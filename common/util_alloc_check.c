@@ -0,0 +1,100 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "util_alloc_check.h"
+
+/*
+ *  debug counter of the heap allocations (ALLOC_CHECK=true in Makefile.env).
+ *
+ *  malloc(), calloc() and realloc() of the process (and operator new, which
+ *  calls malloc) are counted for the calling thread between
+ *  ALLOC_CHECK_BEGIN() and ALLOC_CHECK_END(). after the warm-up calls of
+ *  a check point, any allocation there is reported and aborts the app.
+ *  the counter wraps the allocator of glibc.
+ */
+
+/* -1: not yet resolved from ALLOC_CHECK_WARMUP environment variable */
+static int s_warmup = -1;
+
+static __thread int  s_counting;
+static __thread long s_num_allocs;
+
+#if defined (USE_ALLOC_CHECK)
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void *
+malloc (size_t size)
+{
+    if (s_counting)
+        s_num_allocs ++;
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+    if (s_counting)
+        s_num_allocs ++;
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    if (s_counting)
+        s_num_allocs ++;
+    return __libc_realloc (ptr, size);
+}
+#endif
+
+
+/*
+ *  the number of the calls of a check point before the allocations
+ *  are asserted. default 30. (or ALLOC_CHECK_WARMUP=n)
+ */
+int
+alloc_check_get_warmup ()
+{
+    if (s_warmup < 0)
+    {
+        const char *env = getenv ("ALLOC_CHECK_WARMUP");
+        s_warmup = env ? atoi (env) : 30;
+        if (s_warmup < 0)
+            s_warmup = 0;
+    }
+    return s_warmup;
+}
+
+void
+alloc_check_begin ()
+{
+    s_num_allocs = 0;
+    s_counting   = 1;
+}
+
+/*
+ *  return the number of the allocations since alloc_check_begin().
+ *  abort if any after the warm-up. (num_calls) is the count of the
+ *  check point (name).
+ */
+long
+alloc_check_end (const char *name, int num_calls)
+{
+    long num_allocs = s_num_allocs;
+
+    s_counting = 0;
+
+    if (num_calls >= alloc_check_get_warmup () && num_allocs > 0)
+    {
+        fprintf (stderr, "ERR: %s(%d): %s: %ld heap allocations after the warm-up (%d calls)\n",
+                 __FILE__, __LINE__, name, num_allocs, num_calls);
+        abort ();
+    }
+
+    return num_allocs;
+}
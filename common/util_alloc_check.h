@@ -0,0 +1,28 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_ALLOC_CHECK_H_
+#define _UTIL_ALLOC_CHECK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined (USE_ALLOC_CHECK)
+#define ALLOC_CHECK_BEGIN()         alloc_check_begin ()
+#define ALLOC_CHECK_END(name)       do { static int s_num_calls; alloc_check_end (name, s_num_calls ++); } while (0)
+#else
+#define ALLOC_CHECK_BEGIN()         ((void)0)
+#define ALLOC_CHECK_END(name)       ((void)0)
+#endif
+
+void alloc_check_begin ();
+long alloc_check_end (const char *name, int num_calls);
+int  alloc_check_get_warmup ();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_ALLOC_CHECK_H_ */
@@ -0,0 +1,243 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_async_infer.h"
+#include "util_pmeter.h"
+#include "util_memory.h"
+
+/*
+ *  Asynchronous inference runner.
+ *
+ *  the worker thread is the only one that invokes the interpreter.
+ *  the render thread fills a request (the network input it has read back
+ *  from GL) and submits it without waiting. only the latest request is
+ *  kept: if the worker is still busy, a pending request is replaced by
+ *  the newer one. the render thread draws at display rate with the most
+ *  recent completed result and the ID of the frame it came from.
+ *
+ *  with ASYNC_INFER_SYNC, the request is invoked on the caller thread in
+ *  async_infer_submit(). this is needed when the interpreter must run on
+ *  the GL thread (GPU delegate).
+ */
+
+static void
+swap_ptr (void **a, void **b)
+{
+    void *tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void
+run_request (async_infer_t *ai, int frame_id)
+{
+    double t0 = pmeter_get_time_ms ();
+    pmeter_set_frame (frame_id);
+    ai->func (ai->input_slot[2], ai->output_work, ai->usrdata);
+    double t1 = pmeter_get_time_ms ();
+
+    pthread_mutex_lock (&ai->mutex);
+    swap_ptr (&ai->output_work, &ai->output_ready);
+    ai->output_frame_id = frame_id;
+    ai->invoke_ms       = t1 - t0;
+    ai->output_seq ++;
+    pthread_mutex_unlock (&ai->mutex);
+}
+
+static void *
+async_infer_thread_main (void *arg)
+{
+    async_infer_t *ai = (async_infer_t *)arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock (&ai->mutex);
+        while (ai->running && !ai->pending)
+            pthread_cond_wait (&ai->cond, &ai->mutex);
+
+        if (!ai->running)
+        {
+            pthread_mutex_unlock (&ai->mutex);
+            break;
+        }
+
+        swap_ptr (&ai->input_slot[1], &ai->input_slot[2]);
+        ai->invoke_frame_id = ai->pending_frame_id;
+        ai->pending = 0;
+        pthread_mutex_unlock (&ai->mutex);
+
+        run_request (ai, ai->invoke_frame_id);
+
+        pthread_mutex_lock (&ai->mutex);
+        ai->invoke_frame_id = -1;
+        pthread_mutex_unlock (&ai->mutex);
+    }
+
+    return NULL;
+}
+
+
+int
+async_infer_init (async_infer_t *ai, size_t input_size, size_t output_size,
+                  async_infer_func_t func, void *usrdata, int flags)
+{
+    memset (ai, 0, sizeof (*ai));
+
+    ai->func        = func;
+    ai->usrdata     = usrdata;
+    ai->flags       = flags;
+    ai->input_size  = input_size;
+    ai->output_size = output_size;
+    ai->output_frame_id = -1;
+    ai->invoke_frame_id = -1;
+
+    for (int i = 0; i < 3; i ++)
+    {
+        ai->input_slot[i] = calloc (1, input_size);
+        if (ai->input_slot[i] == NULL)
+        {
+            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+        mem_register_buffer ("async_infer input", ai->input_slot[i], input_size);
+    }
+
+    ai->output_work  = calloc (1, output_size);
+    ai->output_ready = calloc (1, output_size);
+    if (ai->output_work == NULL || ai->output_ready == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    mem_register_buffer ("async_infer output", ai->output_work,  output_size);
+    mem_register_buffer ("async_infer output", ai->output_ready, output_size);
+
+    pthread_mutex_init (&ai->mutex, NULL);
+    pthread_cond_init  (&ai->cond,  NULL);
+
+    if (flags & ASYNC_INFER_SYNC)
+        return 0;
+
+    ai->running = 1;
+    if (pthread_create (&ai->thread, NULL, async_infer_thread_main, ai) != 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        ai->running = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+async_infer_exit (async_infer_t *ai)
+{
+    if (ai->running)
+    {
+        pthread_mutex_lock (&ai->mutex);
+        ai->running = 0;
+        pthread_cond_signal (&ai->cond);
+        pthread_mutex_unlock (&ai->mutex);
+
+        pthread_join (ai->thread, NULL);
+    }
+
+    pthread_cond_destroy  (&ai->cond);
+    pthread_mutex_destroy (&ai->mutex);
+
+    for (int i = 0; i < 3; i ++)
+    {
+        mem_unregister_buffer (ai->input_slot[i]);
+        free (ai->input_slot[i]);
+    }
+    mem_unregister_buffer (ai->output_work);
+    mem_unregister_buffer (ai->output_ready);
+    free (ai->output_work);
+    free (ai->output_ready);
+}
+
+
+/*
+ *  the buffer to fill the next request in.
+ *  it is owned by the caller until async_infer_submit().
+ */
+void *
+async_infer_get_input_buf (async_infer_t *ai)
+{
+    return ai->input_slot[0];
+}
+
+int
+async_infer_submit (async_infer_t *ai, int frame_id)
+{
+    if (ai->flags & ASYNC_INFER_SYNC)
+    {
+        swap_ptr (&ai->input_slot[0], &ai->input_slot[2]);
+        run_request (ai, frame_id);
+        return 0;
+    }
+
+    pthread_mutex_lock (&ai->mutex);
+    swap_ptr (&ai->input_slot[0], &ai->input_slot[1]);
+    if (ai->pending)
+        ai->num_dropped ++;
+    ai->pending = 1;
+    ai->pending_frame_id = frame_id;
+    pthread_cond_signal (&ai->cond);
+    pthread_mutex_unlock (&ai->mutex);
+
+    return 0;
+}
+
+/*
+ *  copy the latest completed result to (output).
+ *  (output) is written only when there is a new result, so the caller
+ *  can keep using its own copy at display rate.
+ *  return  1: a new result since the last call
+ *          0: the same result as the last call
+ *         -1: no result yet
+ */
+int
+async_infer_get_result (async_infer_t *ai, void *output, int *frame_id, double *invoke_ms)
+{
+    int ret;
+
+    pthread_mutex_lock (&ai->mutex);
+    if (ai->output_seq == 0)
+    {
+        pthread_mutex_unlock (&ai->mutex);
+        return -1;
+    }
+
+    ret = (ai->output_seq != ai->read_seq) ? 1 : 0;
+    ai->read_seq = ai->output_seq;
+
+    if (output && ret)
+        memcpy (output, ai->output_ready, ai->output_size);
+    if (frame_id)
+        *frame_id = ai->output_frame_id;
+    if (invoke_ms)
+        *invoke_ms = ai->invoke_ms;
+    pthread_mutex_unlock (&ai->mutex);
+
+    return ret;
+}
+
+/*
+ *  1 if a request is pending or being invoked.
+ */
+int
+async_infer_is_busy (async_infer_t *ai)
+{
+    int busy;
+
+    pthread_mutex_lock (&ai->mutex);
+    busy = ai->pending || (ai->invoke_frame_id >= 0);
+    pthread_mutex_unlock (&ai->mutex);
+
+    return busy;
+}
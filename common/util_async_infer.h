@@ -0,0 +1,69 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_ASYNC_INFER_H_
+#define _UTIL_ASYNC_INFER_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* flags for async_infer_init() */
+#define ASYNC_INFER_SYNC        (1 << 0)    /* run the inference on the caller thread */
+
+/*
+ *  inference body. runs on the worker thread.
+ *      input : a request filled by the render thread   (input_size  bytes)
+ *      output: the result to publish                   (output_size bytes)
+ */
+typedef int (*async_infer_func_t) (void *input, void *output, void *usrdata);
+
+typedef struct _async_infer_t
+{
+    pthread_t           thread;
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    int                 flags;
+    int                 running;
+
+    async_infer_func_t  func;
+    void                *usrdata;
+
+    size_t              input_size;
+    size_t              output_size;
+
+    /* [0] being filled by the caller, [1] pending, [2] being invoked */
+    void                *input_slot[3];
+    int                 pending;
+    int                 pending_frame_id;
+    int                 invoke_frame_id;
+
+    void                *output_work;       /* written by the worker          */
+    void                *output_ready;      /* the latest completed result    */
+    int                 output_frame_id;    /* source frame of output_ready   */
+    int                 output_seq;         /* number of completed results    */
+    int                 read_seq;           /* output_seq at the last read    */
+    double              invoke_ms;
+
+    int                 num_dropped;        /* requests replaced before invoke */
+} async_infer_t;
+
+
+int   async_infer_init (async_infer_t *ai, size_t input_size, size_t output_size,
+                        async_infer_func_t func, void *usrdata, int flags);
+void  async_infer_exit (async_infer_t *ai);
+
+void *async_infer_get_input_buf (async_infer_t *ai);
+int   async_infer_submit (async_infer_t *ai, int frame_id);
+int   async_infer_get_result (async_infer_t *ai, void *output, int *frame_id, double *invoke_ms);
+int   async_infer_is_busy (async_infer_t *ai);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_ASYNC_INFER_H_ */
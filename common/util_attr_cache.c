@@ -0,0 +1,142 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include "util_attr_cache.h"
+
+/*
+ *  per-track cache of the attribute model results (age, gender, ...).
+ *
+ *  the attributes of a tracked object hardly change frame to frame,
+ *  so the model is re-run only when
+ *    - the track is new,
+ *    - the result is older than (refresh_interval) frames, or
+ *    - the input quality (score, size, ...) has improved by (quality_gain).
+ *  the entries not seen for (max_unseen) frames are evicted.
+ */
+int
+attr_cache_init (attr_cache_t *cache, int data_size, const attr_cache_config_t *config)
+{
+    memset (cache, 0, sizeof (*cache));
+
+    if (data_size <= 0 || data_size > ATTR_CACHE_MAX_DATA)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    cache->data_size = data_size;
+    if (config)
+    {
+        cache->config = *config;
+    }
+    else
+    {
+        cache->config.refresh_interval = 30;
+        cache->config.quality_gain     = 0.2f;
+        cache->config.max_unseen       = 30;
+    }
+
+    attr_cache_reset (cache);
+    return 0;
+}
+
+void
+attr_cache_reset (attr_cache_t *cache)
+{
+    for (int i = 0; i < ATTR_CACHE_MAX_ENTRIES; i ++)
+        cache->entry[i].track_id = -1;
+}
+
+
+/* call once per frame before the lookups */
+void
+attr_cache_next_frame (attr_cache_t *cache)
+{
+    cache->frame ++;
+
+    for (int i = 0; i < ATTR_CACHE_MAX_ENTRIES; i ++)
+    {
+        attr_cache_entry_t *e = &cache->entry[i];
+        if (e->track_id >= 0 && cache->frame - e->last_seen > cache->config.max_unseen)
+            e->track_id = -1;
+    }
+}
+
+
+static attr_cache_entry_t *
+find_entry (attr_cache_t *cache, int track_id)
+{
+    for (int i = 0; i < ATTR_CACHE_MAX_ENTRIES; i ++)
+    {
+        if (cache->entry[i].track_id == track_id)
+            return &cache->entry[i];
+    }
+    return NULL;
+}
+
+/*
+ *  return 1 and copy the cached attributes to (data) if they are still valid.
+ *  return 0 if the model should be run. (then call attr_cache_store())
+ */
+int
+attr_cache_lookup (attr_cache_t *cache, int track_id, float quality, void *data)
+{
+    attr_cache_entry_t *e;
+
+    if (track_id < 0 || (e = find_entry (cache, track_id)) == NULL)
+    {
+        cache->num_misses ++;
+        return 0;
+    }
+
+    e->last_seen = cache->frame;
+
+    if ((cache->config.refresh_interval > 0 &&
+         cache->frame - e->last_update >= cache->config.refresh_interval) ||
+        quality > e->quality * (1.0f + cache->config.quality_gain))
+    {
+        cache->num_misses ++;
+        return 0;
+    }
+
+    memcpy (data, e->data, cache->data_size);
+    cache->num_hits ++;
+    return 1;
+}
+
+void
+attr_cache_store (attr_cache_t *cache, int track_id, float quality, const void *data)
+{
+    attr_cache_entry_t *e;
+
+    if (track_id < 0)
+        return;
+
+    e = find_entry (cache, track_id);
+
+    /* a new track takes an empty entry, or the least recently seen one */
+    if (e == NULL)
+    {
+        e = &cache->entry[0];
+        for (int i = 0; i < ATTR_CACHE_MAX_ENTRIES; i ++)
+        {
+            attr_cache_entry_t *cand = &cache->entry[i];
+            if (cand->track_id < 0)
+            {
+                e = cand;
+                break;
+            }
+            if (cand->last_seen < e->last_seen)
+                e = cand;
+        }
+    }
+
+    e->track_id    = track_id;
+    e->last_seen   = cache->frame;
+    e->last_update = cache->frame;
+    e->quality     = quality;
+    memcpy (e->data, data, cache->data_size);
+}
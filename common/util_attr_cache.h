@@ -0,0 +1,54 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_ATTR_CACHE_H_
+#define _UTIL_ATTR_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ATTR_CACHE_MAX_ENTRIES  32
+#define ATTR_CACHE_MAX_DATA     64      /* [bytes] per entry */
+
+typedef struct _attr_cache_config_t
+{
+    int     refresh_interval;   /* re-run the model every N frames of a track (0: never) */
+    float   quality_gain;       /* re-run if the quality improves by this ratio */
+    int     max_unseen;         /* evict the entries not seen for N frames */
+} attr_cache_config_t;
+
+typedef struct _attr_cache_entry_t
+{
+    int     track_id;           /* -1: empty */
+    int     last_seen;          /* frame */
+    int     last_update;        /* frame */
+    float   quality;            /* quality of the input when the data was stored */
+    unsigned char data[ATTR_CACHE_MAX_DATA];
+} attr_cache_entry_t;
+
+typedef struct _attr_cache_t
+{
+    attr_cache_config_t config;
+    int                 data_size;
+    int                 frame;
+    attr_cache_entry_t  entry[ATTR_CACHE_MAX_ENTRIES];
+
+    int                 num_hits;   /* total */
+    int                 num_misses; /* total */
+} attr_cache_t;
+
+
+int  attr_cache_init (attr_cache_t *cache, int data_size, const attr_cache_config_t *config);
+void attr_cache_reset (attr_cache_t *cache);
+
+void attr_cache_next_frame (attr_cache_t *cache);
+int  attr_cache_lookup (attr_cache_t *cache, int track_id, float quality, void *data);
+void attr_cache_store (attr_cache_t *cache, int track_id, float quality, const void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_ATTR_CACHE_H_ */
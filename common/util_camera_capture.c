@@ -9,7 +9,10 @@
 #include "util_v4l2.h"
 #include "util_debug.h"
 #include "util_texture.h"
+#include "util_motion.h"
 #include "util_camera_capture.h"
+#include "util_pmeter.h"
+#include "util_memory.h"
 
 static pthread_t    s_capture_thread;
 static void         *s_capture_buf = NULL;
@@ -19,6 +22,14 @@ static int          s_capcrop_w, s_capcrop_h;
 static int          s_capcropped = 0;
 static unsigned int s_capture_fmt;
 static int          s_force_convert_to_rgba = 0;
+static volatile uint32_t s_capture_seq = 0;  /* incremented for every captured frame */
+
+static int          s_motion_enable = 0;
+static pthread_mutex_t   s_motion_mutex = PTHREAD_MUTEX_INITIALIZER;
+static motion_detector_t s_motion;
+static uint8_t      *s_motion_mask = NULL;  /* snapshot at check_capture_motion() */
+static int          s_motion_cells;
+static float        s_motion_region[4];
 
 #define _max(A, B)    ((A) > (B) ? (A) : (B))
 #define _min(A, B)    ((A) < (B) ? (A) : (B))
@@ -32,6 +43,7 @@ convert_to_rgba8888 (void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsi
     if (s_capture_buf == NULL)
     {
         s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 4);
+        mem_register_buffer ("capture", s_capture_buf, cap_w * cap_h * 4);
     }
 
     if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V') ||
@@ -110,6 +122,7 @@ copy_yuyv_image_cropped (void *buf, int ofstx, int ofsty, int cap_w, int cap_h,
     if (s_capture_buf == NULL)
     {
         s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 2);
+        mem_register_buffer ("capture", s_capture_buf, cap_w * cap_h * 2);
     }
 
     if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V') ||
@@ -143,6 +156,7 @@ copy_yuyv_image (void *buf, int cap_w, int cap_h, unsigned int fmt)
     if (s_capture_buf == NULL)
     {
         s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 2);
+        mem_register_buffer ("capture", s_capture_buf, cap_w * cap_h * 2);
     }
 
     if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V') ||
@@ -171,6 +185,7 @@ capture_thread_main ()
 
         capture_frame_t *frame = v4l2_acquire_capture_frame (s_cap_dev);
 
+        PMETER_SCOPE_BEGIN ("capture");
         if (s_force_convert_to_rgba)
         {
             convert_to_rgba8888 (frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
@@ -182,7 +197,16 @@ capture_thread_main ()
             else
                 copy_yuyv_image (frame->vaddr, s_capcrop_w, s_capcrop_h, s_capture_fmt);
         }
+        if (s_motion_enable)
+        {
+            pthread_mutex_lock (&s_motion_mutex);
+            motion_update_yuyv (&s_motion, frame->vaddr, s_capture_w * 2, ofstx, ofsty,
+                                s_capture_fmt == v4l2_fourcc ('U', 'Y', 'V', 'Y'));
+            pthread_mutex_unlock (&s_motion_mutex);
+        }
+        PMETER_SCOPE_END ();
         v4l2_release_capture_frame (s_cap_dev, frame);
+        s_capture_seq ++;
     }
     return 0;
 }
@@ -231,6 +255,21 @@ init_capture (uint32_t flags)
     {
         s_force_convert_to_rgba = 1;
     }
+
+    if (flags & CAPTURE_MOTION_DETECT)
+    {
+        if (cap_fmt != v4l2_fourcc ('Y', 'U', 'Y', 'V') &&
+            cap_fmt != v4l2_fourcc ('U', 'Y', 'V', 'Y'))
+        {
+            fprintf (stderr, "motion detection needs YUYV capture. disabled.\n");
+        }
+        else if (motion_init (&s_motion, s_capcrop_w, s_capcrop_h, CAPTURE_MOTION_SCALE) == 0)
+        {
+            s_motion_mask = (uint8_t *)calloc (s_motion.mask_w * s_motion.mask_h, 1);
+            mem_register_buffer ("motion_mask", s_motion_mask, s_motion.mask_w * s_motion.mask_h);
+            s_motion_enable = (s_motion_mask != NULL);
+        }
+    }
     
     return 0;
 }
@@ -274,6 +313,95 @@ get_capture_buffer (void ** buf)
     return 0;
 }
 
+/* 0 until the first frame is captured */
+uint32_t
+get_capture_frame_seq ()
+{
+    return s_capture_seq;
+}
+
+
+/* -------------------------------------------------- *
+ *  motion gating (CAPTURE_MOTION_DETECT)
+ *  the luma difference is computed on the capture thread.
+ * -------------------------------------------------- */
+int
+set_capture_motion_config (int pixel_thresh, float area_thresh, int max_skip)
+{
+    if (!s_motion_enable)
+        return -1;
+
+    pthread_mutex_lock (&s_motion_mutex);
+    s_motion.config.pixel_thresh = pixel_thresh;
+    s_motion.config.area_thresh  = area_thresh;
+    s_motion.config.max_skip     = max_skip;
+    pthread_mutex_unlock (&s_motion_mutex);
+    return 0;
+}
+
+/*
+ *  return 1 if the latest frame has changed enough (or too many frames
+ *  have been skipped) to run the inference. always 1 without motion detection.
+ *  the motion mask at this point can be read by get_capture_motion_mask().
+ */
+int
+check_capture_motion (float *score)
+{
+    int need_infer;
+
+    if (!s_motion_enable)
+    {
+        if (score)
+            *score = 1.0f;
+        return 1;
+    }
+
+    pthread_mutex_lock (&s_motion_mutex);
+    need_infer = motion_need_infer (&s_motion);
+    if (need_infer)
+    {
+        memcpy (s_motion_mask, s_motion.mask, s_motion.mask_w * s_motion.mask_h);
+        s_motion_cells = motion_get_region (&s_motion, &s_motion_region[0], &s_motion_region[1],
+                                                       &s_motion_region[2], &s_motion_region[3]);
+    }
+    if (score)
+        *score = s_motion.score;
+    pthread_mutex_unlock (&s_motion_mutex);
+
+    return need_infer;
+}
+
+/* 1 per MOTION_CELL_SIZE cell: changed since the previous inference */
+int
+get_capture_motion_mask (uint8_t **mask, int *mask_w, int *mask_h)
+{
+    if (!s_motion_enable)
+        return -1;
+
+    *mask   = s_motion_mask;
+    *mask_w = s_motion.mask_w;
+    *mask_h = s_motion.mask_h;
+    return 0;
+}
+
+/* bounding box of the changed cells [0, 1]. return the number of the changed cells */
+int
+get_capture_motion_region (float *x1, float *y1, float *x2, float *y2)
+{
+    if (!s_motion_enable)
+    {
+        *x1 = *y1 = 0.0f;
+        *x2 = *y2 = 1.0f;
+        return -1;
+    }
+
+    *x1 = s_motion_region[0];
+    *y1 = s_motion_region[1];
+    *x2 = s_motion_region[2];
+    *y2 = s_motion_region[3];
+    return s_motion_cells;
+}
+
 int
 start_capture ()
 {
@@ -9,11 +9,20 @@
 
 #define CAPTURE_SQUARED_CROP        (1 << 0)
 #define CAPTURE_PIXFORMAT_RGBA      (1 << 1)
+#define CAPTURE_MOTION_DETECT       (1 << 2)
+
+#define CAPTURE_MOTION_SCALE        4       /* downsampling factor of the motion detection */
 
 int init_capture (uint32_t flags);
 int get_capture_dimension (int *width, int *height);
 int get_capture_pixformat (uint32_t *pixformat);
 int get_capture_buffer (void ** buf);
+uint32_t get_capture_frame_seq ();
+
+int set_capture_motion_config (int pixel_thresh, float area_thresh, int max_skip);
+int check_capture_motion (float *score);
+int get_capture_motion_mask (uint8_t **mask, int *mask_w, int *mask_h);
+int get_capture_motion_region (float *x1, float *y1, float *x2, float *y2);
 
 int start_capture ();
 
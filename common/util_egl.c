@@ -439,6 +439,20 @@ egl_swap ()
     return 0;
 }
 
+/*
+ *  dispatch the pending input events without swapping.
+ *  (for the render loop which skips egl_swap() while idle)
+ */
+int
+egl_poll_events ()
+{
+#if !defined(USE_GLX)
+    return winsys_poll_events ();
+#else
+    return glx_poll_events ();
+#endif
+}
+
 int
 egl_set_swap_interval (int interval)
 {
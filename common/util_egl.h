@@ -17,6 +17,7 @@ int egl_init_and_create_eglstream         (int *stream_fd);
 int egl_create_eglstream_surface          (int gles_version, int depth_size, int stencil_size, int sample_num, int win_w, int win_h);
 int egl_terminate ();
 int egl_swap ();
+int egl_poll_events ();
 int egl_set_swap_interval (int interval);
 
 EGLImageKHR egl_create_eglimage (int width, int height);
@@ -0,0 +1,80 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include "util_extrapolate.h"
+
+/*
+ *  render-time extrapolation of the keypoints.
+ *
+ *  a landmark model produces the results at a lower rate than the
+ *  display. the velocity of each value is estimated from the last two
+ *  results, and the values are drawn at (pos + vel * dt), where dt is
+ *  the time elapsed since the latest result. (capped to the horizon,
+ *  so a stopped motion does not overshoot much)
+ */
+void
+extrap_reset (extrap_track_t *et)
+{
+    et->num   = 0;
+    et->valid = 0;
+}
+
+void
+extrap_update (extrap_track_t *et, const float *val, int num, double time_ms)
+{
+    if (num > EXTRAP_MAX_VALUES)
+    {
+        fprintf (stderr, "ERR: %s(%d): too many values (%d)\n", __FILE__, __LINE__, num);
+        num = EXTRAP_MAX_VALUES;
+    }
+
+    double dt = time_ms - et->time_ms;
+
+    /* the first result, or the track has been lost for a while */
+    if (et->valid == 0 || et->num != num || dt <= 0 || dt > EXTRAP_MAX_HORIZON_MS * 4)
+    {
+        memcpy (et->pos, val, num * sizeof (float));
+        memset (et->vel, 0, num * sizeof (float));
+        et->num     = num;
+        et->valid   = 1;
+        et->time_ms = time_ms;
+        return;
+    }
+
+    float inv_dt = 1.0f / (float)dt;
+    for (int i = 0; i < num; i ++)
+    {
+        float v = (val[i] - et->pos[i]) * inv_dt;
+
+        if (et->valid < 2)
+            et->vel[i] = v;
+        else
+            et->vel[i] += EXTRAP_VEL_ALPHA * (v - et->vel[i]);
+
+        et->pos[i] = val[i];
+    }
+
+    et->valid   = 2;
+    et->time_ms = time_ms;
+}
+
+void
+extrap_predict (extrap_track_t *et, double time_ms, float *val)
+{
+    double dt = time_ms - et->time_ms;
+
+    if (et->valid < 2 || dt <= 0)
+    {
+        memcpy (val, et->pos, et->num * sizeof (float));
+        return;
+    }
+
+    if (dt > EXTRAP_MAX_HORIZON_MS)
+        dt = EXTRAP_MAX_HORIZON_MS;
+
+    for (int i = 0; i < et->num; i ++)
+        val[i] = et->pos[i] + et->vel[i] * (float)dt;
+}
@@ -0,0 +1,38 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_EXTRAPOLATE_H_
+#define _UTIL_EXTRAPOLATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXTRAP_MAX_VALUES       (480 * 3)   /* facemesh: 468 keypoints x (x, y, z) */
+#define EXTRAP_MAX_HORIZON_MS   100.0       /* never extrapolate further than this */
+#define EXTRAP_VEL_ALPHA        0.5f        /* smoothing factor of the velocity */
+
+/*
+ *  keypoint state of one track (a hand, a face, a pose).
+ *  the keypoints are packed into an array of floats by the app.
+ */
+typedef struct _extrap_track_t
+{
+    int         num;                        /* number of values */
+    int         valid;                      /* 0: empty, 1: position only, 2: position and velocity */
+    double      time_ms;                    /* time of the latest result */
+    float       pos[EXTRAP_MAX_VALUES];
+    float       vel[EXTRAP_MAX_VALUES];     /* [/ms] */
+} extrap_track_t;
+
+
+void extrap_reset (extrap_track_t *et);
+void extrap_update (extrap_track_t *et, const float *val, int num, double time_ms);
+void extrap_predict (extrap_track_t *et, double time_ms, float *val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_EXTRAPOLATE_H_ */
@@ -0,0 +1,131 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_frame_arena.h"
+#include "util_memory.h"
+
+#define FRAME_ARENA_ALIGN   16
+
+/*
+ *  frame-scoped bump allocator.
+ *
+ *  the scratch memory of the decode and the post-process of a frame is
+ *  taken from one buffer, and all of it is given back at once by
+ *  frame_arena_reset() at the start of the next frame.
+ *  if a frame needs more than the buffer, the allocations which do not fit
+ *  return NULL (the callers fall back to the heap), and the buffer is
+ *  grown to the peak at the next reset. so the heap is touched only
+ *  during the warm-up.
+ */
+static __thread frame_arena_t *s_cur_arena;
+
+
+static int
+alloc_buf (frame_arena_t *arena, size_t size)
+{
+    arena->buf = (unsigned char *)malloc (size);
+    if (arena->buf == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        arena->size = 0;
+        return -1;
+    }
+
+    arena->size = size;
+    mem_register_buffer (arena->name, arena->buf, size);
+    return 0;
+}
+
+int
+frame_arena_init (frame_arena_t *arena, const char *name, size_t size)
+{
+    memset (arena, 0, sizeof (*arena));
+    arena->name = name;
+
+    return alloc_buf (arena, size);
+}
+
+void
+frame_arena_exit (frame_arena_t *arena)
+{
+    if (arena->buf)
+    {
+        mem_unregister_buffer (arena->buf);
+        free (arena->buf);
+    }
+    memset (arena, 0, sizeof (*arena));
+}
+
+void
+frame_arena_reset (frame_arena_t *arena)
+{
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    arena->used = 0;
+
+    if (arena->peak > arena->size)
+    {
+        /* a bit of margin, so that it does not grow frame by frame */
+        size_t size = arena->peak + arena->peak / 4;
+
+        if (arena->buf)
+        {
+            mem_unregister_buffer (arena->buf);
+            free (arena->buf);
+        }
+        alloc_buf (arena, size);
+    }
+}
+
+/* return NULL if (size) does not fit. */
+void *
+frame_arena_alloc (frame_arena_t *arena, size_t size)
+{
+    size_t ofst = (arena->used + FRAME_ARENA_ALIGN - 1) & ~(size_t)(FRAME_ARENA_ALIGN - 1);
+
+    arena->used = ofst + size;
+    if (arena->used > arena->size)
+    {
+        arena->num_overflows ++;
+        return NULL;
+    }
+
+    return arena->buf + ofst;
+}
+
+int
+frame_arena_contains (frame_arena_t *arena, const void *ptr)
+{
+    const unsigned char *p = (const unsigned char *)ptr;
+
+    return (arena->buf && p >= arena->buf && p < arena->buf + arena->size);
+}
+
+
+/*
+ *  reset (arena), and make it the current arena of the calling thread.
+ *  the containers on frame_arena_allocator created until frame_arena_end()
+ *  take their memory from it.
+ */
+void
+frame_arena_begin (frame_arena_t *arena)
+{
+    frame_arena_reset (arena);
+    s_cur_arena = arena;
+}
+
+void
+frame_arena_end ()
+{
+    s_cur_arena = NULL;
+}
+
+frame_arena_t *
+frame_arena_current ()
+{
+    return s_cur_arena;
+}
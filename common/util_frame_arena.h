@@ -0,0 +1,95 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_FRAME_ARENA_H_
+#define _UTIL_FRAME_ARENA_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _frame_arena_t
+{
+    const char      *name;          /* static string, for util_memory */
+    unsigned char   *buf;
+    size_t          size;
+    size_t          used;           /* this frame, including the overflow */
+    size_t          peak;
+    int             num_overflows;  /* total allocations which did not fit */
+} frame_arena_t;
+
+int   frame_arena_init (frame_arena_t *arena, const char *name, size_t size);
+void  frame_arena_exit (frame_arena_t *arena);
+void  frame_arena_reset (frame_arena_t *arena);
+void *frame_arena_alloc (frame_arena_t *arena, size_t size);
+int   frame_arena_contains (frame_arena_t *arena, const void *ptr);
+
+void           frame_arena_begin (frame_arena_t *arena);
+void           frame_arena_end ();
+frame_arena_t *frame_arena_current ();
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#ifdef __cplusplus
+#include <new>
+#include <list>
+#include <vector>
+
+/*
+ *  STL allocator on the current frame arena of the thread, to keep the
+ *  temporary lists and vectors of the post-processes off the heap.
+ *  it takes the arena current at the construction of the container.
+ *  the memory is given back at frame_arena_reset(), not at deallocate().
+ *  an allocation which does not fit falls back to the heap.
+ */
+template <typename T>
+struct frame_arena_allocator
+{
+    typedef T value_type;
+
+    frame_arena_t *arena;
+
+    frame_arena_allocator () : arena (frame_arena_current ()) {}
+
+    template <typename U>
+    frame_arena_allocator (const frame_arena_allocator<U> &a) : arena (a.arena) {}
+
+    T *allocate (size_t n)
+    {
+        void *p = arena ? frame_arena_alloc (arena, n * sizeof (T)) : NULL;
+        if (p == NULL)
+            p = ::operator new (n * sizeof (T));
+        return (T *)p;
+    }
+
+    void deallocate (T *p, size_t n)
+    {
+        if (arena == NULL || !frame_arena_contains (arena, p))
+            ::operator delete (p);
+    }
+};
+
+template <typename T, typename U>
+bool operator== (const frame_arena_allocator<T> &a, const frame_arena_allocator<U> &b)
+{
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!= (const frame_arena_allocator<T> &a, const frame_arena_allocator<U> &b)
+{
+    return a.arena != b.arena;
+}
+
+template <typename T> using arena_list   = std::list  <T, frame_arena_allocator<T> >;
+template <typename T> using arena_vector = std::vector<T, frame_arena_allocator<T> >;
+
+#endif /* __cplusplus */
+
+#endif /* _UTIL_FRAME_ARENA_H_ */
@@ -0,0 +1,80 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <string.h>
+#include <unistd.h>
+#include "util_egl.h"
+#include "util_frame_seq.h"
+
+/*
+ *  frame identity tracking.
+ *
+ *  texture_2d_t::frame_seq changes only when a new capture/video frame is
+ *  uploaded, and it never changes for a still image. so the inference
+ *  result of the last frame is reused as long as the frame_seq is the same,
+ *  and only the rendering is repeated.
+ *
+ *  in the idle mode, the rendering is skipped too until something changes.
+ *  the rendered frame is tracked apart from the inferred one, so a new frame
+ *  is displayed even while the inference of an older one is in flight.
+ */
+void
+frame_seq_init (frame_seq_t *fs, int idle_enable)
+{
+    memset (fs, 0, sizeof (*fs));
+    fs->idle_enable = idle_enable;
+}
+
+/*
+ *  return 1 if the frame has not been inferred yet (and mark it inferred),
+ *  0 if the result of the last inference can be reused.
+ */
+int
+frame_seq_is_new (frame_seq_t *fs, uint32_t frame_seq)
+{
+    if (fs->infer_valid && fs->infer_seq == frame_seq)
+    {
+        fs->num_skipped ++;
+        return 0;
+    }
+
+    fs->infer_seq   = frame_seq;
+    fs->infer_valid = 1;
+    return 1;
+}
+
+/* force the next frame to be inferred. (e.g. the model input is changed) */
+void
+frame_seq_invalidate (frame_seq_t *fs)
+{
+    fs->infer_valid  = 0;
+    fs->render_valid = 0;
+}
+
+/*
+ *  frame_seq: the input frame to be displayed. (texture_2d_t::frame_seq)
+ *  changed  : the scene has been updated by other than a new frame.
+ *             (e.g. an inference result arrived from a worker thread)
+ *
+ *  return 0 in the idle mode if the same scene has already been rendered.
+ *  the caller skips the rendering and egl_swap(). the input events are
+ *  dispatched here instead of egl_swap(), and an input event wakes the
+ *  render loop up. it sleeps a little otherwise, so the loop does not spin.
+ */
+int
+frame_seq_need_render (frame_seq_t *fs, uint32_t frame_seq, int changed)
+{
+    if (!fs->idle_enable || changed || !fs->render_valid || fs->render_seq != frame_seq)
+    {
+        fs->render_seq   = frame_seq;
+        fs->render_valid = 1;
+        return 1;
+    }
+
+    if (egl_poll_events () > 0)
+        return 1;
+
+    usleep (FRAME_SEQ_IDLE_WAIT_MS * 1000);
+    return 0;
+}
@@ -0,0 +1,37 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_FRAME_SEQ_H_
+#define _UTIL_FRAME_SEQ_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_SEQ_IDLE_WAIT_MS  10      /* polling interval while idle */
+
+typedef struct _frame_seq_t
+{
+    uint32_t    infer_seq;              /* frame_seq of the last inferred frame */
+    int         infer_valid;
+    int         idle_enable;
+    uint32_t    render_seq;             /* frame_seq of the last rendered frame */
+    int         render_valid;
+
+    int         num_skipped;            /* inferences skipped for an unchanged frame */
+} frame_seq_t;
+
+
+void frame_seq_init (frame_seq_t *fs, int idle_enable);
+int  frame_seq_is_new (frame_seq_t *fs, uint32_t frame_seq);
+void frame_seq_invalidate (frame_seq_t *fs);
+int  frame_seq_need_render (frame_seq_t *fs, uint32_t frame_seq, int changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_FRAME_SEQ_H_ */
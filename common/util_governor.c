@@ -0,0 +1,191 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include "util_governor.h"
+
+#define GOVERNOR_EMA_ALPHA      0.1
+
+/*
+ *  latency-budget governor.
+ *
+ *  the app reports the latency of its stages every frame, and registers
+ *  the knobs which trade the quality for the latency (detector interval,
+ *  number of threads, quantized model, ...) in the order to be degraded.
+ *
+ *  if the sum of the stage latencies (EMA) exceeds the budget, the first
+ *  knob which can still be degraded is stepped up by one level. if it is
+ *  well below the budget, the last degraded knob is restored by one level.
+ *  after a decision, the governor waits for the latency to settle.
+ */
+void
+governor_init (governor_t *gov, double budget_ms)
+{
+    memset (gov, 0, sizeof (*gov));
+    gov->budget_ms     = budget_ms;
+    gov->hysteresis    = 0.15f;
+    gov->settle_frames = 30;
+    gov->verbose       = 1;
+}
+
+int
+governor_add_stage (governor_t *gov, const char *name)
+{
+    if (gov->num_stages >= GOVERNOR_MAX_STAGES)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    governor_stage_t *stage = &gov->stage[gov->num_stages];
+    memset (stage, 0, sizeof (*stage));
+    stage->name = name;
+
+    return gov->num_stages ++;
+}
+
+int
+governor_add_knob (governor_t *gov, const char *name, int level, int min_level, int max_level,
+                   governor_apply_t apply, void *usrdata)
+{
+    if (gov->num_knobs >= GOVERNOR_MAX_KNOBS)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    governor_knob_t *knob = &gov->knob[gov->num_knobs];
+    knob->name      = name;
+    knob->level     = level;
+    knob->min_level = min_level;
+    knob->max_level = max_level;
+    knob->apply     = apply;
+    knob->usrdata   = usrdata;
+
+    return gov->num_knobs ++;
+}
+
+void
+governor_set_latency (governor_t *gov, int stage_id, double ms)
+{
+    if (stage_id < 0 || stage_id >= gov->num_stages)
+        return;
+
+    governor_stage_t *stage = &gov->stage[stage_id];
+    stage->last_ms = ms;
+    if (stage->valid)
+        stage->ema_ms += GOVERNOR_EMA_ALPHA * (ms - stage->ema_ms);
+    else
+        stage->ema_ms = ms;
+    stage->valid = 1;
+}
+
+
+static int
+step_knob (governor_t *gov, int knob_id, int step)
+{
+    governor_knob_t *knob = &gov->knob[knob_id];
+    int new_level = knob->level + step;
+
+    if (knob->apply && knob->apply (new_level, knob->usrdata) < 0)
+        return -1;
+
+    governor_decision_t *d = &gov->log[gov->num_decisions % GOVERNOR_MAX_LOG];
+    d->frame      = gov->frame;
+    d->knob_id    = knob_id;
+    d->from_level = knob->level;
+    d->to_level   = new_level;
+    d->latency_ms = gov->latency_ms;
+    gov->num_decisions ++;
+
+    if (gov->verbose)
+    {
+        fprintf (stderr, "governor: [%6d] %s %d -> %d (%.1f ms, budget %.1f ms)\n",
+                 d->frame, knob->name, d->from_level, d->to_level, d->latency_ms, gov->budget_ms);
+    }
+
+    knob->level = new_level;
+    gov->last_decision = gov->frame;
+    return 0;
+}
+
+/*
+ *  call once per frame after the latencies are reported.
+ *  return 1 if a knob has been changed.
+ */
+int
+governor_update (governor_t *gov)
+{
+    double latency = 0;
+    int since;
+
+    gov->frame ++;
+
+    for (int i = 0; i < gov->num_stages; i ++)
+        latency += gov->stage[i].ema_ms;
+    gov->latency_ms = latency;
+
+    since = gov->frame - gov->last_decision;
+    if (since < gov->settle_frames)
+        return 0;
+
+    /* over budget: degrade the first knob which has some room */
+    if (latency > gov->budget_ms * (1.0 + gov->hysteresis))
+    {
+        for (int i = 0; i < gov->num_knobs; i ++)
+        {
+            if (gov->knob[i].level < gov->knob[i].max_level)
+                return (step_knob (gov, i, +1) == 0);
+        }
+        return 0;
+    }
+
+    /* well within budget: restore the last degraded knob, a bit more carefully */
+    if (latency < gov->budget_ms * (1.0 - gov->hysteresis) && since >= gov->settle_frames * 2)
+    {
+        for (int i = gov->num_knobs - 1; i >= 0; i --)
+        {
+            if (gov->knob[i].level > gov->knob[i].min_level)
+                return (step_knob (gov, i, -1) == 0);
+        }
+    }
+
+    return 0;
+}
+
+int
+governor_get_level (governor_t *gov, int knob_id)
+{
+    if (knob_id < 0 || knob_id >= gov->num_knobs)
+        return 0;
+
+    return gov->knob[knob_id].level;
+}
+
+/* idx 0: the latest decision. NULL if not exist */
+const governor_decision_t *
+governor_get_decision (governor_t *gov, int idx)
+{
+    if (idx < 0 || idx >= gov->num_decisions || idx >= GOVERNOR_MAX_LOG)
+        return NULL;
+
+    return &gov->log[(gov->num_decisions - 1 - idx) % GOVERNOR_MAX_LOG];
+}
+
+/* for draw_dbgstr() */
+int
+governor_format_stats (governor_t *gov, char *buf, int size)
+{
+    int len = 0;
+
+    len += snprintf (buf + len, size - len, "Budget  :%5.1f/%5.1f [ms]\n", gov->latency_ms, gov->budget_ms);
+    for (int i = 0; i < gov->num_knobs && len < size; i ++)
+    {
+        governor_knob_t *knob = &gov->knob[i];
+        len += snprintf (buf + len, size - len, " %-14s:%d\n", knob->name, knob->level);
+    }
+
+    return len;
+}
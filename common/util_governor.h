@@ -0,0 +1,86 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_GOVERNOR_H_
+#define _UTIL_GOVERNOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GOVERNOR_MAX_STAGES     8
+#define GOVERNOR_MAX_KNOBS      8
+#define GOVERNOR_MAX_LOG        16
+
+/*
+ *  apply a new level of the knob. a higher level is cheaper.
+ *  return 0 if applied, -1 to retry later (e.g. the worker thread is busy).
+ */
+typedef int (*governor_apply_t) (int level, void *usrdata);
+
+typedef struct _governor_stage_t
+{
+    const char  *name;
+    double      last_ms;
+    double      ema_ms;
+    int         valid;
+} governor_stage_t;
+
+typedef struct _governor_knob_t
+{
+    const char          *name;
+    int                 level;
+    int                 min_level;
+    int                 max_level;
+    governor_apply_t    apply;
+    void                *usrdata;
+} governor_knob_t;
+
+typedef struct _governor_decision_t
+{
+    int         frame;
+    int         knob_id;
+    int         from_level;
+    int         to_level;
+    double      latency_ms;
+} governor_decision_t;
+
+typedef struct _governor_t
+{
+    double              budget_ms;      /* target of the sum of the stage latencies */
+    float               hysteresis;     /* degrade above budget*(1+h), restore below budget*(1-h) */
+    int                 settle_frames;  /* frames to wait after a decision */
+    int                 verbose;        /* print the decisions to stderr */
+
+    governor_stage_t    stage[GOVERNOR_MAX_STAGES];
+    int                 num_stages;
+    governor_knob_t     knob[GOVERNOR_MAX_KNOBS];
+    int                 num_knobs;
+
+    double              latency_ms;     /* the latest sum of the stage EMAs */
+    int                 frame;
+    int                 last_decision;  /* frame of the last decision */
+
+    governor_decision_t log[GOVERNOR_MAX_LOG];
+    int                 num_decisions;  /* total. log[] keeps the last GOVERNOR_MAX_LOG */
+} governor_t;
+
+
+void governor_init (governor_t *gov, double budget_ms);
+int  governor_add_stage (governor_t *gov, const char *name);
+int  governor_add_knob (governor_t *gov, const char *name, int level, int min_level, int max_level,
+                        governor_apply_t apply, void *usrdata);
+
+void governor_set_latency (governor_t *gov, int stage_id, double ms);
+int  governor_update (governor_t *gov);
+int  governor_get_level (governor_t *gov, int knob_id);
+
+const governor_decision_t *governor_get_decision (governor_t *gov, int idx);
+int  governor_format_stats (governor_t *gov, char *buf, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_GOVERNOR_H_ */
@@ -0,0 +1,472 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_graph.h"
+#include "util_pmeter.h"
+
+/*
+ *  a small dataflow graph runtime.
+ *
+ *  the graph is described by a text file, one node per line:
+ *
+ *      # comment
+ *      node <name> <type> [in=<stream>,...] [out=<stream>,...] [<key>=<value> ...]
+ *
+ *  a stream is the output packet of one node. it is referenced by name from
+ *  the inputs of the following nodes, so the nodes must be listed in a
+ *  topological order. the packet type names of both ends are checked at load.
+ *
+ *  every frame, graph_run() processes the nodes level by level. the nodes of
+ *  the same level are independent each other: the non-GL nodes run on the
+ *  thread pool, while the GL nodes run on the caller (GL context) thread.
+ */
+#define LATENCY_SMOOTH  0.9
+
+static const graph_node_def_t *s_node_defs[GRAPH_MAX_NODE_TYPES];
+static int                     s_num_node_defs;
+
+
+int
+graph_register_node (const graph_node_def_t *def)
+{
+    for (int i = 0; i < s_num_node_defs; i ++)
+    {
+        if (strcmp (s_node_defs[i]->type, def->type) == 0)
+            return 0;
+    }
+
+    if (s_num_node_defs >= GRAPH_MAX_NODE_TYPES)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    s_node_defs[s_num_node_defs ++] = def;
+    return 0;
+}
+
+static const graph_node_def_t *
+find_node_def (const char *type)
+{
+    for (int i = 0; i < s_num_node_defs; i ++)
+    {
+        if (strcmp (s_node_defs[i]->type, type) == 0)
+            return s_node_defs[i];
+    }
+    return NULL;
+}
+
+static int
+find_stream (graph_t *graph, const char *name)
+{
+    for (int i = 0; i < graph->num_streams; i ++)
+    {
+        if (strcmp (graph->streams[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int
+count_types (const char * const *types)
+{
+    int num = 0;
+    while (num < GRAPH_MAX_PORTS && types[num])
+        num ++;
+    return num;
+}
+
+
+/* -------------------------------------------------- *
+ *  config parser
+ * -------------------------------------------------- */
+static int
+parse_inputs (graph_t *graph, graph_node_t *node, char *list, int lineno)
+{
+    char *save;
+
+    for (char *s = strtok_r (list, ",", &save); s; s = strtok_r (NULL, ",", &save))
+    {
+        int idx = find_stream (graph, s);
+        if (idx < 0)
+        {
+            fprintf (stderr, "ERR: graph(%d): unknown stream \"%s\"\n", lineno, s);
+            return -1;
+        }
+        if (node->num_inputs >= GRAPH_MAX_PORTS)
+        {
+            fprintf (stderr, "ERR: graph(%d): too many inputs\n", lineno);
+            return -1;
+        }
+        node->inputs[node->num_inputs ++] = idx;
+    }
+    return 0;
+}
+
+static int
+parse_outputs (graph_t *graph, graph_node_t *node, char *list, int lineno)
+{
+    char *save;
+
+    for (char *s = strtok_r (list, ",", &save); s; s = strtok_r (NULL, ",", &save))
+    {
+        if (find_stream (graph, s) >= 0)
+        {
+            fprintf (stderr, "ERR: graph(%d): stream \"%s\" has two producers\n", lineno, s);
+            return -1;
+        }
+        if (node->num_outputs >= GRAPH_MAX_PORTS || graph->num_streams >= GRAPH_MAX_STREAMS)
+        {
+            fprintf (stderr, "ERR: graph(%d): too many outputs\n", lineno);
+            return -1;
+        }
+
+        graph_stream_t *stream = &graph->streams[graph->num_streams];
+        snprintf (stream->name, sizeof (stream->name), "%s", s);
+        stream->producer = graph->num_nodes;
+        node->outputs[node->num_outputs ++] = graph->num_streams ++;
+    }
+    return 0;
+}
+
+/* check the port counts and the packet types, and allocate the output packets */
+static int
+connect_node (graph_t *graph, graph_node_t *node, int lineno)
+{
+    const graph_node_def_t *def = node->def;
+
+    if (node->num_inputs != count_types (def->input_types) ||
+        node->num_outputs != count_types (def->output_types))
+    {
+        fprintf (stderr, "ERR: graph(%d): %s takes %d inputs and %d outputs\n", lineno,
+                 def->type, count_types (def->input_types), count_types (def->output_types));
+        return -1;
+    }
+
+    node->level = 0;
+    for (int i = 0; i < node->num_inputs; i ++)
+    {
+        graph_stream_t *stream = &graph->streams[node->inputs[i]];
+        if (strcmp (stream->type, def->input_types[i]) != 0)
+        {
+            fprintf (stderr, "ERR: graph(%d): %s.in[%d] expects \"%s\", but \"%s\" is \"%s\"\n",
+                     lineno, node->name, i, def->input_types[i], stream->name, stream->type);
+            return -1;
+        }
+
+        int level = graph->nodes[stream->producer].level + 1;
+        if (node->level < level)
+            node->level = level;
+    }
+
+    for (int i = 0; i < node->num_outputs; i ++)
+    {
+        graph_stream_t *stream = &graph->streams[node->outputs[i]];
+        stream->type = def->output_types[i];
+        stream->buf  = calloc (1, def->output_sizes[i]);
+        if (stream->buf == NULL)
+        {
+            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    if (graph->num_levels < node->level + 1)
+        graph->num_levels = node->level + 1;
+
+    return 0;
+}
+
+static int
+parse_node (graph_t *graph, char *line, int lineno)
+{
+    char *save;
+    char *name = strtok_r (line, " \t\r\n", &save);
+    char *type = strtok_r (NULL, " \t\r\n", &save);
+
+    if (name == NULL || type == NULL)
+    {
+        fprintf (stderr, "ERR: graph(%d): \"node <name> <type> ...\" expected\n", lineno);
+        return -1;
+    }
+
+    const graph_node_def_t *def = find_node_def (type);
+    if (def == NULL)
+    {
+        fprintf (stderr, "ERR: graph(%d): unknown node type \"%s\"\n", lineno, type);
+        return -1;
+    }
+
+    if (graph->num_nodes >= GRAPH_MAX_NODES)
+    {
+        fprintf (stderr, "ERR: graph(%d): too many nodes\n", lineno);
+        return -1;
+    }
+
+    for (int i = 0; i < graph->num_nodes; i ++)
+    {
+        if ((def->flags & GRAPH_NODE_SINGLE) && graph->nodes[i].def == def)
+        {
+            fprintf (stderr, "ERR: graph(%d): only one %s node is allowed\n", lineno, type);
+            return -1;
+        }
+        if (strcmp (graph->nodes[i].name, name) == 0)
+        {
+            fprintf (stderr, "ERR: graph(%d): duplicated node name \"%s\"\n", lineno, name);
+            return -1;
+        }
+    }
+
+    graph_node_t *node = &graph->nodes[graph->num_nodes];
+    memset (node, 0, sizeof (*node));
+    node->def   = def;
+    node->graph = graph;
+    snprintf (node->name, sizeof (node->name), "%s", name);
+
+    for (char *tok = strtok_r (NULL, " \t\r\n", &save); tok; tok = strtok_r (NULL, " \t\r\n", &save))
+    {
+        char *val = strchr (tok, '=');
+        if (val == NULL)
+        {
+            fprintf (stderr, "ERR: graph(%d): \"%s\" is not <key>=<value>\n", lineno, tok);
+            return -1;
+        }
+        *val ++ = '\0';
+
+        if (strcmp (tok, "in") == 0)
+        {
+            if (parse_inputs (graph, node, val, lineno) < 0)
+                return -1;
+        }
+        else if (strcmp (tok, "out") == 0)
+        {
+            if (parse_outputs (graph, node, val, lineno) < 0)
+                return -1;
+        }
+        else
+        {
+            if (node->num_params >= GRAPH_MAX_PARAMS)
+            {
+                fprintf (stderr, "ERR: graph(%d): too many params\n", lineno);
+                return -1;
+            }
+            snprintf (node->param_key[node->num_params], sizeof (node->param_key[0]), "%s", tok);
+            snprintf (node->param_val[node->num_params], sizeof (node->param_val[0]), "%s", val);
+            node->num_params ++;
+        }
+    }
+
+    if (connect_node (graph, node, lineno) < 0)
+        return -1;
+
+    graph->num_nodes ++;
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  load / exit
+ * -------------------------------------------------- */
+int
+graph_load (graph_t *graph, const char *fname, int num_threads)
+{
+    char line[1024];
+    int  lineno = 0;
+
+    memset (graph, 0, sizeof (*graph));
+
+    FILE *fp = fopen (fname, "r");
+    if (fp == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d): can't open %s\n", __FILE__, __LINE__, fname);
+        return -1;
+    }
+
+    while (fgets (line, sizeof (line), fp))
+    {
+        lineno ++;
+
+        char *comment = strchr (line, '#');
+        if (comment)
+            *comment = '\0';
+
+        char *save;
+        char *keyword = strtok_r (line, " \t\r\n", &save);
+        if (keyword == NULL)
+            continue;
+
+        if (strcmp (keyword, "node") != 0)
+        {
+            fprintf (stderr, "ERR: graph(%d): unknown keyword \"%s\"\n", lineno, keyword);
+            goto err_exit;
+        }
+
+        if (parse_node (graph, save, lineno) < 0)
+            goto err_exit;
+    }
+    fclose (fp);
+    fp = NULL;
+
+    /* model init (and GL resources) on the caller thread */
+    for (int i = 0; i < graph->num_nodes; i ++)
+    {
+        graph_node_t *node = &graph->nodes[i];
+        if (node->def->init && node->def->init (node) < 0)
+        {
+            fprintf (stderr, "ERR: %s(%d): init of \"%s\" failed\n", __FILE__, __LINE__, node->name);
+            graph->num_nodes = i;
+            goto err_exit;
+        }
+    }
+
+    threadpool_init (&graph->pool, num_threads);
+
+    for (int lv = 0; lv < graph->num_levels; lv ++)
+    {
+        fprintf (stderr, "graph level[%d]:", lv);
+        for (int i = 0; i < graph->num_nodes; i ++)
+        {
+            if (graph->nodes[i].level == lv)
+                fprintf (stderr, " %s(%s)", graph->nodes[i].name, graph->nodes[i].def->type);
+        }
+        fprintf (stderr, "\n");
+    }
+
+    return 0;
+
+err_exit:
+    if (fp)
+        fclose (fp);
+    for (int i = 0; i < graph->num_nodes; i ++)
+    {
+        if (graph->nodes[i].def->exit)
+            graph->nodes[i].def->exit (&graph->nodes[i]);
+    }
+    for (int i = 0; i < graph->num_streams; i ++)
+        free (graph->streams[i].buf);
+    memset (graph, 0, sizeof (*graph));
+    return -1;
+}
+
+void
+graph_exit (graph_t *graph)
+{
+    threadpool_exit (&graph->pool);
+
+    for (int i = 0; i < graph->num_nodes; i ++)
+    {
+        if (graph->nodes[i].def->exit)
+            graph->nodes[i].def->exit (&graph->nodes[i]);
+    }
+
+    for (int i = 0; i < graph->num_streams; i ++)
+        free (graph->streams[i].buf);
+
+    memset (graph, 0, sizeof (*graph));
+}
+
+
+/* -------------------------------------------------- *
+ *  run
+ * -------------------------------------------------- */
+static int
+process_node (graph_node_t *node)
+{
+    graph_t *graph = node->graph;
+    void *inputs [GRAPH_MAX_PORTS];
+    void *outputs[GRAPH_MAX_PORTS];
+
+    for (int i = 0; i < node->num_inputs; i ++)
+        inputs[i] = graph->streams[node->inputs[i]].buf;
+    for (int i = 0; i < node->num_outputs; i ++)
+        outputs[i] = graph->streams[node->outputs[i]].buf;
+
+    double t0 = pmeter_get_time_ms ();
+    int ret = node->def->process (node, inputs, outputs);
+    double t1 = pmeter_get_time_ms ();
+
+    if (node->latency_ms == 0)
+        node->latency_ms = t1 - t0;
+    else
+        node->latency_ms = LATENCY_SMOOTH * node->latency_ms + (1.0 - LATENCY_SMOOTH) * (t1 - t0);
+
+    if (ret < 0)
+        fprintf (stderr, "ERR: %s(%d): \"%s\" failed\n", __FILE__, __LINE__, node->name);
+
+    return ret;
+}
+
+static void
+process_node_task (void *arg)
+{
+    process_node ((graph_node_t *)arg);
+}
+
+/*
+ *  process one frame. the output packets of the previous level are complete
+ *  before the next level starts.
+ */
+int
+graph_run (graph_t *graph)
+{
+    int ret = 0;
+
+    for (int lv = 0; lv < graph->num_levels; lv ++)
+    {
+        for (int i = 0; i < graph->num_nodes; i ++)
+        {
+            graph_node_t *node = &graph->nodes[i];
+            if (node->level == lv && !(node->def->flags & GRAPH_NODE_GL))
+                threadpool_submit (&graph->pool, process_node_task, node);
+        }
+
+        for (int i = 0; i < graph->num_nodes; i ++)
+        {
+            graph_node_t *node = &graph->nodes[i];
+            if (node->level == lv && (node->def->flags & GRAPH_NODE_GL))
+            {
+                if (process_node (node) < 0)
+                    ret = -1;
+            }
+        }
+
+        threadpool_wait (&graph->pool);
+    }
+
+    return ret;
+}
+
+
+/* -------------------------------------------------- *
+ *  utilities
+ * -------------------------------------------------- */
+const char *
+graph_node_get_param (graph_node_t *node, const char *key, const char *default_val)
+{
+    for (int i = 0; i < node->num_params; i ++)
+    {
+        if (strcmp (node->param_key[i], key) == 0)
+            return node->param_val[i];
+    }
+    return default_val;
+}
+
+int
+graph_format_stats (graph_t *graph, char *buf, int size)
+{
+    int len = 0;
+
+    for (int i = 0; i < graph->num_nodes && len < size; i ++)
+    {
+        graph_node_t *node = &graph->nodes[i];
+        len += snprintf (buf + len, size - len, "%s%-10s:%5.1f [ms] L%d%s",
+                         i ? "\n" : "", node->name, node->latency_ms, node->level,
+                         (node->def->flags & GRAPH_NODE_GL) ? " GL" : "");
+    }
+
+    return len;
+}
@@ -0,0 +1,103 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_GRAPH_H_
+#define _UTIL_GRAPH_H_
+
+#include <stddef.h>
+#include "util_threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GRAPH_MAX_NODES         32
+#define GRAPH_MAX_STREAMS       64
+#define GRAPH_MAX_PORTS         4
+#define GRAPH_MAX_PARAMS        8
+#define GRAPH_MAX_NODE_TYPES    64
+
+/* flags for graph_node_def_t */
+#define GRAPH_NODE_GL           (1 << 0)    /* uses GL. runs on the caller thread           */
+#define GRAPH_NODE_SINGLE       (1 << 1)    /* wraps module statics. one instance per graph */
+
+typedef struct _graph_node_t graph_node_t;
+
+/*
+ *  a node type. registered once with graph_register_node().
+ *
+ *  input_types[] / output_types[] are NULL terminated lists of packet type
+ *  names. an edge is valid only if the producer and the consumer agree on
+ *  the type name. output_sizes[] is the byte size of each output packet,
+ *  the runtime owns the buffers.
+ */
+typedef struct _graph_node_def_t
+{
+    const char  *type;
+    int         flags;
+    const char  *input_types [GRAPH_MAX_PORTS + 1];
+    const char  *output_types[GRAPH_MAX_PORTS + 1];
+    size_t      output_sizes [GRAPH_MAX_PORTS];
+
+    int  (*init)    (graph_node_t *node);
+    int  (*process) (graph_node_t *node, void **inputs, void **outputs);
+    void (*exit)    (graph_node_t *node);
+} graph_node_def_t;
+
+struct _graph_node_t
+{
+    const graph_node_def_t *def;
+    char        name[32];
+
+    int         num_inputs;
+    int         num_outputs;
+    int         inputs [GRAPH_MAX_PORTS];   /* stream index */
+    int         outputs[GRAPH_MAX_PORTS];
+
+    int         num_params;
+    char        param_key[GRAPH_MAX_PARAMS][32];
+    char        param_val[GRAPH_MAX_PARAMS][128];
+
+    int         level;                      /* longest path from a source node */
+    double      latency_ms;                 /* moving average of process()     */
+    void        *usrdata;
+
+    struct _graph_t *graph;
+};
+
+typedef struct _graph_stream_t
+{
+    char        name[32];
+    const char  *type;
+    void        *buf;
+    int         producer;                   /* node index */
+} graph_stream_t;
+
+typedef struct _graph_t
+{
+    int             num_nodes;
+    graph_node_t    nodes[GRAPH_MAX_NODES];
+
+    int             num_streams;
+    graph_stream_t  streams[GRAPH_MAX_STREAMS];
+
+    int             num_levels;
+    threadpool_t    pool;
+} graph_t;
+
+
+int         graph_register_node (const graph_node_def_t *def);
+
+int         graph_load (graph_t *graph, const char *fname, int num_threads);
+int         graph_run (graph_t *graph);
+void        graph_exit (graph_t *graph);
+
+const char *graph_node_get_param (graph_node_t *node, const char *key, const char *default_val);
+int         graph_format_stats (graph_t *graph, char *buf, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_GRAPH_H_ */
@@ -0,0 +1,299 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include "util_heatmap.h"
+#include "util_debug.h"
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#include <arm_neon.h>
+#define HEATMAP_USE_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define HEATMAP_USE_SSE2
+#endif
+
+
+/* -------------------------------------------------- *
+ *  per-channel max/argmax in one contiguous pass.
+ *
+ *  the tensor is NHWC, so the channels of one cell are
+ *  contiguous. SIMD lanes are mapped to channels and the
+ *  running max/argmax of each channel is kept in
+ *  (max_val[], max_idx[]), which stay in L1.
+ *
+ *  ties keep the first cell in raster order, same as the
+ *  scalar "if (val > max)" loops this replaces.
+ * -------------------------------------------------- */
+void
+heatmap_argmax (const heatmap_t *hmp, int *max_idx, float *max_val)
+{
+    int ch       = hmp->ch;
+    int cell_num = hmp->w * hmp->h;
+    const float *p = hmp->ptr;
+
+    for (int c = 0; c < ch; c ++)
+    {
+        max_val[c] = -FLT_MAX;
+        max_idx[c] = 0;
+    }
+
+    for (int i = 0; i < cell_num; i ++, p += ch)
+    {
+        int c = 0;
+#if defined (HEATMAP_USE_NEON)
+        int32x4_t vi = vdupq_n_s32 (i);
+        for (; c + 4 <= ch; c += 4)
+        {
+            float32x4_t v  = vld1q_f32 (p + c);
+            float32x4_t m  = vld1q_f32 (max_val + c);
+            int32x4_t   mi = vld1q_s32 (max_idx + c);
+            uint32x4_t  gt = vcgtq_f32 (v, m);
+            vst1q_f32 (max_val + c, vbslq_f32 (gt, v,  m));
+            vst1q_s32 (max_idx + c, vbslq_s32 (gt, vi, mi));
+        }
+#elif defined (HEATMAP_USE_SSE2)
+        __m128i vi = _mm_set1_epi32 (i);
+        for (; c + 4 <= ch; c += 4)
+        {
+            __m128  v   = _mm_loadu_ps (p + c);
+            __m128  m   = _mm_loadu_ps (max_val + c);
+            __m128i mi  = _mm_loadu_si128 ((__m128i *)(max_idx + c));
+            __m128  gt  = _mm_cmpgt_ps (v, m);
+            __m128i gti = _mm_castps_si128 (gt);
+            _mm_storeu_ps (max_val + c, _mm_or_ps (_mm_and_ps (gt, v), _mm_andnot_ps (gt, m)));
+            _mm_storeu_si128 ((__m128i *)(max_idx + c),
+                              _mm_or_si128 (_mm_and_si128 (gti, vi), _mm_andnot_si128 (gti, mi)));
+        }
+#endif
+        for (; c < ch; c ++)
+        {
+            if (p[c] > max_val[c])
+            {
+                max_val[c] = p[c];
+                max_idx[c] = i;
+            }
+        }
+    }
+}
+
+
+static float
+get_heatmap_val (const heatmap_t *hmp, int x, int y, int c)
+{
+    return hmp->ptr[(y * hmp->w + x) * hmp->ch + c];
+}
+
+/*
+ *  fit a parabola to (v0, v1, v2) centered on v1 and
+ *  return the offset of its vertex. (-0.5 ... +0.5)
+ */
+static float
+get_subpixel_shift (float v0, float v1, float v2)
+{
+    float denom = v0 - 2.0f * v1 + v2;
+    if (denom >= 0.0f)
+        return 0.0f;
+
+    float d = 0.5f * (v0 - v2) / denom;
+    if (d < -0.5f) d = -0.5f;
+    if (d >  0.5f) d =  0.5f;
+    return d;
+}
+
+static void
+refine_subpixel (const heatmap_t *hmp, int c, heatmap_peak_t *peak)
+{
+    int x = peak->idx_x;
+    int y = peak->idx_y;
+    float v = get_heatmap_val (hmp, x, y, c);
+
+    if (x > 0 && x < hmp->w - 1)
+    {
+        float l = get_heatmap_val (hmp, x - 1, y, c);
+        float r = get_heatmap_val (hmp, x + 1, y, c);
+        peak->pos_x += get_subpixel_shift (l, v, r);
+    }
+
+    if (y > 0 && y < hmp->h - 1)
+    {
+        float t = get_heatmap_val (hmp, x, y - 1, c);
+        float b = get_heatmap_val (hmp, x, y + 1, c);
+        peak->pos_y += get_subpixel_shift (t, v, b);
+    }
+}
+
+static void
+get_offset_vector (const heatmap_t *hmp, const heatmap_offset_t *ofst, int key, heatmap_peak_t *peak)
+{
+    int slot = ofst->key_remap ? ofst->key_remap[key] : key;
+    const float *cell = ofst->ptr + (peak->idx_y * hmp->w + peak->idx_x) * ofst->ch;
+
+    for (int i = 0; i < 3; i ++)
+    {
+        int comp = ofst->comp_ofst[i];
+        peak->ofst[i] = (comp < 0) ? 0.0f : cell[ofst->key_stride * slot + comp];
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  single pose decode:
+ *    argmax of every channel, then the offset vector
+ *    at each peak and optional sub-pixel refinement.
+ * -------------------------------------------------- */
+int
+heatmap_decode_keypoints (const heatmap_t *hmp, const heatmap_offset_t *ofst,
+                          int flags, heatmap_peak_t *peaks)
+{
+    int   max_idx[HEATMAP_MAX_CH];
+    float max_val[HEATMAP_MAX_CH];
+
+    if (hmp->ch > HEATMAP_MAX_CH)
+    {
+        DBG_LOGE ("ERR: %s(%d): too many channels (%d)\n", __FILE__, __LINE__, hmp->ch);
+        return -1;
+    }
+
+    heatmap_argmax (hmp, max_idx, max_val);
+
+    for (int c = 0; c < hmp->ch; c ++)
+    {
+        heatmap_peak_t *peak = &peaks[c];
+
+        peak->idx_x = max_idx[c] % hmp->w;
+        peak->idx_y = max_idx[c] / hmp->w;
+        peak->score = max_val[c];
+        peak->pos_x = (float)peak->idx_x;
+        peak->pos_y = (float)peak->idx_y;
+
+        if (flags & HEATMAP_FLAG_SUBPIXEL)
+            refine_subpixel (hmp, c, peak);
+
+        if (ofst)
+            get_offset_vector (hmp, ofst, c, peak);
+        else
+            memset (peak->ofst, 0, sizeof (peak->ofst));
+    }
+
+    return hmp->ch;
+}
+
+
+/* -------------------------------------------------- *
+ *  return the first index (>= x) of a contiguous row whose value
+ *  is >= thresh, or w if there is none.
+ *  4 values are tested at once.
+ * -------------------------------------------------- */
+int
+heatmap_find_next_above (const float *row, int x, int w, float thresh)
+{
+#if defined (HEATMAP_USE_NEON)
+    float32x4_t vth = vdupq_n_f32 (thresh);
+    for (; x + 4 <= w; x += 4)
+    {
+        uint32x4_t ge = vcgeq_f32 (vld1q_f32 (row + x), vth);
+        uint32x2_t or2 = vorr_u32 (vget_low_u32 (ge), vget_high_u32 (ge));
+        if (vget_lane_u32 (vpmax_u32 (or2, or2), 0))
+            break;
+    }
+#elif defined (HEATMAP_USE_SSE2)
+    __m128 vth = _mm_set1_ps (thresh);
+    for (; x + 4 <= w; x += 4)
+    {
+        if (_mm_movemask_ps (_mm_cmpge_ps (_mm_loadu_ps (row + x), vth)))
+            break;
+    }
+#endif
+
+    for (; x < w; x ++)
+    {
+        if (row[x] >= thresh)
+            return x;
+    }
+    return w;
+}
+
+/* -------------------------------------------------- *
+ *  local maxima of a single channel.
+ *
+ *  equivalent to "val >= thresh && val >= dilate(val)",
+ *  but the (2r+1)x(2r+1) window is only visited for the
+ *  few cells above the threshold, so no dilated copy of
+ *  the heatmap is needed.
+ * -------------------------------------------------- */
+static int
+find_next_candidate (const heatmap_t *hmp, const float *row, int x, int c, float thresh)
+{
+    if (hmp->ch == 1)
+        return heatmap_find_next_above (row, x, hmp->w, thresh);
+
+    for (; x < hmp->w; x ++)
+    {
+        if (row[x * hmp->ch + c] >= thresh)
+            return x;
+    }
+    return hmp->w;
+}
+
+static int
+is_max_in_local_window (const heatmap_t *hmp, int c, int cx, int cy, int radius, float val)
+{
+    int sx = cx - radius;
+    int ex = cx + radius + 1;
+    int sy = cy - radius;
+    int ey = cy + radius + 1;
+
+    if (sx < 0)      sx = 0;
+    if (sy < 0)      sy = 0;
+    if (ex > hmp->w) ex = hmp->w;
+    if (ey > hmp->h) ey = hmp->h;
+
+    for (int y = sy; y < ey; y ++)
+    {
+        for (int x = sx; x < ex; x ++)
+        {
+            if (get_heatmap_val (hmp, x, y, c) > val)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+int
+heatmap_find_local_max (const heatmap_t *hmp, int ch, int radius, float thresh,
+                        heatmap_peak_t *peaks, int max_num)
+{
+    int num = 0;
+
+    for (int y = 0; y < hmp->h; y ++)
+    {
+        const float *row = hmp->ptr + y * hmp->w * hmp->ch;
+        int x = 0;
+
+        while ((x = find_next_candidate (hmp, row, x, ch, thresh)) < hmp->w)
+        {
+            float val = row[x * hmp->ch + ch];
+
+            if (is_max_in_local_window (hmp, ch, x, y, radius, val))
+            {
+                heatmap_peak_t *peak = &peaks[num];
+                memset (peak, 0, sizeof (*peak));
+                peak->idx_x = x;
+                peak->idx_y = y;
+                peak->score = val;
+                peak->pos_x = (float)x;
+                peak->pos_y = (float)y;
+
+                if (++ num >= max_num)
+                    return num;
+            }
+            x ++;
+        }
+    }
+
+    return num;
+}
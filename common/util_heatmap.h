@@ -0,0 +1,68 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_HEATMAP_H_
+#define _UTIL_HEATMAP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HEATMAP_MAX_CH          64
+
+/* flags for heatmap_decode_keypoints() */
+#define HEATMAP_FLAG_SUBPIXEL   (1 << 0)
+
+/* heatmap tensor in NHWC layout (N = 1) */
+typedef struct _heatmap_t
+{
+    const float *ptr;
+    int         w;
+    int         h;
+    int         ch;
+} heatmap_t;
+
+/*
+ *  offset tensor in NHWC layout.
+ *  the channel of component [comp] of keypoint [key] is:
+ *      key_stride * key_remap[key] + comp_ofst[comp]
+ *  (comp_ofst[comp] < 0 means the component is not present.)
+ *
+ *  posenet : key_stride = 1, comp_ofst = {K, 0, -1}   (y planes first)
+ *  pose3d  : key_stride = 3, comp_ofst = {0, 1,  2}   (xyz interleaved)
+ */
+typedef struct _heatmap_offset_t
+{
+    const float *ptr;
+    int         ch;
+    int         key_stride;
+    int         comp_ofst[3];
+    const int   *key_remap;     /* NULL: identity */
+} heatmap_offset_t;
+
+typedef struct _heatmap_peak_t
+{
+    int   idx_x;                /* heatmap cell of the peak */
+    int   idx_y;
+    float score;
+    float pos_x;                /* peak position in cell units (sub-pixel refined) */
+    float pos_y;
+    float ofst[3];              /* offset vector at the peak cell */
+} heatmap_peak_t;
+
+
+void heatmap_argmax (const heatmap_t *hmp, int *max_idx, float *max_val);
+
+int  heatmap_decode_keypoints (const heatmap_t *hmp, const heatmap_offset_t *ofst,
+                               int flags, heatmap_peak_t *peaks);
+
+int  heatmap_find_next_above (const float *row, int x, int w, float thresh);
+int  heatmap_find_local_max (const heatmap_t *hmp, int ch, int radius, float thresh,
+                             heatmap_peak_t *peaks, int max_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_HEATMAP_H_ */
@@ -0,0 +1,124 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include "util_image_crop.h"
+
+/*
+ *  CPU version of the "draw the ROI to the FBO and glReadPixels()" crop,
+ *  for the stages which run off the GL thread.
+ *  the source is an RGBA image (top row first), sampled bilinearly with
+ *  clamp-to-edge, same as the GL texture.
+ */
+static inline int
+clampi (int v, int lo, int hi)
+{
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+static void
+sample_bilinear (const uint8_t *src, int src_w, int src_h, float fx, float fy, float *rgb)
+{
+    int   x0 = (int)(fx + 1.0f) - 1;    /* floor() for fx > -1 */
+    int   y0 = (int)(fy + 1.0f) - 1;
+    float ax = fx - x0;
+    float ay = fy - y0;
+    int   x1 = clampi (x0 + 1, 0, src_w - 1);
+    int   y1 = clampi (y0 + 1, 0, src_h - 1);
+
+    x0 = clampi (x0, 0, src_w - 1);
+    y0 = clampi (y0, 0, src_h - 1);
+
+    const uint8_t *p00 = src + (y0 * src_w + x0) * 4;
+    const uint8_t *p01 = src + (y0 * src_w + x1) * 4;
+    const uint8_t *p10 = src + (y1 * src_w + x0) * 4;
+    const uint8_t *p11 = src + (y1 * src_w + x1) * 4;
+
+    for (int c = 0; c < 3; c ++)
+    {
+        float top = p00[c] + (p01[c] - p00[c]) * ax;
+        float btm = p10[c] + (p11[c] - p10[c]) * ax;
+        rgb[c] = top + (btm - top) * ay;
+    }
+}
+
+void
+image_crop_rgba_to_fp32 (const uint8_t *src, int src_w, int src_h, const float quad[4][2],
+                         float *dst, int dst_w, int dst_h, float mean, float std)
+{
+    /* the ROI is a (rotated) rectangle, so an affine map is enough */
+    float ux = (quad[1][0] - quad[0][0]) * src_w / dst_w;   /* source step per dst pixel (x) */
+    float uy = (quad[1][1] - quad[0][1]) * src_h / dst_w;
+    float vx = (quad[3][0] - quad[0][0]) * src_w / dst_h;   /* source step per dst pixel (y) */
+    float vy = (quad[3][1] - quad[0][1]) * src_h / dst_h;
+    float ox = quad[0][0] * src_w - 0.5f;
+    float oy = quad[0][1] * src_h - 0.5f;
+    float rgb[3];
+
+    for (int y = 0; y < dst_h; y ++)
+    {
+        float v = y + 0.5f;
+        for (int x = 0; x < dst_w; x ++)
+        {
+            float u  = x + 0.5f;
+            float fx = ox + u * ux + v * vx;
+            float fy = oy + u * uy + v * vy;
+
+            sample_bilinear (src, src_w, src_h, fx, fy, rgb);
+            *dst ++ = (rgb[0] - mean) / std;
+            *dst ++ = (rgb[1] - mean) / std;
+            *dst ++ = (rgb[2] - mean) / std;
+        }
+    }
+}
+
+/* same as above, for the quantized (uint8 RGB) input tensors */
+void
+image_crop_rgba_to_uint8 (const uint8_t *src, int src_w, int src_h, const float quad[4][2],
+                          uint8_t *dst, int dst_w, int dst_h)
+{
+    float ux = (quad[1][0] - quad[0][0]) * src_w / dst_w;
+    float uy = (quad[1][1] - quad[0][1]) * src_h / dst_w;
+    float vx = (quad[3][0] - quad[0][0]) * src_w / dst_h;
+    float vy = (quad[3][1] - quad[0][1]) * src_h / dst_h;
+    float ox = quad[0][0] * src_w - 0.5f;
+    float oy = quad[0][1] * src_h - 0.5f;
+    float rgb[3];
+
+    for (int y = 0; y < dst_h; y ++)
+    {
+        float v = y + 0.5f;
+        for (int x = 0; x < dst_w; x ++)
+        {
+            float u  = x + 0.5f;
+            float fx = ox + u * ux + v * vx;
+            float fy = oy + u * uy + v * vy;
+
+            sample_bilinear (src, src_w, src_h, fx, fy, rgb);
+            *dst ++ = (uint8_t)(rgb[0] + 0.5f);
+            *dst ++ = (uint8_t)(rgb[1] + 0.5f);
+            *dst ++ = (uint8_t)(rgb[2] + 0.5f);
+        }
+    }
+}
+
+void
+image_resize_rgba_to_fp32 (const uint8_t *src, int src_w, int src_h,
+                           float *dst, int dst_w, int dst_h, float mean, float std)
+{
+    const float quad[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+
+    image_crop_rgba_to_fp32 (src, src_w, src_h, quad, dst, dst_w, dst_h, mean, std);
+}
+
+void
+image_resize_rgba_to_uint8 (const uint8_t *src, int src_w, int src_h,
+                            uint8_t *dst, int dst_w, int dst_h)
+{
+    const float quad[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+
+    image_crop_rgba_to_uint8 (src, src_w, src_h, quad, dst, dst_w, dst_h);
+}
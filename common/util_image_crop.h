@@ -0,0 +1,39 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_IMAGE_CROP_H_
+#define _UTIL_IMAGE_CROP_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  quad[4][2]: corners of the crop region in the source image,
+ *              normalized to [0, 1].
+ *
+ *      0--------1      [0]: top-left     of the destination
+ *      |        |      [1]: top-right
+ *      |        |      [2]: bottom-right
+ *      3--------2      [3]: bottom-left
+ */
+void image_crop_rgba_to_fp32 (const uint8_t *src, int src_w, int src_h, const float quad[4][2],
+                              float *dst, int dst_w, int dst_h, float mean, float std);
+
+void image_resize_rgba_to_fp32 (const uint8_t *src, int src_w, int src_h,
+                                float *dst, int dst_w, int dst_h, float mean, float std);
+
+void image_crop_rgba_to_uint8 (const uint8_t *src, int src_w, int src_h, const float quad[4][2],
+                               uint8_t *dst, int dst_w, int dst_h);
+
+void image_resize_rgba_to_uint8 (const uint8_t *src, int src_w, int src_h,
+                                 uint8_t *dst, int dst_w, int dst_h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_IMAGE_CROP_H_ */
@@ -0,0 +1,253 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "util_memory.h"
+
+/*
+ *  memory accounting.
+ *
+ *  the large buffers (readback staging, capture/decode frames, async
+ *  inference slots, pipeline packets, ...) are registered with their size,
+ *  and the interpreters with a query function which reports their arena
+ *  and model sizes at the time of the query. mem_print_report() lists them
+ *  with the RSS of the process. the memory of the delegates is not visible
+ *  from outside, and is counted in the RSS growth while the model is created.
+ */
+typedef struct _mem_buffer_t
+{
+    const char  *name;
+    const void  *ptr;
+    size_t      size;
+} mem_buffer_t;
+
+typedef struct _mem_model_t
+{
+    void                *handle;
+    mem_model_query_t   query;
+} mem_model_t;
+
+static pthread_mutex_t  s_mem_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mem_buffer_t     s_buffer[MEM_MAX_BUFFERS];
+static int              s_num_buffers;
+static mem_model_t      s_model[MEM_MAX_MODELS];
+static int              s_num_models;
+
+
+/* (name) must be a static string. a registered (ptr) is updated. */
+int
+mem_register_buffer (const char *name, const void *ptr, size_t size)
+{
+    int i, ret = 0;
+
+    if (ptr == NULL)
+        return -1;
+
+    pthread_mutex_lock (&s_mem_mutex);
+
+    for (i = 0; i < s_num_buffers; i ++)
+    {
+        if (s_buffer[i].ptr == ptr)
+            break;
+    }
+
+    if (i < MEM_MAX_BUFFERS)
+    {
+        s_buffer[i].name = name;
+        s_buffer[i].ptr  = ptr;
+        s_buffer[i].size = size;
+        if (i == s_num_buffers)
+            s_num_buffers ++;
+    }
+    else
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        ret = -1;
+    }
+
+    pthread_mutex_unlock (&s_mem_mutex);
+    return ret;
+}
+
+void
+mem_unregister_buffer (const void *ptr)
+{
+    pthread_mutex_lock (&s_mem_mutex);
+    for (int i = 0; i < s_num_buffers; i ++)
+    {
+        if (s_buffer[i].ptr == ptr)
+        {
+            s_buffer[i] = s_buffer[-- s_num_buffers];
+            break;
+        }
+    }
+    pthread_mutex_unlock (&s_mem_mutex);
+}
+
+int
+mem_register_model (void *handle, mem_model_query_t query)
+{
+    int i, ret = 0;
+
+    pthread_mutex_lock (&s_mem_mutex);
+
+    for (i = 0; i < s_num_models; i ++)
+    {
+        if (s_model[i].handle == handle)
+            break;
+    }
+
+    if (i < MEM_MAX_MODELS)
+    {
+        s_model[i].handle = handle;
+        s_model[i].query  = query;
+        if (i == s_num_models)
+            s_num_models ++;
+    }
+    else
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        ret = -1;
+    }
+
+    pthread_mutex_unlock (&s_mem_mutex);
+    return ret;
+}
+
+void
+mem_unregister_model (void *handle)
+{
+    pthread_mutex_lock (&s_mem_mutex);
+    for (int i = 0; i < s_num_models; i ++)
+    {
+        if (s_model[i].handle == handle)
+        {
+            s_model[i] = s_model[-- s_num_models];
+            break;
+        }
+    }
+    pthread_mutex_unlock (&s_mem_mutex);
+}
+
+
+/* VmRSS and VmHWM of /proc/self/status */
+int
+mem_get_process_rss (size_t *rss_bytes, size_t *peak_rss_bytes)
+{
+    char line[256];
+    unsigned long kb;
+    FILE *fp;
+
+    *rss_bytes = *peak_rss_bytes = 0;
+
+    fp = fopen ("/proc/self/status", "r");
+    if (fp == NULL)
+        return -1;
+
+    while (fgets (line, sizeof (line), fp))
+    {
+        if (sscanf (line, "VmRSS: %lu kB", &kb) == 1)
+            *rss_bytes = kb * 1024;
+        else if (sscanf (line, "VmHWM: %lu kB", &kb) == 1)
+            *peak_rss_bytes = kb * 1024;
+    }
+
+    fclose (fp);
+    return 0;
+}
+
+int
+mem_get_report (mem_report_t *report)
+{
+    memset (report, 0, sizeof (*report));
+
+    pthread_mutex_lock (&s_mem_mutex);
+
+    for (int i = 0; i < s_num_models; i ++)
+    {
+        mem_model_info_t *info = &report->model[report->num_models];
+
+        memset (info, 0, sizeof (*info));
+        if (s_model[i].query (s_model[i].handle, info) < 0)
+            continue;
+
+        report->model_bytes += info->model_bytes + info->arena_bytes +
+                               info->persistent_bytes + info->dynamic_bytes;
+        report->num_models ++;
+    }
+
+    for (int i = 0; i < s_num_buffers; i ++)
+        report->buffer_bytes += s_buffer[i].size;
+    report->num_buffers = s_num_buffers;
+
+    pthread_mutex_unlock (&s_mem_mutex);
+
+    mem_get_process_rss (&report->rss_bytes, &report->peak_rss_bytes);
+    return 0;
+}
+
+static const char *
+basename_of (const char *path)
+{
+    const char *p = strrchr (path, '/');
+    return p ? p + 1 : path;
+}
+
+void
+mem_print_report (FILE *fp)
+{
+    mem_report_t report;
+
+    mem_get_report (&report);
+
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    fprintf (fp, "%-36s %9s %9s %9s %9s %9s\n", "model [KB]", "mapping", "arena", "persist", "dynamic", "load RSS");
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < report.num_models; i ++)
+    {
+        mem_model_info_t *info = &report.model[i];
+        fprintf (fp, "%-36.36s %9zu %9zu %9zu %9zu %9ld\n", basename_of (info->name),
+                 info->model_bytes / 1024, info->arena_bytes / 1024, info->persistent_bytes / 1024,
+                 info->dynamic_bytes / 1024, info->load_rss_bytes / 1024);
+    }
+
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    fprintf (fp, "%-36s %9s\n", "buffer [KB]", "size");
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    pthread_mutex_lock (&s_mem_mutex);
+    for (int i = 0; i < s_num_buffers; i ++)
+        fprintf (fp, "%-36.36s %9zu\n", s_buffer[i].name, s_buffer[i].size / 1024);
+    pthread_mutex_unlock (&s_mem_mutex);
+
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    fprintf (fp, "models %zu KB, buffers %zu KB, RSS %zu KB (peak %zu KB)\n",
+             report.model_bytes / 1024, report.buffer_bytes / 1024,
+             report.rss_bytes / 1024, report.peak_rss_bytes / 1024);
+}
+
+static void
+print_exit_report ()
+{
+    mem_print_report (stderr);
+}
+
+/*
+ *  print the report if MEM_REPORT=1, and once more at exit.
+ *  the staging buffers allocated on the first frame, and the peak RSS,
+ *  appear only in the second one.
+ */
+void
+mem_print_startup_report ()
+{
+    const char *env = getenv ("MEM_REPORT");
+
+    if (env && atoi (env) > 0)
+    {
+        mem_print_report (stderr);
+        atexit (print_exit_report);
+    }
+}
@@ -0,0 +1,70 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_MEMORY_H_
+#define _UTIL_MEMORY_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_MAX_BUFFERS     64
+#define MEM_MAX_MODELS      16
+
+typedef struct _mem_model_info_t
+{
+    const char  *name;              /* model path */
+    size_t      model_bytes;        /* mapped flatbuffer */
+    size_t      arena_bytes;        /* activations (non-persistent arena) */
+    size_t      persistent_bytes;   /* persistent arena */
+    size_t      dynamic_bytes;      /* dynamic tensors */
+    long        load_rss_bytes;     /* RSS growth while created (incl. the delegate) */
+} mem_model_info_t;
+
+/* fill (info) of (handle). return -1 if it is not created */
+typedef int (*mem_model_query_t) (void *handle, mem_model_info_t *info);
+
+typedef struct _mem_report_t
+{
+    int                 num_models;
+    mem_model_info_t    model[MEM_MAX_MODELS];
+
+    int                 num_buffers;
+    size_t              buffer_bytes;   /* registered buffers in total */
+    size_t              model_bytes;    /* models in total (mapping + arenas) */
+
+    size_t              rss_bytes;      /* process */
+    size_t              peak_rss_bytes; /* process */
+} mem_report_t;
+
+
+/*
+ *  the registry keeps the address of a buffer, and never reads it.
+ *  tell GCC so, or registering a fresh malloc() warns -Wmaybe-uninitialized.
+ */
+#if defined (__GNUC__) && (__GNUC__ >= 10) && !defined (__clang__)
+#define MEM_ADDR_ONLY(idx)  __attribute__ ((access (none, idx)))
+#else
+#define MEM_ADDR_ONLY(idx)
+#endif
+
+int  mem_register_buffer (const char *name, const void *ptr, size_t size) MEM_ADDR_ONLY (2);
+void mem_unregister_buffer (const void *ptr) MEM_ADDR_ONLY (1);
+
+int  mem_register_model (void *handle, mem_model_query_t query);
+void mem_unregister_model (void *handle);
+
+int  mem_get_process_rss (size_t *rss_bytes, size_t *peak_rss_bytes);
+int  mem_get_report (mem_report_t *report);
+void mem_print_report (FILE *fp);
+void mem_print_startup_report ();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_MEMORY_H_ */
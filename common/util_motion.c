@@ -0,0 +1,249 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_motion.h"
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#include <arm_neon.h>
+#define MOTION_USE_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define MOTION_USE_SSE2
+#endif
+
+#define MOTION_CELL_MIN_CNT  (MOTION_CELL_SIZE * MOTION_CELL_SIZE / 8)
+
+
+/* -------------------------------------------------- *
+ *  motion detection by frame differencing.
+ *
+ *  the luma of a YUYV frame is downsampled by (scale),
+ *  and compared with the luma of the frame which was
+ *  inferred last. (not with the previous frame, so a slow
+ *  motion is accumulated until it exceeds the threshold)
+ *
+ *  the changed pixels are counted per MOTION_CELL_SIZE^2
+ *  cell, and the cells form the motion mask.
+ * -------------------------------------------------- */
+int
+motion_init (motion_detector_t *md, int src_w, int src_h, int scale)
+{
+    memset (md, 0, sizeof (*md));
+
+    /* take the average of Y0 and Y1 of a YUYV macro pixel */
+    if (scale < 2)
+        scale = 2;
+    scale &= ~1;
+
+    md->scale  = scale;
+    md->w      = src_w / scale;
+    md->h      = src_h / scale;
+    md->mask_w = (md->w + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+    md->mask_h = (md->h + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+
+    md->luma     = (uint8_t  *)calloc (md->w * md->h, sizeof (uint8_t));
+    md->ref      = (uint8_t  *)calloc (md->w * md->h, sizeof (uint8_t));
+    md->mask     = (uint8_t  *)calloc (md->mask_w * md->mask_h, sizeof (uint8_t));
+    md->cell_cnt = (uint16_t *)calloc (md->mask_w * md->mask_h, sizeof (uint16_t));
+    if (md->luma == NULL || md->ref == NULL || md->mask == NULL || md->cell_cnt == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        motion_exit (md);
+        return -1;
+    }
+
+    md->config.pixel_thresh = 24;
+    md->config.area_thresh  = 0.002f;
+    md->config.max_skip     = 30;
+
+    return 0;
+}
+
+void
+motion_exit (motion_detector_t *md)
+{
+    free (md->luma);
+    free (md->ref);
+    free (md->mask);
+    free (md->cell_cnt);
+    md->luma     = NULL;
+    md->ref      = NULL;
+    md->mask     = NULL;
+    md->cell_cnt = NULL;
+}
+
+
+static void
+downsample_luma (motion_detector_t *md, const uint8_t *src, int stride,
+                 int ofstx, int ofsty, int is_uyvy)
+{
+    int scale = md->scale;
+
+    for (int y = 0; y < md->h; y ++)
+    {
+        const uint8_t *s = src + (ofsty + y * scale) * stride + (ofstx & ~1) * 2 + is_uyvy;
+        uint8_t       *d = md->luma + y * md->w;
+
+        for (int x = 0; x < md->w; x ++, s += scale * 2)
+            d[x] = (s[0] + s[2] + 1) >> 1;
+    }
+}
+
+
+/*
+ *  count the pixels whose difference exceeds (thresh), and add
+ *  them to the cell counters of the line. return the total count.
+ */
+static int
+diff_line (const uint8_t *a, const uint8_t *b, int w, uint8_t thresh, uint16_t *cell_cnt)
+{
+    int num = 0;
+    int x = 0;
+
+#if defined (MOTION_USE_NEON)
+    uint8x16_t vth = vdupq_n_u8 (thresh);
+    for (; x + 16 <= w; x += 16)
+    {
+        uint8x16_t d = vabdq_u8 (vld1q_u8 (a + x), vld1q_u8 (b + x));
+        uint8x16_t c = vshrq_n_u8 (vcgtq_u8 (d, vth), 7);
+        uint64x2_t s = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (c)));
+        int c0 = (int)vgetq_lane_u64 (s, 0);
+        int c1 = (int)vgetq_lane_u64 (s, 1);
+
+        cell_cnt[(x    ) / MOTION_CELL_SIZE] += c0;
+        cell_cnt[(x + 8) / MOTION_CELL_SIZE] += c1;
+        num += c0 + c1;
+    }
+#elif defined (MOTION_USE_SSE2)
+    __m128i vth  = _mm_set1_epi8 ((char)thresh);
+    __m128i zero = _mm_setzero_si128 ();
+    for (; x + 16 <= w; x += 16)
+    {
+        __m128i va = _mm_loadu_si128 ((const __m128i *)(a + x));
+        __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + x));
+        __m128i d  = _mm_or_si128 (_mm_subs_epu8 (va, vb), _mm_subs_epu8 (vb, va));
+        __m128i eq = _mm_cmpeq_epi8 (_mm_subs_epu8 (d, vth), zero);   /* d <= thresh */
+        unsigned int bits = ~_mm_movemask_epi8 (eq) & 0xFFFF;
+        int c0 = __builtin_popcount (bits & 0xFF);
+        int c1 = __builtin_popcount (bits >> 8);
+
+        cell_cnt[(x    ) / MOTION_CELL_SIZE] += c0;
+        cell_cnt[(x + 8) / MOTION_CELL_SIZE] += c1;
+        num += c0 + c1;
+    }
+#endif
+    for (; x < w; x ++)
+    {
+        int d = a[x] - b[x];
+        if (d > thresh || -d > thresh)
+        {
+            cell_cnt[x / MOTION_CELL_SIZE] ++;
+            num ++;
+        }
+    }
+
+    return num;
+}
+
+
+/* called for every captured frame */
+void
+motion_update_yuyv (motion_detector_t *md, const uint8_t *src, int stride,
+                    int ofstx, int ofsty, int is_uyvy)
+{
+    int num_cells = md->mask_w * md->mask_h;
+    int num_changed = 0;
+
+    if (md->luma == NULL)
+        return;
+
+    downsample_luma (md, src, stride, ofstx, ofsty, is_uyvy);
+
+    if (!md->has_ref)
+    {
+        memset (md->mask, 1, num_cells);
+        md->score = 1.0f;
+        return;
+    }
+
+    memset (md->cell_cnt, 0, num_cells * sizeof (uint16_t));
+    for (int y = 0; y < md->h; y ++)
+    {
+        num_changed += diff_line (md->luma + y * md->w, md->ref + y * md->w, md->w,
+                                  md->config.pixel_thresh,
+                                  md->cell_cnt + (y / MOTION_CELL_SIZE) * md->mask_w);
+    }
+
+    for (int i = 0; i < num_cells; i ++)
+        md->mask[i] = (md->cell_cnt[i] >= MOTION_CELL_MIN_CNT);
+
+    md->score = (float)num_changed / (float)(md->w * md->h);
+}
+
+
+/*
+ *  return 1 if the inference should run on the latest frame.
+ *  then the frame becomes the reference of the next comparison.
+ */
+int
+motion_need_infer (motion_detector_t *md)
+{
+    if (md->has_ref &&
+        md->score < md->config.area_thresh &&
+        md->num_skipped < md->config.max_skip)
+    {
+        md->num_skipped ++;
+        return 0;
+    }
+
+    memcpy (md->ref, md->luma, md->w * md->h);
+    md->has_ref     = 1;
+    md->num_skipped = 0;
+    return 1;
+}
+
+
+/*
+ *  bounding box of the changed cells, normalized to [0, 1].
+ *  return the number of the changed cells.
+ */
+int
+motion_get_region (motion_detector_t *md, float *x1, float *y1, float *x2, float *y2)
+{
+    int cx1 = md->mask_w, cy1 = md->mask_h, cx2 = -1, cy2 = -1;
+    int num = 0;
+
+    for (int y = 0; y < md->mask_h; y ++)
+    {
+        for (int x = 0; x < md->mask_w; x ++)
+        {
+            if (md->mask[y * md->mask_w + x] == 0)
+                continue;
+
+            if (x < cx1) cx1 = x;
+            if (y < cy1) cy1 = y;
+            if (x > cx2) cx2 = x;
+            if (y > cy2) cy2 = y;
+            num ++;
+        }
+    }
+
+    if (num == 0)
+    {
+        *x1 = *y1 = *x2 = *y2 = 0.0f;
+        return 0;
+    }
+
+    *x1 = (float)(cx1       * MOTION_CELL_SIZE) / md->w;
+    *y1 = (float)(cy1       * MOTION_CELL_SIZE) / md->h;
+    *x2 = (float)((cx2 + 1) * MOTION_CELL_SIZE) / md->w;
+    *y2 = (float)((cy2 + 1) * MOTION_CELL_SIZE) / md->h;
+    if (*x2 > 1.0f) *x2 = 1.0f;
+    if (*y2 > 1.0f) *y2 = 1.0f;
+
+    return num;
+}
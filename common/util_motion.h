@@ -0,0 +1,55 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_MOTION_H_
+#define _UTIL_MOTION_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTION_CELL_SIZE    8       /* [downsampled pixels] per side of a mask cell */
+
+typedef struct _motion_config_t
+{
+    int     pixel_thresh;           /* luma difference regarded as changed [0, 255] */
+    float   area_thresh;            /* ratio of the changed pixels to run the inference */
+    int     max_skip;               /* run the inference at least every (max_skip + 1) frames */
+} motion_config_t;
+
+typedef struct _motion_detector_t
+{
+    motion_config_t config;
+
+    int         scale;              /* downsampling factor of the source image */
+    int         w, h;               /* size of the downsampled luma plane */
+    uint8_t     *luma;              /* latest frame   */
+    uint8_t     *ref;               /* frame of the last inference */
+    int         has_ref;
+
+    int         mask_w, mask_h;
+    uint8_t     *mask;              /* 1: the cell has changed since the last inference */
+    uint16_t    *cell_cnt;
+
+    float       score;              /* ratio of the changed pixels */
+    int         num_skipped;        /* consecutive frames skipped by motion_need_infer() */
+} motion_detector_t;
+
+
+int  motion_init (motion_detector_t *md, int src_w, int src_h, int scale);
+void motion_exit (motion_detector_t *md);
+
+void motion_update_yuyv (motion_detector_t *md, const uint8_t *src, int stride,
+                         int ofstx, int ofsty, int is_uyvy);
+
+int  motion_need_infer (motion_detector_t *md);
+int  motion_get_region (motion_detector_t *md, float *x1, float *y1, float *x2, float *y2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_MOTION_H_ */
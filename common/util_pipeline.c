@@ -0,0 +1,473 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_pipeline.h"
+#include "util_pmeter.h"
+#include "util_memory.h"
+
+/*
+ *  Multi-stage pipelined executor.
+ *
+ *  each stage runs on its own thread and the stages are connected by
+ *  bounded queues, so frame N's landmark stage overlaps with frame N+1's
+ *  detection stage and the throughput approaches the slowest stage
+ *  instead of the sum of all the stages.
+ *
+ *  a packet carries one frame through all the stages. the packets are
+ *  allocated once at pipeline_start(), and circulate between the free
+ *  list, the queues and the caller. nothing is allocated per frame.
+ *
+ *      caller --submit--> [q0] stage0 [q1] stage1 ... [qN] --get_result--> caller
+ *        ^                                                                    |
+ *        +---------------------------- release -------------------------------+
+ *
+ *  with PIPELINE_SYNC, pipeline_submit() runs all the stages in order on
+ *  the caller thread. this is needed when the interpreters must run on
+ *  the GL thread (GPU delegate).
+ */
+#define LATENCY_SMOOTH      0.9
+
+typedef struct _packet_hdr_t
+{
+    double  submit_ms;
+    int     frame_id;
+    int     pad;
+} packet_hdr_t;
+
+#define PACKET_HDR(p)   ((packet_hdr_t *)(p) - 1)
+#define PACKET_BODY(h)  ((void *)((packet_hdr_t *)(h) + 1))
+
+
+/* -------------------------------------------------- *
+ *  bounded queue
+ * -------------------------------------------------- */
+static int
+queue_init (pipeline_queue_t *q, int capacity, int policy)
+{
+    q->items = (void **)calloc (capacity, sizeof (void *));
+    if (q->items == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    q->capacity = capacity;
+    q->policy   = policy;
+
+    pthread_mutex_init (&q->mutex, NULL);
+    pthread_cond_init  (&q->cond,  NULL);
+    return 0;
+}
+
+static void
+queue_exit (pipeline_queue_t *q)
+{
+    if (q->items == NULL)
+        return;
+
+    pthread_cond_destroy  (&q->cond);
+    pthread_mutex_destroy (&q->mutex);
+    free (q->items);
+    q->items = NULL;
+}
+
+static void
+queue_wakeup (pipeline_queue_t *q)
+{
+    pthread_mutex_lock (&q->mutex);
+    pthread_cond_broadcast (&q->cond);
+    pthread_mutex_unlock (&q->mutex);
+}
+
+/* the caller holds the mutex */
+static void *
+queue_pop_locked (pipeline_queue_t *q)
+{
+    void *item = q->items[q->head];
+
+    q->head = (q->head + 1) % q->capacity;
+    q->count --;
+    pthread_cond_broadcast (&q->cond);
+    return item;
+}
+
+static void
+release_packet (pipeline_t *pl, void *packet);
+
+/*
+ *  push a packet. when the queue is full, follow its policy.
+ *  return 0 if queued, -1 if the packet has been dropped.
+ */
+static int
+queue_push (pipeline_t *pl, pipeline_queue_t *q, void *item)
+{
+    void *dropped = NULL;
+
+    pthread_mutex_lock (&q->mutex);
+
+    if (q->count == q->capacity)
+    {
+        switch (q->policy)
+        {
+        case PIPELINE_BLOCK:
+            while (q->count == q->capacity && pl->running)
+                pthread_cond_wait (&q->cond, &q->mutex);
+            if (q->count == q->capacity)
+                dropped = item;         /* stopping */
+            break;
+        case PIPELINE_DROP_OLDEST:
+            dropped = queue_pop_locked (q);
+            break;
+        case PIPELINE_DROP_NEWEST:
+        default:
+            dropped = item;
+            break;
+        }
+        if (dropped)
+            q->num_dropped ++;
+    }
+
+    if (dropped != item)
+    {
+        q->items[(q->head + q->count) % q->capacity] = item;
+        q->count ++;
+        if (q->count > q->max_depth)
+            q->max_depth = q->count;
+        pthread_cond_broadcast (&q->cond);
+    }
+    pthread_mutex_unlock (&q->mutex);
+
+    if (dropped)
+        release_packet (pl, dropped);
+
+    return (dropped == item) ? -1 : 0;
+}
+
+/* (wait) 1: wait for a packet while running.  0: return NULL if empty. */
+static void *
+queue_pop (pipeline_t *pl, pipeline_queue_t *q, int wait)
+{
+    void *item = NULL;
+
+    pthread_mutex_lock (&q->mutex);
+    while (wait && q->count == 0 && pl->running)
+        pthread_cond_wait (&q->cond, &q->mutex);
+
+    if (q->count > 0)
+        item = queue_pop_locked (q);
+    pthread_mutex_unlock (&q->mutex);
+
+    return item;
+}
+
+
+/* -------------------------------------------------- *
+ *  packets
+ * -------------------------------------------------- */
+static void
+release_packet (pipeline_t *pl, void *packet)
+{
+    pipeline_queue_t *q = &pl->free_packets;
+
+    /* the free list can hold every packet, so this never blocks */
+    pthread_mutex_lock (&q->mutex);
+    q->items[(q->head + q->count) % q->capacity] = packet;
+    q->count ++;
+    pthread_mutex_unlock (&q->mutex);
+}
+
+void *
+pipeline_acquire_packet (pipeline_t *pl)
+{
+    void *hdr = queue_pop (pl, &pl->free_packets, 0);
+
+    if (hdr == NULL)
+        return NULL;
+
+    return PACKET_BODY (hdr);
+}
+
+void
+pipeline_release_packet (pipeline_t *pl, void *packet)
+{
+    if (packet)
+        release_packet (pl, PACKET_HDR (packet));
+}
+
+
+/* -------------------------------------------------- *
+ *  stages
+ * -------------------------------------------------- */
+static int
+run_stage (pipeline_stage_t *stage, packet_hdr_t *hdr)
+{
+    double t0 = pmeter_get_time_ms ();
+    pmeter_set_frame (hdr->frame_id);
+    int ret = stage->func (PACKET_BODY (hdr), stage->usrdata);
+    double t1 = pmeter_get_time_ms ();
+
+    /* read by pipeline_get_stats() without lock. a torn value is harmless. */
+    if (stage->num_processed == 0)
+        stage->latency_ms = t1 - t0;
+    else
+        stage->latency_ms = LATENCY_SMOOTH * stage->latency_ms + (1.0 - LATENCY_SMOOTH) * (t1 - t0);
+    stage->num_processed ++;
+
+    return ret;
+}
+
+static void *
+stage_thread_main (void *arg)
+{
+    pipeline_stage_t *stage = (pipeline_stage_t *)arg;
+    pipeline_t       *pl    = stage->pipeline;
+
+    for (;;)
+    {
+        packet_hdr_t *hdr = (packet_hdr_t *)queue_pop (pl, stage->in, 1);
+        if (hdr == NULL)
+            break;              /* stopping */
+
+        if (run_stage (stage, hdr) == 0)
+            queue_push (pl, stage->out, hdr);
+        else
+            release_packet (pl, hdr);
+    }
+
+    return NULL;
+}
+
+
+/* -------------------------------------------------- *
+ *  API
+ * -------------------------------------------------- */
+int
+pipeline_init (pipeline_t *pl, size_t packet_size, int queue_depth, int flags)
+{
+    memset (pl, 0, sizeof (*pl));
+
+    pl->flags       = flags;
+    pl->packet_size = (packet_size + sizeof (packet_hdr_t) - 1) / sizeof (packet_hdr_t) * sizeof (packet_hdr_t);
+    pl->queue_depth = (queue_depth > 0) ? queue_depth : 1;
+
+    return 0;
+}
+
+/*
+ *  stages are connected in the order they are added.
+ *  (policy) applies to the input queue of the stage.
+ */
+int
+pipeline_add_stage (pipeline_t *pl, const char *name, pipeline_func_t func, void *usrdata, int policy)
+{
+    if (pl->num_stages >= PIPELINE_MAX_STAGES)
+    {
+        fprintf (stderr, "ERR: %s(%d): too many stages\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    int idx = pl->num_stages ++;
+    pipeline_stage_t *stage = &pl->stages[idx];
+
+    snprintf (stage->name, sizeof (stage->name), "%s", name);
+    stage->func     = func;
+    stage->usrdata  = usrdata;
+    stage->pipeline = pl;
+    stage->in       = &pl->queues[idx];
+    stage->out      = &pl->queues[idx + 1];
+    stage->in->policy = policy;
+
+    return idx;
+}
+
+int
+pipeline_start (pipeline_t *pl)
+{
+    int num_queues = pl->num_stages + 1;
+
+    /* every queue full + one in each stage + one held by the caller on each side */
+    pl->num_packets = num_queues * pl->queue_depth + pl->num_stages + 2;
+    pl->packet_mem  = (char *)calloc (pl->num_packets, sizeof (packet_hdr_t) + pl->packet_size);
+    if (pl->packet_mem == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    mem_register_buffer ("pipeline packets", pl->packet_mem,
+                         pl->num_packets * (sizeof (packet_hdr_t) + pl->packet_size));
+
+    for (int i = 0; i < num_queues; i ++)
+    {
+        /* the result queue always keeps the latest */
+        int policy = (i == pl->num_stages) ? PIPELINE_DROP_OLDEST : pl->queues[i].policy;
+        if (queue_init (&pl->queues[i], pl->queue_depth, policy) < 0)
+            return -1;
+    }
+
+    if (queue_init (&pl->free_packets, pl->num_packets, PIPELINE_DROP_NEWEST) < 0)
+        return -1;
+
+    for (int i = 0; i < pl->num_packets; i ++)
+        release_packet (pl, pl->packet_mem + i * (sizeof (packet_hdr_t) + pl->packet_size));
+
+    if (pl->flags & PIPELINE_SYNC)
+        return 0;
+
+    pl->running = 1;
+    for (int i = 0; i < pl->num_stages; i ++)
+    {
+        if (pthread_create (&pl->stages[i].thread, NULL, stage_thread_main, &pl->stages[i]) != 0)
+        {
+            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+            pl->running = 0;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+pipeline_exit (pipeline_t *pl)
+{
+    if (pl->running)
+    {
+        pl->running = 0;
+        for (int i = 0; i <= pl->num_stages; i ++)
+            queue_wakeup (&pl->queues[i]);
+
+        for (int i = 0; i < pl->num_stages; i ++)
+            pthread_join (pl->stages[i].thread, NULL);
+    }
+
+    for (int i = 0; i <= pl->num_stages; i ++)
+        queue_exit (&pl->queues[i]);
+    queue_exit (&pl->free_packets);
+
+    mem_unregister_buffer (pl->packet_mem);
+    free (pl->packet_mem);
+    pl->packet_mem = NULL;
+}
+
+
+/*
+ *  feed a packet acquired by pipeline_acquire_packet() to the first stage.
+ *  the packet belongs to the pipeline after this call.
+ *  return -1 if it has been dropped by the policy of the first stage.
+ */
+int
+pipeline_submit (pipeline_t *pl, void *packet, int frame_id)
+{
+    packet_hdr_t *hdr = PACKET_HDR (packet);
+
+    hdr->frame_id  = frame_id;
+    hdr->submit_ms = pmeter_get_time_ms ();
+
+    if (pl->flags & PIPELINE_SYNC)
+    {
+        for (int i = 0; i < pl->num_stages; i ++)
+        {
+            if (run_stage (&pl->stages[i], hdr) != 0)
+            {
+                release_packet (pl, hdr);
+                return 0;
+            }
+        }
+        return queue_push (pl, &pl->queues[pl->num_stages], hdr);
+    }
+
+    return queue_push (pl, &pl->queues[0], hdr);
+}
+
+/*
+ *  the latest packet which has passed all the stages, or NULL if there
+ *  is no new one. older results are released. the caller owns the packet
+ *  until pipeline_release_packet().
+ */
+void *
+pipeline_get_result (pipeline_t *pl, int *frame_id)
+{
+    pipeline_queue_t *q = &pl->queues[pl->num_stages];
+    packet_hdr_t *hdr = NULL, *next;
+
+    while ((next = (packet_hdr_t *)queue_pop (pl, q, 0)) != NULL)
+    {
+        if (hdr)
+            release_packet (pl, hdr);
+        hdr = next;
+    }
+
+    if (hdr == NULL)
+        return NULL;
+
+    double latency = pmeter_get_time_ms () - hdr->submit_ms;
+    if (pl->num_results == 0)
+        pl->total_latency_ms = latency;
+    else
+        pl->total_latency_ms = LATENCY_SMOOTH * pl->total_latency_ms + (1.0 - LATENCY_SMOOTH) * latency;
+    pl->num_results ++;
+
+    if (frame_id)
+        *frame_id = hdr->frame_id;
+
+    return PACKET_BODY (hdr);
+}
+
+
+int
+pipeline_get_queue_depth (pipeline_t *pl, int stage)
+{
+    pipeline_queue_t *q = &pl->queues[stage];
+    int depth;
+
+    pthread_mutex_lock (&q->mutex);
+    depth = q->count;
+    pthread_mutex_unlock (&q->mutex);
+
+    return depth;
+}
+
+void
+pipeline_get_stats (pipeline_t *pl, int stage, pipeline_stats_t *stats)
+{
+    pipeline_stage_t *s = &pl->stages[stage];
+    pipeline_queue_t *q = s->in;
+
+    pthread_mutex_lock (&q->mutex);
+    stats->queue_depth     = q->count;
+    stats->max_queue_depth = q->max_depth;
+    stats->num_dropped     = q->num_dropped;
+    pthread_mutex_unlock (&q->mutex);
+
+    stats->name          = s->name;
+    stats->num_processed = s->num_processed;
+    stats->latency_ms    = s->latency_ms;
+}
+
+/*
+ *  one line per stage, for draw_dbgstr().
+ *      "detect  :  4.2 [ms] q:1/2 drop:3"
+ */
+int
+pipeline_format_stats (pipeline_t *pl, char *buf, int size)
+{
+    int len = 0;
+
+    for (int i = 0; i < pl->num_stages && len < size; i ++)
+    {
+        pipeline_stats_t stats;
+        pipeline_get_stats (pl, i, &stats);
+
+        len += snprintf (buf + len, size - len, "%-8s:%5.1f [ms] q:%d/%d drop:%d\n",
+                         stats.name, stats.latency_ms, stats.queue_depth,
+                         stats.max_queue_depth, stats.num_dropped);
+    }
+
+    if (len < size)
+        len += snprintf (buf + len, size - len, "Latency :%5.1f [ms]", pl->total_latency_ms);
+
+    return len;
+}
@@ -0,0 +1,112 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_PIPELINE_H_
+#define _UTIL_PIPELINE_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIPELINE_MAX_STAGES     8
+
+/* flags for pipeline_init() */
+#define PIPELINE_SYNC           (1 << 0)    /* run all the stages on the caller thread */
+
+/* what a stage does when its input queue is full */
+enum pipeline_policy {
+    PIPELINE_BLOCK = 0,             /* back-pressure: the upstream stage waits   */
+    PIPELINE_DROP_OLDEST,           /* the oldest queued packet is discarded     */
+    PIPELINE_DROP_NEWEST,           /* the incoming packet is discarded          */
+};
+
+/*
+ *  stage body. runs on the stage thread.
+ *  return 0 to pass the packet downstream, otherwise it is dropped.
+ */
+typedef int (*pipeline_func_t) (void *packet, void *usrdata);
+
+/* bounded queue of packets. one producer and one consumer. */
+typedef struct _pipeline_queue_t
+{
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    void                **items;
+    int                 capacity;
+    int                 head;
+    int                 count;
+    int                 policy;
+
+    int                 max_depth;
+    int                 num_dropped;
+} pipeline_queue_t;
+
+typedef struct _pipeline_stage_t
+{
+    char                name[32];
+    pipeline_func_t     func;
+    void                *usrdata;
+    pthread_t           thread;
+    struct _pipeline_t  *pipeline;
+    pipeline_queue_t    *in;
+    pipeline_queue_t    *out;
+
+    int                 num_processed;
+    double              latency_ms;         /* moving average of func() */
+} pipeline_stage_t;
+
+typedef struct _pipeline_t
+{
+    int                 flags;
+    int                 running;
+    int                 queue_depth;
+
+    int                 num_stages;
+    pipeline_stage_t    stages[PIPELINE_MAX_STAGES];
+
+    /* queues[i] is the input of stages[i], queues[num_stages] holds the results */
+    pipeline_queue_t    queues[PIPELINE_MAX_STAGES + 1];
+    pipeline_queue_t    free_packets;
+
+    size_t              packet_size;
+    int                 num_packets;
+    char                *packet_mem;
+
+    double              total_latency_ms;   /* moving average of submit -> result */
+    int                 num_results;
+} pipeline_t;
+
+typedef struct _pipeline_stats_t
+{
+    const char          *name;
+    int                 queue_depth;        /* packets waiting in front of the stage */
+    int                 max_queue_depth;
+    int                 num_dropped;        /* dropped by the input queue policy     */
+    int                 num_processed;
+    double              latency_ms;
+} pipeline_stats_t;
+
+
+int   pipeline_init (pipeline_t *pl, size_t packet_size, int queue_depth, int flags);
+int   pipeline_add_stage (pipeline_t *pl, const char *name, pipeline_func_t func, void *usrdata, int policy);
+int   pipeline_start (pipeline_t *pl);
+void  pipeline_exit (pipeline_t *pl);
+
+void *pipeline_acquire_packet (pipeline_t *pl);
+void  pipeline_release_packet (pipeline_t *pl, void *packet);
+int   pipeline_submit (pipeline_t *pl, void *packet, int frame_id);
+void *pipeline_get_result (pipeline_t *pl, int *frame_id);
+
+int   pipeline_get_queue_depth (pipeline_t *pl, int stage);
+void  pipeline_get_stats (pipeline_t *pl, int stage, pipeline_stats_t *stats);
+int   pipeline_format_stats (pipeline_t *pl, char *buf, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_PIPELINE_H_ */
@@ -3,9 +3,16 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include <GLES2/gl2.h>
 #include "util_pmeter.h"
 #include "util_shader.h"
@@ -53,6 +60,777 @@ pmeter_get_laptime (int id, int *num, float **laptime)
 }
 
 
+/* -------------------------------------------------- *
+ *  hardware counters (PMETER_COUNTERS=1)
+ *
+ *  a perf_event_open() counter group (cycles, instructions, cache misses,
+ *  branch misses) is opened for each thread, and read at the begin and
+ *  the end of every scope. the counters count the calling thread only.
+ *  (not the worker threads of the TFLite CPU kernels)
+ *
+ *  if perf events are not available (kernel.perf_event_paranoid, seccomp
+ *  of a container, ...), the counters are silently disabled. a counter
+ *  which the CPU does not support is left out of the group.
+ * -------------------------------------------------- */
+typedef struct _pmeter_counter_val_t
+{
+    unsigned long long  time_enabled;
+    unsigned long long  time_running;
+    unsigned long long  value[PMETER_NUM_COUNTERS];
+} pmeter_counter_val_t;
+
+typedef struct _pmeter_counter_thread_t
+{
+    int         state;          /* 0: not opened, 1: opened, -1: not available */
+    int         leader_fd;
+    int         nr;             /* number of the counters in the group */
+    int         slot[PMETER_NUM_COUNTERS];  /* index in the group. -1: not counted */
+} pmeter_counter_thread_t;
+
+static int          s_counter_enable;
+static unsigned int s_counter_mask;     /* counters opened by any thread */
+static __thread pmeter_counter_thread_t s_counter_thread;
+
+static const unsigned long long s_counter_config[PMETER_NUM_COUNTERS] =
+{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static const char *s_counter_name[PMETER_NUM_COUNTERS] =
+{
+    "cycles",
+    "instructions",
+    "cache_misses",
+    "branch_misses",
+};
+
+
+static int
+open_counter (unsigned long long config, int group_fd)
+{
+    struct perf_event_attr attr;
+
+    memset (&attr, 0, sizeof (attr));
+    attr.size           = sizeof (attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP |
+                          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall (__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static int
+open_counter_group (pmeter_counter_thread_t *ct)
+{
+    ct->state = -1;
+    ct->nr    = 0;
+    ct->leader_fd = -1;
+
+    for (int i = 0; i < PMETER_NUM_COUNTERS; i ++)
+    {
+        int fd = open_counter (s_counter_config[i], ct->leader_fd);
+
+        ct->slot[i] = -1;
+        if (fd < 0)
+        {
+            /* without cycles, no counters are meaningful */
+            if (i == PMETER_CNT_CYCLES)
+            {
+                if (__atomic_exchange_n (&s_counter_enable, 0, __ATOMIC_RELAXED))
+                    fprintf (stderr, "pmeter: hardware counters are not available (%s)\n", strerror (errno));
+                return -1;
+            }
+            continue;
+        }
+
+        if (ct->leader_fd < 0)
+            ct->leader_fd = fd;
+        ct->slot[i] = ct->nr ++;
+        __atomic_or_fetch (&s_counter_mask, 1u << i, __ATOMIC_RELAXED);
+    }
+
+    ct->state = 1;
+    return 0;
+}
+
+/* return -1 if the counters are not available on this thread */
+static int
+read_counters (pmeter_counter_val_t *val)
+{
+    pmeter_counter_thread_t *ct = &s_counter_thread;
+    unsigned long long buf[3 + PMETER_NUM_COUNTERS];
+
+    if (!__atomic_load_n (&s_counter_enable, __ATOMIC_RELAXED))
+        return -1;
+
+    if (ct->state == 0)
+        open_counter_group (ct);
+    if (ct->state < 0)
+        return -1;
+
+    if (read (ct->leader_fd, buf, sizeof (buf)) < (ssize_t)((3 + ct->nr) * sizeof (buf[0])))
+        return -1;
+
+    /* buf: nr, time_enabled, time_running, value[nr] */
+    val->time_enabled = buf[1];
+    val->time_running = buf[2];
+    for (int i = 0; i < PMETER_NUM_COUNTERS; i ++)
+        val->value[i] = (ct->slot[i] < 0) ? 0 : buf[3 + ct->slot[i]];
+
+    return 0;
+}
+
+/* the counts between (c0) and (c1), scaled if the group has been multiplexed */
+static void
+diff_counters (const pmeter_counter_val_t *c0, const pmeter_counter_val_t *c1, unsigned long long *delta)
+{
+    unsigned long long enabled = c1->time_enabled - c0->time_enabled;
+    unsigned long long running = c1->time_running - c0->time_running;
+
+    for (int i = 0; i < PMETER_NUM_COUNTERS; i ++)
+    {
+        delta[i] = c1->value[i] - c0->value[i];
+        if (running > 0 && running < enabled)
+            delta[i] = (unsigned long long)((double)delta[i] * enabled / running);
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  named scopes
+ *
+ *  PMETER_SCOPE_BEGIN ("invoke_xxx") / PMETER_SCOPE_END () measure the
+ *  enclosed code. the scopes nest: a scope is identified by its name and
+ *  its parent, so the same name under the different parents is counted
+ *  separately. (name) must be a static string.
+ *
+ *  each thread records its samples into its own buffer, which is merged
+ *  into the global statistics when its outermost scope ends (or the buffer
+ *  is full). the rolling percentiles are computed over the last
+ *  PMETER_WINDOW samples, and the summary is printed on exit.
+ *  (set PMETER_SUMMARY=0 to disable it)
+ * -------------------------------------------------- */
+#define PMETER_TLS_SAMPLES  64
+
+typedef struct _pmeter_scope_t
+{
+    const char  *name;
+    int         parent;
+    int         depth;
+    int         count;
+    double      total_ms;
+    double      max_ms;
+    double      last_ms;
+    float       window[PMETER_WINDOW];
+
+    int         num_counted;
+    unsigned long long counter[PMETER_NUM_COUNTERS];
+} pmeter_scope_t;
+
+typedef struct _pmeter_thread_t
+{
+    int         depth;
+    int         stack_id[PMETER_MAX_DEPTH];
+    double      stack_t0[PMETER_MAX_DEPTH];
+    int         stack_counted[PMETER_MAX_DEPTH];
+    pmeter_counter_val_t stack_cnt[PMETER_MAX_DEPTH];
+
+    int         num_samples;
+    int         sample_id[PMETER_TLS_SAMPLES];
+    float       sample_ms[PMETER_TLS_SAMPLES];
+    int         sample_counted[PMETER_TLS_SAMPLES];
+    unsigned long long sample_cnt[PMETER_TLS_SAMPLES][PMETER_NUM_COUNTERS];
+} pmeter_thread_t;
+
+static pmeter_scope_t   s_scope[PMETER_MAX_SCOPES];
+static int              s_num_scopes;
+static char             s_scope_lock;
+static __thread pmeter_thread_t s_thread;
+
+
+static void
+lock_scopes ()
+{
+    while (__atomic_test_and_set (&s_scope_lock, __ATOMIC_ACQUIRE))
+        ;
+}
+
+static void
+unlock_scopes ()
+{
+    __atomic_clear (&s_scope_lock, __ATOMIC_RELEASE);
+}
+
+static void
+print_summary_at_exit ()
+{
+    const char *env = getenv ("PMETER_SUMMARY");
+
+    if (env && atoi (env) == 0)
+        return;
+
+    pmeter_print_summary (stderr);
+}
+
+static int
+lookup_scope (int parent, const char *name, int num)
+{
+    for (int i = 0; i < num; i ++)
+    {
+        pmeter_scope_t *scope = &s_scope[i];
+        if (scope->parent == parent && (scope->name == name || strcmp (scope->name, name) == 0))
+            return i;
+    }
+    return -1;
+}
+
+static int
+find_scope (int parent, int depth, const char *name)
+{
+    int id;
+
+    /* the entries are only appended, so they can be looked up without the lock */
+    id = lookup_scope (parent, name, __atomic_load_n (&s_num_scopes, __ATOMIC_ACQUIRE));
+    if (id >= 0)
+        return id;
+
+    lock_scopes ();
+
+    id = lookup_scope (parent, name, s_num_scopes);
+    if (id < 0 && s_num_scopes < PMETER_MAX_SCOPES)
+    {
+        id = s_num_scopes;
+        memset (&s_scope[id], 0, sizeof (s_scope[id]));
+        s_scope[id].name   = name;
+        s_scope[id].parent = parent;
+        s_scope[id].depth  = depth;
+
+        if (id == 0)
+            atexit (print_summary_at_exit);
+
+        __atomic_store_n (&s_num_scopes, id + 1, __ATOMIC_RELEASE);
+    }
+
+    unlock_scopes ();
+    return id;
+}
+
+static void
+flush_samples (pmeter_thread_t *th)
+{
+    lock_scopes ();
+    for (int i = 0; i < th->num_samples; i ++)
+    {
+        pmeter_scope_t *scope = &s_scope[th->sample_id[i]];
+        float ms = th->sample_ms[i];
+
+        scope->window[scope->count % PMETER_WINDOW] = ms;
+        scope->count ++;
+        scope->total_ms += ms;
+        scope->last_ms   = ms;
+        if (ms > scope->max_ms)
+            scope->max_ms = ms;
+
+        if (th->sample_counted[i])
+        {
+            for (int j = 0; j < PMETER_NUM_COUNTERS; j ++)
+                scope->counter[j] += th->sample_cnt[i][j];
+            scope->num_counted ++;
+        }
+    }
+    unlock_scopes ();
+
+    th->num_samples = 0;
+}
+
+/* -------------------------------------------------- *
+ *  trace export
+ *
+ *  the scopes (and the other trace events, e.g. the TFLite operators)
+ *  are recorded into a ring buffer of each thread, and written as a
+ *  Chrome trace-event JSON file, which can be opened by chrome://tracing
+ *  or https://ui.perfetto.dev. every event carries the frame ID of its
+ *  thread (pmeter_set_frame()), so a frame can be followed across threads.
+ *
+ *  PMETER_TRACE=<file>  : record from the start, and write at exit.
+ *  SIGUSR1              : toggle the recording. the events are written
+ *                         when it is stopped. (<file>.1, <file>.2, ...)
+ * -------------------------------------------------- */
+#define PMETER_TRACE_RING           16384   /* events per thread */
+#define PMETER_TRACE_MAX_THREADS    32
+#define PMETER_TRACE_MAX_DEPTH      16
+#define PMETER_TRACE_DEFAULT_FILE   "pmeter_trace.json"
+
+typedef struct _pmeter_trace_event_t
+{
+    const char  *name;          /* static string */
+    double      ts_ms;
+    float       dur_ms;
+    int         frame;
+    int         counted;
+    unsigned long long counter[PMETER_NUM_COUNTERS];
+} pmeter_trace_event_t;
+
+typedef struct _pmeter_trace_ring_t
+{
+    int         tid;
+    char        thread_name[16];
+    unsigned int head;          /* written by the owner thread only */
+    unsigned int tail;          /* written by pmeter_trace_write() only */
+    pmeter_trace_event_t event[PMETER_TRACE_RING];
+} pmeter_trace_ring_t;
+
+typedef struct _pmeter_trace_thread_t
+{
+    int         frame;          /* -1: not set */
+    pmeter_trace_ring_t *ring;
+
+    int         depth;          /* pmeter_trace_begin() */
+    const char  *name[PMETER_TRACE_MAX_DEPTH];
+    double      t0[PMETER_TRACE_MAX_DEPTH];
+} pmeter_trace_thread_t;
+
+static int                  s_env_init;
+static int                  s_trace_enable;
+static volatile sig_atomic_t s_trace_toggle;
+static int                  s_trace_num_dumps;
+static char                 s_trace_path[PATH_MAX] = PMETER_TRACE_DEFAULT_FILE;
+static pmeter_trace_ring_t  *s_trace_ring[PMETER_TRACE_MAX_THREADS];
+static int                  s_trace_num_rings;
+static __thread pmeter_trace_thread_t s_trace_thread = {-1};
+
+
+static void
+trace_write_at_exit ()
+{
+    if (__atomic_load_n (&s_trace_enable, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n (&s_trace_enable, 0, __ATOMIC_RELEASE);
+        pmeter_trace_write (NULL);
+    }
+}
+
+static void
+trace_sigusr1_handler (int sig)
+{
+    s_trace_toggle = 1;
+}
+
+static void
+init_env ()
+{
+    const char *env;
+
+    if (__atomic_load_n (&s_env_init, __ATOMIC_RELAXED) ||
+        __atomic_exchange_n (&s_env_init, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    env = getenv ("PMETER_COUNTERS");
+    if (env && atoi (env) > 0)
+        __atomic_store_n (&s_counter_enable, 1, __ATOMIC_RELEASE);
+
+    env = getenv ("PMETER_TRACE");
+    if (env && env[0])
+    {
+        snprintf (s_trace_path, sizeof (s_trace_path), "%s", env);
+        __atomic_store_n (&s_trace_enable, 1, __ATOMIC_RELEASE);
+    }
+
+    signal (SIGUSR1, trace_sigusr1_handler);
+    atexit (trace_write_at_exit);
+}
+
+static pmeter_trace_ring_t *
+get_trace_ring (pmeter_trace_thread_t *th)
+{
+    pmeter_trace_ring_t *ring;
+
+    if (th->ring)
+        return th->ring;
+
+    ring = (pmeter_trace_ring_t *)calloc (1, sizeof (pmeter_trace_ring_t));
+    if (ring == NULL)
+        return NULL;
+
+    ring->tid = (int)syscall (SYS_gettid);
+    prctl (PR_GET_NAME, ring->thread_name, 0, 0, 0);
+
+    /* the rings outlive their threads, to be written at exit */
+    lock_scopes ();
+    if (s_trace_num_rings < PMETER_TRACE_MAX_THREADS)
+        s_trace_ring[s_trace_num_rings ++] = ring;
+    else
+    {
+        free (ring);
+        ring = NULL;
+    }
+    unlock_scopes ();
+
+    th->ring = ring;
+    return ring;
+}
+
+/* (cnt) NULL: no counters */
+static void
+trace_record (const char *name, double t0, double t1, const unsigned long long *cnt)
+{
+    pmeter_trace_thread_t *th = &s_trace_thread;
+    pmeter_trace_ring_t *ring;
+    pmeter_trace_event_t *ev;
+
+    if (!__atomic_load_n (&s_trace_enable, __ATOMIC_RELAXED) || (ring = get_trace_ring (th)) == NULL)
+        return;
+
+    /*
+     *  the last (head) must be visible before the slot is overwritten,
+     *  so that pmeter_trace_write() can tell an event which is being overwritten.
+     */
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    ev = &ring->event[ring->head % PMETER_TRACE_RING];
+    ev->name   = name;
+    ev->ts_ms  = t0;
+    ev->dur_ms = t1 - t0;
+    ev->frame  = th->frame;
+    ev->counted = (cnt != NULL);
+    if (cnt)
+        memcpy (ev->counter, cnt, sizeof (ev->counter));
+    __atomic_store_n (&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  set the frame ID of the calling thread, which is attached to its events.
+ *  the main loop calls this once per frame, which also handles SIGUSR1.
+ */
+void
+pmeter_set_frame (int frame)
+{
+    init_env ();
+    s_trace_thread.frame = frame;
+
+    if (s_trace_toggle)
+    {
+        s_trace_toggle = 0;
+        if (__atomic_exchange_n (&s_trace_enable, !s_trace_enable, __ATOMIC_ACQ_REL))
+            pmeter_trace_write (NULL);
+        else
+            fprintf (stderr, "pmeter: trace started\n");
+    }
+}
+
+int
+pmeter_trace_enabled ()
+{
+    return __atomic_load_n (&s_trace_enable, __ATOMIC_RELAXED);
+}
+
+/* trace only event (not counted in the scope statistics). (name) must be a static string */
+int
+pmeter_trace_begin (const char *name)
+{
+    pmeter_trace_thread_t *th = &s_trace_thread;
+    int handle = th->depth;
+
+    if (th->depth < PMETER_TRACE_MAX_DEPTH)
+    {
+        th->name[th->depth] = name;
+        th->t0[th->depth]   = pmeter_get_time_ms ();
+    }
+    th->depth ++;
+
+    return handle;
+}
+
+void
+pmeter_trace_end (int handle)
+{
+    pmeter_trace_thread_t *th = &s_trace_thread;
+
+    if (handle < 0 || handle >= th->depth)
+        return;
+
+    th->depth = handle;
+    if (handle < PMETER_TRACE_MAX_DEPTH)
+        trace_record (th->name[handle], th->t0[handle], pmeter_get_time_ms (), NULL);
+}
+
+/*
+ *  write the events recorded since the last write.
+ *  (path) NULL: PMETER_TRACE (or pmeter_trace.json), numbered after the first.
+ *
+ *  the other threads may be recording meanwhile. each ring is read up to
+ *  its (head) at the start, and its (tail) is advanced; (head) is left to
+ *  its owner. an event overwritten while it is copied is dropped.
+ */
+int
+pmeter_trace_write (const char *path)
+{
+    char  fname[PATH_MAX + 16];
+    FILE *fp;
+    int   pid = getpid ();
+    int   num_events = 0;
+
+    if (path == NULL)
+    {
+        if (s_trace_num_dumps == 0)
+            snprintf (fname, sizeof (fname), "%s", s_trace_path);
+        else
+            snprintf (fname, sizeof (fname), "%s.%d", s_trace_path, s_trace_num_dumps);
+        s_trace_num_dumps ++;
+        path = fname;
+    }
+
+    fp = fopen (path, "w");
+    if (fp == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d): %s\n", __FILE__, __LINE__, path);
+        return -1;
+    }
+
+    fprintf (fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    int num_rings = __atomic_load_n (&s_trace_num_rings, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < num_rings; i ++)
+    {
+        pmeter_trace_ring_t *ring = s_trace_ring[i];
+        unsigned int head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+        unsigned int tail = ring->tail;
+
+        /* the older ones have been overwritten */
+        if (head - tail > PMETER_TRACE_RING)
+            tail = head - PMETER_TRACE_RING;
+
+        fprintf (fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 (i > 0) ? ",\n" : "", pid, ring->tid, ring->thread_name);
+
+        for (unsigned int j = tail; j != head; j ++)
+        {
+            pmeter_trace_event_t copy = ring->event[j % PMETER_TRACE_RING];
+            pmeter_trace_event_t *ev = &copy;
+
+            /* the owner has wrapped around to this slot during the copy */
+            __atomic_thread_fence (__ATOMIC_ACQUIRE);
+            if (__atomic_load_n (&ring->head, __ATOMIC_RELAXED) - j >= PMETER_TRACE_RING)
+                continue;
+
+            fprintf (fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+                     ev->name, ev->ts_ms * 1000.0, ev->dur_ms * 1000.0, pid, ring->tid);
+            if (ev->frame >= 0 || ev->counted)
+            {
+                fprintf (fp, ",\"args\":{\"frame\":%d", ev->frame);
+                for (int k = 0; ev->counted && k < PMETER_NUM_COUNTERS; k ++)
+                {
+                    if (s_counter_mask & (1u << k))
+                        fprintf (fp, ",\"%s\":%llu", s_counter_name[k], ev->counter[k]);
+                }
+                fprintf (fp, "}");
+            }
+            fprintf (fp, "}");
+            num_events ++;
+        }
+
+        ring->tail = head;
+    }
+
+    fprintf (fp, "\n]}\n");
+    fclose (fp);
+
+    fprintf (stderr, "pmeter: %d trace events are written to %s\n", num_events, path);
+    return 0;
+}
+
+
+/* return the scope id. -1 if the scope table is full */
+int
+pmeter_scope_begin (const char *name)
+{
+    pmeter_thread_t *th = &s_thread;
+    int id = -1;
+
+    init_env ();
+
+    if (th->depth < PMETER_MAX_DEPTH)
+    {
+        int parent = (th->depth > 0) ? th->stack_id[th->depth - 1] : -1;
+
+        id = find_scope (parent, th->depth, name);
+        th->stack_id[th->depth] = id;
+        th->stack_counted[th->depth] = (read_counters (&th->stack_cnt[th->depth]) == 0);
+        th->stack_t0[th->depth] = pmeter_get_time_ms ();
+    }
+    th->depth ++;
+
+    return id;
+}
+
+void
+pmeter_scope_end ()
+{
+    pmeter_thread_t *th = &s_thread;
+    int id;
+
+    if (th->depth <= 0)
+        return;
+
+    th->depth --;
+    if (th->depth >= PMETER_MAX_DEPTH || (id = th->stack_id[th->depth]) < 0)
+        return;
+
+    double t1 = pmeter_get_time_ms ();
+    int    n  = th->num_samples;
+    pmeter_counter_val_t cnt;
+
+    th->sample_counted[n] = th->stack_counted[th->depth] && read_counters (&cnt) == 0;
+    if (th->sample_counted[n])
+        diff_counters (&th->stack_cnt[th->depth], &cnt, th->sample_cnt[n]);
+
+    trace_record (s_scope[id].name, th->stack_t0[th->depth], t1,
+                  th->sample_counted[n] ? th->sample_cnt[n] : NULL);
+
+    th->sample_id[n] = id;
+    th->sample_ms[n] = t1 - th->stack_t0[th->depth];
+    th->num_samples ++;
+
+    if (th->depth == 0 || th->num_samples >= PMETER_TLS_SAMPLES)
+        flush_samples (th);
+}
+
+int
+pmeter_get_num_scopes ()
+{
+    return __atomic_load_n (&s_num_scopes, __ATOMIC_ACQUIRE);
+}
+
+static int
+compare_float (const void *a, const void *b)
+{
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+int
+pmeter_get_scope_stats (int scope_id, pmeter_scope_stats_t *stats)
+{
+    float window[PMETER_WINDOW];
+    int num;
+
+    if (scope_id < 0 || scope_id >= pmeter_get_num_scopes ())
+        return -1;
+
+    lock_scopes ();
+    pmeter_scope_t *scope = &s_scope[scope_id];
+    stats->name     = scope->name;
+    stats->parent   = scope->parent;
+    stats->depth    = scope->depth;
+    stats->count    = scope->count;
+    stats->total_ms = scope->total_ms;
+    stats->max_ms   = scope->max_ms;
+    stats->last_ms  = scope->last_ms;
+    stats->num_counted  = scope->num_counted;
+    stats->counter_mask = s_counter_mask;
+    memcpy (stats->counter, scope->counter, sizeof (stats->counter));
+
+    num = (scope->count < PMETER_WINDOW) ? scope->count : PMETER_WINDOW;
+    memcpy (window, scope->window, num * sizeof (float));
+    unlock_scopes ();
+
+    stats->p50_ms = stats->p95_ms = stats->p99_ms = 0;
+    if (num > 0)
+    {
+        qsort (window, num, sizeof (float), compare_float);
+        stats->p50_ms = window[(int)((num - 1) * 0.50f)];
+        stats->p95_ms = window[(int)((num - 1) * 0.95f)];
+        stats->p99_ms = window[(int)((num - 1) * 0.99f)];
+    }
+
+    return 0;
+}
+
+/* per kilo instructions. "-" if not counted */
+static void
+print_mpki (FILE *fp, pmeter_scope_stats_t *st, int cnt)
+{
+    unsigned long long inst = st->counter[PMETER_CNT_INSTRUCTIONS];
+
+    if (!(st->counter_mask & (1u << cnt)) || !(st->counter_mask & (1u << PMETER_CNT_INSTRUCTIONS)) || inst == 0)
+        fprintf (fp, " %11s", "-");
+    else
+        fprintf (fp, " %11.2f", st->counter[cnt] * 1000.0 / inst);
+}
+
+static void
+print_scope_counters (FILE *fp, pmeter_scope_stats_t *st)
+{
+    unsigned long long cycles = st->counter[PMETER_CNT_CYCLES];
+    unsigned long long inst   = st->counter[PMETER_CNT_INSTRUCTIONS];
+
+    fprintf (fp, " %7d %10.3f", st->num_counted, cycles / 1000000.0 / st->num_counted);
+
+    if (!(st->counter_mask & (1u << PMETER_CNT_INSTRUCTIONS)) || cycles == 0)
+        fprintf (fp, " %8s", "-");
+    else
+        fprintf (fp, " %8.2f", (double)inst / cycles);
+
+    print_mpki (fp, st, PMETER_CNT_CACHE_MISSES);
+    print_mpki (fp, st, PMETER_CNT_BRANCH_MISSES);
+    fprintf (fp, "\n");
+}
+
+static void
+print_scope_tree (FILE *fp, int parent, int num_scopes, int counters)
+{
+    for (int i = 0; i < num_scopes; i ++)
+    {
+        pmeter_scope_stats_t st;
+
+        if (pmeter_get_scope_stats (i, &st) < 0 || st.parent != parent)
+            continue;
+
+        if (!counters && st.count > 0)
+        {
+            fprintf (fp, "%*s%-*s %7d %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+                     st.depth * 2, "", 32 - st.depth * 2, st.name, st.count,
+                     st.total_ms / st.count, st.p50_ms, st.p95_ms, st.p99_ms, st.max_ms);
+        }
+        if (counters && st.num_counted > 0)
+        {
+            fprintf (fp, "%*s%-*s", st.depth * 2, "", 32 - st.depth * 2, st.name);
+            print_scope_counters (fp, &st);
+        }
+        print_scope_tree (fp, i, num_scopes, counters);
+    }
+}
+
+void
+pmeter_print_summary (FILE *fp)
+{
+    int num_scopes = pmeter_get_num_scopes ();
+
+    if (num_scopes == 0)
+        return;
+
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    fprintf (fp, "%-32s %7s %8s %8s %8s %8s %8s\n", "scope [ms]", "count", "mean", "p50", "p95", "p99", "max");
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    print_scope_tree (fp, -1, num_scopes, 0);
+
+    if (__atomic_load_n (&s_counter_mask, __ATOMIC_RELAXED) == 0)
+        return;
+
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    fprintf (fp, "%-32s %7s %10s %8s %11s %11s\n", "scope [per call]", "count", "Mcycles", "IPC", "cache-MPKI", "branch-MPKI");
+    fprintf (fp, "-------------------------------------------------------------------------------------\n");
+    print_scope_tree (fp, -1, num_scopes, 1);
+}
+
 static char vs_pmeter[] = "                  \n\
 attribute vec4 a_Vertex;                     \n\
 uniform   vec4 u_Translate;                  \n\
@@ -5,8 +5,43 @@
 #ifndef _PMETER_H_
 #define _PMETER_H_
 
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define PMETER_MAX_LAP_NUM 128
 
+#define PMETER_MAX_SCOPES       64
+#define PMETER_MAX_DEPTH        16
+#define PMETER_WINDOW           256     /* samples of the rolling percentiles */
+
+/* hardware counters of the scopes (PMETER_COUNTERS=1) */
+#define PMETER_CNT_CYCLES           0
+#define PMETER_CNT_INSTRUCTIONS     1
+#define PMETER_CNT_CACHE_MISSES     2
+#define PMETER_CNT_BRANCH_MISSES    3
+#define PMETER_NUM_COUNTERS         4
+
+typedef struct _pmeter_scope_stats_t
+{
+    const char  *name;
+    int         parent;         /* scope id. -1: root */
+    int         depth;
+    int         count;          /* total */
+    double      total_ms;
+    double      max_ms;
+    double      last_ms;
+    double      p50_ms;         /* over the last PMETER_WINDOW samples */
+    double      p95_ms;
+    double      p99_ms;
+
+    int         num_counted;    /* samples with the hardware counters */
+    unsigned long long counter[PMETER_NUM_COUNTERS];    /* total of the counted samples */
+    unsigned int counter_mask;  /* (1 << PMETER_CNT_xxx): available */
+} pmeter_scope_stats_t;
+
 
 #if 1
 
@@ -16,6 +51,10 @@
 #define PMETER_RESET_LAP() pmeter_reset_lap (0)
 #define PMETER_SET_LAP()   pmeter_set_lap (0)
 
+#define PMETER_SCOPE_BEGIN(name) pmeter_scope_begin (name)
+#define PMETER_SCOPE_END()       pmeter_scope_end ()
+#define PMETER_SET_FRAME(frame)  pmeter_set_frame (frame)
+
 #else
 #define PMETER_RESET_LAP_EX(id) ((void)0)
 #define PMETER_SET_LAP_EX(id)   ((void)0)
@@ -23,6 +62,10 @@
 #define PMETER_RESET_LAP() ((void)0)
 #define PMETER_SET_LAP()   ((void)0)
 
+#define PMETER_SCOPE_BEGIN(name) ((void)0)
+#define PMETER_SCOPE_END()       ((void)0)
+#define PMETER_SET_FRAME(frame)  ((void)0)
+
 #endif
 
 double pmeter_get_time_ms ();
@@ -32,5 +75,20 @@ void   init_pmeter (int win_w, int win_h, int data_num);
 int    draw_pmeter_ex (int id, int x, int y, float scale);
 int    draw_pmeter (int x, int y);
 
+int    pmeter_scope_begin (const char *name);
+void   pmeter_scope_end ();
+int    pmeter_get_num_scopes ();
+int    pmeter_get_scope_stats (int scope_id, pmeter_scope_stats_t *stats);
+void   pmeter_print_summary (FILE *fp);
+
+void   pmeter_set_frame (int frame);
+int    pmeter_trace_enabled ();
+int    pmeter_trace_begin (const char *name);
+void   pmeter_trace_end (int handle);
+int    pmeter_trace_write (const char *path);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
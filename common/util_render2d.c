@@ -141,6 +141,27 @@ void main (void)                                      \n\
 }                                                     \n";
 
 
+/* ------------------------------------------------------ *
+ *  shader for uint8 label map + palette lookup
+ *      u_sampler : (w x h) LUMINANCE, class id per texel
+ *      u_palette : (256 x 1) RGBA,    color per class id
+ * ------------------------------------------------------ */
+static char fs_cmap_label[] ="                         \n\
+precision mediump float;                              \n\
+varying     vec2      v_TexCoord;                     \n\
+uniform     sampler2D u_sampler;                      \n\
+uniform     sampler2D u_palette;                      \n\
+uniform     vec4      u_Color;                        \n\
+                                                      \n\
+void main (void)                                      \n\
+{                                                     \n\
+    float label = texture2D (u_sampler, v_TexCoord).r;\n\
+    float u = (label * 255.0 + 0.5) / 256.0;          \n\
+    gl_FragColor = texture2D (u_palette, vec2(u, 0.5));\n\
+    gl_FragColor *= u_Color;                          \n\
+}                                                     \n";
+
+
 /* ------------------------------------------------------ *
  *  shader for YUYV Texture
  *      +--+--+--+--+
@@ -259,6 +280,7 @@ enum shader_type {
     SHADER_TYPE_CMAP_JET,       // 3
     SHADER_TYPE_TEX_YUYV,       // 4
     SHADER_TYPE_TEX_UYVY,       // 5
+    SHADER_TYPE_CMAP_LABEL,     // 6
 
     SHADER_TYPE_MAX
 };
@@ -272,12 +294,14 @@ static char *s_shader[SHADER_NUM * 2] =
     vs_tex,    fs_cmap_jet,
     vs_tex_yuyv, fs_tex_yuyv,
     vs_tex_uyvy, fs_tex_uyvy,
+    vs_tex,    fs_cmap_label,
 };
 
 static shader_obj_t s_sobj[SHADER_NUM];
 static int s_loc_mtx[SHADER_NUM];
 static int s_loc_color[SHADER_NUM];
 static int s_loc_texdim[SHADER_NUM];
+static int s_loc_palette[SHADER_NUM];
 
 static float varray[] =
 {   0.0, 0.0,
@@ -336,6 +360,7 @@ init_2d_renderer (int w, int h)
         s_loc_mtx[i]    = glGetUniformLocation(s_sobj[i].program, "u_PMVMatrix");
         s_loc_color[i]  = glGetUniformLocation(s_sobj[i].program, "u_Color");
         s_loc_texdim[i] = glGetUniformLocation(s_sobj[i].program, "u_TexDim");
+        s_loc_palette[i]= glGetUniformLocation(s_sobj[i].program, "u_palette");
     }
 
     set_projection_matrix (w, h);
@@ -347,6 +372,7 @@ typedef struct _texparam
 {
     int          textype;
     int          texid;
+    int          texid1;            /* palette for SHADER_TYPE_CMAP_LABEL */
     int          x, y, w, h;
     int          texw, texh;
     int          upsidedown;
@@ -389,6 +415,14 @@ draw_2d_texture_in (texparam_t *tparam)
         glBindTexture (GL_TEXTURE_2D, texid);
         uv = tparam->upsidedown ? tarray2 : tarray;
         break;
+    case SHADER_TYPE_CMAP_LABEL:
+        glUniform1i (s_loc_palette[ttype], 1);
+        glActiveTexture (GL_TEXTURE1);
+        glBindTexture (GL_TEXTURE_2D, tparam->texid1);
+        glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D, texid);
+        uv = tparam->upsidedown ? tarray2 : tarray;
+        break;
     case SHADER_TYPE_EXTEX:
         glBindTexture (GL_TEXTURE_EXTERNAL_OES, texid);
         uv = tparam->upsidedown ? tarray : tarray2;
@@ -664,6 +698,56 @@ draw_2d_colormap (int texid, int x, int y, int w, int h, float alpha, int upside
     return 0;
 }
 
+/*
+ *  draw uint8 label map with the class colors of (palette_texid).
+ *  see create_2d_label_texture() and create_2d_palette_texture().
+ */
+int
+draw_2d_labelmap (int texid, int palette_texid, int x, int y, int w, int h, float alpha, int upsidedown)
+{
+    texparam_t tparam = {0};
+    tparam.x       = x;
+    tparam.y       = y;
+    tparam.w       = w;
+    tparam.h       = h;
+    tparam.texid   = texid;
+    tparam.texid1  = palette_texid;
+    tparam.textype = SHADER_TYPE_CMAP_LABEL;
+    tparam.color[0]= 1.0f;
+    tparam.color[1]= 1.0f;
+    tparam.color[2]= 1.0f;
+    tparam.color[3]= alpha;
+    tparam.upsidedown = upsidedown;
+    draw_2d_texture_in (&tparam);
+
+    return 0;
+}
+
+int
+draw_2d_labelmap_rot (int texid, int palette_texid, int x, int y, int w, int h, float alpha,
+                      float px, float py, float deg)
+{
+    texparam_t tparam = {0};
+    tparam.x       = x;
+    tparam.y       = y;
+    tparam.w       = w;
+    tparam.h       = h;
+    tparam.texid   = texid;
+    tparam.texid1  = palette_texid;
+    tparam.textype = SHADER_TYPE_CMAP_LABEL;
+    tparam.rot     = deg;
+    tparam.px      = px * w;    /* relative pivot position (0 <= px <= 1) */
+    tparam.py      = py * h;    /* relative pivot position (0 <= py <= 1) */
+    tparam.color[0]= 1.0f;
+    tparam.color[1]= 1.0f;
+    tparam.color[2]= 1.0f;
+    tparam.color[3]= alpha;
+    tparam.upsidedown = 0;
+    draw_2d_texture_in (&tparam);
+
+    return 0;
+}
+
 
 int
 draw_2d_fillrect (int x, int y, int w, int h, float *color)
@@ -21,6 +21,9 @@ int draw_2d_texture_blendfunc (int texid, int x, int y, int w, int h,
 int draw_2d_texture_modulate (int texid, int x, int y, int w, int h,
                            int upsidedown, float *color, unsigned int *blendfunc);
 int draw_2d_colormap (int texid, int x, int y, int w, int h, float alpha, int upsidedown);
+int draw_2d_labelmap (int texid, int palette_texid, int x, int y, int w, int h, float alpha, int upsidedown);
+int draw_2d_labelmap_rot (int texid, int palette_texid, int x, int y, int w, int h, float alpha,
+                          float px, float py, float deg);
 
 int draw_2d_rect (int x, int y, int w, int h, float *color, float line_width);
 int draw_2d_rect_rot (int x, int y, int w, int h, float *color, float line_width,
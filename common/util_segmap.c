@@ -0,0 +1,169 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include "util_segmap.h"
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#include <arm_neon.h>
+#define SEGMAP_USE_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define SEGMAP_USE_SSE2
+#endif
+
+
+/*
+ *  argmax over the channels of one pixel.
+ *  SIMD lanes are mapped to channels; ties keep the lowest class id.
+ */
+static inline int
+argmax_channel (const float *p, int ch)
+{
+    int   c       = 1;
+    int   max_id  = 0;
+    float max_val = p[0];
+
+#if defined (SEGMAP_USE_NEON) || defined (SEGMAP_USE_SSE2)
+    if (ch >= 8)
+    {
+        float lane_val[4];
+        int   lane_id [4];
+#if defined (SEGMAP_USE_NEON)
+        float32x4_t vmax = vld1q_f32 (p);
+        int32x4_t   vcur = {0, 1, 2, 3};
+        int32x4_t   vidx = vcur;
+        int32x4_t   v4   = vdupq_n_s32 (4);
+        for (c = 4; c + 4 <= ch; c += 4)
+        {
+            float32x4_t v  = vld1q_f32 (p + c);
+            uint32x4_t  gt = vcgtq_f32 (v, vmax);
+            vcur = vaddq_s32 (vcur, v4);
+            vmax = vbslq_f32 (gt, v, vmax);
+            vidx = vbslq_s32 (gt, vcur, vidx);
+        }
+        vst1q_f32 (lane_val, vmax);
+        vst1q_s32 (lane_id,  vidx);
+#else
+        __m128  vmax = _mm_loadu_ps (p);
+        __m128i vcur = _mm_set_epi32 (3, 2, 1, 0);
+        __m128i vidx = vcur;
+        __m128i v4   = _mm_set1_epi32 (4);
+        for (c = 4; c + 4 <= ch; c += 4)
+        {
+            __m128  v   = _mm_loadu_ps (p + c);
+            __m128  gt  = _mm_cmpgt_ps (v, vmax);
+            __m128i gti = _mm_castps_si128 (gt);
+            vcur = _mm_add_epi32 (vcur, v4);
+            vmax = _mm_or_ps (_mm_and_ps (gt, v), _mm_andnot_ps (gt, vmax));
+            vidx = _mm_or_si128 (_mm_and_si128 (gti, vcur), _mm_andnot_si128 (gti, vidx));
+        }
+        _mm_storeu_ps (lane_val, vmax);
+        _mm_storeu_si128 ((__m128i *)lane_id, vidx);
+#endif
+        max_val = lane_val[0];
+        max_id  = lane_id [0];
+        for (int i = 1; i < 4; i ++)
+        {
+            if (lane_val[i] > max_val || (lane_val[i] == max_val && lane_id[i] < max_id))
+            {
+                max_val = lane_val[i];
+                max_id  = lane_id [i];
+            }
+        }
+    }
+#endif
+
+    for (; c < ch; c ++)
+    {
+        if (p[c] > max_val)
+        {
+            max_val = p[c];
+            max_id  = c;
+        }
+    }
+    return max_id;
+}
+
+/*
+ *  2 class (background/foreground) model.
+ *  SIMD lanes are mapped to pixels: deinterleave (c0, c1) of 4 pixels
+ *  and compare them at once.
+ */
+static void
+argmax_2class (const float *segmap, int num, uint8_t *labels)
+{
+    int i = 0;
+
+#if defined (SEGMAP_USE_NEON)
+    for (; i + 4 <= num; i += 4)
+    {
+        float32x4x2_t v  = vld2q_f32 (segmap + 2 * i);
+        uint32x4_t    gt = vshrq_n_u32 (vcgtq_f32 (v.val[1], v.val[0]), 31);
+        uint16x4_t    n  = vmovn_u32 (gt);
+        labels[i + 0] = vget_lane_u16 (n, 0);
+        labels[i + 1] = vget_lane_u16 (n, 1);
+        labels[i + 2] = vget_lane_u16 (n, 2);
+        labels[i + 3] = vget_lane_u16 (n, 3);
+    }
+#elif defined (SEGMAP_USE_SSE2)
+    for (; i + 4 <= num; i += 4)
+    {
+        __m128 a  = _mm_loadu_ps (segmap + 2 * i);
+        __m128 b  = _mm_loadu_ps (segmap + 2 * i + 4);
+        __m128 c0 = _mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0));
+        __m128 c1 = _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1));
+        int mask  = _mm_movemask_ps (_mm_cmpgt_ps (c1, c0));
+        labels[i + 0] = (mask >> 0) & 1;
+        labels[i + 1] = (mask >> 1) & 1;
+        labels[i + 2] = (mask >> 2) & 1;
+        labels[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+
+    for (; i < num; i ++)
+    {
+        labels[i] = (segmap[2 * i + 1] > segmap[2 * i]) ? 1 : 0;
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  find the most confident class for each pixel and
+ *  store it as a compact uint8 label map.
+ *      segmap: (h, w, ch) float
+ *      labels: (h, w)     uint8
+ * -------------------------------------------------- */
+void
+segmap_argmax_u8 (const float *segmap, int w, int h, int ch, uint8_t *labels)
+{
+    int num = w * h;
+
+    if (ch == 2)
+    {
+        argmax_2class (segmap, num, labels);
+        return;
+    }
+
+    for (int i = 0; i < num; i ++)
+    {
+        labels[i] = argmax_channel (segmap + i * ch, ch);
+    }
+}
+
+/* -------------------------------------------------- *
+ *  narrow int64 class labels (the model already applied
+ *  argmax) to uint8. out of range labels become 0.
+ * -------------------------------------------------- */
+void
+segmap_label_to_u8 (const int64_t *segmap, int w, int h, int num_class, uint8_t *labels)
+{
+    int num = w * h;
+
+    for (int i = 0; i < num; i ++)
+    {
+        int64_t val = segmap[i];
+        labels[i] = (val < 0 || val >= num_class) ? 0 : (uint8_t)val;
+    }
+}
@@ -0,0 +1,21 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_SEGMAP_H_
+#define _UTIL_SEGMAP_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void segmap_argmax_u8 (const float *segmap, int w, int h, int ch, uint8_t *labels);
+void segmap_label_to_u8 (const int64_t *segmap, int w, int h, int num_class, uint8_t *labels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_SEGMAP_H_ */
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <GLES2/gl2.h>
 #include "util_texture.h"
 #include "assertgl.h"
@@ -86,9 +87,107 @@ create_2d_texture_ex (texture_2d_t *tex2d, void *imgbuf, int width, int height,
     tex2d->width  = width;
     tex2d->height = height;
     tex2d->format = fmt;
+    tex2d->frame_seq = 0;
     return 0;
 }
 
+/* -------------------------------------------------- *
+ *  uint8 label map (one class id per texel).
+ *  sampled with NEAREST so that class ids are never
+ *  interpolated before the palette lookup.
+ * -------------------------------------------------- */
+int
+create_2d_label_texture (texture_2d_t *tex2d, void *labels, int width, int height)
+{
+    GLuint texid;
+
+    glGenTextures (1, &texid);
+    glBindTexture (GL_TEXTURE_2D, texid);
+
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_LUMINANCE, width, height, 0,
+                  GL_LUMINANCE, GL_UNSIGNED_BYTE, labels);
+
+    tex2d->texid  = texid;
+    tex2d->width  = width;
+    tex2d->height = height;
+    tex2d->format = pixfmt_fourcc ('L', 'A', 'B', '8');
+
+    GLASSERT();
+    return 0;
+}
+
+int
+update_2d_label_texture (texture_2d_t *tex2d, void *labels)
+{
+    glBindTexture (GL_TEXTURE_2D, tex2d->texid);
+
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, tex2d->width, tex2d->height,
+                     GL_LUMINANCE, GL_UNSIGNED_BYTE, labels);
+
+    GLASSERT();
+    return 0;
+}
+
+/* -------------------------------------------------- *
+ *  256x1 RGBA palette for the label map.
+ *      rgba: (num x 4) uint8. entries [num, 256) are zero.
+ * -------------------------------------------------- */
+int
+create_2d_palette_texture (texture_2d_t *tex2d, uint8_t *rgba, int num)
+{
+    uint8_t palette[256 * 4] = {0};
+    GLuint texid;
+
+    if (num > 256)
+        num = 256;
+    memcpy (palette, rgba, num * 4);
+
+    glGenTextures (1, &texid);
+    glBindTexture (GL_TEXTURE_2D, texid);
+
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, 256, 1, 0,
+                  GL_RGBA, GL_UNSIGNED_BYTE, palette);
+
+    tex2d->texid  = texid;
+    tex2d->width  = 256;
+    tex2d->height = 1;
+    tex2d->format = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+    GLASSERT();
+    return 0;
+}
+
+/* overwrite the entries [0, num) of the palette. the others are kept. */
+int
+update_2d_palette_texture (texture_2d_t *tex2d, uint8_t *rgba, int num)
+{
+    if (num > 256)
+        num = 256;
+
+    glBindTexture (GL_TEXTURE_2D, tex2d->texid);
+
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, num, 1,
+                     GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+    GLASSERT();
+    return 0;
+}
+
+
 
 int
 load_png_texture (char *name, int *lpTexID, int *lpWidth, int *lpHeight)
@@ -217,12 +316,20 @@ create_capture_texture (texture_2d_t *captex)
     return 0;
 }
 
-void
+/*
+ *  upload the latest captured frame.
+ *  return 1 if the texture is updated, 0 if no new frame has been captured.
+ */
+int
 update_capture_texture (texture_2d_t *captex)
 {
     int      cap_w, cap_h;
     uint32_t cap_fmt;
     void     *cap_buf;
+    uint32_t cap_seq = get_capture_frame_seq ();
+
+    if (cap_seq == captex->frame_seq)
+        return 0;
 
     get_capture_dimension (&cap_w, &cap_h);
     get_capture_pixformat (&cap_fmt);
@@ -244,7 +351,10 @@ update_capture_texture (texture_2d_t *captex)
 
         glBindTexture (GL_TEXTURE_2D, captex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, cap_buf);
+        captex->frame_seq = cap_seq;
+        return 1;
     }
+    return 0;
 }
 #endif
 
@@ -267,12 +377,20 @@ create_video_texture (texture_2d_t *vidtex, const char *fname)
     return 0;
 }
 
-void
+/*
+ *  upload the latest decoded frame.
+ *  return 1 if the texture is updated, 0 if no new frame has been decoded.
+ */
+int
 update_video_texture (texture_2d_t *vidtex)
 {
     int   video_w, video_h;
     uint32_t video_fmt;
     void *video_buf;
+    uint32_t video_seq = get_video_frame_seq ();
+
+    if (video_seq == vidtex->frame_seq)
+        return 0;
 
     get_video_dimension (&video_w, &video_h);
     get_video_pixformat (&video_fmt);
@@ -295,7 +413,10 @@ update_video_texture (texture_2d_t *vidtex)
 
         glBindTexture (GL_TEXTURE_2D, vidtex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, video_buf);
+        vidtex->frame_seq = video_seq;
+        return 1;
     }
+    return 0;
 }
 
 #endif /* USE_INPUT_VIDEO_DECODE */
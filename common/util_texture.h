@@ -16,6 +16,7 @@ typedef struct _texture_2d_t
     int         width;
     int         height;
     uint32_t    format;
+    uint32_t    frame_seq;      /* sequence number of the uploaded capture/video frame */
 } texture_2d_t;
 
 int load_png_texture (char *name, int *lpTexID, int *width, int *height);
@@ -25,14 +26,19 @@ uint32_t create_2d_texture (void *imgbuf, int width, int height);
 
 int create_2d_texture_ex (texture_2d_t *tex2d, void *imgbuf, int w, int h, uint32_t fmt);
 
+int create_2d_label_texture (texture_2d_t *tex2d, void *labels, int w, int h);
+int update_2d_label_texture (texture_2d_t *tex2d, void *labels);
+int create_2d_palette_texture (texture_2d_t *tex2d, uint8_t *rgba, int num);
+int update_2d_palette_texture (texture_2d_t *tex2d, uint8_t *rgba, int num);
+
 #if defined (USE_INPUT_CAMERA_CAPTURE2)
 int  create_capture_texture (texture_2d_t *captex);
-void update_capture_texture (texture_2d_t *captex);
+int  update_capture_texture (texture_2d_t *captex);
 #endif
 
 #if defined (USE_INPUT_VIDEO_DECODE2)
 int  create_video_texture (texture_2d_t *vidtex, const char *fname);
-void update_video_texture (texture_2d_t *vidtex);
+int  update_video_texture (texture_2d_t *vidtex);
 #endif
 
 #endif /* TEXTURE_UTIL_H */
@@ -2,11 +2,31 @@
  * The MIT License (MIT)
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <algorithm>
+#if defined (USE_XNNPACK_WEIGHTS_CACHE)
+#include <dirent.h>
+#include <libgen.h>
+#include <limits.h>
+#endif
 #include "util_tflite.h"
+#include "util_pmeter.h"
 #include "util_debug.h"
 
 using namespace tflite;
 
+/* -1: not yet resolved from TFLITE_TENSOR_INFO environment variable */
+static int s_print_tensor_info = -1;
+
+/* -1: not yet resolved from TFLITE_WARMUP environment variable */
+static int s_warmup_num = -1;
+
+/* -1: not yet resolved from TFLITE_IDLE_RELEASE environment variable */
+static int s_idle_release = -1;
 
 
 static void
@@ -74,6 +94,27 @@ print_tensor (TfLiteTensor *tensor, int idx)
     DBG_LOG ("\n");
 }
 
+/*
+ *  the tensor info dump on the interpreter creation is off by default.
+ *  enable it with tflite_set_print_tensor_info(1) or TFLITE_TENSOR_INFO=1.
+ */
+void
+tflite_set_print_tensor_info (int enable)
+{
+    s_print_tensor_info = enable;
+}
+
+int
+tflite_get_print_tensor_info ()
+{
+    if (s_print_tensor_info < 0)
+    {
+        const char *env = getenv ("TFLITE_TENSOR_INFO");
+        s_print_tensor_info = (env && atoi (env) != 0) ? 1 : 0;
+    }
+    return s_print_tensor_info;
+}
+
 void
 tflite_print_tensor_info (std::unique_ptr<Interpreter> &interpreter)
 {
@@ -133,10 +174,100 @@ tflite_print_tensor_info (std::unique_ptr<Interpreter> &interpreter)
 }
 
 
+#if defined (USE_XNNPACK_WEIGHTS_CACHE)
+/* -------------------------------------------------- *
+ *  XNNPACK weights cache
+ *
+ *  the repacked weights are stored in a file next to the model, and
+ *  mmapped by the later launches instead of repacking them again.
+ *  the file name has the hash of the model, so a cache of another
+ *  version of the model is never used. (and is removed)
+ * -------------------------------------------------- */
+static uint64_t
+hash_model (tflite_interpreter_t *p)
+{
+    const Allocation *alloc = p->model->allocation ();
+    uint64_t h = 0xcbf29ce484222325ULL;   /* FNV-1a, 8 bytes at a time */
+
+    if (alloc == NULL || alloc->base () == NULL)
+        return 0;
+
+    const uint8_t *buf  = (const uint8_t *)alloc->base ();
+    size_t        size  = alloc->bytes ();
+    size_t        i     = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t w;
+        memcpy (&w, buf + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    for (; i < size; i ++)
+        h = (h ^ buf[i]) * 0x100000001b3ULL;
+
+    return h ^ size;
+}
+
+/* remove "<model>.*.xnnpack_cache" other than (cur_path) */
+static void
+remove_stale_weights_cache (const char *model_path, const char *cur_path)
+{
+    char dir_buf[PATH_MAX], base_buf[PATH_MAX], path[PATH_MAX];
+    const char *suffix = ".xnnpack_cache";
+
+    snprintf (dir_buf,  sizeof (dir_buf),  "%s", model_path);
+    snprintf (base_buf, sizeof (base_buf), "%s", model_path);
+    const char *dir  = dirname (dir_buf);
+    const char *base = basename (base_buf);
+    size_t base_len  = strlen (base);
+    size_t sfx_len   = strlen (suffix);
+
+    DIR *dp = opendir (dir);
+    if (dp == NULL)
+        return;
+
+    struct dirent *ent;
+    while ((ent = readdir (dp)) != NULL)
+    {
+        size_t len = strlen (ent->d_name);
+        if (len <= base_len + sfx_len ||
+            strncmp (ent->d_name, base, base_len) != 0 || ent->d_name[base_len] != '.' ||
+            strcmp (ent->d_name + len - sfx_len, suffix) != 0)
+            continue;
+
+        snprintf (path, sizeof (path), "%s/%s", dir, ent->d_name);
+        if (strcmp (path, cur_path) != 0)
+        {
+            DBG_LOG ("remove stale weights cache: %s\n", path);
+            unlink (path);
+        }
+    }
+    closedir (dp);
+}
+
+static const char *
+get_weights_cache_path (tflite_interpreter_t *p, const char *model_path)
+{
+    char path[PATH_MAX];
+
+    if (model_path == NULL)
+        return NULL;
+
+    snprintf (path, sizeof (path), "%s.%016llx.xnnpack_cache",
+              model_path, (unsigned long long)hash_model (p));
+    remove_stale_weights_cache (model_path, path);
+
+    p->weights_cache_path = path;
+    return p->weights_cache_path.c_str ();
+}
+#endif
+
+
 static int
-modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
+modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt, const char *model_path)
 {
     TfLiteDelegate *delegate = NULL;
+    void (*delete_func) (TfLiteDelegate *) = NULL;
 
 #if defined (USE_GL_DELEGATE)
     const TfLiteGpuDelegateOptions options = {
@@ -148,6 +279,7 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
         },
     };
     delegate = TfLiteGpuDelegateCreate(&options);
+    delete_func = TfLiteGpuDelegateDelete;
 
 #if defined (USE_INPUT_SSBO)
     if (opt && opt->gpubuffer)
@@ -174,10 +306,11 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
         .inference_priority3 = TFLITE_GPU_INFERENCE_PRIORITY_AUTO,
     };
     delegate = TfLiteGpuDelegateV2Create(&options);
+    delete_func = TfLiteGpuDelegateV2Delete;
 #endif
 
 #if defined (USE_NNAPI_DELEGATE)
-    delegate = tflite::NnApiDelegate ();
+    delegate = tflite::NnApiDelegate ();     /* a singleton, not deleted */
 #endif
 
 
@@ -193,16 +326,11 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
     TfLiteHexagonInit();  // Needed once at startup.
     TfLiteHexagonDelegateOptions params = {0};
 
-    // 'delegate_ptr' Need to outlive the interpreter. For example,
+    // 'delegate' Need to outlive the interpreter. For example,
     // If use case will need to resize input or anything that can trigger
-    // re-applying delegates then 'delegate_ptr' need to outlive the interpreter.
-    auto* delegate_ptr = TfLiteHexagonDelegateCreate(&params);
-    tflite::Interpreter::TfLiteDelegatePtr delegatep(delegate_ptr,
-        [](TfLiteDelegate* delegatep) {
-            TfLiteHexagonDelegateDelete(delegatep);
-        });
-
-    delegate = delegatep.get();
+    // re-applying delegates then 'delegate' need to outlive the interpreter.
+    delegate = TfLiteHexagonDelegateCreate(&params);
+    delete_func = TfLiteHexagonDelegateDelete;
 #endif
 
 #if defined (USE_XNNPACK_DELEGATE)
@@ -214,16 +342,32 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
     TfLiteXNNPackDelegateOptions xnnpack_options = TfLiteXNNPackDelegateOptionsDefault();
     xnnpack_options.num_threads = num_threads;
 
+#if defined (USE_XNNPACK_WEIGHTS_CACHE)
+    /* needs TfLiteXNNPackDelegateOptions::weight_cache_file_path (the file-backed weight cache) */
+    xnnpack_options.weight_cache_file_path = get_weights_cache_path (p, model_path);
     delegate = TfLiteXNNPackDelegateCreate (&xnnpack_options);
     if (!delegate)
+    {
+        /* e.g. the model directory is read-only. repack the weights in memory. */
+        DBG_LOGW ("can't use the weights cache: %s\n", xnnpack_options.weight_cache_file_path);
+        xnnpack_options.weight_cache_file_path = NULL;
+    }
+#endif
+    if (!delegate)
+        delegate = TfLiteXNNPackDelegateCreate (&xnnpack_options);
+    if (!delegate)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
     }
+    delete_func = TfLiteXNNPackDelegateDelete;
 #endif
 
     if (!delegate)
         return 0;
 
+    /* owned by (p), and deleted after the interpreter (e.g. at the hot swap) */
+    p->delegate = std::unique_ptr<TfLiteDelegate, tflite_delegate_deleter_t> (delegate, {delete_func});
+
     if (p->interpreter->ModifyGraphWithDelegate(delegate) != kTfLiteOk)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
@@ -234,9 +378,439 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
 }
 
 
+/* -------------------------------------------------- *
+ *  warm-up
+ *
+ *  the first Invoke() is several times slower than the steady state,
+ *  because of the page faults on the mmapped weights and the lazy
+ *  initialization of the kernels. they are paid at the creation of the
+ *  interpreter instead of on the first frame.
+ * -------------------------------------------------- */
+static double
+get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + tv.tv_nsec / 1000000.0);
+}
+
+/*
+ *  the number of the dummy invocations on the creation.
+ *  default 3. 0 disables the warm-up. (or TFLITE_WARMUP=n)
+ */
+void
+tflite_set_warmup (int num_invoke)
+{
+    s_warmup_num = num_invoke;
+}
+
+int
+tflite_get_warmup ()
+{
+    if (s_warmup_num < 0)
+    {
+        const char *env = getenv ("TFLITE_WARMUP");
+        s_warmup_num = env ? atoi (env) : 3;
+        if (s_warmup_num < 0)
+            s_warmup_num = 0;
+    }
+    return s_warmup_num;
+}
+
+/* read ahead the model mapping, and touch every page of it. */
+static void
+prefault_model (tflite_interpreter_t *p)
+{
+    const Allocation *alloc = p->model ? p->model->allocation () : NULL;
+    if (alloc == NULL || alloc->base () == NULL)
+        return;
+
+    const volatile uint8_t *base = (const volatile uint8_t *)alloc->base ();
+    size_t    size  = alloc->bytes ();
+    uintptr_t page  = (uintptr_t)sysconf (_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)base & ~(page - 1);
+
+    madvise ((void *)start, size + ((uintptr_t)base - start), MADV_WILLNEED);
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i += page)
+        sum += base[i];
+    (void)sum;
+}
+
+/* representative input: zero in the (de)quantized domain */
+static void
+fill_dummy_input (TfLiteTensor *tensor)
+{
+    if (tensor->data.raw == NULL)
+        return;
+
+    switch (tensor->type)
+    {
+    case kTfLiteUInt8:
+    case kTfLiteInt8:
+        memset (tensor->data.raw, tensor->params.zero_point, tensor->bytes);
+        break;
+    default:
+        memset (tensor->data.raw, 0, tensor->bytes);
+        break;
+    }
+}
+
+/*
+ *  prefault the model, and run (num_invoke) dummy invocations.
+ *  the inputs are overwritten, so call this before the app feeds them.
+ */
+int
+tflite_warmup (tflite_interpreter_t *p, int num_invoke, tflite_warmup_stat_t *stat)
+{
+    std::unique_ptr<Interpreter> &interpreter = p->interpreter;
+    tflite_warmup_stat_t st = {0};
+    double t0, t1;
+
+    if (!interpreter)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    t0 = get_time_ms ();
+    prefault_model (p);
+    t1 = get_time_ms ();
+    st.prefault_ms = t1 - t0;
+
+    for (size_t i = 0; i < interpreter->inputs ().size (); i ++)
+        fill_dummy_input (interpreter->tensor (interpreter->inputs ()[i]));
+
+    for (int i = 0; i < num_invoke; i ++)
+    {
+        t0 = get_time_ms ();
+        if (interpreter->Invoke () != kTfLiteOk)
+        {
+            DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+        t1 = get_time_ms ();
+
+        if (i == 0)
+            st.first_ms = t1 - t0;
+        else
+            st.steady_ms += (t1 - t0) / (num_invoke - 1);
+    }
+    st.num_invoke = num_invoke;
+
+    if (stat)
+        *stat = st;
+    return 0;
+}
+
+static void
+warmup_and_report (tflite_interpreter_t *p, const char *model_path)
+{
+    tflite_warmup_stat_t stat;
+
+    if (tflite_warmup (p, tflite_get_warmup (), &stat) < 0)
+        return;
+
+    DBG_LOG ("warmup: %s: prefault %.1f [ms], first invoke %.1f [ms], steady %.1f [ms]\n",
+             model_path, stat.prefault_ms, stat.first_ms, stat.steady_ms);
+}
+
+
+/*
+ *  forward the operator events of the interpreters to the pmeter trace.
+ *  (the tags of TFLite are static strings)
+ */
+class pmeter_trace_profiler : public tflite::Profiler
+{
+public:
+    uint32_t BeginEvent (const char *tag, EventType event_type,
+                         int64_t event_metadata1, int64_t event_metadata2) override
+    {
+        if (!pmeter_trace_enabled ())
+            return (uint32_t)-1;
+
+        return (uint32_t)pmeter_trace_begin (tag);
+    }
+
+    void EndEvent (uint32_t event_handle) override
+    {
+        pmeter_trace_end ((int)event_handle);
+    }
+};
+
+static pmeter_trace_profiler s_trace_profiler;
+
+
+/*
+ *  memory accounting (util_memory).
+ *  the tensors of an arena point into one buffer, so the span of them is
+ *  the size of the arena. 0 while the arena is released.
+ */
+static size_t
+get_arena_span (Interpreter *interpreter, TfLiteAllocationType type)
+{
+    uintptr_t lo = UINTPTR_MAX, hi = 0;
+
+    for (size_t i = 0; i < interpreter->tensors_size (); i ++)
+    {
+        const TfLiteTensor *tensor = interpreter->tensor (i);
+        if (tensor->allocation_type != type || tensor->data.raw == NULL || tensor->bytes == 0)
+            continue;
+
+        uintptr_t addr = (uintptr_t)tensor->data.raw;
+        if (addr < lo)
+            lo = addr;
+        if (addr + tensor->bytes > hi)
+            hi = addr + tensor->bytes;
+    }
+
+    return (hi > lo) ? hi - lo : 0;
+}
+
+int
+tflite_get_memory_info (tflite_interpreter_t *p, mem_model_info_t *info)
+{
+    Interpreter *interpreter = p->interpreter.get ();
+
+    if (interpreter == NULL)
+        return -1;
+
+    const Allocation *alloc = p->model ? p->model->allocation () : NULL;
+
+    info->name             = p->model_path.c_str ();
+    info->model_bytes      = alloc ? alloc->bytes () : 0;
+    info->arena_bytes      = get_arena_span (interpreter, kTfLiteArenaRw);
+    info->persistent_bytes = get_arena_span (interpreter, kTfLiteArenaRwPersistent);
+    info->dynamic_bytes    = 0;
+    info->load_rss_bytes   = p->load_rss_bytes;
+
+    for (size_t i = 0; i < interpreter->tensors_size (); i ++)
+    {
+        const TfLiteTensor *tensor = interpreter->tensor (i);
+        if (tensor->allocation_type == kTfLiteDynamic && tensor->data.raw)
+            info->dynamic_bytes += tensor->bytes;
+    }
+
+    return 0;
+}
+
+static int
+query_memory_info (void *handle, mem_model_info_t *info)
+{
+    return tflite_get_memory_info ((tflite_interpreter_t *)handle, info);
+}
+
+static void
+register_memory_info (tflite_interpreter_t *p, const char *model_path, size_t rss0)
+{
+    size_t rss, peak;
+
+    mem_get_process_rss (&rss, &peak);
+    p->model_path     = model_path;
+    p->load_rss_bytes = (long)rss - (long)rss0;
+
+    mem_register_model (p, query_memory_info);
+}
+
+
+/* -------------------------------------------------- *
+ *  release of the idle arenas
+ *
+ *  the second model of a multi-model app (face -> landmark, portrait, ...)
+ *  runs only while a face is found, but keeps its activation arena.
+ *  the non-persistent arena of an interpreter not used for (idle_frames)
+ *  frames is released, and allocated again when the interpreter is used.
+ *  the weights and the delegate stay, so the re-allocation is cheap, and
+ *  its cost is measured ("tflite_realloc" scope of pmeter).
+ *
+ *  an app opts in per interpreter with tflite_enable_idle_release(), and
+ *  brackets the use of it, from feeding the input until reading the output,
+ *  with tflite_begin_use() and tflite_end_use(). tflite_idle_next_frame()
+ *  is called once per processed frame. the output must not be read after
+ *  tflite_end_use() if the interpreter can be released meanwhile.
+ * -------------------------------------------------- */
+static pthread_mutex_t                      s_idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<tflite_interpreter_t *>  s_idle_list;
+static int                                  s_idle_frame;
+
+/*
+ *  the number of the idle frames before the release.
+ *  default 0 (never released). (or TFLITE_IDLE_RELEASE=n)
+ */
+void
+tflite_set_idle_release (int idle_frames)
+{
+    s_idle_release = idle_frames;
+}
+
+int
+tflite_get_idle_release ()
+{
+    if (s_idle_release < 0)
+    {
+        const char *env = getenv ("TFLITE_IDLE_RELEASE");
+        s_idle_release = env ? atoi (env) : 0;
+        if (s_idle_release < 0)
+            s_idle_release = 0;
+    }
+    return s_idle_release;
+}
+
+/*
+ *  call after the creation, and before the tensors are bound by
+ *  tflite_get_tensor_by_name(). their pointers are updated when the
+ *  arena is allocated again.
+ */
+int
+tflite_enable_idle_release (tflite_interpreter_t *p)
+{
+    if (!p->interpreter)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+#if !defined (USE_GL_DELEGATE) && !defined (USE_GPU_DELEGATEV2)  /* their memory is not in the arena */
+    pthread_mutex_lock (&s_idle_mutex);
+    if (!p->idle_enabled)
+    {
+        p->idle_enabled    = 1;
+        p->idle_busy       = 0;
+        p->idle_released   = 0;
+        p->idle_last_frame = s_idle_frame;
+        memset (&p->idle_stat, 0, sizeof (p->idle_stat));
+        p->idle_tensors.clear ();
+        s_idle_list.push_back (p);
+    }
+    pthread_mutex_unlock (&s_idle_mutex);
+#endif
+
+    return 0;
+}
+
+/*
+ *  mark (p) in use, and allocate its arena again if released.
+ *  return 1 if allocated again (the bound tensors point to the new arena),
+ *  0 if not, -1 on failure.
+ */
+int
+tflite_begin_use (tflite_interpreter_t *p)
+{
+    int released;
+    double t0, t1;
+
+    if (!p->idle_enabled)
+        return 0;
+
+    pthread_mutex_lock (&s_idle_mutex);
+    p->idle_busy       = 1;
+    p->idle_last_frame = s_idle_frame;
+    released           = p->idle_released;
+    pthread_mutex_unlock (&s_idle_mutex);
+
+    if (!released)
+        return 0;
+
+    /* (busy) keeps the scan of tflite_idle_next_frame() away meanwhile */
+    PMETER_SCOPE_BEGIN ("tflite_realloc");
+    t0 = get_time_ms ();
+    TfLiteStatus status = p->interpreter->AllocateTensors ();
+    t1 = get_time_ms ();
+    PMETER_SCOPE_END ();
+
+    if (status != kTfLiteOk)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (size_t i = 0; i < p->idle_tensors.size (); i ++)
+    {
+        tflite_tensor_t *t = p->idle_tensors[i];
+        t->ptr = p->interpreter->tensor (t->idx)->data.raw;
+    }
+
+    pthread_mutex_lock (&s_idle_mutex);
+    tflite_idle_stat_t *stat = &p->idle_stat;
+    stat->num_realloc ++;
+    stat->realloc_ms        = t1 - t0;
+    stat->realloc_total_ms += t1 - t0;
+    if (stat->realloc_max_ms < t1 - t0)
+        stat->realloc_max_ms = t1 - t0;
+    p->idle_released = 0;
+    pthread_mutex_unlock (&s_idle_mutex);
+
+    DBG_LOG ("idle release: %s: allocated again in %.2f [ms]\n", p->model_path.c_str (), t1 - t0);
+    return 1;
+}
+
+void
+tflite_end_use (tflite_interpreter_t *p)
+{
+    if (!p->idle_enabled)
+        return;
+
+    pthread_mutex_lock (&s_idle_mutex);
+    p->idle_busy = 0;
+    pthread_mutex_unlock (&s_idle_mutex);
+}
+
+/* release the arenas of the interpreters idle for (idle_frames) frames */
+void
+tflite_idle_next_frame ()
+{
+    int idle_frames = tflite_get_idle_release ();
+
+    pthread_mutex_lock (&s_idle_mutex);
+
+    s_idle_frame ++;
+
+    for (size_t i = 0; i < s_idle_list.size () && idle_frames > 0; i ++)
+    {
+        tflite_interpreter_t *p = s_idle_list[i];
+
+        if (p->idle_busy || p->idle_released || s_idle_frame - p->idle_last_frame < idle_frames)
+            continue;
+
+        size_t bytes = get_arena_span (p->interpreter.get (), kTfLiteArenaRw);
+        if (p->interpreter->ReleaseNonPersistentMemory () != kTfLiteOk)
+        {
+            DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+            continue;
+        }
+
+        p->idle_released = 1;
+        p->idle_stat.num_release ++;
+        p->idle_stat.released_bytes = bytes;
+
+        DBG_LOG ("idle release: %s: released %zu [KB]\n", p->model_path.c_str (), bytes / 1024);
+    }
+
+    pthread_mutex_unlock (&s_idle_mutex);
+}
+
+int
+tflite_get_idle_stat (tflite_interpreter_t *p, tflite_idle_stat_t *stat)
+{
+    if (!p->idle_enabled)
+        return -1;
+
+    pthread_mutex_lock (&s_idle_mutex);
+    *stat = p->idle_stat;
+    pthread_mutex_unlock (&s_idle_mutex);
+
+    return 0;
+}
+
+
 int
 tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_path)
 {
+    size_t rss0, peak;
+
+    mem_get_process_rss (&rss0, &peak);
+
     p->model = FlatBufferModel::BuildFromFile (model_path);
     if (!p->model)
     {
@@ -244,6 +818,10 @@ tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_
         return -1;
     }
 
+    /* fault in the weights before the delegate packs them */
+    if (tflite_get_warmup () > 0)
+        prefault_model (p);
+
     InterpreterBuilder(*(p->model), p->resolver)(&(p->interpreter));
     if (!p->interpreter)
     {
@@ -251,29 +829,37 @@ tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_
         return -1;
     }
 
-    if (modify_graph_with_delegate (p, NULL) < 0)
+    if (modify_graph_with_delegate (p, NULL, model_path) < 0)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         //return -1;
     }
 
     p->interpreter->SetNumThreads(4);
+    p->interpreter->SetProfiler (&s_trace_profiler);
     if (p->interpreter->AllocateTensors() != kTfLiteOk)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
-#if 1 /* for debug */
-    tflite_print_tensor_info (p->interpreter);
-#endif
+    if (tflite_get_print_tensor_info ())
+        tflite_print_tensor_info (p->interpreter);
 
+    if (tflite_get_warmup () > 0)
+        warmup_and_report (p, model_path);
+
+    register_memory_info (p, model_path, rss0);
     return 0;
 }
 
 int
 tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *model_path, tflite_createopt_t *opt)
 {
+    size_t rss0, peak;
+
+    mem_get_process_rss (&rss0, &peak);
+
     p->model = FlatBufferModel::BuildFromFile (model_path);
     if (!p->model)
     {
@@ -281,6 +867,10 @@ tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *mod
         return -1;
     }
 
+    /* fault in the weights before the delegate packs them */
+    if (tflite_get_warmup () > 0)
+        prefault_model (p);
+
     InterpreterBuilder(*(p->model), p->resolver)(&(p->interpreter));
     if (!p->interpreter)
     {
@@ -294,23 +884,45 @@ tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *mod
     p->interpreter->ResizeInputTensor(input_id, sizes);
 #endif
 
-    if (modify_graph_with_delegate (p, opt) < 0)
+    if (modify_graph_with_delegate (p, opt, model_path) < 0)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
     p->interpreter->SetNumThreads(4);
+    p->interpreter->SetProfiler (&s_trace_profiler);
     if (p->interpreter->AllocateTensors() != kTfLiteOk)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
-#if 1 /* for debug */
-    tflite_print_tensor_info (p->interpreter);
-#endif
+    if (tflite_get_print_tensor_info ())
+        tflite_print_tensor_info (p->interpreter);
+
+    if (tflite_get_warmup () > 0)
+        warmup_and_report (p, model_path);
 
+    register_memory_info (p, model_path, rss0);
+    return 0;
+}
+
+/*
+ *  change the number of threads of the CPU kernels at runtime.
+ *  (the threads of the delegates are fixed at the creation)
+ *  must not be called while the interpreter is invoked.
+ */
+int
+tflite_set_num_threads (tflite_interpreter_t *p, int num_threads)
+{
+    if (!p->interpreter || num_threads < 1)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    p->interpreter->SetNumThreads (num_threads);
     return 0;
 }
 
@@ -380,6 +992,12 @@ tflite_get_tensor_by_name (tflite_interpreter_t *p, int io, const char *name, tf
         ptensor->dims[i] = tensor->dims->data[i];
     }
 
+    if (p->idle_enabled &&
+        std::find (p->idle_tensors.begin (), p->idle_tensors.end (), ptensor) == p->idle_tensors.end ())
+    {
+        p->idle_tensors.push_back (ptensor);
+    }
+
     return 0;
 }
 
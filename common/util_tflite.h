@@ -27,15 +27,46 @@
 #include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
 #endif
 
+#include "util_memory.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct tflite_idle_stat_t
+{
+    int         num_release;
+    int         num_realloc;
+    size_t      released_bytes;     /* arena of the last release */
+    double      realloc_ms;         /* the last re-allocation */
+    double      realloc_max_ms;
+    double      realloc_total_ms;
+} tflite_idle_stat_t;
+
+/* deletes a delegate by the function of its kind. (func) NULL: not owned */
+typedef struct tflite_delegate_deleter_t
+{
+    void (*func) (TfLiteDelegate *delegate);
+    void operator() (TfLiteDelegate *delegate) const { if (func) func (delegate); }
+} tflite_delegate_deleter_t;
+
 typedef struct tflite_interpreter_t
 {
     std::unique_ptr<tflite::FlatBufferModel> model;
+    std::unique_ptr<TfLiteDelegate, tflite_delegate_deleter_t> delegate;   /* outlives the interpreter */
     std::unique_ptr<tflite::Interpreter>     interpreter;
     tflite::ops::builtin::BuiltinOpResolver  resolver;
+    std::string                              weights_cache_path;    /* XNNPACK weights cache */
+    std::string                              model_path;
+    long                                     load_rss_bytes;        /* RSS growth while created */
+
+    /* release of the idle arena (tflite_enable_idle_release) */
+    int                                      idle_enabled;
+    int                                      idle_busy;             /* between begin/end_use */
+    int                                      idle_released;
+    int                                      idle_last_frame;
+    tflite_idle_stat_t                       idle_stat;
+    std::vector<struct tflite_tensor_t *>    idle_tensors;          /* rebound on the re-allocation */
 } tflite_interpreter_t;
 
 typedef struct tflite_createopt_t
@@ -43,6 +74,14 @@ typedef struct tflite_createopt_t
     int gpubuffer;
 } tflite_createopt_t;
 
+typedef struct tflite_warmup_stat_t
+{
+    double      prefault_ms;
+    double      first_ms;       /* the first Invoke() */
+    double      steady_ms;      /* average of the following Invoke()s */
+    int         num_invoke;
+} tflite_warmup_stat_t;
+
 typedef struct tflite_tensor_t
 {
     int         idx;        /* whole  tensor index */
@@ -62,6 +101,23 @@ int tflite_get_tensor_by_name (tflite_interpreter_t *p, int io, const char *name
 
 int tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_path);
 int tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *model_path, tflite_createopt_t *opt);
+int tflite_set_num_threads (tflite_interpreter_t *p, int num_threads);
+int tflite_get_memory_info (tflite_interpreter_t *p, mem_model_info_t *info);
+
+void tflite_set_idle_release (int idle_frames);
+int  tflite_get_idle_release ();
+int  tflite_enable_idle_release (tflite_interpreter_t *p);
+int  tflite_begin_use (tflite_interpreter_t *p);
+void tflite_end_use (tflite_interpreter_t *p);
+void tflite_idle_next_frame ();
+int  tflite_get_idle_stat (tflite_interpreter_t *p, tflite_idle_stat_t *stat);
+
+void tflite_set_print_tensor_info (int enable);
+
+void tflite_set_warmup (int num_invoke);
+int  tflite_get_warmup ();
+int  tflite_warmup (tflite_interpreter_t *p, int num_invoke, tflite_warmup_stat_t *stat);
+int  tflite_get_print_tensor_info ();
 
 
 
@@ -69,5 +125,7 @@ int tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char
 }
 #endif
 
+void tflite_print_tensor_info (std::unique_ptr<tflite::Interpreter> &interpreter);
+
 #endif /* _UTIL_TFLITE_H_ */
 
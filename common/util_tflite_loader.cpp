@@ -0,0 +1,253 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <string.h>
+#include "util_tflite_loader.h"
+#include "util_debug.h"
+
+/*
+ *  build the interpreters of an app concurrently.
+ *
+ *  each model (file map, interpreter build, delegate, AllocateTensors)
+ *  is created by a task of a thread pool, so the main thread can create
+ *  the GL resources meanwhile, and join the loads with tflite_loader_wait().
+ *
+ *  the GPU delegates must be created on the GL thread. with them, the
+ *  pool has no thread and every model is created on the caller thread
+ *  in tflite_loader_wait().
+ */
+static void
+load_model_task (void *arg)
+{
+    tflite_load_req_t *req = (tflite_load_req_t *)arg;
+
+    req->ret = tflite_create_interpreter_from_file (req->interpreter, req->model_path);
+}
+
+
+int
+tflite_loader_start (tflite_loader_t *ld, int num_models)
+{
+    int num_threads = num_models;
+
+    memset (&ld->reqs, 0, sizeof (ld->reqs));
+    ld->num_reqs = 0;
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    num_threads = 0;
+#endif
+    threadpool_init (&ld->pool, num_threads);
+
+    /* the dumps of the concurrent loads would interleave. print them at the join. */
+    ld->print_info = tflite_get_print_tensor_info ();
+    tflite_set_print_tensor_info (0);
+
+    ld->started = 1;
+    return 0;
+}
+
+int
+tflite_loader_add (tflite_loader_t *ld, tflite_interpreter_t *p, const char *model_path)
+{
+    if (!ld->started || ld->num_reqs >= TFLITE_LOADER_MAX_MODELS)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    tflite_load_req_t *req = &ld->reqs[ld->num_reqs ++];
+    req->interpreter = p;
+    req->model_path  = model_path;
+    req->ret         = -1;
+
+    return threadpool_submit (&ld->pool, load_model_task, req);
+}
+
+/*
+ *  wait until all the models are created.
+ *  return -1 if any of them has failed.
+ */
+int
+tflite_loader_wait (tflite_loader_t *ld)
+{
+    int ret = 0;
+
+    if (!ld->started)
+        return 0;
+
+    threadpool_wait (&ld->pool);
+    threadpool_exit (&ld->pool);
+    ld->started = 0;
+
+    tflite_set_print_tensor_info (ld->print_info);
+
+    for (int i = 0; i < ld->num_reqs; i ++)
+    {
+        tflite_load_req_t *req = &ld->reqs[i];
+        if (req->ret < 0)
+        {
+            DBG_LOGE ("ERR: %s(%d): %s\n", __FILE__, __LINE__, req->model_path);
+            ret = -1;
+            continue;
+        }
+
+        if (ld->print_info)
+        {
+            DBG_LOG ("\n%s", req->model_path);
+            tflite_print_tensor_info (req->interpreter->interpreter);
+        }
+    }
+
+    return ret;
+}
+
+
+/* -------------------------------------------------- *
+ *  hot swap of a model
+ *
+ *  the replacement interpreter is built (and warmed up) on a background
+ *  thread while the app keeps invoking the current one. then the app
+ *  swaps it in with tflite_swap_commit() between the frames, when no
+ *  invocation is in flight, and the old interpreter is released there.
+ *
+ *  with the GPU delegates, the model is built on the caller (GL) thread
+ *  in tflite_swap_load().
+ * -------------------------------------------------- */
+static void *
+swap_load_thread (void *arg)
+{
+    tflite_swap_t *sw = (tflite_swap_t *)arg;
+    tflite_interpreter_t *next = new tflite_interpreter_t;
+    int ret;
+
+    ret = tflite_create_interpreter_from_file (next, sw->model_path.c_str ());
+
+    pthread_mutex_lock (&sw->mutex);
+    if (ret < 0)
+    {
+        mem_unregister_model (next);
+        delete next;
+        sw->state = TFLITE_SWAP_FAILED;
+    }
+    else
+    {
+        sw->next  = next;
+        sw->state = TFLITE_SWAP_READY;
+    }
+    pthread_mutex_unlock (&sw->mutex);
+
+    return NULL;
+}
+
+static void
+join_load_thread (tflite_swap_t *sw)
+{
+    if (sw->joinable)
+        pthread_join (sw->thread, NULL);
+    sw->joinable = 0;
+}
+
+int
+tflite_swap_init (tflite_swap_t *sw)
+{
+    pthread_mutex_init (&sw->mutex, NULL);
+    sw->joinable = 0;
+    sw->state    = TFLITE_SWAP_IDLE;
+    sw->next     = NULL;
+
+    return 0;
+}
+
+void
+tflite_swap_exit (tflite_swap_t *sw)
+{
+    join_load_thread (sw);
+
+    if (sw->next)
+        mem_unregister_model (sw->next);
+    delete sw->next;
+    sw->next  = NULL;
+    sw->state = TFLITE_SWAP_IDLE;
+    pthread_mutex_destroy (&sw->mutex);
+}
+
+/*
+ *  start loading (model_path). return -1 if another model is being loaded
+ *  or waiting for the commit.
+ */
+int
+tflite_swap_load (tflite_swap_t *sw, const char *model_path)
+{
+    int state = tflite_swap_get_state (sw);
+
+    if (state == TFLITE_SWAP_LOADING || state == TFLITE_SWAP_READY)
+        return -1;
+
+    join_load_thread (sw);      /* the last load has failed */
+
+    sw->model_path = model_path;
+    sw->state      = TFLITE_SWAP_LOADING;
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    swap_load_thread (sw);
+#else
+    if (pthread_create (&sw->thread, NULL, swap_load_thread, sw) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        sw->state = TFLITE_SWAP_IDLE;
+        return -1;
+    }
+    sw->joinable = 1;
+#endif
+    return 0;
+}
+
+int
+tflite_swap_get_state (tflite_swap_t *sw)
+{
+    int state;
+
+    pthread_mutex_lock (&sw->mutex);
+    state = sw->state;
+    pthread_mutex_unlock (&sw->mutex);
+
+    return state;
+}
+
+/*
+ *  swap the loaded interpreter into (dst), and release the old one.
+ *  the caller must guarantee that (dst) is not being invoked.
+ *  return 1 if swapped, 0 if not ready yet, -1 if the load has failed.
+ *  the tensors of (dst) must be bound again after the swap.
+ */
+int
+tflite_swap_commit (tflite_swap_t *sw, tflite_interpreter_t *dst)
+{
+    int state = tflite_swap_get_state (sw);
+
+    if (state == TFLITE_SWAP_IDLE || state == TFLITE_SWAP_LOADING)
+        return 0;
+
+    join_load_thread (sw);
+    sw->state = TFLITE_SWAP_IDLE;
+
+    if (state == TFLITE_SWAP_FAILED)
+    {
+        DBG_LOGE ("ERR: %s(%d): %s\n", __FILE__, __LINE__, sw->model_path.c_str ());
+        return -1;
+    }
+
+    /* the old interpreter goes to (next), and is destroyed before its model */
+    std::swap (dst->interpreter,        sw->next->interpreter);
+    std::swap (dst->delegate,           sw->next->delegate);
+    std::swap (dst->model,              sw->next->model);
+    std::swap (dst->weights_cache_path, sw->next->weights_cache_path);
+    std::swap (dst->model_path,         sw->next->model_path);
+    std::swap (dst->load_rss_bytes,     sw->next->load_rss_bytes);
+    mem_unregister_model (sw->next);
+    delete sw->next;
+    sw->next = NULL;
+
+    return 1;
+}
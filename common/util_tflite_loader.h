@@ -0,0 +1,64 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_TFLITE_LOADER_H_
+#define _UTIL_TFLITE_LOADER_H_
+
+#include "util_tflite.h"
+#include "util_threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TFLITE_LOADER_MAX_MODELS    8
+
+typedef struct tflite_load_req_t
+{
+    tflite_interpreter_t    *interpreter;
+    const char              *model_path;
+    int                     ret;            /* [OUT] 0: created, -1: failed */
+} tflite_load_req_t;
+
+typedef struct tflite_loader_t
+{
+    threadpool_t        pool;
+    int                 started;
+    int                 print_info;         /* tensor info dump, deferred until the join */
+    int                 num_reqs;
+    tflite_load_req_t   reqs[TFLITE_LOADER_MAX_MODELS];
+} tflite_loader_t;
+
+/* state of tflite_swap_t */
+#define TFLITE_SWAP_IDLE        0
+#define TFLITE_SWAP_LOADING     1
+#define TFLITE_SWAP_READY       2
+#define TFLITE_SWAP_FAILED      3
+
+typedef struct tflite_swap_t
+{
+    pthread_t               thread;
+    int                     joinable;
+    pthread_mutex_t         mutex;
+    int                     state;
+    std::string             model_path;     /* being loaded */
+    tflite_interpreter_t    *next;          /* built on the background thread */
+} tflite_swap_t;
+
+
+int tflite_loader_start (tflite_loader_t *ld, int num_models);
+int tflite_loader_add (tflite_loader_t *ld, tflite_interpreter_t *p, const char *model_path);
+int tflite_loader_wait (tflite_loader_t *ld);
+
+int  tflite_swap_init (tflite_swap_t *sw);
+void tflite_swap_exit (tflite_swap_t *sw);
+int  tflite_swap_load (tflite_swap_t *sw, const char *model_path);
+int  tflite_swap_get_state (tflite_swap_t *sw);
+int  tflite_swap_commit (tflite_swap_t *sw, tflite_interpreter_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_TFLITE_LOADER_H_ */
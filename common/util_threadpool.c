@@ -0,0 +1,141 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include "util_threadpool.h"
+
+/*
+ *  fork-join thread pool.
+ *
+ *  tasks are submitted in a batch by one thread, which then joins the
+ *  batch with threadpool_wait(). the waiting thread picks up tasks too,
+ *  so a pool of 0 threads runs every task on the caller thread.
+ */
+
+/* the caller holds the mutex. return 0 if there is no task to pick. */
+static int
+run_next_task_locked (threadpool_t *tp)
+{
+    if (tp->next_task >= tp->num_tasks)
+        return 0;
+
+    int idx = tp->next_task ++;
+    threadpool_func_t func = tp->funcs[idx];
+    void *arg = tp->args[idx];
+
+    pthread_mutex_unlock (&tp->mutex);
+    func (arg);
+    pthread_mutex_lock (&tp->mutex);
+
+    tp->num_done ++;
+    pthread_cond_broadcast (&tp->cond_done);
+    return 1;
+}
+
+static void *
+threadpool_thread_main (void *arg)
+{
+    threadpool_t *tp = (threadpool_t *)arg;
+
+    pthread_mutex_lock (&tp->mutex);
+    for (;;)
+    {
+        while (tp->running && tp->next_task >= tp->num_tasks)
+            pthread_cond_wait (&tp->cond_task, &tp->mutex);
+
+        if (!tp->running)
+            break;
+
+        run_next_task_locked (tp);
+    }
+    pthread_mutex_unlock (&tp->mutex);
+
+    return NULL;
+}
+
+
+int
+threadpool_init (threadpool_t *tp, int num_threads)
+{
+    memset (tp, 0, sizeof (*tp));
+
+    if (num_threads > THREADPOOL_MAX_THREADS)
+        num_threads = THREADPOOL_MAX_THREADS;
+
+    pthread_mutex_init (&tp->mutex, NULL);
+    pthread_cond_init  (&tp->cond_task, NULL);
+    pthread_cond_init  (&tp->cond_done, NULL);
+
+    tp->running = 1;
+    for (int i = 0; i < num_threads; i ++)
+    {
+        if (pthread_create (&tp->threads[i], NULL, threadpool_thread_main, tp) != 0)
+        {
+            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+            break;
+        }
+        tp->num_threads ++;
+    }
+
+    return tp->num_threads;
+}
+
+void
+threadpool_exit (threadpool_t *tp)
+{
+    pthread_mutex_lock (&tp->mutex);
+    tp->running = 0;
+    pthread_cond_broadcast (&tp->cond_task);
+    pthread_mutex_unlock (&tp->mutex);
+
+    for (int i = 0; i < tp->num_threads; i ++)
+        pthread_join (tp->threads[i], NULL);
+
+    pthread_cond_destroy  (&tp->cond_done);
+    pthread_cond_destroy  (&tp->cond_task);
+    pthread_mutex_destroy (&tp->mutex);
+}
+
+
+int
+threadpool_submit (threadpool_t *tp, threadpool_func_t func, void *arg)
+{
+    pthread_mutex_lock (&tp->mutex);
+    if (tp->num_tasks >= THREADPOOL_MAX_TASKS)
+    {
+        pthread_mutex_unlock (&tp->mutex);
+        fprintf (stderr, "ERR: %s(%d): too many tasks\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    tp->funcs[tp->num_tasks] = func;
+    tp->args [tp->num_tasks] = arg;
+    tp->num_tasks ++;
+    pthread_cond_signal (&tp->cond_task);
+    pthread_mutex_unlock (&tp->mutex);
+
+    return 0;
+}
+
+/*
+ *  run the remaining tasks on the caller thread too, and wait until
+ *  all the submitted tasks are completed.
+ */
+void
+threadpool_wait (threadpool_t *tp)
+{
+    pthread_mutex_lock (&tp->mutex);
+
+    while (run_next_task_locked (tp))
+        ;
+
+    while (tp->num_done < tp->num_tasks)
+        pthread_cond_wait (&tp->cond_done, &tp->mutex);
+
+    tp->num_tasks = 0;
+    tp->next_task = 0;
+    tp->num_done  = 0;
+    pthread_mutex_unlock (&tp->mutex);
+}
@@ -0,0 +1,47 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_THREADPOOL_H_
+#define _UTIL_THREADPOOL_H_
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THREADPOOL_MAX_THREADS  16
+#define THREADPOOL_MAX_TASKS    64
+
+typedef void (*threadpool_func_t) (void *arg);
+
+typedef struct _threadpool_t
+{
+    pthread_t           threads[THREADPOOL_MAX_THREADS];
+    int                 num_threads;
+    int                 running;
+
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond_task;          /* a task has been submitted */
+    pthread_cond_t      cond_done;          /* a task has been completed */
+
+    threadpool_func_t   funcs[THREADPOOL_MAX_TASKS];
+    void                *args[THREADPOOL_MAX_TASKS];
+    int                 num_tasks;          /* submitted    */
+    int                 next_task;          /* next to pick */
+    int                 num_done;           /* completed    */
+} threadpool_t;
+
+
+int  threadpool_init (threadpool_t *tp, int num_threads);
+void threadpool_exit (threadpool_t *tp);
+
+int  threadpool_submit (threadpool_t *tp, threadpool_func_t func, void *arg);
+void threadpool_wait (threadpool_t *tp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_THREADPOOL_H_ */
@@ -0,0 +1,334 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include "util_tracker.h"
+
+/*
+ *  SORT style multi object tracker.
+ *    "Simple Online and Realtime Tracking", Bewley et al., 2016.
+ *
+ *  each box is tracked by a constant velocity Kalman filter on
+ *  (cx, cy, w, h). the process and measurement noise are diagonal
+ *  and the motion model does not mix the components, so the 8-state
+ *  filter splits exactly into four independent (pos, vel) filters.
+ *  the noise is proportional to the box size as in DeepSORT, so the
+ *  tracker works both in pixels and in normalized coordinates.
+ */
+#define STD_WEIGHT_POS      (1.0f / 20.0f)
+#define STD_WEIGHT_VEL      (1.0f / 160.0f)
+
+enum {
+    KF_CX = 0,
+    KF_CY,
+    KF_W,
+    KF_H,
+};
+
+
+/* -------------------------------------------------- *
+ *  Kalman filter of one component
+ * -------------------------------------------------- */
+static void
+kf_init (tracker_kf_t *kf, float z, float size)
+{
+    float std_pos = 2.0f  * STD_WEIGHT_POS * size;
+    float std_vel = 10.0f * STD_WEIGHT_VEL * size;
+
+    kf->x[0] = z;
+    kf->x[1] = 0.0f;
+    kf->P[0][0] = std_pos * std_pos;
+    kf->P[0][1] = 0.0f;
+    kf->P[1][0] = 0.0f;
+    kf->P[1][1] = std_vel * std_vel;
+}
+
+static void
+kf_predict (tracker_kf_t *kf, float size)
+{
+    float std_pos = STD_WEIGHT_POS * size;
+    float std_vel = STD_WEIGHT_VEL * size;
+
+    /* x = F x,  F = |1 1|
+     *               |0 1| */
+    kf->x[0] += kf->x[1];
+
+    /* P = F P F^T + Q */
+    float p00 = kf->P[0][0] + kf->P[0][1] + kf->P[1][0] + kf->P[1][1];
+    float p01 = kf->P[0][1] + kf->P[1][1];
+    float p10 = kf->P[1][0] + kf->P[1][1];
+    float p11 = kf->P[1][1];
+
+    kf->P[0][0] = p00 + std_pos * std_pos;
+    kf->P[0][1] = p01;
+    kf->P[1][0] = p10;
+    kf->P[1][1] = p11 + std_vel * std_vel;
+}
+
+static void
+kf_update (tracker_kf_t *kf, float z, float size)
+{
+    float std_pos = STD_WEIGHT_POS * size;
+
+    /* H = |1 0| */
+    float S  = kf->P[0][0] + std_pos * std_pos;
+    float k0 = kf->P[0][0] / S;
+    float k1 = kf->P[1][0] / S;
+    float y  = z - kf->x[0];
+
+    kf->x[0] += k0 * y;
+    kf->x[1] += k1 * y;
+
+    float p00 = kf->P[0][0];
+    float p01 = kf->P[0][1];
+    kf->P[0][0] -= k0 * p00;
+    kf->P[0][1] -= k0 * p01;
+    kf->P[1][0] -= k1 * p00;
+    kf->P[1][1] -= k1 * p01;
+}
+
+
+/* -------------------------------------------------- *
+ *  box <==> track state
+ * -------------------------------------------------- */
+static void
+track_to_box (tracker_track_t *trk, tracker_box_t *box)
+{
+    float cx = trk->kf[KF_CX].x[0];
+    float cy = trk->kf[KF_CY].x[0];
+    float w  = trk->kf[KF_W ].x[0];
+    float h  = trk->kf[KF_H ].x[0];
+
+    if (w < 0.0f) w = 0.0f;
+    if (h < 0.0f) h = 0.0f;
+
+    box->x1 = cx - w * 0.5f;
+    box->y1 = cy - h * 0.5f;
+    box->x2 = cx + w * 0.5f;
+    box->y2 = cy + h * 0.5f;
+    box->score    = trk->score;
+    box->cls      = trk->cls;
+    box->track_id = trk->track_id;
+}
+
+static void
+track_init (tracker_track_t *trk, tracker_box_t *box, int track_id)
+{
+    float w = box->x2 - box->x1;
+    float h = box->y2 - box->y1;
+
+    trk->track_id = track_id;
+    trk->cls      = box->cls;
+    trk->score    = box->score;
+    trk->hits     = 1;
+    trk->age      = 0;
+
+    kf_init (&trk->kf[KF_CX], box->x1 + w * 0.5f, w);
+    kf_init (&trk->kf[KF_CY], box->y1 + h * 0.5f, h);
+    kf_init (&trk->kf[KF_W ], w, w);
+    kf_init (&trk->kf[KF_H ], h, h);
+}
+
+static void
+track_update (tracker_track_t *trk, tracker_box_t *box)
+{
+    float w = box->x2 - box->x1;
+    float h = box->y2 - box->y1;
+
+    trk->score = box->score;
+    trk->hits ++;
+    trk->age   = 0;
+
+    kf_update (&trk->kf[KF_CX], box->x1 + w * 0.5f, w);
+    kf_update (&trk->kf[KF_CY], box->y1 + h * 0.5f, h);
+    kf_update (&trk->kf[KF_W ], w, w);
+    kf_update (&trk->kf[KF_H ], h, h);
+}
+
+static float
+calc_iou (tracker_box_t *b0, tracker_box_t *b1)
+{
+    float area0 = (b0->x2 - b0->x1) * (b0->y2 - b0->y1);
+    float area1 = (b1->x2 - b1->x1) * (b1->y2 - b1->y1);
+    if (area0 <= 0 || area1 <= 0)
+        return 0.0f;
+
+    float ix1 = b0->x1 > b1->x1 ? b0->x1 : b1->x1;
+    float iy1 = b0->y1 > b1->y1 ? b0->y1 : b1->y1;
+    float ix2 = b0->x2 < b1->x2 ? b0->x2 : b1->x2;
+    float iy2 = b0->y2 < b1->y2 ? b0->y2 : b1->y2;
+    if (ix2 <= ix1 || iy2 <= iy1)
+        return 0.0f;
+
+    float intersect = (ix2 - ix1) * (iy2 - iy1);
+    return intersect / (area0 + area1 - intersect);
+}
+
+
+/* -------------------------------------------------- *
+ *  API
+ * -------------------------------------------------- */
+void
+tracker_init (tracker_t *trk, const tracker_config_t *config)
+{
+    memset (trk, 0, sizeof (*trk));
+
+    if (config)
+    {
+        trk->config = *config;
+    }
+    else
+    {
+        trk->config.iou_thresh = 0.3f;
+        trk->config.max_age    = 5;
+        trk->config.min_hits   = 1;
+    }
+}
+
+void
+tracker_reset (tracker_t *trk)
+{
+    trk->num = 0;
+}
+
+/*
+ *  advance all the tracks by one frame.
+ *  call this every frame, before tracker_update() if there is a detection.
+ */
+void
+tracker_predict (tracker_t *trk)
+{
+    for (int i = 0; i < trk->num; i ++)
+    {
+        tracker_track_t *t = &trk->tracks[i];
+        float w = t->kf[KF_W].x[0];
+        float h = t->kf[KF_H].x[0];
+
+        kf_predict (&t->kf[KF_CX], w);
+        kf_predict (&t->kf[KF_CY], h);
+        kf_predict (&t->kf[KF_W ], w);
+        kf_predict (&t->kf[KF_H ], h);
+        t->age ++;
+    }
+}
+
+/*
+ *  associate the detections of this frame with the predicted tracks.
+ *  greedy matching on IoU (the highest pair first) within the same class.
+ *  unmatched detections start new tracks, and the tracks which have not
+ *  been detected for more than (max_age) frames are removed.
+ *  the track ID of each detection is written back to (dets).
+ */
+int
+tracker_update (tracker_t *trk, tracker_box_t *dets, int num_dets)
+{
+    int det_matched[TRACKER_MAX_TRACKS] = {0};
+    int trk_matched[TRACKER_MAX_TRACKS] = {0};
+    int num_trks = trk->num;
+
+    if (num_dets > TRACKER_MAX_TRACKS)
+        num_dets = TRACKER_MAX_TRACKS;
+
+    for (int j = 0; j < num_dets; j ++)
+        dets[j].track_id = -1;
+
+    for (int i = 0; i < num_trks; i ++)
+    {
+        tracker_box_t pred;
+        track_to_box (&trk->tracks[i], &pred);
+
+        for (int j = 0; j < num_dets; j ++)
+        {
+            if (dets[j].cls != pred.cls)
+                trk->iou[i][j] = 0.0f;
+            else
+                trk->iou[i][j] = calc_iou (&pred, &dets[j]);
+        }
+    }
+
+    /* greedy association */
+    for (;;)
+    {
+        float max_iou = trk->config.iou_thresh;
+        int   max_i = -1, max_j = -1;
+
+        for (int i = 0; i < num_trks; i ++)
+        {
+            if (trk_matched[i])
+                continue;
+            for (int j = 0; j < num_dets; j ++)
+            {
+                if (!det_matched[j] && trk->iou[i][j] >= max_iou)
+                {
+                    max_iou = trk->iou[i][j];
+                    max_i = i;
+                    max_j = j;
+                }
+            }
+        }
+
+        if (max_i < 0)
+            break;
+
+        trk_matched[max_i] = 1;
+        det_matched[max_j] = 1;
+        track_update (&trk->tracks[max_i], &dets[max_j]);
+        dets[max_j].track_id = trk->tracks[max_i].track_id;
+    }
+
+    /* remove lost tracks */
+    int num = 0;
+    for (int i = 0; i < num_trks; i ++)
+    {
+        if (trk->tracks[i].age > trk->config.max_age)
+            continue;
+
+        if (num != i)
+            trk->tracks[num] = trk->tracks[i];
+        num ++;
+    }
+
+    /* new tracks */
+    for (int j = 0; j < num_dets; j ++)
+    {
+        if (det_matched[j])
+            continue;
+
+        if (num >= TRACKER_MAX_TRACKS)
+        {
+            fprintf (stderr, "ERR: %s(%d): too many tracks\n", __FILE__, __LINE__);
+            break;
+        }
+
+        track_init (&trk->tracks[num], &dets[j], trk->next_id ++);
+        dets[j].track_id = trk->tracks[num].track_id;
+        num ++;
+    }
+
+    trk->num = num;
+    return num;
+}
+
+/*
+ *  current box of the confirmed tracks.
+ */
+int
+tracker_get_boxes (tracker_t *trk, tracker_box_t *boxes, int max_num)
+{
+    int num = 0;
+
+    for (int i = 0; i < trk->num && num < max_num; i ++)
+    {
+        tracker_track_t *t = &trk->tracks[i];
+
+        if (t->hits < trk->config.min_hits || t->age > trk->config.max_age)
+            continue;
+
+        track_to_box (t, &boxes[num]);
+        num ++;
+    }
+
+    return num;
+}
@@ -0,0 +1,68 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_TRACKER_H_
+#define _UTIL_TRACKER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACKER_MAX_TRACKS      128
+
+typedef struct _tracker_box_t
+{
+    float x1, y1, x2, y2;
+    float score;
+    int   cls;
+    int   track_id;             /* [OUT] -1: not (yet) assigned */
+} tracker_box_t;
+
+typedef struct _tracker_config_t
+{
+    float iou_thresh;           /* min IoU to associate a detection with a track */
+    int   max_age;              /* frames a track survives without a detection   */
+    int   min_hits;             /* detections needed before a track is reported  */
+} tracker_config_t;
+
+/* constant velocity Kalman filter of one box component: state (pos, vel) */
+typedef struct _tracker_kf_t
+{
+    float x[2];
+    float P[2][2];
+} tracker_kf_t;
+
+typedef struct _tracker_track_t
+{
+    int   track_id;
+    int   cls;
+    float score;
+    int   hits;                 /* number of associated detections  */
+    int   age;                  /* frames since the last detection  */
+    tracker_kf_t kf[4];         /* cx, cy, w, h */
+} tracker_track_t;
+
+typedef struct _tracker_t
+{
+    tracker_config_t config;
+    int              num;
+    int              next_id;
+    tracker_track_t  tracks[TRACKER_MAX_TRACKS];
+
+    float            iou[TRACKER_MAX_TRACKS][TRACKER_MAX_TRACKS];  /* scratch of tracker_update() */
+} tracker_t;
+
+
+void tracker_init (tracker_t *trk, const tracker_config_t *config);
+void tracker_reset (tracker_t *trk);
+
+void tracker_predict (tracker_t *trk);
+int  tracker_update (tracker_t *trk, tracker_box_t *dets, int num_dets);
+int  tracker_get_boxes (tracker_t *trk, tracker_box_t *boxes, int max_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_TRACKER_H_ */
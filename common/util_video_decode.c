@@ -9,6 +9,8 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include "util_texture.h"
+#include "util_pmeter.h"
+#include "util_memory.h"
 
 /*
  *	control play speed.
@@ -29,6 +31,7 @@ static unsigned int     s_video_fmt;
 static int64_t          s_duration_base;
 
 static void             *s_decode_buf = NULL;
+static volatile uint32_t s_decode_seq = 0;      /* incremented for every decoded frame */
 
 int
 init_video_decode ()
@@ -144,6 +147,13 @@ get_video_buffer (void ** buf)
     return 0;
 }
 
+/* 0 until the first frame is decoded */
+uint32_t
+get_video_frame_seq ()
+{
+    return s_decode_seq;
+}
+
 static int 
 save_to_ppm (AVFrame *frame, int width, int height, int icnt)
 {
@@ -175,6 +185,7 @@ convert_to_rgba8888 (AVFrame *frame, int ofstx, int ofsty, int width, int height
     if (s_decode_buf == NULL)
     {
         s_decode_buf = (unsigned char *)malloc (width * height * 4);
+        mem_register_buffer ("decode", s_decode_buf, width * height * 4);
     }
 
     for (int y = 0; y < height; y ++)
@@ -209,6 +220,7 @@ on_frame_decoded (AVFrame *frame)
     }
 
     convert_to_rgba8888 (frame, ofstx, ofsty, s_crop_w, s_crop_h);
+    s_decode_seq ++;
 
     return 0;
 }
@@ -284,7 +296,9 @@ decode_thread_main ()
         {
             if (packet.stream_index == s_video_stream_index)
             {
+                PMETER_SCOPE_BEGIN ("decode");
                 ret = avcodec_send_packet (s_dec_ctx, &packet);
+                PMETER_SCOPE_END ();
                 if (ret < 0)
                 {
                     fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
@@ -310,9 +324,11 @@ decode_thread_main ()
                         return 0;
                     }
 
+                    PMETER_SCOPE_BEGIN ("convert");
                     sws_scale(sws_ctx, (const uint8_t * const *) frame->data,
                                        frame->linesize, 0, dec_h,
                                        framergb->data, framergb->linesize);
+                    PMETER_SCOPE_END ();
 
                     sleep_to_pts (&packet);
                     on_frame_decoded (framergb);
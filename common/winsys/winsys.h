@@ -12,5 +12,6 @@
 void *winsys_init_native_display (void);
 void *winsys_init_native_window (void *dpy, int win_w, int win_h);
 int   winsys_swap();
+int   winsys_poll_events();
 void *winsys_create_native_pixmap (int width, int height);
 #endif /* _WINSYS_H_ */
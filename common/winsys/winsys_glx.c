@@ -212,15 +212,17 @@ glx_terminate ()
     return 0;
 }
 
+/* dispatch the pending input events. return the number of the events. */
 int
-glx_swap ()
+glx_poll_events ()
 {
-    glXSwapBuffers (s_xdpy, s_xwin);
-
     XEvent event;
+    int    num_events = 0;
+
     while (XPending (s_xdpy))
     {
         XNextEvent (s_xdpy, &event);
+        num_events ++;
         switch (event.type)
         {
         case ButtonPress:
@@ -246,6 +248,15 @@ glx_swap ()
             break;
         }
     }
+    return num_events;
+}
+
+int
+glx_swap ()
+{
+    glXSwapBuffers (s_xdpy, s_xwin);
+
+    glx_poll_events ();
     return 0;
 }
 
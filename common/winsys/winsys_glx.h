@@ -15,5 +15,6 @@ int glx_initialize (int glx_version, int depth_size, int stencil_size, int sampl
                     int win_w, int win_h);
 int glx_terminate ();
 int glx_swap ();
+int glx_poll_events ();
 
 #endif /* UTIL_GLX_H_ */
@@ -483,6 +483,12 @@ winsys_swap()
   return 0;
 }
 
+int
+winsys_poll_events()
+{
+  return 0;
+}
+
 void *
 winsys_create_native_pixmap (int width, int height)
 {
@@ -63,13 +63,17 @@ winsys_init_native_window (void *dpy, int win_w, int win_h)
 }
 
 
-int 
-winsys_swap()
+/* dispatch the pending input events. return the number of the events. */
+int
+winsys_poll_events()
 {
     XEvent event;
+    int    num_events = 0;
+
     while (XPending (s_xdpy))
     {
         XNextEvent (s_xdpy, &event);
+        num_events ++;
         switch (event.type)
         {
         case ButtonPress:
@@ -95,6 +99,13 @@ winsys_swap()
             break;
         }
     }
+    return num_events;
+}
+
+int 
+winsys_swap()
+{
+    winsys_poll_events ();
     return 0;
 }
 
@@ -118,13 +118,16 @@ winsys_init_native_window (void *dpy, int win_w, int win_h)
 }
 
 
-int 
-winsys_swap()
+/* dispatch the pending input events. return the number of the events. */
+int
+winsys_poll_events()
 {
     xcb_generic_event_t *event;
+    int num_events = 0;
 
     while ((event = xcb_poll_for_queued_event (s_xcb_conn)))
     {
+        num_events ++;
         switch (event->response_type & ~0x80) 
         {
         case XCB_KEY_PRESS: {
@@ -186,6 +189,13 @@ winsys_swap()
         free (event);
     }
 
+    return num_events;
+}
+
+int 
+winsys_swap()
+{
+    winsys_poll_events ();
     return 0;
 }
 
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
@@ -11,10 +12,16 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_age_gender.h"
+#include "util_pipeline.h"
+#include "util_image_crop.h"
+#include "util_frame_seq.h"
+#include "util_tracker.h"
+#include "util_attr_cache.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -24,103 +31,167 @@
 
 
 
-/* resize image to DNN network input size and convert to fp32. */
-void
-feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
+/*
+ *  the cascade "face detect -> age/gender" runs as a pipeline, one thread
+ *  per stage. the render thread reads back the whole camera frame once,
+ *  and each stage crops its network input from that frame on the CPU.
+ *  (the GL context is bound to the render thread.)
+ */
+#define FRAME_SIZE      512
+
+typedef struct _age_gender_packet_t
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
+    face_detect_result_t    face;
+    age_gender_result_t     age_gender[MAX_FACE_NUM];
+    int                     track_id[MAX_FACE_NUM];
+    int                     num_invoked;    /* age/gender invocations for this frame */
+    /* followed by the RGBA frame (FRAME_SIZE x FRAME_SIZE) */
+} age_gender_packet_t;
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+#define PACKET_FRAME(pkt)   ((uint8_t *)((age_gender_packet_t *)(pkt) + 1))
 
-    buf_ui8 = pui8;
 
-    draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
+/* read back the camera frame. (top row first) */
+static void
+feed_frame_image (texture_2d_t *srctex, int win_w, int win_h, uint8_t *buf_ui8)
+{
+    draw_2d_texture_ex (srctex, 0, win_h - FRAME_SIZE, FRAME_SIZE, FRAME_SIZE, 1);
 
     glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+    glReadPixels (0, 0, FRAME_SIZE, FRAME_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+}
+
+/* resize image to DNN network input size and convert to fp32. */
+static void
+feed_face_detect_image (age_gender_packet_t *pkt)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
 
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
-    float mean = 128.0f;
-    float std  = 128.0f;
-    for (y = 0; y < h; y ++)
+    image_resize_rgba_to_fp32 (PACKET_FRAME (pkt), FRAME_SIZE, FRAME_SIZE,
+                               buf_fp32, w, h, 128.0f, 128.0f);
+}
+
+static void
+feed_age_gender_image (age_gender_packet_t *pkt, int face_id)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_age_gender_input_buf (&w, &h);
+    face_t *face = &pkt->face.faces[face_id];
+    float quad[4][2];
+
+    //    0--------1
+    //    |        |
+    //    |        |
+    //    3--------2
+    for (int i = 0; i < 4; i ++)
     {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
+        quad[i][0] = face->face_pos[i].x;
+        quad[i][1] = face->face_pos[i].y;
     }
 
-    return;
+    /* convert UI8 [0, 255] ==> FP32 [0, 255] */
+    image_crop_rgba_to_fp32 (PACKET_FRAME (pkt), FRAME_SIZE, FRAME_SIZE, quad,
+                             buf_fp32, w, h, 0.0f, 1.0f);
 }
 
-void
-feed_age_gender_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
+
+/* -------------------------------------------------- *
+ *  pipeline stages. each runs on its own thread.
+ * -------------------------------------------------- */
+static int
+run_face_detect_stage (void *packet, void *usrdata)
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_age_gender_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
+    age_gender_packet_t *pkt = (age_gender_packet_t *)packet;
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+    PMETER_SCOPE_BEGIN ("feed_face_detect_image");
+    feed_face_detect_image (pkt);
+    PMETER_SCOPE_END ();
+    PMETER_SCOPE_BEGIN ("invoke_face_detect");
+    invoke_face_detect (&pkt->face);
+    PMETER_SCOPE_END ();
 
-    buf_ui8 = pui8;
+    return 0;
+}
 
-    float texcoord[] = { 0.0f, 1.0f,
-                         0.0f, 0.0f,
-                         1.0f, 1.0f,
-                         1.0f, 0.0f };
+/*
+ *  the age/gender of a face hardly changes frame to frame. the faces are
+ *  tracked, and the classifier runs only for the new tracks, on a refresh
+ *  interval, or when the face is seen better than when it was classified.
+ *  (the state is owned by the age/gender stage thread)
+ */
+typedef struct _age_gender_stage_t
+{
+    int             enable_cache;
+    tracker_t       tracker;
+    attr_cache_t    cache;
+} age_gender_stage_t;
 
-    if (detection->num > face_id)
+static void
+track_faces (tracker_t *tracker, face_detect_result_t *detection, int *track_id)
+{
+    tracker_box_t boxes[MAX_FACE_NUM];
+
+    for (int i = 0; i < detection->num; i ++)
     {
-        face_t *face = &(detection->faces[face_id]);
-        float x0 = face->face_pos[0].x;
-        float y0 = face->face_pos[0].y;
-        float x1 = face->face_pos[1].x; //    0--------1
-        float y1 = face->face_pos[1].y; //    |        |
-        float x2 = face->face_pos[2].x; //    |        |
-        float y2 = face->face_pos[2].y; //    3--------2
-        float x3 = face->face_pos[3].x;
-        float y3 = face->face_pos[3].y;
-        texcoord[0] = x3;   texcoord[1] = y3;
-        texcoord[2] = x0;   texcoord[3] = y0;
-        texcoord[4] = x2;   texcoord[5] = y2;
-        texcoord[6] = x1;   texcoord[7] = y1;
+        face_t *face = &detection->faces[i];
+        boxes[i].x1    = face->topleft.x;
+        boxes[i].y1    = face->topleft.y;
+        boxes[i].x2    = face->btmright.x;
+        boxes[i].y2    = face->btmright.y;
+        boxes[i].score = face->score;
+        boxes[i].cls   = 0;
     }
 
-    draw_2d_texture_ex_texcoord (srctex, 0, win_h - h, w, h, texcoord);
+    tracker_predict (tracker);
+    tracker_update (tracker, boxes, detection->num);
 
-    glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+    for (int i = 0; i < detection->num; i ++)
+        track_id[i] = boxes[i].track_id;
+}
 
-    /* convert UI8 [0, 255] ==> FP32 [0, 255] */
-    float mean = 0.0f;
-    float std  = 1.0f;
-    for (y = 0; y < h; y ++)
+/* a larger and more confident face gives a better estimation */
+static float
+face_quality (face_t *face)
+{
+    float w = face->btmright.x - face->topleft.x;
+    float h = face->btmright.y - face->topleft.y;
+
+    return face->score * w * h;
+}
+
+static int
+run_age_gender_stage (void *packet, void *usrdata)
+{
+    age_gender_packet_t *pkt   = (age_gender_packet_t *)packet;
+    age_gender_stage_t  *stage = (age_gender_stage_t *)usrdata;
+
+    track_faces (&stage->tracker, &pkt->face, pkt->track_id);
+    attr_cache_next_frame (&stage->cache);
+
+    pkt->num_invoked = 0;
+    for (int face_id = 0; face_id < pkt->face.num; face_id ++)
     {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
+        int   track_id = pkt->track_id[face_id];
+        float quality  = face_quality (&pkt->face.faces[face_id]);
+
+        if (stage->enable_cache &&
+            attr_cache_lookup (&stage->cache, track_id, quality, &pkt->age_gender[face_id]))
+            continue;
+
+        PMETER_SCOPE_BEGIN ("feed_age_gender_image");
+        feed_age_gender_image (pkt, face_id);
+        PMETER_SCOPE_END ();
+        PMETER_SCOPE_BEGIN ("invoke_age_gender");
+        invoke_age_gender (&pkt->age_gender[face_id]);
+        PMETER_SCOPE_END ();
+        pkt->num_invoked ++;
+
+        attr_cache_store (&stage->cache, track_id, quality, &pkt->age_gender[face_id]);
     }
 
-    return;
+    return 0;
 }
 
 
@@ -276,9 +347,22 @@ main(int argc, char *argv[])
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms0 = 0, invoke_ms1 = 0;
+    double ttime[10] = {0}, interval;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    int result_frame = -1;
+    pipeline_t pipeline;
+    age_gender_packet_t *cur_packet = NULL;
+    static age_gender_packet_t empty_packet;
+    static age_gender_stage_t  age_gender_stage;
+    int enable_attr_cache = 1;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int enable_pipeline = 0;    /* the GPU delegate must be invoked on the GL thread */
+#else
+    int enable_pipeline = 1;
+#endif
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -287,21 +371,30 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "nqsv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'n':
+                enable_attr_cache = 0;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 's':
+                enable_pipeline = 0;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -364,17 +457,40 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    /* --------------------------------------- *
+     *  face detect -> age/gender
+     * --------------------------------------- */
+    {
+        tracker_config_t config;
+        config.iou_thresh = 0.3f;
+        config.max_age    = 5;
+        config.min_hits   = 1;
+        tracker_init (&age_gender_stage.tracker, &config);
+
+        attr_cache_init (&age_gender_stage.cache, sizeof (age_gender_result_t), NULL);
+        age_gender_stage.enable_cache = enable_attr_cache;
+    }
+
+    pipeline_init (&pipeline, sizeof (age_gender_packet_t) + FRAME_SIZE * FRAME_SIZE * 4, 1,
+                   enable_pipeline ? 0 : PIPELINE_SYNC);
+    pipeline_add_stage (&pipeline, "detect", run_face_detect_stage, NULL, PIPELINE_DROP_OLDEST);
+    pipeline_add_stage (&pipeline, "agegend", run_age_gender_stage,  &age_gender_stage, PIPELINE_BLOCK);
+    pipeline_start (&pipeline);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        face_detect_result_t face_detect_ret = {0};
-        age_gender_result_t  age_gender_ret[MAX_FACE_NUM] = {0};
-        char strbuf[512];
+        char strbuf[1024];
+        int  len;
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -388,50 +504,74 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
-         *  face detection
+         *  feed the camera frame to the pipeline.
+         *  keep at most one frame waiting for the detection stage,
+         *  so the frames in flight are as new as possible.
+         *  (a frame which has already been fed is not fed again)
          * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
-
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_face_detect (&face_detect_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
-
-        /* --------------------------------------- *
-         *  Age Gender estimation
-         * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        int changed = 0;
+        if (pipeline_get_queue_depth (&pipeline, 0) == 0 &&
+            frame_seq_is_new (&fseq, captex.frame_seq))
         {
-            feed_age_gender_image (&captex, win_w, win_h, &face_detect_ret, face_id);
+            age_gender_packet_t *pkt = (age_gender_packet_t *)pipeline_acquire_packet (&pipeline);
+            if (pkt)
+            {
+                PMETER_SCOPE_BEGIN ("feed_frame_image");
+                feed_frame_image (&captex, win_w, win_h, PACKET_FRAME (pkt));
+                PMETER_SCOPE_END ();
+                pipeline_submit (&pipeline, pkt, count);
+            }
+            else
+            {
+                frame_seq_invalidate (&fseq);   /* retry on the next loop */
+            }
+        }
 
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_age_gender (&age_gender_ret[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+        /* the latest frame which has passed all the stages */
+        {
+            age_gender_packet_t *pkt = (age_gender_packet_t *)pipeline_get_result (&pipeline, &result_frame);
+            if (pkt)
+            {
+                pipeline_release_packet (&pipeline, cur_packet);
+                cur_packet = pkt;
+                changed = 1;
+            }
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, changed))
+            continue;
+
+        age_gender_packet_t  *ret = cur_packet ? cur_packet : &empty_packet;
+        face_detect_result_t *face_detect_ret = &ret->face;
+        age_gender_result_t  *age_gender_ret  = ret->age_gender;
+
         /* --------------------------------------- *
          *  render scene (left half)
          * --------------------------------------- */
         glClear (GL_COLOR_BUFFER_BIT);
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
-        render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_detect_ret, age_gender_ret);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
+        render_detect_region (draw_x, draw_y, draw_w, draw_h, face_detect_ret, age_gender_ret);
+        PMETER_SCOPE_END ();
 
         /* visualize the segmentation results. */
         /* draw cropped image of the face area */
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
         {
             float w = 100;
             float h = 100;
@@ -439,7 +579,9 @@ main(int argc, char *argv[])
             float y = h * face_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-            render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+            PMETER_SCOPE_BEGIN ("render_cropped_face_image");
+            render_cropped_face_image (&captex, x, y, w, h, face_detect_ret, face_id);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -449,11 +591,15 @@ main(int argc, char *argv[])
         glViewport (0, 0, win_w, win_h);
         draw_pmeter (0, 40);
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]",
-            interval, invoke_ms0, invoke_ms1);
+        len  = sprintf (strbuf, "Interval:%5.1f [ms]\nFrameLag:%3d\nAgeGend :%2d/%2d faces\n",
+                        interval, (result_frame >= 0) ? count - result_frame : 0,
+                        ret->num_invoked, face_detect_ret->num);
+        pipeline_format_stats (&pipeline, strbuf + len, sizeof (strbuf) - len);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -3,6 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_age_gender.h"
 #include <list>
 
@@ -28,6 +30,8 @@ static tflite_tensor_t      s_tensor_gender;
 
 static std::list<fvec2> s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * determine where the anchor points are scatterd.
  *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
@@ -93,7 +97,8 @@ init_tflite_age_gender(int use_quantized_tflite)
     tflite_get_tensor_by_name (&s_detect_interpreter, 1, "regressors",     &s_detect_tensor_bboxes);
     tflite_get_tensor_by_name (&s_detect_interpreter, 1, "classificators", &s_detect_tensor_scores);
 
-    /* Age Gender estimation */
+    /* Age Gender estimation.
+     * the tensor buffers don't move after AllocateTensors(), so they are bound only once here. */
     tflite_create_interpreter_from_file (&s_interpreter, age_gender_model);
     tflite_get_tensor_by_name (&s_interpreter, 0, "input_1",    &s_tensor_input);
     tflite_get_tensor_by_name (&s_interpreter, 1, "Identity",   &s_tensor_age);
@@ -103,6 +108,8 @@ init_tflite_age_gender(int use_quantized_tflite)
     int det_input_h = s_detect_tensor_input.dims[1];
     create_blazeface_anchors (det_input_w, det_input_h);
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -126,9 +133,6 @@ get_face_detect_input_buf (int *w, int *h)
 void *
 get_age_gender_input_buf (int *w, int *h)
 {
-#if 1  /* do we need to acquire these pointers again ? */
-    tflite_get_tensor_by_name (&s_interpreter, 0, "input_1",    &s_tensor_input);
-#endif
     *w = s_tensor_input.dims[2];
     *h = s_tensor_input.dims[1];
     return s_tensor_input.ptr;
@@ -148,7 +152,7 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
@@ -259,7 +263,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -381,7 +385,7 @@ compute_face_rect (face_t &face)
 
 
 static void
-pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_list)
+pack_face_result (face_detect_result_t *facedet_result, arena_list<face_t> &face_list)
 {
     int num_faces = 0;
     for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
@@ -413,9 +417,12 @@ invoke_face_detect (face_detect_result_t *facedet_result)
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = 0.75f;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
@@ -424,7 +431,7 @@ invoke_face_detect (face_detect_result_t *facedet_result)
 
 #if 1 /* USE NMS */
     float iou_thresh = 0.3f;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (facedet_result, face_nms_list);
@@ -432,33 +439,30 @@ invoke_face_detect (face_detect_result_t *facedet_result)
     pack_face_result (facedet_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_face_detect");
+    frame_arena_end ();
+
     return 0;
 }
 
 
-static bool
-compare_age (age_t &v1, age_t &v2)
-{
-    if (v1.score > v2.score)
-        return true;
-    else
-        return false;
-}
-
+/* the most likely age */
 static void
-decode_ages (std::list<age_t> &age_list)
+decode_ages (age_t *age_item)
 {
-    age_t age_item;
     float *ages_ptr = (float *)s_tensor_age.ptr;
     int num_age     = s_tensor_age.dims[1];
-    for (int i = 0; i < num_age; i ++)
+
+    age_item->age   = 0;
+    age_item->score = ages_ptr[0];
+    for (int i = 1; i < num_age; i ++)
     {
-        age_item.age   = i;
-        age_item.score = ages_ptr[i];
-        age_list.push_back (age_item);
+        if (ages_ptr[i] > age_item->score)
+        {
+            age_item->age   = i;
+            age_item->score = ages_ptr[i];
+        }
     }
-
-    age_list.sort (compare_age);
 }
 
 int
@@ -470,26 +474,14 @@ invoke_age_gender (age_gender_result_t *age_gender_result)
         return -1;
     }
 
-#if 1 /* do we need to acquire these pointers again ? */
-    tflite_get_tensor_by_name (&s_interpreter, 1, "Identity",   &s_tensor_age);
-    tflite_get_tensor_by_name (&s_interpreter, 1, "Identity_1", &s_tensor_gender);
-#endif
-
-    std::list<age_t> age_list;
-    decode_ages (age_list);
+    age_t age_item;
+    decode_ages (&age_item);
 
-    //for (auto itr = age_list.begin(); itr != age_list.end(); itr ++)
-    //{
-    //    age_t age_item = *itr;
-    //    fprintf (stderr, "%2d: %f\n", age_item.age, age_item.score);
-    //}
-    
     float *gender_ptr = (float *)s_tensor_gender.ptr;
     float score_m = gender_ptr[1];
     float score_f = gender_ptr[0];
     //fprintf (stderr, "gender(%f, %f)\n", score_m, score_f);
 
-    age_t age_item = age_list.front();
     age_gender_result->age.age   = age_item.age;
     age_gender_result->age.score = age_item.score;
     age_gender_result->gender.score_m = score_m;
@@ -3,6 +3,8 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_blazeface.h"
 #include <list>
 
@@ -20,6 +22,8 @@ static tflite_tensor_t      s_detect_tensor_bboxes;
 
 static std::list<fvec2> s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * determine where the anchor points are scatterd.
  *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
@@ -90,6 +94,8 @@ init_tflite_blazeface(int use_quantized_tflite, blazeface_config_t *config)
     config->score_thresh = 0.75f;
     config->iou_thresh   = 0.3f;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -115,7 +121,7 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
@@ -226,7 +232,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -259,7 +265,7 @@ non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_l
 }
 
 static void
-pack_face_result (blazeface_result_t *face_result, std::list<face_t> &face_list)
+pack_face_result (blazeface_result_t *face_result, arena_list<face_t> &face_list)
 {
     int num_faces = 0;
     for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
@@ -287,9 +293,12 @@ invoke_blazeface (blazeface_result_t *face_result, blazeface_config_t *config)
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
@@ -298,7 +307,7 @@ invoke_blazeface (blazeface_result_t *face_result, blazeface_config_t *config)
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (face_result, face_nms_list);
@@ -306,6 +315,9 @@ invoke_blazeface (blazeface_result_t *face_result, blazeface_config_t *config)
     pack_face_result (face_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_blazeface");
+    frame_arena_end ();
+
     return 0;
 }
 
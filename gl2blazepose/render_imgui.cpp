@@ -52,6 +52,12 @@ render_gui (imgui_data_t *imgui_data)
     ImGui::SliderFloat("Score thresh", &imgui_data->blazepose_config.score_thresh, 0.0f, 1.0f);
     ImGui::SliderFloat("IOU   thresh", &imgui_data->blazepose_config.iou_thresh,   0.0f, 1.0f);
 
+    bool enable_track = imgui_data->blazepose_config.enable_track;
+    ImGui::Checkbox("ROI tracking", &enable_track);
+    imgui_data->blazepose_config.enable_track = enable_track ? 1 : 0;
+    ImGui::SliderFloat("Track thresh", &imgui_data->blazepose_config.track_thresh, 0.0f, 1.0f);
+    ImGui::SliderFloat("Track smooth", &imgui_data->blazepose_config.track_smooth, 0.0f, 0.95f);
+
     ImVec4 frame_color;
     frame_color.x = imgui_data->frame_color[0];
     frame_color.y = imgui_data->frame_color[1];
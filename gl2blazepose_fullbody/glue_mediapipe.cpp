@@ -172,7 +172,7 @@ compare (detect_region_t &v1, detect_region_t &v2)
 }
 
 int
-non_max_suppression (std::list<detect_region_t> &region_list, std::list<detect_region_t> &region_nms_list, float iou_thresh)
+non_max_suppression (arena_list<detect_region_t> &region_list, arena_list<detect_region_t> &region_nms_list, float iou_thresh)
 {
     region_list.sort (compare);
 
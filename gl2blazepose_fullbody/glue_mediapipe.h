@@ -23,6 +23,7 @@
 #include <list>
 #include <vector>
 #include "tflite_blazepose.h"
+#include "util_frame_arena.h"
 
 typedef struct Anchor
 {
@@ -83,7 +84,7 @@ int GenerateAnchors(std::vector<Anchor>* anchors, const SsdAnchorsCalculatorOpti
 
 
 
-int non_max_suppression (std::list<detect_region_t> &region_list,
-                         std::list<detect_region_t> &region_nms_list, float iou_thresh);
+int non_max_suppression (arena_list<detect_region_t> &region_list,
+                         arena_list<detect_region_t> &region_nms_list, float iou_thresh);
 
 #endif /* GLUE_MEDIAPIPE_H_ */
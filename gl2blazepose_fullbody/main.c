@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -11,10 +12,13 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_blazepose.h"
+#include "util_frame_seq.h"
+#include "util_extrapolate.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 #include "render_imgui.h"
@@ -35,7 +39,10 @@ feed_pose_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_pose_detect_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -73,7 +80,10 @@ feed_pose_landmark_image(texture_2d_t *srctex, int win_w, int win_h, pose_detect
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_pose_landmark_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -322,6 +332,85 @@ render_cropped_pose_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw,
 }
 
 
+/* -------------------------------------------------- *
+ *  keypoint extrapolation (-p option)
+ *  the joints (in the ROI space) and the ROI are extrapolated
+ *  together. the rotation of the ROI is kept as it is.
+ * -------------------------------------------------- */
+#define POSE_EXTRAP_NUM     (POSE_JOINT_NUM * 3 + 4 + 4 * 2 + 4)
+
+static void
+pack_pose_keypoints (float *val, detect_region_t *region, pose_landmark_result_t *landmark)
+{
+    memcpy (val, landmark->joint, POSE_JOINT_NUM * sizeof (fvec3));
+    val += POSE_JOINT_NUM * 3;
+
+    val[0] = region->roi_center.x;
+    val[1] = region->roi_center.y;
+    val[2] = region->roi_size.x;
+    val[3] = region->roi_size.y;
+    memcpy (&val[4], region->roi_coord, 4 * sizeof (fvec2));
+    val[12] = region->topleft.x;
+    val[13] = region->topleft.y;
+    val[14] = region->btmright.x;
+    val[15] = region->btmright.y;
+}
+
+static void
+unpack_pose_keypoints (float *val, detect_region_t *region, pose_landmark_result_t *landmark)
+{
+    memcpy (landmark->joint, val, POSE_JOINT_NUM * sizeof (fvec3));
+    val += POSE_JOINT_NUM * 3;
+
+    region->roi_center.x = val[0];
+    region->roi_center.y = val[1];
+    region->roi_size.x   = val[2];
+    region->roi_size.y   = val[3];
+    memcpy (region->roi_coord, &val[4], 4 * sizeof (fvec2));
+    region->topleft.x    = val[12];
+    region->topleft.y    = val[13];
+    region->btmright.x   = val[14];
+    region->btmright.y   = val[15];
+}
+
+static void
+update_pose_extrap (extrap_track_t *extrap, pose_detect_result_t *detect,
+                    pose_landmark_result_t *landmark, double time_ms)
+{
+    float val[POSE_EXTRAP_NUM];
+
+    for (int pose_id = 0; pose_id < MAX_POSE_NUM; pose_id ++)
+    {
+        if (pose_id >= detect->num)
+        {
+            extrap_reset (&extrap[pose_id]);
+            continue;
+        }
+
+        pack_pose_keypoints (val, &detect->poses[pose_id], &landmark[pose_id]);
+        extrap_update (&extrap[pose_id], val, POSE_EXTRAP_NUM, time_ms);
+    }
+}
+
+static void
+predict_pose_extrap (extrap_track_t *extrap, pose_detect_result_t *dst_detect, pose_landmark_result_t *dst_landmark,
+                     pose_detect_result_t *detect, pose_landmark_result_t *landmark, double time_ms)
+{
+    float val[POSE_EXTRAP_NUM];
+
+    *dst_detect = *detect;
+    memcpy (dst_landmark, landmark, MAX_POSE_NUM * sizeof (pose_landmark_result_t));
+    for (int pose_id = 0; pose_id < detect->num; pose_id ++)
+    {
+        if (extrap[pose_id].valid == 0)
+            continue;
+
+        extrap_predict (&extrap[pose_id], time_ms, val);
+        unpack_pose_keypoints (val, &dst_detect->poses[pose_id], &dst_landmark[pose_id]);
+    }
+}
+
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -419,6 +508,9 @@ main(int argc, char *argv[])
     double ttime[10] = {0}, interval, invoke_ms0 = 0, invoke_ms1 = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    int enable_extrap = 0;
+    frame_seq_t fseq;
     imgui_data_t imgui_data = {0};
     UNUSED (argc);
     UNUSED (*argv);
@@ -428,12 +520,15 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "pqv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'p':
+                enable_extrap = 1;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
@@ -443,6 +538,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -507,17 +605,29 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
+    pose_detect_result_t track_ret = {0};
+    static pose_detect_result_t    detect_ret;
+    static pose_landmark_result_t  landmark_ret[MAX_POSE_NUM];
+    static pose_detect_result_t    pred_detect;
+    static pose_landmark_result_t  pred_landmark[MAX_POSE_NUM];
+    static extrap_track_t          pose_extrap[MAX_POSE_NUM];
+    pose_detect_result_t    *draw_detect   = &detect_ret;
+    pose_landmark_result_t  *draw_landmark = landmark_ret;
+    blazepose_config_t last_config = imgui_data.blazepose_config;
+
+    mem_print_startup_report ();
+
     for (count = 0; ; count ++)
     {
-        pose_detect_result_t    detect_ret = {0};
-        pose_landmark_result_t  landmark_ret[MAX_POSE_NUM] = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -530,50 +640,107 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
-        /* --------------------------------------- *
-         *  Pose detection
-         * --------------------------------------- */
-        feed_pose_detect_image (&captex, win_w, win_h);
-
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_pose_detect (&detect_ret, &imgui_data.blazepose_config);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
+        /* the last result is reused while the frame and the config are unchanged */
+        if (memcmp (&last_config, &imgui_data.blazepose_config, sizeof (last_config)) != 0)
+        {
+            last_config = imgui_data.blazepose_config;
+            frame_seq_invalidate (&fseq);
+        }
 
-        /* --------------------------------------- *
-         *  Pose landmark
-         * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int pose_id = 0; pose_id < detect_ret.num; pose_id ++)
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
         {
-            feed_pose_landmark_image (&captex, win_w, win_h, &detect_ret, pose_id);
+            /* --------------------------------------- *
+             *  Pose detection
+             *  (skipped while the ROI is tracked from the landmarks)
+             * --------------------------------------- */
+            if (imgui_data.blazepose_config.enable_track && track_ret.num > 0)
+            {
+                detect_ret = track_ret;
+                invoke_ms0 = 0;
+            }
+            else
+            {
+                PMETER_SCOPE_BEGIN ("feed_pose_detect_image");
+                feed_pose_detect_image (&captex, win_w, win_h);
+                PMETER_SCOPE_END ();
+                memset (&detect_ret, 0, sizeof (detect_ret));
+
+                ttime[2] = pmeter_get_time_ms ();
+                PMETER_SCOPE_BEGIN ("invoke_pose_detect");
+                invoke_pose_detect (&detect_ret, &imgui_data.blazepose_config);
+                PMETER_SCOPE_END ();
+                ttime[3] = pmeter_get_time_ms ();
+                invoke_ms0 = ttime[3] - ttime[2];
+            }
 
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_pose_landmark (&landmark_ret[pose_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            /* --------------------------------------- *
+             *  Pose landmark
+             * --------------------------------------- */
+            invoke_ms1 = 0;
+            memset (landmark_ret, 0, sizeof (landmark_ret));
+            for (int pose_id = 0; pose_id < detect_ret.num; pose_id ++)
+            {
+                PMETER_SCOPE_BEGIN ("feed_pose_landmark_image");
+                feed_pose_landmark_image (&captex, win_w, win_h, &detect_ret, pose_id);
+                PMETER_SCOPE_END ();
+
+                ttime[4] = pmeter_get_time_ms ();
+                PMETER_SCOPE_BEGIN ("invoke_pose_landmark");
+                invoke_pose_landmark (&landmark_ret[pose_id]);
+                PMETER_SCOPE_END ();
+                ttime[5] = pmeter_get_time_ms ();
+                invoke_ms1 += ttime[5] - ttime[4];
+            }
+
+            /* ROI of the next frame */
+            track_ret.num = 0;
+            if (imgui_data.blazepose_config.enable_track)
+                track_pose_roi (&track_ret, &detect_ret, landmark_ret, &imgui_data.blazepose_config);
+
+            if (enable_extrap)
+                update_pose_extrap (pose_extrap, &detect_ret, landmark_ret, ttime[1]);
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
+
         /* --------------------------------------- *
          *  render scene
+         *  (the keypoints are extrapolated to the display time with -p)
          * --------------------------------------- */
+        if (enable_extrap)
+        {
+            predict_pose_extrap (pose_extrap, &pred_detect, pred_landmark,
+                                 &detect_ret, landmark_ret, pmeter_get_time_ms ());
+            draw_detect   = &pred_detect;
+            draw_landmark = pred_landmark;
+        }
+
         glClear (GL_COLOR_BUFFER_BIT);
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
-        render_detect_region (draw_x, draw_y, draw_w, draw_h, &detect_ret, &imgui_data);
-        render_pose_landmark (draw_x, draw_y, draw_w, draw_h, &landmark_ret[0], &detect_ret, 0);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
+        render_detect_region (draw_x, draw_y, draw_w, draw_h, draw_detect, &imgui_data);
+        PMETER_SCOPE_END ();
+        PMETER_SCOPE_BEGIN ("render_pose_landmark");
+        render_pose_landmark (draw_x, draw_y, draw_w, draw_h, &draw_landmark[0], draw_detect, 0);
+        PMETER_SCOPE_END ();
 
         /* draw cropped image of the pose area */
-        for (int pose_id = 0; pose_id < detect_ret.num; pose_id ++)
+        for (int pose_id = 0; pose_id < draw_detect->num; pose_id ++)
         {
             float w = 100;
             float h = 100;
@@ -581,7 +748,9 @@ main(int argc, char *argv[])
             float y = h * pose_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-            render_cropped_pose_image (&captex, x, y, w, h, &detect_ret, pose_id);
+            PMETER_SCOPE_BEGIN ("render_cropped_pose_image");
+            render_cropped_pose_image (&captex, x, y, w, h, draw_detect, pose_id);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -595,9 +764,13 @@ main(int argc, char *argv[])
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&imgui_data);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -3,9 +3,12 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_blazepose.h"
 #include "glue_mediapipe.h"
 #include <list>
+#include <float.h>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/modules/pose_detection
@@ -26,8 +29,16 @@ static tflite_tensor_t      s_landmark_tensor_input;
 static tflite_tensor_t      s_landmark_tensor_landmark;
 static tflite_tensor_t      s_landmark_tensor_landmarkflag;
 
+static int                  s_landmark_num_points;
+
 static std::vector<Anchor>  s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
+/* detector keypoints which the auxiliary landmarks correspond to */
+#define POSE_ROI_CENTER_KEY     kMidHipCenter
+#define POSE_ROI_SCALE_KEY      kFullBodySizeRot
+
 
 static int
 create_ssd_anchors(int input_w, int input_h)
@@ -100,12 +111,26 @@ init_tflite_blazepose(int use_quantized_tflite, blazepose_config_t *config)
     tflite_get_tensor_by_name (&s_landmark_interpreter, 1, "ld_3d",           &s_landmark_tensor_landmark);
     tflite_get_tensor_by_name (&s_landmark_interpreter, 1, "output_poseflag", &s_landmark_tensor_landmarkflag);
 
+    /* (x, y, z, visibility) for each keypoint */
+    s_landmark_num_points = 1;
+    for (int i = 0; i < 4; i ++)
+    {
+        if (s_landmark_tensor_landmark.dims[i] > 0)
+            s_landmark_num_points *= s_landmark_tensor_landmark.dims[i];
+    }
+    s_landmark_num_points /= 4;
+
     int det_input_w = s_detect_tensor_input.dims[2];
     int det_input_h = s_detect_tensor_input.dims[1];
     create_ssd_anchors (det_input_w, det_input_h);
 
     config->score_thresh = 0.75f;
     config->iou_thresh   = 0.3f;
+    config->enable_track = 1;
+    config->track_thresh = 0.5f;
+    config->track_smooth = 0.5f;
+
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
 
     return 0;
 }
@@ -147,7 +172,7 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<detect_region_t> &region_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (arena_list<detect_region_t> &region_list, float score_thresh, int input_img_w, int input_img_h)
 {
     detect_region_t region;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
@@ -322,7 +347,7 @@ compute_detect_to_roi (detect_region_t &region)
 
 
 static void
-pack_detect_result (pose_detect_result_t *detect_result, std::list<detect_region_t> &region_list)
+pack_detect_result (pose_detect_result_t *detect_result, arena_list<detect_region_t> &region_list)
 {
     int num_regions = 0;
     for (auto itr = region_list.begin(); itr != region_list.end(); itr ++)
@@ -354,9 +379,12 @@ invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t *con
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<detect_region_t> region_list;
+    arena_list<detect_region_t> region_list;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
@@ -365,7 +393,7 @@ invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t *con
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<detect_region_t> region_nms_list;
+    arena_list<detect_region_t> region_nms_list;
 
     non_max_suppression (region_list, region_nms_list, iou_thresh);
     pack_detect_result (detect_result, region_nms_list);
@@ -373,6 +401,9 @@ invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t *con
     pack_detect_result (detect_result, region_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_pose_detect");
+    frame_arena_end ();
+
     return 0;
 }
 
@@ -405,6 +436,107 @@ invoke_pose_landmark (pose_landmark_result_t *landmark_result)
         //    landmark_ptr[4 * i + 0], landmark_ptr[4 * i + 1], landmark_ptr[4 * i + 2]);
     }
 
+    /* auxiliary keypoints for the ROI of the next frame */
+    for (int i = 0; i < 2 && POSE_JOINT_NUM + i < s_landmark_num_points; i ++)
+    {
+        float *ptr = landmark_ptr + 4 * (POSE_JOINT_NUM + i);
+        landmark_result->align_key[i].x = ptr[0] / (float)img_w;
+        landmark_result->align_key[i].y = ptr[1] / (float)img_h;
+        landmark_result->align_key[i].z = ptr[2];
+    }
+
     return 0;
 }
 
+
+
+/* -------------------------------------------------- *
+ *  Track pose ROI from the landmarks
+ *
+ *  the landmark model also outputs 2 auxiliary keypoints
+ *  (ROI center and size/rotation point) right after the
+ *  POSE_JOINT_NUM landmarks. they have the same meaning as
+ *  the detector keypoints, so the ROI of the next frame can
+ *  be derived from them without running the detector.
+ *  (mediapipe/modules/pose_landmark/pose_landmarks_to_roi.pbtxt)
+ * -------------------------------------------------- */
+
+/* landmark (normalized to the ROI) ==> image coordinate */
+static fvec2
+landmark_to_image (detect_region_t &region, fvec3 &joint)
+{
+    fvec2 pos;
+    pos.x = (joint.x - 0.5f) * region.roi_size.x;
+    pos.y = (joint.y - 0.5f) * region.roi_size.y;
+
+    rot_vec (pos, region.rotation);
+    pos.x += region.roi_center.x;
+    pos.y += region.roi_center.y;
+    return pos;
+}
+
+static void
+compute_landmark_to_roi (detect_region_t &region, pose_landmark_result_t *landmark, float smooth)
+{
+    fvec2 center = landmark_to_image (region, landmark->align_key[0]);
+    fvec2 scale  = landmark_to_image (region, landmark->align_key[1]);
+
+    /* exponential smoothing against the ROI of the previous frame */
+    fvec2 &prev_center = region.keys[POSE_ROI_CENTER_KEY];
+    fvec2 &prev_scale  = region.keys[POSE_ROI_SCALE_KEY];
+    prev_center.x += (1.0f - smooth) * (center.x - prev_center.x);
+    prev_center.y += (1.0f - smooth) * (center.y - prev_center.y);
+    prev_scale.x  += (1.0f - smooth) * (scale.x  - prev_scale.x);
+    prev_scale.y  += (1.0f - smooth) * (scale.y  - prev_scale.y);
+
+    float target_angle = M_PI * 0.5f;
+    float rotation = target_angle - std::atan2(-(prev_scale.y - prev_center.y), prev_scale.x - prev_center.x);
+    region.rotation = normalize_radians (rotation);
+
+    /* bounding box of the landmarks, only for visualization */
+    float x_min = FLT_MAX, x_max = -FLT_MAX;
+    float y_min = FLT_MAX, y_max = -FLT_MAX;
+    for (int i = 0; i < POSE_JOINT_NUM; i ++)
+    {
+        fvec2 p = landmark_to_image (region, landmark->joint[i]);
+        x_min = std::min (x_min, p.x);  x_max = std::max (x_max, p.x);
+        y_min = std::min (y_min, p.y);  y_max = std::max (y_max, p.y);
+    }
+    region.topleft.x  = x_min;
+    region.topleft.y  = y_min;
+    region.btmright.x = x_max;
+    region.btmright.y = y_max;
+    region.score      = landmark->score;
+
+    compute_detect_to_roi (region);
+}
+
+/*
+ *  compute the ROIs of the next frame into (track_result).
+ *  if the presence of any pose falls below the threshold, (track_result)
+ *  is cleared so that the detector runs again.
+ */
+int
+track_pose_roi (pose_detect_result_t *track_result, pose_detect_result_t *detect_result,
+                pose_landmark_result_t *landmark_result, blazepose_config_t *config)
+{
+    track_result->num = 0;
+
+    if (s_landmark_num_points < POSE_JOINT_NUM + 2)
+        return 0;
+
+    for (int i = 0; i < detect_result->num; i ++)
+    {
+        if (landmark_result[i].score < config->track_thresh)
+        {
+            track_result->num = 0;
+            return 0;
+        }
+
+        detect_region_t &region = track_result->poses[track_result->num ++];
+        region = detect_result->poses[i];
+        compute_landmark_to_roi (region, &landmark_result[i], config->track_smooth);
+    }
+
+    return track_result->num;
+}
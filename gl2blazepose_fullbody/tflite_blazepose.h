@@ -52,6 +52,7 @@ typedef struct _pose_landmark_result_t
 {
     float score;
     fvec3 joint[POSE_JOINT_NUM];
+    fvec3 align_key[2];         /* auxiliary keypoints (ROI center, size/rotation) */
 } pose_landmark_result_t;
 
 
@@ -59,6 +60,9 @@ typedef struct _blazepose_config_t
 {
     float score_thresh;
     float iou_thresh;
+    int   enable_track;         /* derive the next ROI from the landmarks */
+    float track_thresh;         /* landmark presence to keep tracking */
+    float track_smooth;         /* [0, 1) smoothing factor of the ROI */
 } blazepose_config_t;
 
 int init_tflite_blazepose (int use_quantized_tflite, blazepose_config_t *config);
@@ -69,6 +73,9 @@ int  invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t
 void *get_pose_landmark_input_buf (int *w, int *h);
 int  invoke_pose_landmark (pose_landmark_result_t *pose_landmark_result);
 
+int  track_pose_roi (pose_detect_result_t *track_result, pose_detect_result_t *detect_result,
+                     pose_landmark_result_t *landmark_result, blazepose_config_t *config);
+
 #ifdef __cplusplus
 }
 #endif
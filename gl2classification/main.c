@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -11,9 +12,11 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "tflite_classification.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -33,7 +36,10 @@ feed_classification_image_uint8 (texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_classification_image_uint8", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -69,7 +75,10 @@ feed_classification_image_float (texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_classification_image_float", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -191,9 +200,12 @@ main(int argc, char *argv[])
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    static classification_result_t class_ret;
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -202,7 +214,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "qv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -217,6 +229,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -279,16 +294,19 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        classification_result_t class_ret = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -301,25 +319,41 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  classification
+         *  (the last result is reused while the frame is unchanged)
          * --------------------------------------- */
-        feed_classification_image (&captex, win_w, win_h);
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
+        {
+            PMETER_SCOPE_BEGIN ("feed_classification_image");
+            feed_classification_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
+            memset (&class_ret, 0, sizeof (class_ret));
+
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_classification");
+            invoke_classification (&class_ret);
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            invoke_ms = ttime[3] - ttime[2];
+        }
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_classification (&class_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms = ttime[3] - ttime[2];
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
 
         /* --------------------------------------- *
          *  render scene
@@ -328,7 +362,9 @@ main(int argc, char *argv[])
 
         /* visualize the object detection results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_classification_result");
         render_classification_result (draw_x, draw_y, draw_w, draw_h, &class_ret);
+        PMETER_SCOPE_END ();
 
         /* --------------------------------------- *
          *  post process
@@ -338,7 +374,9 @@ main(int argc, char *argv[])
         sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]", interval, invoke_ms);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
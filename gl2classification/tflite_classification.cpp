@@ -3,6 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_classification.h"
 #include <list>
 
@@ -19,6 +21,8 @@ static tflite_tensor_t      s_tensor_output;
 
 static char                 s_class_name [MAX_CLASS_NUM][64];
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 
 /* -------------------------------------------------- *
  *  load class labels
@@ -72,6 +76,8 @@ init_tflite_classification(int use_quantized_tflite)
 
     load_label_map ();
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -119,7 +125,7 @@ get_scoreval (int class_id)
 }
 
 static int
-push_listitem (std::list<classify_t> &class_list, classify_t &item, size_t topn)
+push_listitem (arena_list<classify_t> &class_list, classify_t &item, size_t topn)
 {
     size_t idx = 0;
 
@@ -163,7 +169,10 @@ invoke_classification (classification_result_t *class_ret)
     }
 
 
-    std::list<classify_t> classify_list;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<classify_t> classify_list;
     for (int i = 0; i < MAX_CLASS_NUM; i ++)
     {
         classify_t item;
@@ -186,5 +195,8 @@ invoke_classification (classification_result_t *class_ret)
         class_ret->num = count;
     }
 
+    ALLOC_CHECK_END ("invoke_classification");
+    frame_arena_end ();
+
     return 0;
 }
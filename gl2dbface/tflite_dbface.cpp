@@ -3,6 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_dbface.h"
 #include <list>
 
@@ -22,6 +24,8 @@ static tflite_tensor_t      s_detect_tensor_hm;
 static tflite_tensor_t      s_detect_tensor_box;
 static tflite_tensor_t      s_detect_tensor_landmark;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 
 
 
@@ -53,6 +57,8 @@ init_tflite_dbface(int use_quantized_tflite, dbface_config_t *config)
     config->score_thresh = 0.3f;
     config->iou_thresh   = 0.3f;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -100,7 +106,7 @@ _exp (float v)
 
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_hm.ptr;
@@ -204,7 +210,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -237,7 +243,7 @@ non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_l
 }
 
 static void
-pack_face_result (dbface_result_t *face_result, std::list<face_t> &face_list)
+pack_face_result (dbface_result_t *face_result, arena_list<face_t> &face_list)
 {
     int num_faces = 0;
     for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
@@ -265,15 +271,18 @@ invoke_dbface (dbface_result_t *face_result, dbface_config_t *config)
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     decode_bounds (face_list, score_thresh);
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (face_result, face_nms_list);
@@ -281,6 +290,9 @@ invoke_dbface (dbface_result_t *face_result, dbface_config_t *config)
     pack_face_result (face_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_dbface");
+    frame_arena_end ();
+
     return 0;
 }
 
@@ -11,10 +11,12 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_dense_depth.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 #include "render_dense_depth.h"
@@ -38,7 +40,10 @@ feed_dense_depth_image(texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_dense_depth_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -319,9 +324,11 @@ main(int argc, char *argv[])
     int win_h = 900;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -330,7 +337,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "qv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -345,6 +352,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -410,17 +420,20 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     dense_depth_result_t dense_depth_result = {0};
-    int is_first = 1;
+    mem_print_startup_report ();
+
     for (count = 0; ; count ++)
     {
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -434,32 +447,41 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  Dense Depth
+         *  (the last result is reused while the frame is unchanged)
          * --------------------------------------- */
-        invoke_ms = 0;
-        if (is_first)
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
         {
+            PMETER_SCOPE_BEGIN ("feed_dense_depth_image");
             feed_dense_depth_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
 
             ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_dense_depth");
             invoke_dense_depth (&dense_depth_result);
+            PMETER_SCOPE_END ();
             ttime[3] = pmeter_get_time_ms ();
             invoke_ms = ttime[3] - ttime[2];
-
-            is_first = 0;
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
+
         /* --------------------------------------- *
          *  render scene (left half)
          * --------------------------------------- */
@@ -475,7 +497,9 @@ main(int argc, char *argv[])
             int dy = 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
+            PMETER_SCOPE_BEGIN ("render_depth_image");
             render_depth_image (&captex, dx, dy, dw, dh, &dense_depth_result);
+            PMETER_SCOPE_END ();
             draw_2d_rect (dx, dy, dw, dh, col_white, 2.0f);
         }
 
@@ -484,7 +508,9 @@ main(int argc, char *argv[])
          * --------------------------------------- */
         glViewport (win_w, 0, win_w, win_h);
 
+        PMETER_SCOPE_BEGIN ("render_depth_image_3d");
         render_depth_image_3d (&captex, draw_x, draw_y, draw_w, draw_h, &dense_depth_result);
+        PMETER_SCOPE_END ();
 
         /* --------------------------------------- *
          *  post process
@@ -500,9 +526,13 @@ main(int argc, char *argv[])
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&s_gui_prop);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -108,10 +108,10 @@ void DecreasingPartialArgSort(const float* values, int num_values,
 }
 
 
-void SelectDetectionsAboveScoreThreshold(const std::vector<float>& values,
+void SelectDetectionsAboveScoreThreshold(const arena_vector<float>& values,
                                          const float threshold,
-                                         std::vector<float>* keep_values,
-                                         std::vector<int>* keep_indices) {
+                                         arena_vector<float>* keep_values,
+                                         arena_vector<int>* keep_indices) {
   for (unsigned int i = 0; i < values.size(); i++) {
     if (values[i] >= threshold) {
       keep_values->emplace_back(values[i]);
@@ -147,22 +147,22 @@ float ComputeIntersectionOverUnion(const float* decoded_boxes,
 // Complexity is O(N^2) pairwise comparison between boxes
 int
 NonMaxSuppressionSingleClassHelper(const float *decoded_boxes,
-                                   const std::vector<float>& scores, 
-                                   std::vector<int>* selected, int max_detections) {
+                                   const arena_vector<float>& scores, 
+                                   arena_vector<int>* selected, int max_detections) {
 
     const float non_max_suppression_score_threshold = ATTR_NMS_SCORE_THRESHOLD;
     const float intersection_over_union_threshold   = ATTR_NMS_IOU_THRESHOLD;
 
     // threshold scores
-    std::vector<int> keep_indices;
+    arena_vector<int> keep_indices;
     // TODO (chowdhery): Remove the dynamic allocation and replace it
     // with temporaries, esp for std::vector<float>
-    std::vector<float> keep_scores;
+    arena_vector<float> keep_scores;
     SelectDetectionsAboveScoreThreshold(
         scores, non_max_suppression_score_threshold, &keep_scores, &keep_indices);
 
     int num_scores_kept = keep_scores.size();
-    std::vector<int> sorted_indices;
+    arena_vector<int> sorted_indices;
     sorted_indices.resize(num_scores_kept);
     DecreasingPartialArgSort(keep_scores.data(), num_scores_kept, num_scores_kept,
                                 sorted_indices.data());
@@ -211,7 +211,7 @@ NonMaxSuppressionSingleClassHelper(const float *decoded_boxes,
 // where N is the number of anchors and K the number of
 // classes.
 int
-NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_boxes, 
+NonMaxSuppressionMultiClassRegularHelper(arena_vector<DetectionBox> &detection_boxes, 
                                          const float *decoded_boxes, const float* scores) {
     const int num_boxes   = s_anchors_count;
     const int num_classes = ATTR_NUM_CLASSES;
@@ -223,15 +223,15 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
     const int num_classes_with_background = num_classes + label_offset;
 
     // For each class, perform non-max suppression.
-    std::vector<float> class_scores(num_boxes);
+    arena_vector<float> class_scores(num_boxes);
 
-    std::vector<int> box_indices_after_regular_non_max_suppression(num_boxes + max_detections);
-    std::vector<float> scores_after_regular_non_max_suppression(num_boxes +  max_detections);
+    arena_vector<int> box_indices_after_regular_non_max_suppression(num_boxes + max_detections);
+    arena_vector<float> scores_after_regular_non_max_suppression(num_boxes +  max_detections);
 
     int size_of_sorted_indices = 0;
-    std::vector<int> sorted_indices;
+    arena_vector<int> sorted_indices;
     sorted_indices.resize(num_boxes + max_detections);
-    std::vector<float> sorted_values;
+    arena_vector<float> sorted_values;
     sorted_values.resize(max_detections);
 
     for (int col = 0; col < num_classes; col++) {
@@ -241,7 +241,7 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
                 *(scores + row * num_classes_with_background + col + label_offset);
         }
         // Perform non-maximal suppression on single class
-        std::vector<int> selected;
+        arena_vector<int> selected;
         NonMaxSuppressionSingleClassHelper(decoded_boxes, class_scores, &selected, num_detections_per_class);
 
         // Add selected indices from non-max suppression of boxes in this class
@@ -311,7 +311,7 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
 // instead of O(KN^2) where N is the number of anchors and K the number of
 // classes.
 int
-NonMaxSuppressionMultiClassFastHelper (std::vector<DetectionBox> &detection_boxes, 
+NonMaxSuppressionMultiClassFastHelper (arena_vector<DetectionBox> &detection_boxes, 
                                        const float *decoded_boxes, const float* scores) {
     const int num_boxes   = s_anchors_count;
     const int num_classes = ATTR_NUM_CLASSES;
@@ -322,9 +322,9 @@ NonMaxSuppressionMultiClassFastHelper (std::vector<DetectionBox> &detection_boxe
     const int num_classes_with_background = num_classes + label_offset;
     const int num_categories_per_anchor   = std::min(max_categories_per_anchor, num_classes);
 
-    std::vector<float> max_scores;
+    arena_vector<float> max_scores;
     max_scores.resize(num_boxes);
-    std::vector<int> sorted_class_indices;
+    arena_vector<int> sorted_class_indices;
     sorted_class_indices.resize(num_boxes * num_classes);
 
     for (int row = 0; row < num_boxes; row++) {
@@ -337,7 +337,7 @@ NonMaxSuppressionMultiClassFastHelper (std::vector<DetectionBox> &detection_boxe
     }
 
     // Perform non-maximal suppression on max scores
-    std::vector<int> selected;
+    arena_vector<int> selected;
     NonMaxSuppressionSingleClassHelper(decoded_boxes, max_scores, &selected, ATTR_MAX_DETECTIONS);
 
     // Allocate output tensors
@@ -421,7 +421,7 @@ init_detect_postprocess (std::string filename)
 
 
 int
-invoke_detection_postprocess (std::vector<DetectionBox> &detection_boxes,  /* [OUT] */
+invoke_detection_postprocess (arena_vector<DetectionBox> &detection_boxes,  /* [OUT] */
                               const float *boxes_ptr,                      /* [IN ] */
                               const float *scores_ptr)                     /* [IN ] */
 {
@@ -5,6 +5,8 @@
 #ifndef _DETECT_POSTPROCESS_H_
 #define _DETECT_POSTPROCESS_H_
 
+#include "util_frame_arena.h"
+
 
 struct DetectionBox {
     float x1;
@@ -18,7 +20,7 @@ struct DetectionBox {
 int init_detect_postprocess (std::string filename);
 
 int
-invoke_detection_postprocess (std::vector<DetectionBox> &detection_boxes,  /* [OUT] */
+invoke_detection_postprocess (arena_vector<DetectionBox> &detection_boxes,  /* [OUT] */
                               const float *boxes_ptr,                      /* [IN ] */
                               const float *_scores_ptr);                   /* [IN ] */
 
@@ -4,33 +4,47 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/stat.h>
 #include <GLES2/gl2.h>
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "tflite_detect.h"
+#include "util_tracker.h"
+#include "util_async_infer.h"
+#include "util_governor.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
 #define UNUSED(x) (void)(x)
 
+static async_infer_t s_detect_runner;
+static size_t        s_detect_input_size;
 
 
 /* resize image to (300x300) for input image of MobileNet SSD */
 void
-feed_detect_image_uint8 (texture_2d_t *srctex, int win_w, int win_h)
+feed_detect_image_uint8 (texture_2d_t *srctex, int win_w, int win_h, void *dstbuf)
 {
     int x, y, w, h;
-    uint8_t *buf_u8 = (uint8_t *)get_detect_input_buf (&w, &h);
+    uint8_t *buf_u8 = (uint8_t *)dstbuf;
     unsigned char *buf_ui8 = NULL;
     static unsigned char *pui8 = NULL;
 
+    get_detect_input_buf (&w, &h);     /* input dims only. dstbuf may be a staging buffer */
+
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_detect_image_uint8", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -59,15 +73,20 @@ feed_detect_image_uint8 (texture_2d_t *srctex, int win_w, int win_h)
 
 /* resize image to DNN network input size and convert to fp32. */
 void
-feed_detect_image_float (texture_2d_t *srctex, int win_w, int win_h)
+feed_detect_image_float (texture_2d_t *srctex, int win_w, int win_h, void *dstbuf)
 {
     int x, y, w, h;
-    float *buf_fp32 = (float *)get_detect_input_buf (&w, &h);
+    float *buf_fp32 = (float *)dstbuf;
     unsigned char *buf_ui8 = NULL;
     static unsigned char *pui8 = NULL;
 
+    get_detect_input_buf (&w, &h);     /* input dims only. dstbuf may be a staging buffer */
+
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_detect_image_float", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -97,13 +116,55 @@ feed_detect_image_float (texture_2d_t *srctex, int win_w, int win_h)
 }
 
 void
-feed_detect_image(texture_2d_t *srctex, int win_w, int win_h)
+feed_detect_image(texture_2d_t *srctex, int win_w, int win_h, void *dstbuf)
 {
     int type = get_detect_input_type ();
     if (type)
-        feed_detect_image_uint8 (srctex, win_w, win_h);
+        feed_detect_image_uint8 (srctex, win_w, win_h, dstbuf);
     else
-        feed_detect_image_float (srctex, win_w, win_h);
+        feed_detect_image_float (srctex, win_w, win_h, dstbuf);
+}
+
+
+/* -------------------------------------------------- *
+ *  inference on the worker thread (util_async_infer)
+ * -------------------------------------------------- */
+static size_t
+get_detect_input_size ()
+{
+    int w, h;
+
+    get_detect_input_buf (&w, &h);
+    return w * h * 3 * (get_detect_input_type () ? sizeof (uint8_t) : sizeof (float));
+}
+
+static int
+run_detect (void *input, void *output, void *usrdata)
+{
+    int w, h, ret;
+    void *buf = get_detect_input_buf (&w, &h);
+
+    /* the model may have been swapped since the init */
+    memcpy (buf, input, get_detect_input_size ());
+
+    PMETER_SCOPE_BEGIN ("invoke_detect");
+    ret = invoke_detect ((detect_result_t *)output);
+    PMETER_SCOPE_END ();
+    return ret;
+}
+
+static int
+init_detect_runner (int enable_async)
+{
+    int w, h;
+    int flags = enable_async ? 0 : ASYNC_INFER_SYNC;
+
+    /* sized for the float input, so that any model can be swapped in */
+    get_detect_input_buf (&w, &h);
+    s_detect_input_size = w * h * 3 * sizeof (float);
+
+    return async_infer_init (&s_detect_runner, s_detect_input_size, sizeof (detect_result_t),
+                             run_detect, NULL, flags);
 }
 
 void
@@ -128,11 +189,194 @@ render_detect_region (int ofstx, int ofsty, int texw, int texh,
         /* class name */
         char *name = get_detect_class_name (det_class);
         char buf[512];
-        sprintf (buf, "%s(%d)", name, (int)(score * 100));
+        sprintf (buf, "%s(%d) #%d", name, (int)(score * 100), detection->obj[i].track_id);
         draw_dbgstr_ex (buf, x1, y1, 1.0f, col_white, col);
     }
 }
 
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+/* the region which has changed since the last detection */
+static void
+render_motion_region (int ofstx, int ofsty, int texw, int texh)
+{
+    float col_red[] = {1.0f, 0.0f, 0.0f, 1.0f};
+    float x1, y1, x2, y2;
+
+    if (get_capture_motion_region (&x1, &y1, &x2, &y2) <= 0)
+        return;
+
+    draw_2d_rect (x1 * texw + ofstx, y1 * texh + ofsty,
+                  (x2 - x1) * texw, (y2 - y1) * texh, col_red, 1.0f);
+}
+#endif
+
+
+/* -------------------------------------------------- *
+ *  detection <==> tracker
+ * -------------------------------------------------- */
+static void
+update_tracker (tracker_t *tracker, detect_result_t *detection)
+{
+    static tracker_box_t s_boxes[MAX_DETECT_OBJS];
+
+    for (int i = 0; i < detection->num; i ++)
+    {
+        detect_obj_t *obj = &detection->obj[i];
+        s_boxes[i].x1    = obj->x1;
+        s_boxes[i].y1    = obj->y1;
+        s_boxes[i].x2    = obj->x2;
+        s_boxes[i].y2    = obj->y2;
+        s_boxes[i].score = obj->score;
+        s_boxes[i].cls   = obj->det_class;
+    }
+
+    tracker_update (tracker, s_boxes, detection->num);
+
+    for (int i = 0; i < detection->num; i ++)
+        detection->obj[i].track_id = s_boxes[i].track_id;
+}
+
+static void
+get_tracked_objects (tracker_t *tracker, detect_result_t *tracked)
+{
+    static tracker_box_t s_boxes[MAX_DETECT_OBJS];
+
+    int num = tracker_get_boxes (tracker, s_boxes, MAX_DETECT_OBJS);
+
+    tracked->num = num;
+    for (int i = 0; i < num; i ++)
+    {
+        detect_obj_t *obj = &tracked->obj[i];
+        obj->x1        = s_boxes[i].x1;
+        obj->y1        = s_boxes[i].y1;
+        obj->x2        = s_boxes[i].x2;
+        obj->y2        = s_boxes[i].y2;
+        obj->score     = s_boxes[i].score;
+        obj->det_class = s_boxes[i].cls;
+        obj->track_id  = s_boxes[i].track_id;
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  latency-budget governor (-b option)
+ *  the knobs are degraded in this order, and restored in reverse.
+ * -------------------------------------------------- */
+typedef struct _interval_knob_t
+{
+    int         *detect_interval;
+    int         base_interval;
+    tracker_t   *tracker;
+} interval_knob_t;
+
+static const int s_knob_threads[] = {4, 2, 1};
+
+static int
+apply_detect_interval (int level, void *usrdata)
+{
+    interval_knob_t *knob = (interval_knob_t *)usrdata;
+
+    *knob->detect_interval = knob->base_interval << level;     /* x1, x2, x4, x8 */
+    knob->tracker->config.max_age = 2 * (*knob->detect_interval);
+    return 0;
+}
+
+/* the interpreter can be changed only while the worker is idle */
+static int
+apply_num_threads (int level, void *usrdata)
+{
+    UNUSED (usrdata);
+    if (async_infer_is_busy (&s_detect_runner))
+        return -1;
+
+    return set_detect_num_threads (s_knob_threads[level]);
+}
+
+/* the model is loaded on the background, and swapped in by the render loop */
+static int
+apply_quantized_model (int level, void *usrdata)
+{
+    const char *model = get_detect_model_path (level);
+    UNUSED (usrdata);
+
+    if (strcmp (get_tflite_detection_model (), model) == 0)
+        return 0;
+
+    request_tflite_detection_model (model);
+    return -1;
+}
+
+static void
+init_governor (governor_t *gov, double budget_ms, int use_quantized_tflite, interval_knob_t *interval_knob)
+{
+    governor_init (gov, budget_ms);
+    governor_add_stage (gov, "feed");
+    governor_add_stage (gov, "detect");
+    governor_add_stage (gov, "render");
+
+    governor_add_knob (gov, "detect_interval", 0, 0, 3, apply_detect_interval, interval_knob);
+    governor_add_knob (gov, "threads", 0, 0, 2, apply_num_threads, NULL);
+
+    /* from the float model to the quantized model */
+    if (!use_quantized_tflite)
+        governor_add_knob (gov, "quantized", 0, 0, 1, apply_quantized_model, NULL);
+}
+
+
+/*
+ *  model update (-u option).
+ *  when the model file has been rewritten (and stays unchanged for a
+ *  second), the new one is hot-swapped in without restarting the app.
+ */
+static void
+check_model_update (double now_ms)
+{
+    static time_t s_mtime, s_new_mtime;
+    static double s_last_check, s_changed_ms;
+    const char *model = get_tflite_detection_model ();
+    struct stat st;
+
+    if (now_ms - s_last_check < 1000.0)
+        return;
+    s_last_check = now_ms;
+
+    if (stat (model, &st) != 0)
+        return;
+
+    if (s_mtime == 0)
+        s_mtime = s_new_mtime = st.st_mtime;
+
+    if (st.st_mtime != s_new_mtime)
+    {
+        s_new_mtime  = st.st_mtime;     /* still being written ? */
+        s_changed_ms = now_ms;
+        return;
+    }
+
+    if (s_new_mtime != s_mtime && now_ms - s_changed_ms >= 1000.0 &&
+        request_tflite_detection_model (model) == 0)
+    {
+        fprintf (stderr, "model updated: %s\n", model);
+        s_mtime = s_new_mtime;
+    }
+}
+
+
+/*
+ *  motion gating (-m option).
+ *  return 1 if the scene has changed enough to run the inference.
+ */
+static int
+check_motion (int enable_motion, float *score)
+{
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    if (enable_motion)
+        return check_capture_motion (score);
+#endif
+    *score = 1.0f;
+    return 1;
+}
+
 
 /* Adjust the texture size to fit the window size
  *
@@ -192,9 +436,29 @@ main(int argc, char *argv[])
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    int enable_motion = 0;
+    int enable_model_update = 0;
+    float motion_thresh = 0.002f, motion_score = 1.0f;
+    int motion_max_skip = 30;
+    double budget_ms = 0;
+    governor_t governor;
+    interval_knob_t interval_knob;
+    frame_seq_t fseq;
+    int detect_interval = 1;
+    int last_submit = -1;
+    int result_frame = -1;
+    static tracker_t tracker;
+    uint32_t predict_seq;
+    static detect_result_t detection;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int enable_async = 0;   /* the GPU delegate must be invoked on the GL thread */
+#else
+    int enable_async = 1;
+#endif
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -203,21 +467,42 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "b:i:m:qsuv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'b':
+                budget_ms = atof (optarg);
+                break;
+            case 'i':
+                detect_interval = atoi (optarg);
+                if (detect_interval < 1)
+                    detect_interval = 1;
+                break;
+            case 'm':
+                sscanf (optarg, "%f,%d", &motion_thresh, &motion_max_skip);
+                enable_motion = 1;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 's':
+                enable_async = 0;
+                break;
+            case 'u':
+                enable_model_update = 1;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -242,6 +527,21 @@ main(int argc, char *argv[])
 
     init_tflite_detection (use_quantized_tflite);
 
+    {
+        tracker_config_t config;
+        config.iou_thresh = 0.3f;
+        config.max_age    = 2 * detect_interval;  /* survive one missed detection */
+        config.min_hits   = 1;
+        tracker_init (&tracker, &config);
+    }
+
+    interval_knob.detect_interval = &detect_interval;
+    interval_knob.base_interval   = detect_interval;
+    interval_knob.tracker         = &tracker;
+    if (budget_ms > 0)
+        init_governor (&governor, budget_ms, use_quantized_tflite, &interval_knob);
+    init_detect_runner (enable_async);
+
 #if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
     /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
     glBindFramebuffer (GL_FRAMEBUFFER, 0);
@@ -261,8 +561,11 @@ main(int argc, char *argv[])
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
     /* initialize V4L2 capture function */
-    if (enable_camera && init_capture (0) == 0)
+    if (enable_camera && init_capture (enable_motion ? CAPTURE_MOTION_DETECT : 0) == 0)
     {
+        if (set_capture_motion_config (24, motion_thresh, motion_max_skip) < 0)
+            enable_motion = 0;
+
         create_capture_texture (&captex);
         texw = captex.width;
         texh = captex.height;
@@ -276,20 +579,26 @@ main(int argc, char *argv[])
         captex.height = texh;
         captex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
         enable_camera = 0;
+        enable_motion = 0;
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+    predict_seq = captex.frame_seq;
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        detect_result_t detection;
+        detect_result_t tracked;
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -302,44 +611,118 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  object detection
+         *  (every N frames. the tracks are predicted on the new frames in between.)
+         *  the detector runs on the worker thread, and a new frame is
+         *  fed only when it is idle, so the render loop never waits.
+         *  (a frame which has already been detected is not fed again,
+         *   nor a frame with little motion if the motion gating is enabled)
          * --------------------------------------- */
-        feed_detect_image (&captex, win_w, win_h);
+        int changed = 0;
+
+        /* the tracks move (and age) by input frames, not by loops.
+         * a still image never ages them out. */
+        if (captex.frame_seq != predict_seq)
+        {
+            tracker_predict (&tracker);
+            predict_seq = captex.frame_seq;
+        }
+
+        /* swap in a new model between the inferences */
+        if (enable_model_update)
+            check_model_update (ttime[1]);
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_detect (&detection);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms = ttime[3] - ttime[2];
+        if (!async_infer_is_busy (&s_detect_runner) && swap_tflite_detection_model () > 0)
+            fprintf (stderr, "model swapped: %s\n", get_tflite_detection_model ());
+
+        if ((last_submit < 0 || count - last_submit >= detect_interval) &&
+            !async_infer_is_busy (&s_detect_runner) &&
+            frame_seq_is_new (&fseq, captex.frame_seq) &&
+            check_motion (enable_motion, &motion_score))
+        {
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("feed_detect_image");
+            feed_detect_image (&captex, win_w, win_h, async_infer_get_input_buf (&s_detect_runner));
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            async_infer_submit (&s_detect_runner, count);
+            last_submit = count;
+
+            if (budget_ms > 0)
+                governor_set_latency (&governor, 0, ttime[3] - ttime[2]);
+        }
+
+        if (async_infer_get_result (&s_detect_runner, &detection, &result_frame, &invoke_ms) > 0)
+        {
+            update_tracker (&tracker, &detection);
+            changed = 1;
+
+            if (budget_ms > 0)
+                governor_set_latency (&governor, 1, invoke_ms);
+        }
+
+        get_tracked_objects (&tracker, &tracked);
+
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, changed))
+            continue;
 
         /* --------------------------------------- *
          *  render scene
          * --------------------------------------- */
+        ttime[4] = pmeter_get_time_ms ();
         glClear (GL_COLOR_BUFFER_BIT);
 
         /* visualize the object detection results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
-        render_detect_region (draw_x, draw_y, draw_w, draw_h, &detection);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
+        render_detect_region (draw_x, draw_y, draw_w, draw_h, &tracked);
+        PMETER_SCOPE_END ();
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+        if (enable_motion)
+        {
+            PMETER_SCOPE_BEGIN ("render_motion_region");
+            render_motion_region (draw_x, draw_y, draw_w, draw_h);
+            PMETER_SCOPE_END ();
+        }
+#endif
 
         /* --------------------------------------- *
          *  post process
          * --------------------------------------- */
         draw_pmeter (0, 40);
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]", interval, invoke_ms);
+        int len = sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]\nFrameLag:%3d\nMotion  :%5.3f\n",
+                           interval, invoke_ms, (result_frame >= 0) ? count - result_frame : 0, motion_score);
+        if (budget_ms > 0)
+            governor_format_stats (&governor, strbuf + len, sizeof (strbuf) - len);
         draw_dbgstr (strbuf, 10, 10);
 
+        /* adapt the knobs to the latency budget */
+        if (budget_ms > 0)
+        {
+            ttime[5] = pmeter_get_time_ms ();
+            governor_set_latency (&governor, 2, ttime[5] - ttime[4]);
+            governor_update (&governor);
+        }
+
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
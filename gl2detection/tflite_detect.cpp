@@ -3,6 +3,9 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_tflite_loader.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "util_debug.h"
 #include "tflite_detect.h"
 #include "detect_postprocess.h"
@@ -36,6 +39,9 @@
 
 
 static tflite_interpreter_t s_interpreter;
+static tflite_swap_t        s_swap;
+static std::string          s_model_path;
+static int                  s_num_threads;
 static tflite_tensor_t  s_tensor_input;
 
 #if defined (INVOKE_POSTPROCESS_AFTER_TFLITE)
@@ -43,6 +49,7 @@ static tflite_tensor_t  s_tensor_boxes;
 static tflite_tensor_t  s_tensor_scores;
 static float            *s_boxes_buf;
 static float            *s_scores_buf;
+static frame_arena_t    s_frame_arena;      /* scratch of the post-process */
 #else
 static tflite_tensor_t  s_tensor_boxes;
 static tflite_tensor_t  s_tensor_scores;
@@ -163,21 +170,23 @@ init_class_color ()
 }
 
 
-int
-init_tflite_detection(int use_quantized_tflite)
+const char *
+get_detect_model_path (int use_quantized_tflite)
 {
-    const char *model;
-
     if (use_quantized_tflite)
-    {
-        model = DETECT_QUANT_MODEL_PATH;
-    }
+        return DETECT_QUANT_MODEL_PATH;
     else
-    {
-        model = DETECT_MODEL_PATH;
-    }
+        return DETECT_MODEL_PATH;
+}
+
+int
+init_tflite_detection(int use_quantized_tflite)
+{
+    const char *model = get_detect_model_path (use_quantized_tflite);
 
     tflite_create_interpreter_from_file (&s_interpreter, model);
+    tflite_swap_init (&s_swap);
+    s_model_path = model;
 
     /* get input tensor */
     tflite_get_tensor_by_name (&s_interpreter, 0, "normalized_input_image_tensor",  &s_tensor_input);
@@ -198,6 +207,7 @@ init_tflite_detection(int use_quantized_tflite)
     }
 
     init_detect_postprocess (ANCHORS_FILE);
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
 #else
     /* get output tensor */
     tflite_get_tensor_by_name (&s_interpreter, 1, "TFLite_Detection_PostProcess",   &s_tensor_boxes);
@@ -212,6 +222,68 @@ init_tflite_detection(int use_quantized_tflite)
     return 0;
 }
 
+/*
+ *  hot swap of the model (the float/quantized model, or an updated file).
+ *  the replacement is loaded and warmed up on a background thread, while
+ *  the current model keeps running. the label map and the colors are kept.
+ *
+ *  return -1 if another model is being loaded.
+ */
+int
+request_tflite_detection_model (const char *model_path)
+{
+#if defined (INVOKE_POSTPROCESS_AFTER_TFLITE)
+    /* the postprocess buffers are sized for the initial model */
+    return -1;
+#else
+    return tflite_swap_load (&s_swap, model_path);
+#endif
+}
+
+/*
+ *  swap in the requested model if it is ready.
+ *  must not be called while the interpreter is invoked.
+ *  return 1 if swapped, 0 if nothing to swap, -1 if the load has failed.
+ */
+int
+swap_tflite_detection_model ()
+{
+#if defined (INVOKE_POSTPROCESS_AFTER_TFLITE)
+    return 0;
+#else
+    int ret = tflite_swap_commit (&s_swap, &s_interpreter);
+    if (ret <= 0)
+        return ret;
+
+    s_model_path = s_swap.model_path;
+
+    if (s_num_threads > 0)
+        tflite_set_num_threads (&s_interpreter, s_num_threads);
+
+    tflite_get_tensor_by_name (&s_interpreter, 0, "normalized_input_image_tensor",  &s_tensor_input);
+    tflite_get_tensor_by_name (&s_interpreter, 1, "TFLite_Detection_PostProcess",   &s_tensor_boxes);
+    tflite_get_tensor_by_name (&s_interpreter, 1, "TFLite_Detection_PostProcess:1", &s_tensor_classes);
+    tflite_get_tensor_by_name (&s_interpreter, 1, "TFLite_Detection_PostProcess:2", &s_tensor_scores);
+    tflite_get_tensor_by_name (&s_interpreter, 1, "TFLite_Detection_PostProcess:3", &s_tensor_num);
+
+    return 1;
+#endif
+}
+
+/* the model which is running now */
+const char *
+get_tflite_detection_model ()
+{
+    return s_model_path.c_str ();
+}
+
+int
+set_detect_num_threads (int num_threads)
+{
+    s_num_threads = num_threads;
+    return tflite_set_num_threads (&s_interpreter, num_threads);
+}
+
 int
 get_detect_input_type ()
 {
@@ -252,7 +324,10 @@ invoke_detect (detect_result_t *detection)
     }
 
 #if defined (INVOKE_POSTPROCESS_AFTER_TFLITE)
-    std::vector<DetectionBox> detection_boxes = {};
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_vector<DetectionBox> detection_boxes = {};
     float *scores = (float *)s_tensor_scores.ptr;
     float *boxes  = (float *)s_tensor_boxes.ptr;
 
@@ -289,6 +364,9 @@ invoke_detect (detect_result_t *detection)
         detection->obj[i].score     = detection_boxes[i].score;
         detection->obj[i].det_class = detection_boxes[i].class_id;
     }
+
+    ALLOC_CHECK_END ("invoke_detect");
+    frame_arena_end ();
 #else
     float *boxes   = (float *)s_tensor_boxes.ptr;
     float *classes = (float *)s_tensor_classes.ptr;
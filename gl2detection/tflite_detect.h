@@ -17,6 +17,7 @@ typedef struct _detect_obj_t
     float x1, x2, y1, y2;
     float score;
     int det_class;
+    int track_id;
 } detect_obj_t;
 
 typedef struct _detect_result_t
@@ -28,6 +29,11 @@ typedef struct _detect_result_t
 
 
 int   init_tflite_detection (int use_quantized_tflite);
+const char *get_detect_model_path (int use_quantized_tflite);
+int   request_tflite_detection_model (const char *model_path);
+int   swap_tflite_detection_model ();
+const char *get_tflite_detection_model ();
+int   set_detect_num_threads (int num_threads);
 int   get_detect_input_type ();
 void  *get_detect_input_buf (int *w, int *h);
 char  *get_detect_class_name (int class_idx);
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
@@ -12,10 +13,12 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_face_portrait.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -35,7 +38,10 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_face_detect_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -73,7 +79,10 @@ feed_portrait_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_resu
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_portrait_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -361,6 +370,10 @@ main(int argc, char *argv[])
     double ttime[10] = {0}, interval, invoke_ms0 = 0, invoke_ms1 = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    face_detect_result_t face_detect_ret = {0};
+    portrait_result_t   portrait_result[MAX_FACE_NUM] = {0};
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -369,7 +382,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "qv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -384,6 +397,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -446,17 +462,19 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        face_detect_result_t face_detect_ret = {0};
-        portrait_result_t   portrait_result[MAX_FACE_NUM] = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -470,46 +488,65 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
-         *  face detection
+         *  face detection -> face portrait
+         *  (the last result is reused while the frame is unchanged)
          * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
-
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_face_detect (&face_detect_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
-
-        /* --------------------------------------- *
-         *  face portrait
-         * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
         {
-            feed_portrait_image (&captex, win_w, win_h, &face_detect_ret, face_id);
-
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_portrait (&portrait_result[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            PMETER_SCOPE_BEGIN ("feed_face_detect_image");
+            feed_face_detect_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
+            memset (&face_detect_ret, 0, sizeof (face_detect_ret));
+
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_face_detect");
+            invoke_face_detect (&face_detect_ret);
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            invoke_ms0 = ttime[3] - ttime[2];
+
+            invoke_ms1 = 0;
+            for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+            {
+                PMETER_SCOPE_BEGIN ("feed_portrait_image");
+                feed_portrait_image (&captex, win_w, win_h, &face_detect_ret, face_id);
+                PMETER_SCOPE_END ();
+
+                ttime[4] = pmeter_get_time_ms ();
+                PMETER_SCOPE_BEGIN ("invoke_portrait");
+                invoke_portrait (&portrait_result[face_id]);
+                PMETER_SCOPE_END ();
+                ttime[5] = pmeter_get_time_ms ();
+                invoke_ms1 += ttime[5] - ttime[4];
+            }
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
+
         /* --------------------------------------- *
          *  render scene (left half)
          * --------------------------------------- */
         glClear (GL_COLOR_BUFFER_BIT);
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
         render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_detect_ret);
+        PMETER_SCOPE_END ();
 
         /* visualize the segmentation results. */
         /* draw cropped image of the face area */
@@ -521,7 +558,9 @@ main(int argc, char *argv[])
             float y = h * face_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
+            PMETER_SCOPE_BEGIN ("render_cropped_face_image");
             render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -533,7 +572,9 @@ main(int argc, char *argv[])
 
         for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
         {
+            PMETER_SCOPE_BEGIN ("render_animface_image");
             render_animface_image (&captex, draw_x, draw_y, draw_w, draw_h, &face_detect_ret, face_id, &portrait_result[face_id]);
+            PMETER_SCOPE_END ();
         }
 
         /* --------------------------------------- *
@@ -546,7 +587,9 @@ main(int argc, char *argv[])
             interval, invoke_ms0, invoke_ms1);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
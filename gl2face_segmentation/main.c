@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
@@ -11,10 +12,13 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_segmap.h"
 #include "util_matrix.h"
 #include "tflite_face_segmentation.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -34,7 +38,10 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_face_detect_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -72,7 +79,10 @@ feed_bisenetv2_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_res
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_bisenetv2_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -206,8 +216,9 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     int64_t *segmap = bisenetv2_ret->segmentmap;
     int segmap_w  = bisenetv2_ret->segmentmap_dims[0];
     int segmap_h  = bisenetv2_ret->segmentmap_dims[1];
-    int x, y;
-    unsigned int imgbuf[segmap_h][segmap_w];
+    static uint8_t      *s_labels = NULL;
+    static texture_2d_t s_labeltex = {0};
+    static texture_2d_t s_palettetex = {0};
 
 #if 1
     unsigned char alpha = 200;
@@ -258,24 +269,19 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
         0,   192, 0,   0,      /* [18] hat */
     };
 #endif
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
+    if (s_labels == NULL)
     {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            int64_t val = segmap[y * segmap_w + x];
-            if (val > 18)
-                val = 0;
-            
-            unsigned char r = color[4 * val + 0];
-            unsigned char g = color[4 * val + 1];
-            unsigned char b = color[4 * val + 2];
-            unsigned char a = color[4 * val + 3];
-
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
+        create_2d_palette_texture (&s_palettetex, color, 19);
+
+        s_labels = (uint8_t *)malloc (segmap_w * segmap_h);
+        mem_register_buffer ("labels", s_labels, segmap_w * segmap_h);
+        create_2d_label_texture (&s_labeltex, NULL, segmap_w, segmap_h);
     }
 
+    /* the model outputs class id per pixel. narrow it to uint8. */
+    segmap_label_to_u8 (segmap, segmap_w, segmap_h, 19, s_labels);
+    update_2d_label_texture (&s_labeltex, s_labels);
+
     face_t *face = &(detection->faces[face_id]);
     float cx     = face->face_cx * texw; //    0--------1
     float cy     = face->face_cy * texh; //    |        |
@@ -285,11 +291,8 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     float by     = cy - face_h * 0.5f;
     float rot    = RAD_TO_DEG (face->rotation);
 
-    texture_2d_t animtex;
-    create_2d_texture_ex (&animtex, imgbuf, segmap_w, segmap_h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
-    draw_2d_texture_ex_texcoord_rot (&animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
-
-    glDeleteTextures (1, &animtex.texid);
+    draw_2d_labelmap_rot (s_labeltex.texid, s_palettetex.texid, ofstx + bx, ofsty + by, face_w, face_h,
+                          1.0f, 0.5, 0.5, rot);
 }
 
 /* Adjust the texture size to fit the window size
@@ -353,6 +356,10 @@ main(int argc, char *argv[])
     double ttime[10] = {0}, interval, invoke_ms0 = 0, invoke_ms1 = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    face_detect_result_t face_detect_ret = {0};
+    bisenetv2_result_t   bisenetv2_result[MAX_FACE_NUM] = {0};
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -361,7 +368,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "qv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -376,6 +383,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -438,17 +448,19 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        face_detect_result_t face_detect_ret = {0};
-        bisenetv2_result_t   bisenetv2_result[MAX_FACE_NUM] = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -462,46 +474,65 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
-         *  face detection
-         * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
-
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_face_detect (&face_detect_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
-
-        /* --------------------------------------- *
-         *  Bisenetv2
+         *  face detection -> Bisenetv2
+         *  (the last result is reused while the frame is unchanged)
          * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
         {
-            feed_bisenetv2_image (&captex, win_w, win_h, &face_detect_ret, face_id);
-
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_bisenetv2 (&bisenetv2_result[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            PMETER_SCOPE_BEGIN ("feed_face_detect_image");
+            feed_face_detect_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
+            memset (&face_detect_ret, 0, sizeof (face_detect_ret));
+
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_face_detect");
+            invoke_face_detect (&face_detect_ret);
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            invoke_ms0 = ttime[3] - ttime[2];
+
+            invoke_ms1 = 0;
+            for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+            {
+                PMETER_SCOPE_BEGIN ("feed_bisenetv2_image");
+                feed_bisenetv2_image (&captex, win_w, win_h, &face_detect_ret, face_id);
+                PMETER_SCOPE_END ();
+
+                ttime[4] = pmeter_get_time_ms ();
+                PMETER_SCOPE_BEGIN ("invoke_bisenetv2");
+                invoke_bisenetv2 (&bisenetv2_result[face_id]);
+                PMETER_SCOPE_END ();
+                ttime[5] = pmeter_get_time_ms ();
+                invoke_ms1 += ttime[5] - ttime[4];
+            }
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
+
         /* --------------------------------------- *
          *  render scene (left half)
          * --------------------------------------- */
         glClear (GL_COLOR_BUFFER_BIT);
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
         render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_detect_ret);
+        PMETER_SCOPE_END ();
 
         /* visualize the segmentation results. */
         /* draw cropped image of the face area */
@@ -513,7 +544,9 @@ main(int argc, char *argv[])
             float y = h * face_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
+            PMETER_SCOPE_BEGIN ("render_cropped_face_image");
             render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -525,7 +558,9 @@ main(int argc, char *argv[])
 
         for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
         {
+            PMETER_SCOPE_BEGIN ("render_animface_image");
             render_animface_image (&captex, draw_x, draw_y, draw_w, draw_h, &face_detect_ret, face_id, &bisenetv2_result[face_id]);
+            PMETER_SCOPE_END ();
         }
 
         /* --------------------------------------- *
@@ -538,7 +573,9 @@ main(int argc, char *argv[])
             interval, invoke_ms0, invoke_ms1);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
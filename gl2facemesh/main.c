@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -12,11 +13,15 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_facemesh.h"
 #include "render_facemesh.h"
+#include "util_async_infer.h"
+#include "util_frame_seq.h"
+#include "util_extrapolate.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 #include "render_imgui.h"
@@ -42,21 +47,55 @@ static maskimage_t s_maskimages[] =
 
 static int s_num_maskimages = sizeof (s_maskimages) / sizeof (maskimage_t);
 
+/*
+ *  a request to the inference worker is either a face detection or
+ *  the face landmarks of the tracked ROIs:
+ *      [facemesh_request_t][detect image] or
+ *      [facemesh_request_t][landmark image of face 0][face 1]...
+ */
+enum {
+    FACEMESH_REQ_DETECT = 0,
+    FACEMESH_REQ_LANDMARK,
+};
+
+typedef struct _facemesh_request_t
+{
+    int                     kind;
+    face_detect_result_t    roi;        /* ROIs the landmark images are cropped with */
+} facemesh_request_t;
+
+typedef struct _facemesh_output_t
+{
+    int                     kind;
+    face_detect_result_t    roi;        /* detected faces, or the ROIs of the request */
+    face_landmark_result_t  mesh[MAX_FACE_NUM];
+    double                  invoke_ms;
+} facemesh_output_t;
+
+static async_infer_t s_facemesh_runner;
+static int s_detect_input_size;
+static int s_landmark_input_size;
 
 
 
 
 /* resize image to DNN network input size and convert to fp32. */
 void
-feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
+feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h, void *dstbuf)
 {
     int x, y, w, h;
     float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
     unsigned char *buf_ui8 = NULL;
     static unsigned char *pui8 = NULL;
 
+    if (dstbuf)
+        buf_fp32 = (float *)dstbuf;
+
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_face_detect_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -86,15 +125,22 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 }
 
 void
-feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
+feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id,
+                         void *dstbuf)
 {
     int x, y, w, h;
     float *buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
     unsigned char *buf_ui8 = NULL;
     static unsigned char *pui8 = NULL;
 
+    if (dstbuf)
+        buf_fp32 = (float *)dstbuf;
+
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_face_landmark_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -167,7 +213,7 @@ render_detect_region (int ofstx, int ofsty, int texw, int texh,
 
         /* detect score */
         char buf[512];
-        sprintf (buf, "%d", (int)(score * 100));
+        sprintf (buf, "%d (id:%d)", (int)(score * 100), face->track_id);
         draw_dbgstr_ex (buf, x1, y1, 1.0f, col_white, col_red);
 #if 0
         /* key points */
@@ -309,6 +355,93 @@ render_cropped_face_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw,
 }
 
 
+/* -------------------------------------------------- *
+ *  keypoint extrapolation (-p option)
+ *  the mesh (in the ROI space) and the ROI are extrapolated
+ *  together per face track. the rotation of the ROI is kept.
+ * -------------------------------------------------- */
+#define FACE_EXTRAP_NUM     (FACE_KEY_NUM * 3 + 4 + 4 * 2 + 2 * 2)
+
+typedef struct _face_extrap_t
+{
+    int             track_id;
+    extrap_track_t  track;
+} face_extrap_t;
+
+static void
+pack_face_keypoints (float *val, face_t *face, face_landmark_result_t *mesh)
+{
+    memcpy (val, mesh->joint, FACE_KEY_NUM * sizeof (fvec3));
+    val += FACE_KEY_NUM * 3;
+
+    val[0] = face->face_cx;
+    val[1] = face->face_cy;
+    val[2] = face->face_w;
+    val[3] = face->face_h;
+    memcpy (&val[4],  face->face_pos, 4 * sizeof (fvec2));
+    memcpy (&val[12], &face->topleft,  sizeof (fvec2));
+    memcpy (&val[14], &face->btmright, sizeof (fvec2));
+}
+
+static void
+unpack_face_keypoints (float *val, face_t *face, face_landmark_result_t *mesh)
+{
+    memcpy (mesh->joint, val, FACE_KEY_NUM * sizeof (fvec3));
+    val += FACE_KEY_NUM * 3;
+
+    face->face_cx = val[0];
+    face->face_cy = val[1];
+    face->face_w  = val[2];
+    face->face_h  = val[3];
+    memcpy (face->face_pos, &val[4],  4 * sizeof (fvec2));
+    memcpy (&face->topleft,  &val[12], sizeof (fvec2));
+    memcpy (&face->btmright, &val[14], sizeof (fvec2));
+}
+
+static void
+update_face_extrap (face_extrap_t *extrap, facemesh_output_t *ret, double time_ms)
+{
+    static float s_val[FACE_EXTRAP_NUM];
+
+    for (int face_id = 0; face_id < MAX_FACE_NUM; face_id ++)
+    {
+        if (face_id >= ret->roi.num)
+        {
+            extrap_reset (&extrap[face_id].track);
+            continue;
+        }
+
+        /* another face has come to this slot */
+        face_t *face = &ret->roi.faces[face_id];
+        if (extrap[face_id].track_id != face->track_id)
+        {
+            extrap_reset (&extrap[face_id].track);
+            extrap[face_id].track_id = face->track_id;
+        }
+
+        pack_face_keypoints (s_val, face, &ret->mesh[face_id]);
+        extrap_update (&extrap[face_id].track, s_val, FACE_EXTRAP_NUM, time_ms);
+    }
+}
+
+static void
+predict_face_extrap (face_extrap_t *extrap, facemesh_output_t *dst, facemesh_output_t *src, double time_ms)
+{
+    static float s_val[FACE_EXTRAP_NUM];
+
+    *dst = *src;
+    for (int face_id = 0; face_id < src->roi.num; face_id ++)
+    {
+        if (extrap[face_id].track.valid == 0 ||
+            extrap[face_id].track_id != src->roi.faces[face_id].track_id)
+            continue;
+
+        extrap_predict (&extrap[face_id].track, time_ms, s_val);
+        unpack_face_keypoints (s_val, &dst->roi.faces[face_id], &dst->mesh[face_id]);
+    }
+}
+
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -397,6 +530,62 @@ setup_imgui (int win_w, int win_h)
 }
 
 
+/* -------------------------------------------------- *
+ *  inference on the worker thread (util_async_infer)
+ * -------------------------------------------------- */
+static int
+run_facemesh (void *input, void *output, void *usrdata)
+{
+    facemesh_request_t *req = (facemesh_request_t *)input;
+    facemesh_output_t  *out = (facemesh_output_t *)output;
+    char *img = (char *)(req + 1);
+    int w, h, ret;
+
+    out->kind = req->kind;
+
+    if (req->kind == FACEMESH_REQ_DETECT)
+    {
+        memcpy (get_face_detect_input_buf (&w, &h), img, s_detect_input_size);
+        PMETER_SCOPE_BEGIN ("invoke_face_detect");
+        ret = invoke_face_detect (&out->roi);
+        PMETER_SCOPE_END ();
+        return ret;
+    }
+
+    out->roi = req->roi;
+    for (int face_id = 0; face_id < req->roi.num; face_id ++)
+    {
+        memcpy (get_facemesh_landmark_input_buf (&w, &h), img + face_id * s_landmark_input_size,
+                s_landmark_input_size);
+        PMETER_SCOPE_BEGIN ("invoke_facemesh_landmark");
+        invoke_facemesh_landmark (&out->mesh[face_id]);
+        PMETER_SCOPE_END ();
+    }
+
+    return 0;
+}
+
+static int
+init_facemesh_runner (int enable_async)
+{
+    int w, h, img_size;
+    int flags = enable_async ? 0 : ASYNC_INFER_SYNC;
+
+    get_face_detect_input_buf (&w, &h);
+    s_detect_input_size = w * h * 3 * sizeof (float);
+
+    get_facemesh_landmark_input_buf (&w, &h);
+    s_landmark_input_size = w * h * 3 * sizeof (float);
+
+    img_size = s_landmark_input_size * MAX_FACE_NUM;
+    if (img_size < s_detect_input_size)
+        img_size = s_detect_input_size;
+
+    return async_infer_init (&s_facemesh_runner, sizeof (facemesh_request_t) + img_size,
+                             sizeof (facemesh_output_t), run_facemesh, NULL, flags);
+}
+
+
 /*--------------------------------------------------------------------------- *
  *      M A I N    F U N C T I O N
  *--------------------------------------------------------------------------- */
@@ -414,13 +603,29 @@ main(int argc, char *argv[])
     int use_quantized_tflite = 0;
     int enable_video = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    int detect_interval = 30;
+    int last_detect = 0;
+    int num_lost = 0;
+    int need_landmark = 0;
+    int result_frame = -1;
+    face_detect_result_t track_ret = {0};
+    static facemesh_output_t new_ret, draw_ret, pred_ret;
+    static face_extrap_t face_extrap[MAX_FACE_NUM];
+    int enable_extrap = 0;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int enable_async = 0;   /* the GPU delegate must be invoked on the GL thread */
+#else
+    int enable_async = 1;
+#endif
     int mask_eye_hole = 0;
     UNUSED (argc);
     UNUSED (*argv);
 
     {
         int c;
-        const char *optstring = "eqv:x";
+        const char *optstring = "ei:pqsv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -429,15 +634,27 @@ main(int argc, char *argv[])
             case 'e':
                 mask_eye_hole = 1;
                 break;
+            case 'i':
+                detect_interval = atoi (optarg);
+                break;
+            case 'p':
+                enable_extrap = 1;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 's':
+                enable_async = 0;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -505,6 +722,7 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
     glClear (GL_COLOR_BUFFER_BIT);
     glViewport (0, 0, win_w, win_h);
 
@@ -536,13 +754,21 @@ main(int argc, char *argv[])
             masktex.height = th;
             masktex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
 
-            feed_face_detect_image (&masktex, win_w, win_h);
+            PMETER_SCOPE_BEGIN ("feed_face_detect_image");
+            feed_face_detect_image (&masktex, win_w, win_h, NULL);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("invoke_face_detect");
             invoke_face_detect (&face_detect_mask[mask_id]);
+            PMETER_SCOPE_END ();
 
             int face_id = 0;
-            feed_face_landmark_image (&masktex, win_w, win_h, &face_detect_mask[mask_id], face_id);
+            PMETER_SCOPE_BEGIN ("feed_face_landmark_image");
+            feed_face_landmark_image (&masktex, win_w, win_h, &face_detect_mask[mask_id], face_id, NULL);
+            PMETER_SCOPE_END ();
 
+            PMETER_SCOPE_BEGIN ("invoke_facemesh_landmark");
             invoke_facemesh_landmark (&face_mesh_mask[mask_id]);
+            PMETER_SCOPE_END ();
         }
         else
         {
@@ -551,13 +777,17 @@ main(int argc, char *argv[])
     }
 
 
+    init_facemesh_runner (enable_async);
+
+    mem_print_startup_report ();
+
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        face_detect_result_t    face_detect_ret = {0};
-        face_landmark_result_t  face_mesh_ret[MAX_FACE_NUM] = {0};
+        face_detect_result_t    *face_detect_ret = &draw_ret.roi;
+        face_landmark_result_t  *face_mesh_ret   = draw_ret.mesh;
 
         int mask_id = (count / 100) % s_num_maskimages;
         mask_id = s_gui_prop.cur_mask_id;
@@ -568,6 +798,7 @@ main(int argc, char *argv[])
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -581,60 +812,124 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
-         *  face detection
+         *  collect the result of the worker thread.
+         *  a detection result becomes the ROIs of the next request.
+         *  a landmark result is drawn, and its mesh gives the ROIs.
          * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
+        int changed = 0;
+        if (async_infer_get_result (&s_facemesh_runner, &new_ret, &result_frame, NULL) > 0)
+        {
+            changed = 1;
+            if (new_ret.kind == FACEMESH_REQ_DETECT)
+            {
+                assign_face_track_id (&new_ret.roi, &track_ret);
+                track_ret = new_ret.roi;
+                num_lost  = 0;
+                invoke_ms0 = s_facemesh_runner.invoke_ms;
+                need_landmark = (track_ret.num > 0);
+
+                if (track_ret.num == 0)
+                    draw_ret.roi.num = 0;   /* no face in the view any more */
+            }
+            else
+            {
+                draw_ret = new_ret;
+                num_lost = track_face_roi (&track_ret, &draw_ret.roi, draw_ret.mesh, 0.5f);
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_face_detect (&face_detect_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
+                if (enable_extrap)
+                    update_face_extrap (face_extrap, &draw_ret, ttime[1]);
+                invoke_ms1 = s_facemesh_runner.invoke_ms;
+            }
+        }
 
         /* --------------------------------------- *
-         *  face landmark
+         *  next request (only when the worker is idle)
+         *  the face detector runs at intervals or when a face is lost.
+         *  otherwise the face ROIs tracked from the mesh are cropped.
+         *  an unchanged frame is not fed again, except for the landmark
+         *  pass of the faces which have just been detected on it.
          * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        if (!async_infer_is_busy (&s_facemesh_runner) &&
+            (frame_seq_is_new (&fseq, captex.frame_seq) || need_landmark))
         {
-            feed_face_landmark_image (&captex, win_w, win_h, &face_detect_ret, face_id);
+            facemesh_request_t *req = (facemesh_request_t *)async_infer_get_input_buf (&s_facemesh_runner);
+            char *img = (char *)(req + 1);
 
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_facemesh_landmark (&face_mesh_ret[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            if (track_ret.num == 0 || num_lost > 0 || count - last_detect >= detect_interval)
+            {
+                req->kind = FACEMESH_REQ_DETECT;
+                PMETER_SCOPE_BEGIN ("feed_face_detect_image");
+                feed_face_detect_image (&captex, win_w, win_h, img);
+                PMETER_SCOPE_END ();
+                last_detect = count;
+                num_lost    = 0;
+            }
+            else
+            {
+                req->kind = FACEMESH_REQ_LANDMARK;
+                req->roi  = track_ret;
+                for (int face_id = 0; face_id < track_ret.num; face_id ++)
+                {
+                    PMETER_SCOPE_BEGIN ("feed_face_landmark_image");
+                    feed_face_landmark_image (&captex, win_w, win_h, &track_ret, face_id,
+                                              img + face_id * s_landmark_input_size);
+                    PMETER_SCOPE_END ();
+                }
+            }
+            async_infer_submit (&s_facemesh_runner, count);
+            need_landmark = 0;
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, changed))
+            continue;
+
         /* --------------------------------------- *
          *  render scene (left half)
+         *  (the keypoints are extrapolated to the display time with -p)
          * --------------------------------------- */
+        if (enable_extrap)
+        {
+            predict_face_extrap (face_extrap, &pred_ret, &draw_ret, pmeter_get_time_ms ());
+            face_detect_ret = &pred_ret.roi;
+            face_mesh_ret   = pred_ret.mesh;
+        }
+
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         /* visualize the face pose estimation results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
 
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
         {
-            render_face_landmark (draw_x, draw_y, draw_w, draw_h, &face_mesh_ret[face_id], &face_detect_ret.faces[face_id],
+            PMETER_SCOPE_BEGIN ("render_face_landmark");
+            render_face_landmark (draw_x, draw_y, draw_w, draw_h, &face_mesh_ret[face_id], &face_detect_ret->faces[face_id],
                                   cur_texid_mask, cur_face_mesh_mask, &cur_face_detect_mask->faces[0], 0);
+            PMETER_SCOPE_END ();
         }
 
         if (s_gui_prop.draw_detect_rect)
         {
-            render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_detect_ret);
+            PMETER_SCOPE_BEGIN ("render_detect_region");
+            render_detect_region (draw_x, draw_y, draw_w, draw_h, face_detect_ret);
+            PMETER_SCOPE_END ();
             
             /* draw cropped image of the face area */
-            for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+            for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
             {
                 float w = 100;
                 float h = 100;
@@ -642,7 +937,9 @@ main(int argc, char *argv[])
                 float y = h * face_id + 10;
                 float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-                render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+                PMETER_SCOPE_BEGIN ("render_cropped_face_image");
+                render_cropped_face_image (&captex, x, y, w, h, face_detect_ret, face_id);
+                PMETER_SCOPE_END ();
                 draw_2d_rect (x, y, w, h, col_white, 2.0f);
             }
         }
@@ -652,14 +949,18 @@ main(int argc, char *argv[])
          * --------------------------------------- */
         glViewport (win_w, 0, win_w, win_h);
 
+        PMETER_SCOPE_BEGIN ("render_3d_scene");
         render_3d_scene (draw_x, draw_y, draw_w, draw_h);
+        PMETER_SCOPE_END ();
 
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
         {
+            PMETER_SCOPE_BEGIN ("render_face_landmark");
             render_face_landmark (draw_x, draw_y, draw_w, draw_h,
-                                  &face_mesh_ret[face_id], &face_detect_ret.faces[face_id],
+                                  &face_mesh_ret[face_id], &face_detect_ret->faces[face_id],
                                   cur_texid_mask, cur_face_mesh_mask, &cur_face_detect_mask->faces[0],
                                   s_gui_prop.draw_mesh_line);
+            PMETER_SCOPE_END ();
         }
 
         /* current mask image */
@@ -682,14 +983,18 @@ main(int argc, char *argv[])
             draw_pmeter (0, 40);
         }
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]",
-            interval, invoke_ms0, invoke_ms1);
+        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]\nFrameLag:%3d",
+            interval, invoke_ms0, invoke_ms1, (result_frame >= 0) ? count - result_frame : 0);
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&s_gui_prop);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -3,8 +3,11 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_facemesh.h"
 #include <list>
+#include <float.h>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/models/face_detection_front.tflite
@@ -28,6 +31,8 @@ static tflite_tensor_t      s_mesh_tensor_score;
 
 static std::list<fvec2> s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * determine where the anchor points are scatterd.
  *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
@@ -104,6 +109,8 @@ init_tflite_facemesh (int use_quantized_tflite)
     int det_input_h = s_detect_tensor_input.dims[1];
     create_blazeface_anchors (det_input_w, det_input_h);
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -137,7 +144,7 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
@@ -248,7 +255,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -369,7 +376,7 @@ compute_face_rect (face_t &face)
 
 
 static void
-pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_list)
+pack_face_result (face_detect_result_t *facedet_result, arena_list<face_t> &face_list)
 {
     int num_faces = 0;
     for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
@@ -401,9 +408,12 @@ invoke_face_detect (face_detect_result_t *facedet_result)
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = 0.75f;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
@@ -412,7 +422,7 @@ invoke_face_detect (face_detect_result_t *facedet_result)
 
 #if 1 /* USE NMS */
     float iou_thresh = 0.3f;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (facedet_result, face_nms_list);
@@ -420,10 +430,148 @@ invoke_face_detect (face_detect_result_t *facedet_result)
     pack_face_result (facedet_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_face_detect");
+    frame_arena_end ();
+
     return 0;
 }
 
- 
+
+
+/* -------------------------------------------------- *
+ *  Track face ROI from the mesh landmarks
+ *
+ *  the ROI of the next frame is computed from the 468
+ *  landmarks of the current frame, so that the face
+ *  detector is needed only at intervals or on loss.
+ *  (mediapipe/modules/face_landmark/face_landmark_landmarks_to_roi.pbtxt)
+ * -------------------------------------------------- */
+#define FACE_TRACK_IOU_THRESH   0.3f
+
+/* facemesh index for each BlazeFace keypoint */
+static const int s_face_key_joint[kFaceKeyNum] = {
+    33,     /* kRightEye (outer corner) */
+    263,    /* kLeftEye  (outer corner) */
+    1,      /* kNose     */
+    13,     /* kMouth    */
+    234,    /* kRightEar */
+    454,    /* kLeftEar  */
+};
+
+static int s_next_track_id = 0;
+
+/* landmark (normalized to the ROI) ==> image coordinate */
+static fvec2
+landmark_to_image (face_t &roi, fvec3 &joint)
+{
+    fvec2 pos;
+    pos.x = (joint.x - 0.5f) * roi.face_w;
+    pos.y = (joint.y - 0.5f) * roi.face_h;
+
+    rot_vec (pos, roi.rotation);
+    pos.x += roi.face_cx;
+    pos.y += roi.face_cy;
+    return pos;
+}
+
+static void
+compute_face_roi_from_landmark (face_t &face, face_landmark_result_t *facemesh)
+{
+    face_t roi = face;
+    float x_min = FLT_MAX, x_max = -FLT_MAX;
+    float y_min = FLT_MAX, y_max = -FLT_MAX;
+
+    for (int i = 0; i < FACE_KEY_NUM; i ++)
+    {
+        fvec2 p = landmark_to_image (roi, facemesh->joint[i]);
+        x_min = std::min (x_min, p.x);  x_max = std::max (x_max, p.x);
+        y_min = std::min (y_min, p.y);  y_max = std::max (y_max, p.y);
+    }
+
+    for (int i = 0; i < kFaceKeyNum; i ++)
+        face.keys[i] = landmark_to_image (roi, facemesh->joint[s_face_key_joint[i]]);
+
+    face.topleft.x  = x_min;
+    face.topleft.y  = y_min;
+    face.btmright.x = x_max;
+    face.btmright.y = y_max;
+
+    /* rotation from the eye corners, then the same expansion as the detector */
+    compute_rotation (face);
+    compute_face_rect (face);
+}
+
+/*
+ *  inherit the track ID of the previous face which overlaps most,
+ *  otherwise assign a new one.
+ */
+void
+assign_face_track_id (face_detect_result_t *facedet_result, face_detect_result_t *prev_result)
+{
+    int used[MAX_FACE_NUM] = {0};
+
+    for (int i = 0; i < facedet_result->num; i ++)
+    {
+        face_t &face = facedet_result->faces[i];
+        float max_iou = FACE_TRACK_IOU_THRESH;
+        int   max_id  = -1;
+
+        for (int j = 0; j < prev_result->num; j ++)
+        {
+            if (used[j])
+                continue;
+
+            float iou = calc_intersection_over_union (face, prev_result->faces[j]);
+            if (iou >= max_iou)
+            {
+                max_iou = iou;
+                max_id  = j;
+            }
+        }
+
+        if (max_id >= 0)
+        {
+            used[max_id]  = 1;
+            face.track_id = prev_result->faces[max_id].track_id;
+        }
+        else
+        {
+            face.track_id = s_next_track_id ++;
+        }
+    }
+}
+
+/*
+ *  compute the ROIs of the next frame into (track_result).
+ *  returns the number of faces lost in this frame.
+ */
+int
+track_face_roi (face_detect_result_t *track_result, face_detect_result_t *facedet_result,
+                face_landmark_result_t *facemesh_result, float score_thresh)
+{
+    int num_lost = 0;
+
+    track_result->num = 0;
+    for (int i = 0; i < facedet_result->num; i ++)
+    {
+        /* the face flag is a logit */
+        float presence = 1.0f / (1.0f + std::exp (-facemesh_result[i].score));
+        if (presence < score_thresh)
+        {
+            num_lost ++;
+            continue;
+        }
+
+        face_t &face = track_result->faces[track_result->num ++];
+        face = facedet_result->faces[i];
+        face.score = presence;
+        compute_face_roi_from_landmark (face, &facemesh_result[i]);
+    }
+
+    return num_lost;
+}
+
+
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite (Facemesh landmark)
  * -------------------------------------------------- */
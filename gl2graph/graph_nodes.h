@@ -0,0 +1,83 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef GRAPH_NODES_H_
+#define GRAPH_NODES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util_graph.h"
+#include "util_texture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GRAPH_FRAME_SIZE    512
+#define GRAPH_MAX_ROIS      16
+#define GRAPH_MAX_LABEL     64
+
+/* -------------------------------------------------- *
+ *  packet types
+ * -------------------------------------------------- */
+
+/* "image": RGBA, top row first */
+typedef struct _graph_image_t
+{
+    int     w, h;
+    uint8_t rgba[GRAPH_FRAME_SIZE * GRAPH_FRAME_SIZE * 4];
+} graph_image_t;
+
+/* "rois": regions in the image, normalized to [0, 1] */
+typedef struct _graph_roi_t
+{
+    float   x1, y1, x2, y2;                 /* bounding box                          */
+    float   quad[4][2];                     /* (rotated) crop region. 0:TL 1:TR 2:BR 3:BL */
+    float   score;
+    char    label[GRAPH_MAX_LABEL];
+} graph_roi_t;
+
+typedef struct _graph_rois_t
+{
+    int         num;
+    graph_roi_t roi[GRAPH_MAX_ROIS];
+} graph_rois_t;
+
+/* "labels": one label per ROI of the input "rois" */
+typedef struct _graph_label_t
+{
+    char    text[GRAPH_MAX_LABEL];
+    float   score;
+} graph_label_t;
+
+typedef struct _graph_labels_t
+{
+    int             num;
+    graph_label_t   label[GRAPH_MAX_ROIS];
+} graph_labels_t;
+
+
+/* -------------------------------------------------- *
+ *  node registration (one file per wrapped module)
+ * -------------------------------------------------- */
+void register_gl_nodes ();
+void register_face_nodes ();
+void register_ssd_nodes ();
+void register_classify_nodes ();
+
+void graph_nodes_set_source (texture_2d_t *tex, int win_w, int win_h,
+                             int draw_x, int draw_y, int draw_w, int draw_h);
+
+/* the model paths of the wrapped modules are relative to their app directory */
+int  graph_nodes_enter_model_dir (graph_node_t *node, const char *default_dir, char *cwd, size_t size);
+void graph_nodes_leave_model_dir (const char *cwd);
+int  graph_nodes_use_quantized (graph_node_t *node);
+
+void graph_nodes_roi_from_bbox (graph_roi_t *roi, float x1, float y1, float x2, float y2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GRAPH_NODES_H_ */
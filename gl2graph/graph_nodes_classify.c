@@ -0,0 +1,93 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "util_image_crop.h"
+#include "tflite_classification.h"
+#include "graph_nodes.h"
+
+#define UNUSED(x) (void)(x)
+
+/*
+ *  Classify: image, rois -> labels. classifies the bounding box of each ROI.
+ *  wraps gl2classification/tflite_classification.cpp.
+ *  param: model_dir=<dir> (default: ../gl2classification), quant=<0|1>
+ */
+static int
+classify_init (graph_node_t *node)
+{
+    char cwd[PATH_MAX];
+
+    if (graph_nodes_enter_model_dir (node, "../gl2classification", cwd, sizeof (cwd)) < 0)
+        return -1;
+
+    int ret = init_tflite_classification (graph_nodes_use_quantized (node));
+    graph_nodes_leave_model_dir (cwd);
+
+    return (ret < 0) ? -1 : 0;
+}
+
+static int
+classify_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    static classification_result_t s_class_result;
+    graph_image_t  *img    = (graph_image_t *)inputs[0];
+    graph_rois_t   *rois   = (graph_rois_t *)inputs[1];
+    graph_labels_t *labels = (graph_labels_t *)outputs[0];
+    int w, h;
+    UNUSED (node);
+
+    void *buf = get_classification_input_buf (&w, &h);
+    int  is_uint8 = get_classification_input_type ();
+
+    labels->num = 0;
+    for (int i = 0; i < rois->num; i ++)
+    {
+        graph_roi_t   *roi   = &rois->roi[i];
+        graph_label_t *label = &labels->label[labels->num ++];
+        float quad[4][2] = {{roi->x1, roi->y1}, {roi->x2, roi->y1},
+                            {roi->x2, roi->y2}, {roi->x1, roi->y2}};
+
+        /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
+        if (is_uint8)
+            image_crop_rgba_to_uint8 (img->rgba, img->w, img->h, quad, (uint8_t *)buf, w, h);
+        else
+            image_crop_rgba_to_fp32 (img->rgba, img->w, img->h, quad, (float *)buf, w, h, 128.0f, 128.0f);
+
+        if (invoke_classification (&s_class_result) < 0)
+            return -1;
+
+        label->text[0] = '\0';
+        label->score   = 0.0f;
+        if (s_class_result.num > 0)
+        {
+            classify_t *top = &s_class_result.classify[0];
+            /* leave room for the "(%d)" suffix */
+            snprintf (label->text, sizeof (label->text), "%.*s(%d)",
+                      (int)sizeof (label->text) - 16, top->name, (int)(top->score * 100));
+            label->score = top->score;
+        }
+    }
+
+    return 0;
+}
+
+
+static const graph_node_def_t s_classify_def =
+{
+    "Classify", GRAPH_NODE_SINGLE,
+    {"image", "rois", NULL},
+    {"labels", NULL},
+    {sizeof (graph_labels_t)},
+    classify_init, classify_process, NULL,
+};
+
+
+void
+register_classify_nodes ()
+{
+    graph_register_node (&s_classify_def);
+}
@@ -0,0 +1,145 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "util_image_crop.h"
+#include "tflite_age_gender.h"
+#include "graph_nodes.h"
+
+#define UNUSED(x) (void)(x)
+
+/*
+ *  FaceDetect / AgeGender: wrap gl2age_gender/tflite_age_gender.cpp.
+ *  one init_tflite_age_gender() loads both models.
+ *  param: model_dir=<dir> (default: ../gl2age_gender), quant=<0|1>
+ */
+static int s_initialized;
+
+static int
+face_module_init (graph_node_t *node)
+{
+    char cwd[PATH_MAX];
+
+    if (s_initialized)
+        return 0;
+
+    if (graph_nodes_enter_model_dir (node, "../gl2age_gender", cwd, sizeof (cwd)) < 0)
+        return -1;
+
+    int ret = init_tflite_age_gender (graph_nodes_use_quantized (node));
+    graph_nodes_leave_model_dir (cwd);
+
+    if (ret < 0)
+        return -1;
+
+    s_initialized = 1;
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  FaceDetect: image -> rois
+ * -------------------------------------------------- */
+static int
+face_detect_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    static face_detect_result_t s_face_result;
+    graph_image_t *img  = (graph_image_t *)inputs[0];
+    graph_rois_t  *rois = (graph_rois_t *)outputs[0];
+    int w, h;
+    UNUSED (node);
+
+    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
+    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
+    image_resize_rgba_to_fp32 (img->rgba, img->w, img->h, buf_fp32, w, h, 128.0f, 128.0f);
+
+    if (invoke_face_detect (&s_face_result) < 0)
+        return -1;
+
+    rois->num = 0;
+    for (int i = 0; i < s_face_result.num && rois->num < GRAPH_MAX_ROIS; i ++)
+    {
+        face_t      *face = &s_face_result.faces[i];
+        graph_roi_t *roi  = &rois->roi[rois->num ++];
+
+        roi->x1 = face->topleft.x;
+        roi->y1 = face->topleft.y;
+        roi->x2 = face->btmright.x;
+        roi->y2 = face->btmright.y;
+        for (int j = 0; j < 4; j ++)
+        {
+            roi->quad[j][0] = face->face_pos[j].x;
+            roi->quad[j][1] = face->face_pos[j].y;
+        }
+        roi->score = face->score;
+        snprintf (roi->label, sizeof (roi->label), "face");
+    }
+
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  AgeGender: image, rois -> labels
+ * -------------------------------------------------- */
+static int
+age_gender_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    graph_image_t  *img    = (graph_image_t *)inputs[0];
+    graph_rois_t   *rois   = (graph_rois_t *)inputs[1];
+    graph_labels_t *labels = (graph_labels_t *)outputs[0];
+    int w, h;
+    UNUSED (node);
+
+    float *buf_fp32 = (float *)get_age_gender_input_buf (&w, &h);
+
+    labels->num = 0;
+    for (int i = 0; i < rois->num; i ++)
+    {
+        age_gender_result_t result;
+        graph_label_t *label = &labels->label[labels->num ++];
+
+        /* convert UI8 [0, 255] ==> FP32 [0, 255] */
+        image_crop_rgba_to_fp32 (img->rgba, img->w, img->h, rois->roi[i].quad,
+                                 buf_fp32, w, h, 0.0f, 1.0f);
+
+        if (invoke_age_gender (&result) < 0)
+            return -1;
+
+        int male = result.gender.score_m > result.gender.score_f;
+        snprintf (label->text, sizeof (label->text), "%c:%dyrs", male ? 'M' : 'F', result.age.age);
+        label->score = male ? result.gender.score_m : result.gender.score_f;
+    }
+
+    return 0;
+}
+
+
+static const graph_node_def_t s_face_detect_def =
+{
+    "FaceDetect", GRAPH_NODE_SINGLE,
+    {"image", NULL},
+    {"rois", NULL},
+    {sizeof (graph_rois_t)},
+    face_module_init, face_detect_process, NULL,
+};
+
+static const graph_node_def_t s_age_gender_def =
+{
+    "AgeGender", GRAPH_NODE_SINGLE,
+    {"image", "rois", NULL},
+    {"labels", NULL},
+    {sizeof (graph_labels_t)},
+    face_module_init, age_gender_process, NULL,
+};
+
+
+void
+register_face_nodes ()
+{
+    graph_register_node (&s_face_detect_def);
+    graph_register_node (&s_age_gender_def);
+}
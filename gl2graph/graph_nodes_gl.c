@@ -0,0 +1,237 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <GLES2/gl2.h>
+#include "util_render2d.h"
+#include "util_debugstr.h"
+#include "graph_nodes.h"
+
+#define UNUSED(x) (void)(x)
+
+/*
+ *  the nodes which use the GL context. they run on the render thread.
+ */
+static struct {
+    texture_2d_t *tex;
+    int win_w, win_h;
+    int draw_x, draw_y, draw_w, draw_h;
+} s_source;
+
+
+void
+graph_nodes_set_source (texture_2d_t *tex, int win_w, int win_h,
+                        int draw_x, int draw_y, int draw_w, int draw_h)
+{
+    s_source.tex    = tex;
+    s_source.win_w  = win_w;
+    s_source.win_h  = win_h;
+    s_source.draw_x = draw_x;
+    s_source.draw_y = draw_y;
+    s_source.draw_w = draw_w;
+    s_source.draw_h = draw_h;
+}
+
+int
+graph_nodes_enter_model_dir (graph_node_t *node, const char *default_dir, char *cwd, size_t size)
+{
+    const char *dir = graph_node_get_param (node, "model_dir", default_dir);
+
+    if (getcwd (cwd, size) == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (chdir (dir) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d): can't chdir to %s\n", __FILE__, __LINE__, dir);
+        return -1;
+    }
+    return 0;
+}
+
+void
+graph_nodes_leave_model_dir (const char *cwd)
+{
+    if (chdir (cwd) < 0)
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+}
+
+int
+graph_nodes_use_quantized (graph_node_t *node)
+{
+    return atoi (graph_node_get_param (node, "quant", "0"));
+}
+
+void
+graph_nodes_roi_from_bbox (graph_roi_t *roi, float x1, float y1, float x2, float y2)
+{
+    roi->x1 = x1;
+    roi->y1 = y1;
+    roi->x2 = x2;
+    roi->y2 = y2;
+
+    roi->quad[0][0] = x1;   roi->quad[0][1] = y1;
+    roi->quad[1][0] = x2;   roi->quad[1][1] = y1;
+    roi->quad[2][0] = x2;   roi->quad[2][1] = y2;
+    roi->quad[3][0] = x1;   roi->quad[3][1] = y2;
+}
+
+
+/* -------------------------------------------------- *
+ *  CameraFrame: read back the camera frame, then draw it as the background.
+ * -------------------------------------------------- */
+static int
+camera_frame_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    graph_image_t *img = (graph_image_t *)outputs[0];
+    UNUSED (node);
+    UNUSED (inputs);
+
+    if (s_source.tex == NULL)
+        return -1;
+
+    draw_2d_texture_ex (s_source.tex, 0, s_source.win_h - GRAPH_FRAME_SIZE,
+                        GRAPH_FRAME_SIZE, GRAPH_FRAME_SIZE, 1);
+
+    glPixelStorei (GL_PACK_ALIGNMENT, 4);
+    glReadPixels (0, 0, GRAPH_FRAME_SIZE, GRAPH_FRAME_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, img->rgba);
+    img->w = GRAPH_FRAME_SIZE;
+    img->h = GRAPH_FRAME_SIZE;
+
+    glClear (GL_COLOR_BUFFER_BIT);
+    draw_2d_texture_ex (s_source.tex, s_source.draw_x, s_source.draw_y,
+                        s_source.draw_w, s_source.draw_h, 0);
+
+    return 0;
+}
+
+static const graph_node_def_t s_camera_frame_def =
+{
+    "CameraFrame", GRAPH_NODE_GL,
+    {NULL},
+    {"image", NULL},
+    {sizeof (graph_image_t)},
+    NULL, camera_frame_process, NULL,
+};
+
+
+/* -------------------------------------------------- *
+ *  RenderRois / RenderLabels: draw the regions on the background.
+ *  param: color=<r>,<g>,<b>
+ * -------------------------------------------------- */
+typedef struct _render_node_t
+{
+    float color[4];
+} render_node_t;
+
+static int
+render_init (graph_node_t *node)
+{
+    render_node_t *render = (render_node_t *)calloc (1, sizeof (render_node_t));
+    if (render == NULL)
+        return -1;
+
+    render->color[0] = 1.0f;
+    render->color[1] = 1.0f;
+    render->color[2] = 0.0f;
+    render->color[3] = 1.0f;
+    sscanf (graph_node_get_param (node, "color", ""), "%f,%f,%f",
+            &render->color[0], &render->color[1], &render->color[2]);
+
+    node->usrdata = render;
+    return 0;
+}
+
+static void
+render_exit (graph_node_t *node)
+{
+    free (node->usrdata);
+    node->usrdata = NULL;
+}
+
+static void
+render_roi (graph_roi_t *roi, const char *text, float *color)
+{
+    float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float ofstx = s_source.draw_x;
+    float ofsty = s_source.draw_y;
+    float texw  = s_source.draw_w;
+    float texh  = s_source.draw_h;
+
+    for (int i = 0; i < 4; i ++)
+    {
+        int j = (i + 1) % 4;
+        draw_2d_line (roi->quad[i][0] * texw + ofstx, roi->quad[i][1] * texh + ofsty,
+                      roi->quad[j][0] * texw + ofstx, roi->quad[j][1] * texh + ofsty, color, 2.0f);
+    }
+
+    if (text && text[0])
+    {
+        float x1 = roi->x1 * texw + ofstx;
+        float y1 = roi->y1 * texh + ofsty;
+        draw_dbgstr_ex ((char *)text, x1, y1 - 22, 1.0f, col_white, color);
+    }
+}
+
+static int
+render_rois_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    render_node_t *render = (render_node_t *)node->usrdata;
+    graph_rois_t  *rois   = (graph_rois_t *)inputs[0];
+    UNUSED (outputs);
+
+    for (int i = 0; i < rois->num; i ++)
+        render_roi (&rois->roi[i], rois->roi[i].label, render->color);
+
+    return 0;
+}
+
+static int
+render_labels_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    render_node_t  *render = (render_node_t *)node->usrdata;
+    graph_rois_t   *rois   = (graph_rois_t *)inputs[0];
+    graph_labels_t *labels = (graph_labels_t *)inputs[1];
+    UNUSED (outputs);
+
+    for (int i = 0; i < rois->num; i ++)
+    {
+        const char *text = (i < labels->num) ? labels->label[i].text : rois->roi[i].label;
+        render_roi (&rois->roi[i], text, render->color);
+    }
+
+    return 0;
+}
+
+static const graph_node_def_t s_render_rois_def =
+{
+    "RenderRois", GRAPH_NODE_GL,
+    {"rois", NULL},
+    {NULL},
+    {0},
+    render_init, render_rois_process, render_exit,
+};
+
+static const graph_node_def_t s_render_labels_def =
+{
+    "RenderLabels", GRAPH_NODE_GL,
+    {"rois", "labels", NULL},
+    {NULL},
+    {0},
+    render_init, render_labels_process, render_exit,
+};
+
+
+void
+register_gl_nodes ()
+{
+    graph_register_node (&s_camera_frame_def);
+    graph_register_node (&s_render_rois_def);
+    graph_register_node (&s_render_labels_def);
+}
@@ -0,0 +1,99 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "util_image_crop.h"
+#include "tflite_detect.h"
+#include "graph_nodes.h"
+
+/*
+ *  SsdDetect: image -> rois. wraps gl2detection/tflite_detect.cpp.
+ *  param: model_dir=<dir> (default: ../gl2detection), quant=<0|1>,
+ *         min_score=<score> (default: 0.5)
+ */
+typedef struct _ssd_node_t
+{
+    float min_score;
+} ssd_node_t;
+
+static int
+ssd_detect_init (graph_node_t *node)
+{
+    char cwd[PATH_MAX];
+    ssd_node_t *ssd = (ssd_node_t *)calloc (1, sizeof (ssd_node_t));
+    if (ssd == NULL)
+        return -1;
+
+    ssd->min_score = atof (graph_node_get_param (node, "min_score", "0.5"));
+    node->usrdata  = ssd;
+
+    if (graph_nodes_enter_model_dir (node, "../gl2detection", cwd, sizeof (cwd)) < 0)
+        return -1;
+
+    int ret = init_tflite_detection (graph_nodes_use_quantized (node));
+    graph_nodes_leave_model_dir (cwd);
+
+    return (ret < 0) ? -1 : 0;
+}
+
+static void
+ssd_detect_exit (graph_node_t *node)
+{
+    free (node->usrdata);
+    node->usrdata = NULL;
+}
+
+static int
+ssd_detect_process (graph_node_t *node, void **inputs, void **outputs)
+{
+    static detect_result_t s_detect_result;
+    ssd_node_t    *ssd  = (ssd_node_t *)node->usrdata;
+    graph_image_t *img  = (graph_image_t *)inputs[0];
+    graph_rois_t  *rois = (graph_rois_t *)outputs[0];
+    int w, h;
+
+    void *buf = get_detect_input_buf (&w, &h);
+    if (get_detect_input_type ())
+        image_resize_rgba_to_uint8 (img->rgba, img->w, img->h, (uint8_t *)buf, w, h);
+    else
+        image_resize_rgba_to_fp32 (img->rgba, img->w, img->h, (float *)buf, w, h, 128.0f, 128.0f);
+
+    if (invoke_detect (&s_detect_result) < 0)
+        return -1;
+
+    rois->num = 0;
+    for (int i = 0; i < s_detect_result.num && rois->num < GRAPH_MAX_ROIS; i ++)
+    {
+        detect_obj_t *obj = &s_detect_result.obj[i];
+        if (obj->score < ssd->min_score)
+            continue;
+
+        graph_roi_t *roi = &rois->roi[rois->num ++];
+        graph_nodes_roi_from_bbox (roi, obj->x1, obj->y1, obj->x2, obj->y2);
+        roi->score = obj->score;
+        snprintf (roi->label, sizeof (roi->label), "%s", get_detect_class_name (obj->det_class));
+    }
+
+    return 0;
+}
+
+
+static const graph_node_def_t s_ssd_detect_def =
+{
+    "SsdDetect", GRAPH_NODE_SINGLE,
+    {"image", NULL},
+    {"rois", NULL},
+    {sizeof (graph_rois_t)},
+    ssd_detect_init, ssd_detect_process, ssd_detect_exit,
+};
+
+
+void
+register_ssd_nodes ()
+{
+    graph_register_node (&s_ssd_detect_def);
+}
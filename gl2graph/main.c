@@ -0,0 +1,261 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <GLES2/gl2.h>
+#include "util_egl.h"
+#include "util_debugstr.h"
+#include "util_pmeter.h"
+#include "util_memory.h"
+#include "util_texture.h"
+#include "util_render2d.h"
+#include "util_graph.h"
+#include "graph_nodes.h"
+#include "util_camera_capture.h"
+#include "util_video_decode.h"
+
+#define UNUSED(x) (void)(x)
+
+#define GRAPH_THREADS   3
+
+
+
+/* Adjust the texture size to fit the window size
+ *
+ *                      Portrait
+ *     Landscape        +------+
+ *     +-+------+-+     +------+
+ *     | |      | |     |      |
+ *     | |      | |     |      |
+ *     +-+------+-+     +------+
+ *                      +------+
+ */
+static void
+adjust_texture (int win_w, int win_h, int texw, int texh,
+                int *dx, int *dy, int *dw, int *dh)
+{
+    float win_aspect = (float)win_w / (float)win_h;
+    float tex_aspect = (float)texw  / (float)texh;
+    float scale;
+    float scaled_w, scaled_h;
+    float offset_x, offset_y;
+
+    if (win_aspect > tex_aspect)
+    {
+        scale = (float)win_h / (float)texh;
+        scaled_w = scale * texw;
+        scaled_h = scale * texh;
+        offset_x = (win_w - scaled_w) * 0.5f;
+        offset_y = 0;
+    }
+    else
+    {
+        scale = (float)win_w / (float)texw;
+        scaled_w = scale * texw;
+        scaled_h = scale * texh;
+        offset_x = 0;
+        offset_y = (win_h - scaled_h) * 0.5f;
+    }
+
+    *dx = (int)offset_x;
+    *dy = (int)offset_y;
+    *dw = (int)scaled_w;
+    *dh = (int)scaled_h;
+}
+
+
+/*--------------------------------------------------------------------------- *
+ *      M A I N    F U N C T I O N
+ *--------------------------------------------------------------------------- */
+int
+main(int argc, char *argv[])
+{
+    char input_name_default[] = "../gl2age_gender/assets/pakutaso.jpg";
+    char graph_name_default[] = "graphs/face_and_objects.graph";
+    char *input_name = NULL;
+    char *graph_name = graph_name_default;
+    int count;
+    int win_w = 900;
+    int win_h = 900;
+    int texid;
+    int texw, texh, draw_x, draw_y, draw_w, draw_h;
+    texture_2d_t captex = {0};
+    double ttime[10] = {0}, interval;
+    int enable_camera = 1;
+    graph_t graph;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int num_threads = 0;        /* the GPU delegate must be invoked on the GL thread */
+#else
+    int num_threads = GRAPH_THREADS;
+#endif
+    UNUSED (argc);
+    UNUSED (*argv);
+#if defined (USE_INPUT_VIDEO_DECODE)
+    int enable_video = 0;
+#endif
+
+    {
+        int c;
+        const char *optstring = "g:sv:x";
+
+        while ((c = getopt (argc, argv, optstring)) != -1)
+        {
+            switch (c)
+            {
+            case 'g':
+                graph_name = optarg;
+                break;
+            case 's':
+                num_threads = 0;
+                break;
+#if defined (USE_INPUT_VIDEO_DECODE)
+            case 'v':
+                enable_video = 1;
+                input_name = optarg;
+                break;
+#endif
+            case 'x':
+                enable_camera = 0;
+                break;
+            }
+        }
+
+        while (optind < argc)
+        {
+            input_name = argv[optind];
+            optind++;
+        }
+    }
+
+    if (input_name == NULL)
+        input_name = input_name_default;
+
+    egl_init_with_platform_window_surface (2, 0, 0, 0, win_w, win_h);
+
+    init_2d_renderer (win_w, win_h);
+    init_pmeter (win_w, win_h, 500);
+    init_dbgstr (win_w, win_h);
+
+    /* --------------------------------------- *
+     *  load the graph and initialize the models
+     * --------------------------------------- */
+    register_gl_nodes ();
+    register_face_nodes ();
+    register_ssd_nodes ();
+    register_classify_nodes ();
+
+    if (graph_load (&graph, graph_name, num_threads) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d): failed to load %s\n", __FILE__, __LINE__, graph_name);
+        return -1;
+    }
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+    glViewport (0, 0, win_w, win_h);
+#endif
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+    /* initialize FFmpeg video decode */
+    if (enable_video && init_video_decode () == 0)
+    {
+        create_video_texture (&captex, input_name);
+        texw = captex.width;
+        texh = captex.height;
+        enable_camera = 0;
+    }
+    else
+#endif
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    /* initialize V4L2 capture function */
+    if (enable_camera && init_capture (CAPTURE_SQUARED_CROP) == 0)
+    {
+        create_capture_texture (&captex);
+        texw = captex.width;
+        texh = captex.height;
+    }
+    else
+#endif
+    {
+        load_jpg_texture (input_name, &texid, &texw, &texh);
+        captex.texid  = texid;
+        captex.width  = texw;
+        captex.height = texh;
+        captex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
+        enable_camera = 0;
+    }
+    adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
+    graph_nodes_set_source (&captex, win_w, win_h, draw_x, draw_y, draw_w, draw_h);
+
+    glClearColor (0.f, 0.f, 0.f, 1.0f);
+
+    mem_print_startup_report ();
+
+    /* --------------------------------------- *
+     *  Render Loop
+     * --------------------------------------- */
+    for (count = 0; ; count ++)
+    {
+        char strbuf[1024];
+        int  len;
+
+        PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
+        PMETER_SET_LAP ();
+
+        ttime[1] = pmeter_get_time_ms ();
+        interval = (count > 0) ? ttime[1] - ttime[0] : 0;
+        ttime[0] = ttime[1];
+
+        glClear (GL_COLOR_BUFFER_BIT);
+        glViewport (0, 0, win_w, win_h);
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+        /* initialize FFmpeg video decode */
+        if (enable_video)
+        {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
+            update_video_texture (&captex);
+            PMETER_SCOPE_END ();
+        }
+#endif
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+        if (enable_camera)
+        {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
+            update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
+        }
+#endif
+
+        /* --------------------------------------- *
+         *  run all the nodes of the graph.
+         *  (readback, inference and rendering)
+         * --------------------------------------- */
+        graph_run (&graph);
+        PMETER_SET_LAP ();
+
+        /* --------------------------------------- *
+         *  post process
+         * --------------------------------------- */
+        glViewport (0, 0, win_w, win_h);
+        draw_pmeter (0, 40);
+
+        len = sprintf (strbuf, "Interval:%5.1f [ms]\nThreads :%d\n", interval, num_threads);
+        graph_format_stats (&graph, strbuf + len, sizeof (strbuf) - len);
+        draw_dbgstr (strbuf, 10, 10);
+
+        PMETER_SCOPE_BEGIN ("egl_swap");
+        egl_swap();
+        PMETER_SCOPE_END ();
+    }
+
+    graph_exit (&graph);
+
+    return 0;
+}
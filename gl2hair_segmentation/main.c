@@ -12,11 +12,14 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_segmap.h"
 #include "util_matrix.h"
 #include "tflite_hair_segmentation.h"
 #include "render_hair.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -36,7 +39,10 @@ feed_segmentation_image (texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_segmentation_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -151,11 +157,13 @@ render_segment_result (int ofstx, int ofsty, int draw_w, int draw_h,
     int segmap_w  = segment_ret->segmentmap_dims[0];
     int segmap_h  = segment_ret->segmentmap_dims[1];
     int segmap_c  = segment_ret->segmentmap_dims[2];
-    int x, y, c;
-    unsigned int imgbuf[segmap_h][segmap_w];
     float hair_color[4] = {0};
-    float back_color[4] = {0};
     static float s_hsv_h = 0.0f;
+    static uint8_t      *s_labels = NULL;
+    static texture_2d_t s_labeltex = {0};
+#if defined (RENDER_BY_BLEND)
+    static texture_2d_t s_palettetex = {0};
+#endif
 
     s_hsv_h += 5.0f;
     if (s_hsv_h >= 360.0f)
@@ -168,58 +176,39 @@ render_segment_result (int ofstx, int ofsty, int draw_w, int draw_h,
     hair_color[3] = lumi;
 #endif
 
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
+    if (s_labels == NULL)
     {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            int max_id;
-            float conf_max = 0;
-            for (c = 0; c < MAX_SEGMENT_CLASS; c ++)
-            {
-                float confidence = segmap[(y * segmap_w * segmap_c)+ (x * segmap_c) + c];
-                if (c == 0 || confidence > conf_max)
-                {
-                    conf_max = confidence;
-                    max_id = c;
-                }
-            }
-
-            float *col = (max_id > 0) ? hair_color : back_color;
-            unsigned char r = ((int)(col[0] * 255)) & 0xff;
-            unsigned char g = ((int)(col[1] * 255)) & 0xff;
-            unsigned char b = ((int)(col[2] * 255)) & 0xff;
-            unsigned char a = ((int)(col[3] * 255)) & 0xff;
+        s_labels = (uint8_t *)malloc (segmap_w * segmap_h);
+        mem_register_buffer ("labels", s_labels, segmap_w * segmap_h);
+        create_2d_label_texture (&s_labeltex, NULL, segmap_w, segmap_h);
 
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
+        /* the label map is a binary hair mask: interpolate it for smooth edges. */
+        glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
 
-    GLuint texid;
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
-
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
-
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,
-        segmap_w, segmap_h, 0, GL_RGBA,
-        GL_UNSIGNED_BYTE, imgbuf);
+    /* find the most confident class for each pixel. */
+    segmap_argmax_u8 (segmap, segmap_w, segmap_h, segmap_c, s_labels);
+    update_2d_label_texture (&s_labeltex, s_labels);
 
 #if !defined (RENDER_BY_BLEND)
-    draw_colored_hair (srctex, texid, ofstx, ofsty, draw_w, draw_h, 0, hair_color);
+    draw_colored_hair (srctex, s_labeltex.texid, ofstx, ofsty, draw_w, draw_h, 0, hair_color);
 #else
     draw_2d_texture_ex (srctex, ofstx, ofsty, draw_w, draw_h, 0);
 
-    unsigned int blend_add  [] = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE};
-    draw_2d_texture_blendfunc (texid, ofstx, ofsty, draw_w, draw_h, 0, blend_add);
-#endif
+    uint8_t palette[MAX_SEGMENT_CLASS * 4] = {0};
+    palette[4] = (uint8_t)(hair_color[0] * 255);
+    palette[5] = (uint8_t)(hair_color[1] * 255);
+    palette[6] = (uint8_t)(hair_color[2] * 255);
+    palette[7] = (uint8_t)(hair_color[3] * 255);
 
-    glDeleteTextures (1, &texid);
+    /* the hair color cycles every frame: update the palette in place. */
+    if (s_palettetex.texid == 0)
+        create_2d_palette_texture (&s_palettetex, palette, MAX_SEGMENT_CLASS);
+    else
+        update_2d_palette_texture (&s_palettetex, palette, MAX_SEGMENT_CLASS);
+    draw_2d_labelmap (s_labeltex.texid, s_palettetex.texid, ofstx, ofsty, draw_w, draw_h, 1.0f, 0);
+#endif
 
     render_hsv_circle (ofstx + draw_w - 100, ofsty + 100, s_hsv_h);
 }
@@ -283,8 +272,11 @@ main(int argc, char *argv[])
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    segmentation_result_t segment_result;
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -293,7 +285,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "v:x";
+        const char *optstring = "v:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -305,6 +297,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -367,16 +362,19 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        segmentation_result_t segment_result;
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -390,25 +388,40 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  hair segmentation
+         *  (the last result is reused while the frame is unchanged)
          * --------------------------------------- */
-        feed_segmentation_image (&captex, win_w, win_h);
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
+        {
+            PMETER_SCOPE_BEGIN ("feed_segmentation_image");
+            feed_segmentation_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
+
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_segmentation");
+            invoke_segmentation (&segment_result);
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            invoke_ms = ttime[3] - ttime[2];
+        }
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_segmentation (&segment_result);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms = ttime[3] - ttime[2];
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
 
         /* --------------------------------------- *
          *  render scene
@@ -420,7 +433,9 @@ main(int argc, char *argv[])
 
         /* visualize the segmentation results. */
         glViewport (win_w, 0, win_w, win_h);
+        PMETER_SCOPE_BEGIN ("render_segment_result");
         render_segment_result (draw_x, draw_y, draw_w, draw_h, &captex, &segment_result);
+        PMETER_SCOPE_END ();
 
         /* --------------------------------------- *
          *  post process
@@ -431,7 +446,9 @@ main(int argc, char *argv[])
         sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]", interval, invoke_ms);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -35,12 +35,13 @@ uniform     vec4      u_Color;                        \n\
                                                       \n\
 void main (void)                                      \n\
 {                                                     \n\
-    vec4 weight = texture2D (u_sampler2, v_TexCoord); \n\
+    float label = texture2D (u_sampler2, v_TexCoord).r;\n\
     vec4 color1 = texture2D (u_sampler,  v_TexCoord); \n\
     vec4 color2 = u_Color;                            \n\
                                                       \n\
+    float weight    = clamp (label * 255.0, 0.0, 1.0);\n\
     float luminance = dot(color1.rgb, vec3(0.299, 0.587, 0.114));   \n\
-    float mix_value = weight.a * luminance;           \n\
+    float mix_value = weight * color2.a * luminance;  \n\
                                                       \n\
     gl_FragColor = mix(color1, color2, mix_value);    \n\
     gl_FragColor.a = 1.0; \n\
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -11,10 +12,14 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_handpose.h"
+#include "util_async_infer.h"
+#include "util_frame_seq.h"
+#include "util_extrapolate.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 #include "render_handpose.h"
@@ -25,20 +30,55 @@
 
 static imgui_data_t s_gui_prop = {0};
 
+/*
+ *  a request to the inference worker is either a palm detection or
+ *  the hand landmarks of the given ROIs:
+ *      [handpose_request_t][palm detection image] or
+ *      [handpose_request_t][landmark image of hand 0][hand 1]...
+ */
+enum {
+    HANDPOSE_REQ_DETECT = 0,
+    HANDPOSE_REQ_LANDMARK,
+};
+
+typedef struct _handpose_request_t
+{
+    int                     kind;
+    int                     roi_tracked;    /* ROIs come from the previous landmarks */
+    palm_detection_result_t roi;            /* ROIs the landmark images are cropped with */
+} handpose_request_t;
+
+typedef struct _handpose_output_t
+{
+    int                     kind;
+    int                     roi_tracked;
+    palm_detection_result_t roi;            /* detected palms, or the ROIs of the request */
+    hand_landmark_result_t  hand[MAX_PALM_NUM];
+} handpose_output_t;
+
+static async_infer_t s_handpose_runner;
+static int s_palm_input_size;
+static int s_landmark_input_size;
 
 
 
 /* resize image to DNN network input size and convert to fp32. */
 void
-feed_palm_detection_image(texture_2d_t *srctex, int win_w, int win_h)
+feed_palm_detection_image(texture_2d_t *srctex, int win_w, int win_h, void *dstbuf)
 {
     int x, y, w, h;
     float *buf_fp32 = (float *)get_palm_detection_input_buf (&w, &h);
     unsigned char *buf_ui8 = NULL;
     static unsigned char *pui8 = NULL;
 
+    if (dstbuf)
+        buf_fp32 = (float *)dstbuf;
+
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_palm_detection_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -68,15 +108,22 @@ feed_palm_detection_image(texture_2d_t *srctex, int win_w, int win_h)
 }
 
 void
-feed_hand_landmark_image(texture_2d_t *srctex, int win_w, int win_h, palm_detection_result_t *detection, unsigned int hand_id)
+feed_hand_landmark_image(texture_2d_t *srctex, int win_w, int win_h, palm_detection_result_t *detection, unsigned int hand_id,
+                         void *dstbuf)
 {
     int x, y, w, h;
     float *buf_fp32 = (float *)get_hand_landmark_input_buf (&w, &h);
     unsigned char *buf_ui8 = NULL;
     static unsigned char *pui8 = NULL;
 
+    if (dstbuf)
+        buf_fp32 = (float *)dstbuf;
+
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_hand_landmark_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -564,6 +611,74 @@ render_cropped_hand_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw,
 }
 
 
+/* -------------------------------------------------- *
+ *  keypoint extrapolation (-p option)
+ *  the joints (in the ROI space) and the ROI are extrapolated
+ *  together. the rotation of the ROI is kept as it is.
+ * -------------------------------------------------- */
+#define HAND_EXTRAP_NUM     (HAND_JOINT_NUM * 3 + 4 + 4 * 2)
+
+static void
+pack_hand_keypoints (float *val, palm_t *palm, hand_landmark_result_t *hand)
+{
+    memcpy (val, hand->joint, HAND_JOINT_NUM * sizeof (fvec3));
+    val += HAND_JOINT_NUM * 3;
+
+    val[0] = palm->hand_cx;
+    val[1] = palm->hand_cy;
+    val[2] = palm->hand_w;
+    val[3] = palm->hand_h;
+    memcpy (&val[4], palm->hand_pos, 4 * sizeof (fvec2));
+}
+
+static void
+unpack_hand_keypoints (float *val, palm_t *palm, hand_landmark_result_t *hand)
+{
+    memcpy (hand->joint, val, HAND_JOINT_NUM * sizeof (fvec3));
+    val += HAND_JOINT_NUM * 3;
+
+    palm->hand_cx = val[0];
+    palm->hand_cy = val[1];
+    palm->hand_w  = val[2];
+    palm->hand_h  = val[3];
+    memcpy (palm->hand_pos, &val[4], 4 * sizeof (fvec2));
+}
+
+static void
+update_hand_extrap (extrap_track_t *extrap, handpose_output_t *ret, double time_ms)
+{
+    float val[HAND_EXTRAP_NUM];
+
+    for (int hand_id = 0; hand_id < MAX_PALM_NUM; hand_id ++)
+    {
+        if (hand_id >= ret->roi.num)
+        {
+            extrap_reset (&extrap[hand_id]);
+            continue;
+        }
+
+        pack_hand_keypoints (val, &ret->roi.palms[hand_id], &ret->hand[hand_id]);
+        extrap_update (&extrap[hand_id], val, HAND_EXTRAP_NUM, time_ms);
+    }
+}
+
+static void
+predict_hand_extrap (extrap_track_t *extrap, handpose_output_t *dst, handpose_output_t *src, double time_ms)
+{
+    float val[HAND_EXTRAP_NUM];
+
+    *dst = *src;
+    for (int hand_id = 0; hand_id < src->roi.num; hand_id ++)
+    {
+        if (extrap[hand_id].valid == 0)
+            continue;
+
+        extrap_predict (&extrap[hand_id], time_ms, val);
+        unpack_hand_keypoints (val, &dst->roi.palms[hand_id], &dst->hand[hand_id]);
+    }
+}
+
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -662,6 +777,66 @@ setup_imgui (int win_w, int win_h)
     s_gui_prop.bone_radius  = 2.0f;
     s_gui_prop.draw_axis    = 0;
     s_gui_prop.draw_pmeter  = 1;
+    s_gui_prop.track_hand_roi     = 1;
+    s_gui_prop.track_score_thresh = 0.5f;
+    s_gui_prop.redetect_interval  = 30;
+}
+
+
+/* -------------------------------------------------- *
+ *  inference on the worker thread (util_async_infer)
+ * -------------------------------------------------- */
+static int
+run_handpose (void *input, void *output, void *usrdata)
+{
+    handpose_request_t *req = (handpose_request_t *)input;
+    handpose_output_t  *out = (handpose_output_t *)output;
+    char *img = (char *)(req + 1);
+    int w, h, ret;
+
+    out->kind        = req->kind;
+    out->roi_tracked = req->roi_tracked;
+
+    if (req->kind == HANDPOSE_REQ_DETECT)
+    {
+        memcpy (get_palm_detection_input_buf (&w, &h), img, s_palm_input_size);
+        PMETER_SCOPE_BEGIN ("invoke_palm_detection");
+        ret = invoke_palm_detection (&out->roi, 0);
+        PMETER_SCOPE_END ();
+        return ret;
+    }
+
+    out->roi = req->roi;
+    for (int hand_id = 0; hand_id < req->roi.num; hand_id ++)
+    {
+        memcpy (get_hand_landmark_input_buf (&w, &h), img + hand_id * s_landmark_input_size,
+                s_landmark_input_size);
+        PMETER_SCOPE_BEGIN ("invoke_hand_landmark");
+        invoke_hand_landmark (&out->hand[hand_id]);
+        PMETER_SCOPE_END ();
+    }
+
+    return 0;
+}
+
+static int
+init_handpose_runner (int enable_async)
+{
+    int w, h, img_size;
+    int flags = enable_async ? 0 : ASYNC_INFER_SYNC;
+
+    get_palm_detection_input_buf (&w, &h);
+    s_palm_input_size = w * h * 3 * sizeof (float);
+
+    get_hand_landmark_input_buf (&w, &h);
+    s_landmark_input_size = w * h * 3 * sizeof (float);
+
+    img_size = s_landmark_input_size * MAX_PALM_NUM;
+    if (img_size < s_palm_input_size)
+        img_size = s_palm_input_size;
+
+    return async_infer_init (&s_handpose_runner, sizeof (handpose_request_t) + img_size,
+                             sizeof (handpose_output_t), run_handpose, NULL, flags);
 }
 
 
@@ -682,6 +857,21 @@ main(int argc, char *argv[])
     int use_quantized_tflite = 0;
     int enable_palm_detect = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    int enable_roi_track = 1;
+    int result_frame = -1;
+    palm_detection_result_t track_ret = {0};
+    int need_landmark = 0;
+    int last_detect = 0;
+    static handpose_output_t new_ret, draw_ret, pred_ret;
+    static extrap_track_t hand_extrap[MAX_PALM_NUM];
+    int enable_extrap = 0;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int enable_async = 0;   /* the GPU delegate must be invoked on the GL thread */
+#else
+    int enable_async = 1;
+#endif
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -690,7 +880,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "mqv:x";
+        const char *optstring = "mnpqsv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -699,15 +889,27 @@ main(int argc, char *argv[])
             case 'm':
                 enable_palm_detect = 1;
                 break;
+            case 'n':
+                enable_roi_track = 0;
+                break;
+            case 'p':
+                enable_extrap = 1;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 's':
+                enable_async = 0;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -721,6 +923,9 @@ main(int argc, char *argv[])
         }
     }
 
+    /* the models are loaded in the background while the GL resources are created */
+    start_init_tflite_hand_landmark (use_quantized_tflite);
+
     egl_init_with_platform_window_surface (2, 8, 0, 0, win_w * 2, win_h);
 
     init_2d_renderer (win_w, win_h);
@@ -728,14 +933,8 @@ main(int argc, char *argv[])
     init_dbgstr (win_w, win_h);
     init_cube ((float)win_w / (float)win_h);
 
-    init_tflite_hand_landmark (use_quantized_tflite);
     setup_imgui (win_w * 2, win_h);
-
-#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
-    /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
-    glBindFramebuffer (GL_FRAMEBUFFER, 0);
-    glViewport (0, 0, win_w, win_h);
-#endif
+    s_gui_prop.track_hand_roi = enable_roi_track;
 
 #if defined (USE_INPUT_VIDEO_DECODE)
     /* initialize FFmpeg video decode */
@@ -769,18 +968,32 @@ main(int argc, char *argv[])
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
+    init_tflite_hand_landmark (use_quantized_tflite);
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+    glViewport (0, 0, win_w, win_h);
+#endif
+
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    init_handpose_runner (enable_async);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        palm_detection_result_t palm_ret = {0};
-        hand_landmark_result_t  hand_ret[MAX_PALM_NUM] = {0};
+        palm_detection_result_t *palm_ret = &draw_ret.roi;
+        hand_landmark_result_t  *hand_ret = draw_ret.hand;
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -794,64 +1007,155 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
-         *  palm detection
+         *  collect the result of the worker thread.
+         *  detected palms become the ROIs of the next request.
+         *  a landmark result is drawn, and gives the hand ROIs
+         *  of the next request while tracking. if any hand is
+         *  lost, the number of hands may have changed, so fall
+         *  back to the palm detector.
+         *  a periodic re-detection while tracking replaces the
+         *  tracked ROIs only if it has found a new hand.
          * --------------------------------------- */
-        if (enable_palm_detect)
+        int changed = 0;
+        if (async_infer_get_result (&s_handpose_runner, &new_ret, &result_frame, NULL) > 0)
         {
-            feed_palm_detection_image (&captex, win_w, win_h);
+            changed = 1;
+            if (new_ret.kind == HANDPOSE_REQ_DETECT)
+            {
+                invoke_ms0 = s_handpose_runner.invoke_ms;
 
-            ttime[2] = pmeter_get_time_ms ();
-            invoke_palm_detection (&palm_ret, 0);
-            ttime[3] = pmeter_get_time_ms ();
-            invoke_ms0 = ttime[3] - ttime[2];
-        }
-        else
-        {
-            invoke_palm_detection (&palm_ret, 1);
+                if (track_ret.num == 0 || new_ret.roi.num > track_ret.num)
+                {
+                    track_ret     = new_ret.roi;
+                    need_landmark = (track_ret.num > 0);
+
+                    if (track_ret.num == 0)
+                        draw_ret.roi.num = 0;   /* no hand in the view any more */
+                }
+            }
+            else
+            {
+                draw_ret   = new_ret;
+                invoke_ms1 = s_handpose_runner.invoke_ms;
+
+                if (enable_extrap)
+                    update_hand_extrap (hand_extrap, &draw_ret, ttime[1]);
+
+                track_ret.num = 0;
+                if (s_gui_prop.track_hand_roi)
+                {
+                    for (int hand_id = 0; hand_id < draw_ret.roi.num; hand_id ++)
+                    {
+                        if (draw_ret.hand[hand_id].score < s_gui_prop.track_score_thresh)
+                        {
+                            track_ret.num = 0;
+                            break;
+                        }
+
+                        palm_t *palm = &track_ret.palms[track_ret.num ++];
+                        *palm = draw_ret.roi.palms[hand_id];
+                        compute_hand_roi_from_landmark (palm, &draw_ret.hand[hand_id]);
+                    }
+                }
+            }
         }
 
         /* --------------------------------------- *
-         *  hand landmark
+         *  next request (only when the worker is idle)
+         *  an unchanged frame is not fed again, except for the landmark
+         *  pass of the palms which have just been detected on it.
          * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int hand_id = 0; hand_id < palm_ret.num; hand_id ++)
+        if (!async_infer_is_busy (&s_handpose_runner) &&
+            (frame_seq_is_new (&fseq, captex.frame_seq) || need_landmark))
         {
-            feed_hand_landmark_image (&captex, win_w, win_h, &palm_ret, hand_id);
+            handpose_request_t *req = (handpose_request_t *)async_infer_get_input_buf (&s_handpose_runner);
+            char *img = (char *)(req + 1);
+
+            req->roi_tracked = (track_ret.num > 0 && s_gui_prop.track_hand_roi);
 
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_hand_landmark (&hand_ret[hand_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            /* while fewer hands than MAX_PALM_NUM are tracked, look for a new one */
+            int redetect = (track_ret.num > 0 && track_ret.num < MAX_PALM_NUM && !need_landmark &&
+                            count - last_detect >= s_gui_prop.redetect_interval);
+
+            if ((track_ret.num == 0 || redetect) && enable_palm_detect)
+            {
+                req->kind = HANDPOSE_REQ_DETECT;
+                last_detect = count;
+                PMETER_SCOPE_BEGIN ("feed_palm_detection_image");
+                feed_palm_detection_image (&captex, win_w, win_h, img);
+                PMETER_SCOPE_END ();
+            }
+            else
+            {
+                /* without the palm detector, crop the whole image */
+                if (track_ret.num == 0)
+                {
+                    PMETER_SCOPE_BEGIN ("invoke_palm_detection");
+                    invoke_palm_detection (&track_ret, 1);
+                    PMETER_SCOPE_END ();
+                }
+
+                req->kind = HANDPOSE_REQ_LANDMARK;
+                req->roi  = track_ret;
+                for (int hand_id = 0; hand_id < track_ret.num; hand_id ++)
+                {
+                    PMETER_SCOPE_BEGIN ("feed_hand_landmark_image");
+                    feed_hand_landmark_image (&captex, win_w, win_h, &track_ret, hand_id,
+                                              img + hand_id * s_landmark_input_size);
+                    PMETER_SCOPE_END ();
+                }
+            }
+            async_infer_submit (&s_handpose_runner, count);
+            need_landmark = 0;
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, changed))
+            continue;
+
         /* --------------------------------------- *
          *  render scene (left half)
+         *  (the keypoints are extrapolated to the display time with -p)
          * --------------------------------------- */
+        if (enable_extrap)
+        {
+            predict_hand_extrap (hand_extrap, &pred_ret, &draw_ret, pmeter_get_time_ms ());
+            palm_ret = &pred_ret.roi;
+            hand_ret = pred_ret.hand;
+        }
+
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         /* visualize the hand pose estimation results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
 
-        for (int hand_id = 0; hand_id < palm_ret.num; hand_id ++)
+        for (int hand_id = 0; hand_id < palm_ret->num; hand_id ++)
         {
-            palm_t *palm = &(palm_ret.palms[hand_id]);
+            palm_t *palm = &(palm_ret->palms[hand_id]);
+            PMETER_SCOPE_BEGIN ("render_palm_region");
             render_palm_region (draw_x, draw_y, draw_w, draw_h, palm);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("render_skelton_2d");
             render_skelton_2d (draw_x, draw_y, draw_w, draw_h, palm, &hand_ret[hand_id]);
+            PMETER_SCOPE_END ();
         }
 
         /* draw cropped image of the hand area */
-        for (int hand_id = 0; hand_id < palm_ret.num; hand_id ++)
+        for (int hand_id = 0; hand_id < palm_ret->num; hand_id ++)
         {
             float w = 100;
             float h = 100;
@@ -859,7 +1163,9 @@ main(int argc, char *argv[])
             float y = h * hand_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-            render_cropped_hand_image (&captex, x, y, w, h, &palm_ret, hand_id);
+            PMETER_SCOPE_BEGIN ("render_cropped_hand_image");
+            render_cropped_hand_image (&captex, x, y, w, h, palm_ret, hand_id);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -867,7 +1173,9 @@ main(int argc, char *argv[])
          *  render scene  (right half)
          * --------------------------------------- */
         glViewport (win_w, 0, win_w, win_h);
-        render_3d_scene (draw_x, draw_y, hand_ret, &palm_ret);
+        PMETER_SCOPE_BEGIN ("render_3d_scene");
+        render_3d_scene (draw_x, draw_y, hand_ret, palm_ret);
+        PMETER_SCOPE_END ();
 
 
         /* --------------------------------------- *
@@ -880,14 +1188,19 @@ main(int argc, char *argv[])
             draw_pmeter (0, 40);
         }
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]",
-            interval, invoke_ms0, invoke_ms1);
+        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]%s\nTFLite1 :%5.1f [ms]\nFrameLag:%3d",
+            interval, invoke_ms0, draw_ret.roi_tracked ? " (tracking)" : "", invoke_ms1,
+            (result_frame >= 0) ? count - result_frame : 0);
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&s_gui_prop);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -87,7 +87,7 @@ static void
 render_gui (imgui_data_t *imgui_data)
 {
     int win_w = 300;
-    int win_h = 220;
+    int win_h = 260;
     int win_y = 10;
     s_win_num = 0;
 
@@ -110,6 +110,12 @@ render_gui (imgui_data_t *imgui_data)
         imgui_data->draw_axis   = draw_axis   ? 1 : 0;
         imgui_data->draw_pmeter = draw_pmeter ? 1 : 0;
 
+        bool track_hand_roi = imgui_data->track_hand_roi;
+        ImGui::Checkbox("track_hand_roi", &track_hand_roi);
+        imgui_data->track_hand_roi = track_hand_roi ? 1 : 0;
+        ImGui::SliderFloat("track_score_thresh", &imgui_data->track_score_thresh, 0.0f, 1.0f);
+        ImGui::SliderInt  ("redetect_interval",  &imgui_data->redetect_interval, 1, 120);
+
         s_win_pos [s_win_num] = ImGui::GetWindowPos  ();
         s_win_size[s_win_num] = ImGui::GetWindowSize ();
         s_win_num ++;
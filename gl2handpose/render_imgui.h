@@ -23,6 +23,9 @@ typedef struct _imgui_data_t
     float bone_radius;
     int   draw_axis;
     int   draw_pmeter;
+    int   track_hand_roi;
+    float track_score_thresh;
+    int   redetect_interval;
 } imgui_data_t;
 
 int  init_imgui (int width, int height);
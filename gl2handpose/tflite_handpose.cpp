@@ -3,9 +3,13 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
+#include "util_tflite_loader.h"
 #include "tflite_handpose.h"
 #include "custom_ops/transpose_conv_bias.h"
 #include <list>
+#include <float.h>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/models/hand_landmark_3d.tflite
@@ -26,6 +30,8 @@ static tflite_tensor_t      s_hand_tensor_input;
 static tflite_tensor_t      s_hand_tensor_landmark;
 static tflite_tensor_t      s_hand_tensor_handflag;
 
+static tflite_loader_t      s_loader;
+
 
 typedef struct Anchor
 {
@@ -34,6 +40,8 @@ typedef struct Anchor
 
 static std::vector<Anchor>  s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 typedef struct SsdAnchorsCalculatorOptions 
 {
     int input_size_width;
@@ -216,7 +224,7 @@ generate_ssd_anchors ()
  *  Create TFLite Interpreter
  * -------------------------------------------------- */
 int
-init_tflite_hand_landmark(int use_quantized_tflite)
+start_init_tflite_hand_landmark (int use_quantized_tflite)
 {
     const char *palm_model;
     const char *hand_model;
@@ -236,19 +244,44 @@ init_tflite_hand_landmark(int use_quantized_tflite)
     s_palm_interpreter.resolver.AddCustom("Convolution2DTransposeBias",
             mediapipe::tflite_operations::RegisterConvolution2DTransposeBias());
 
-    tflite_create_interpreter_from_file (&s_palm_interpreter, palm_model);
+    /* the interpreters are built on the loader threads */
+    tflite_loader_start (&s_loader, 2);
+    tflite_loader_add (&s_loader, &s_palm_interpreter, palm_model);
+    tflite_loader_add (&s_loader, &s_hand_interpreter, hand_model);
+
+    return 0;
+}
+
+/*
+ *  wait for the interpreters started by start_init_tflite_hand_landmark(),
+ *  (or build them here if not started yet) and bind the tensors.
+ */
+int
+init_tflite_hand_landmark (int use_quantized_tflite)
+{
+    if (!s_loader.started)
+        start_init_tflite_hand_landmark (use_quantized_tflite);
+
+    if (tflite_loader_wait (&s_loader) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* Palm Detection */
     tflite_get_tensor_by_name (&s_palm_interpreter, 0, "input",           &s_palm_tensor_input);
     tflite_get_tensor_by_name (&s_palm_interpreter, 1, "classificators",  &s_palm_tensor_scores);
     tflite_get_tensor_by_name (&s_palm_interpreter, 1, "regressors",      &s_palm_tensor_points);
 
     /* Hand Landmark */
-    tflite_create_interpreter_from_file (&s_hand_interpreter, hand_model);
     tflite_get_tensor_by_name (&s_hand_interpreter, 0, "input_1",         &s_hand_tensor_input);
     tflite_get_tensor_by_name (&s_hand_interpreter, 1, "ld_21_3d",        &s_hand_tensor_landmark);
     tflite_get_tensor_by_name (&s_hand_interpreter, 1, "output_handflag", &s_hand_tensor_handflag);
 
     generate_ssd_anchors ();
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -272,7 +305,7 @@ get_hand_landmark_input_buf (int *w, int *h)
 /* -------------------------------------------------- *
  *  Decode palm detection result
  * -------------------------------------------------- */static int
-decode_keypoints (std::list<palm_t> &palm_list, float score_thresh)
+decode_keypoints (arena_list<palm_t> &palm_list, float score_thresh)
 {
     palm_t palm_item;
     float *scores_ptr = (float *)s_palm_tensor_scores.ptr;
@@ -387,7 +420,7 @@ compare (palm_t &v1, palm_t &v2)
 }
 
 static int
-non_max_suppression (std::list<palm_t> &face_list, std::list<palm_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<palm_t> &face_list, arena_list<palm_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -452,6 +485,32 @@ rot_vec (fvec2 &vec, float rotation)
     vec.y = sx * std::sin(rotation) + sy * std::cos(rotation);
 }
 
+static void
+set_hand_rect (palm_t &palm, float hand_cx, float hand_cy, float hand_w, float hand_h)
+{
+    float rotation = palm.rotation;
+
+    palm.hand_cx = hand_cx;
+    palm.hand_cy = hand_cy;
+    palm.hand_w  = hand_w;
+    palm.hand_h  = hand_h;
+
+    float dx = hand_w * 0.5f;
+    float dy = hand_h * 0.5f;
+
+    palm.hand_pos[0].x = - dx;  palm.hand_pos[0].y = - dy;
+    palm.hand_pos[1].x = + dx;  palm.hand_pos[1].y = - dy;
+    palm.hand_pos[2].x = + dx;  palm.hand_pos[2].y = + dy;
+    palm.hand_pos[3].x = - dx;  palm.hand_pos[3].y = + dy;
+
+    for (int i = 0; i < 4; i ++)
+    {
+        rot_vec (palm.hand_pos[i], rotation);
+        palm.hand_pos[i].x += hand_cx;
+        palm.hand_pos[i].y += hand_cy;
+    }
+}
+
 static void
 compute_hand_rect (palm_t &palm)
 {
@@ -486,29 +545,11 @@ compute_hand_rect (palm_t &palm)
     float hand_w = width  * 2.6f;
     float hand_h = height * 2.6f;
 
-    palm.hand_cx = hand_cx;
-    palm.hand_cy = hand_cy;
-    palm.hand_w  = hand_w;
-    palm.hand_h  = hand_h;
-
-    float dx = hand_w * 0.5f;
-    float dy = hand_h * 0.5f;
-
-    palm.hand_pos[0].x = - dx;  palm.hand_pos[0].y = - dy;
-    palm.hand_pos[1].x = + dx;  palm.hand_pos[1].y = - dy;
-    palm.hand_pos[2].x = + dx;  palm.hand_pos[2].y = + dy;
-    palm.hand_pos[3].x = - dx;  palm.hand_pos[3].y = + dy;
-
-    for (int i = 0; i < 4; i ++)
-    {
-        rot_vec (palm.hand_pos[i], rotation);
-        palm.hand_pos[i].x += hand_cx;
-        palm.hand_pos[i].y += hand_cy;
-    }
+    set_hand_rect (palm, hand_cx, hand_cy, hand_w, hand_h);
 }
 
 static void
-pack_palm_result (palm_detection_result_t *palm_result, std::list<palm_t> &palm_list)
+pack_palm_result (palm_detection_result_t *palm_result, arena_list<palm_t> &palm_list)
 {
     int num_palms = 0;
     for (auto itr = palm_list.begin(); itr != palm_list.end(); itr ++)
@@ -541,14 +582,17 @@ detect_palm (palm_detection_result_t *palm_result)
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     float score_thresh = 0.7f;
-    std::list<palm_t> palm_list;
+    arena_list<palm_t> palm_list;
 
     decode_keypoints (palm_list, score_thresh);
 
 #if 1 /* USE NMS */
     float iou_thresh = 0.03f;
-    std::list<palm_t> palm_nms_list;
+    arena_list<palm_t> palm_nms_list;
 
     non_max_suppression (palm_list, palm_nms_list, iou_thresh);
     pack_palm_result (palm_result, palm_nms_list);
@@ -556,6 +600,9 @@ detect_palm (palm_detection_result_t *palm_result)
     pack_palm_result (palm_result, palm_list);
 #endif
 
+    ALLOC_CHECK_END ("detect_palm");
+    frame_arena_end ();
+
     return 0;
 }
 
@@ -625,3 +672,103 @@ invoke_hand_landmark (hand_landmark_result_t *hand_result)
     return 0;
 }
 
+
+
+
+/* -------------------------------------------------- *
+ *  Track hand ROI from the landmarks
+ *
+ *  the ROI of the next frame is computed from the 21
+ *  landmarks of the current frame, so that the palm
+ *  detector is needed only when the hand is lost.
+ *  (mediapipe/modules/hand_landmark/hand_landmark_landmarks_to_roi.pbtxt)
+ * -------------------------------------------------- */
+static const int s_palm_key_joint[7] = {
+    0,  /* wrist          */
+    5,  /* MCP of index   */
+    9,  /* MCP of middle  */
+    13, /* MCP of ring    */
+    17, /* MCP of pinky   */
+    1,  /* CMC of thumb   */
+    2,  /* MCP of thumb   */
+};
+
+static const int s_roi_joint[] = {0, 1, 2, 3, 5, 6, 9, 10, 13, 14, 17, 18};
+
+/* landmark (normalized to the ROI) ==> image coordinate */
+static fvec2
+landmark_to_image (palm_t &roi, fvec3 &joint)
+{
+    fvec2 pos;
+    pos.x = (joint.x - 0.5f) * roi.hand_w;
+    pos.y = (joint.y - 0.5f) * roi.hand_h;
+
+    rot_vec (pos, roi.rotation);
+    pos.x += roi.hand_cx;
+    pos.y += roi.hand_cy;
+    return pos;
+}
+
+int
+compute_hand_roi_from_landmark (palm_t *palm, hand_landmark_result_t *hand_landmark)
+{
+    palm_t roi = *palm;
+    fvec2  pts[HAND_JOINT_NUM];
+    int    num_pts = sizeof (s_roi_joint) / sizeof (s_roi_joint[0]);
+
+    for (int i = 0; i < HAND_JOINT_NUM; i ++)
+        pts[i] = landmark_to_image (roi, hand_landmark->joint[i]);
+
+    /* keypoints of the palm, to reuse the rotation of the palm detector. */
+    for (int i = 0; i < 7; i ++)
+        palm->keys[i] = pts[s_palm_key_joint[i]];
+
+    compute_rotation (*palm);
+    float rotation = palm->rotation;
+
+    /* bounding box of the landmarks */
+    float x_min = FLT_MAX, x_max = -FLT_MAX;
+    float y_min = FLT_MAX, y_max = -FLT_MAX;
+    for (int i = 0; i < num_pts; i ++)
+    {
+        fvec2 &p = pts[s_roi_joint[i]];
+        x_min = std::min (x_min, p.x);  x_max = std::max (x_max, p.x);
+        y_min = std::min (y_min, p.y);  y_max = std::max (y_max, p.y);
+    }
+    palm->rect.topleft.x  = x_min;
+    palm->rect.topleft.y  = y_min;
+    palm->rect.btmright.x = x_max;
+    palm->rect.btmright.y = y_max;
+    palm->score = hand_landmark->score;
+
+    /* bounding box aligned to the hand direction */
+    float axis_cx = (x_min + x_max) * 0.5f;
+    float axis_cy = (y_min + y_max) * 0.5f;
+    x_min = FLT_MAX; x_max = -FLT_MAX;
+    y_min = FLT_MAX; y_max = -FLT_MAX;
+    for (int i = 0; i < num_pts; i ++)
+    {
+        fvec2 p = pts[s_roi_joint[i]];
+        p.x -= axis_cx;
+        p.y -= axis_cy;
+        rot_vec (p, -rotation);
+        x_min = std::min (x_min, p.x);  x_max = std::max (x_max, p.x);
+        y_min = std::min (y_min, p.y);  y_max = std::max (y_max, p.y);
+    }
+
+    float width   = x_max - x_min;
+    float height  = y_max - y_min;
+    float shift_x =  0.0f;
+    float shift_y = -0.1f;
+    float scale   =  2.0f;
+
+    fvec2 center;
+    center.x = (x_min + x_max) * 0.5f + width  * shift_x;
+    center.y = (y_min + y_max) * 0.5f + height * shift_y;
+    rot_vec (center, rotation);
+
+    float long_side = std::max (width, height) * scale;
+    set_hand_rect (*palm, axis_cx + center.x, axis_cy + center.y, long_side, long_side);
+
+    return 0;
+}
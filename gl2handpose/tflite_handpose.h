@@ -62,6 +62,7 @@ typedef struct _pose3d_config_t
     float iou_thresh;
 } pose3d_config_t;
 
+int   start_init_tflite_hand_landmark (int use_quantized_tflite);
 int   init_tflite_hand_landmark (int use_quantized_tflite);
 
 void  *get_palm_detection_input_buf (int *w, int *h);
@@ -70,6 +71,8 @@ int   invoke_palm_detection (palm_detection_result_t *palm_result, int flag);
 void  *get_hand_landmark_input_buf (int *w, int *h);
 int   invoke_hand_landmark (hand_landmark_result_t *hand_landmark_result);
 
+int   compute_hand_roi_from_landmark (palm_t *palm, hand_landmark_result_t *hand_landmark);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,8 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -12,10 +14,14 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_facemesh.h"
+#include "util_pipeline.h"
+#include "util_image_crop.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -25,195 +31,129 @@
 
 
 
-/* resize image to DNN network input size and convert to fp32. */
-void
-feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
+/*
+ *  the cascade "face detect -> face mesh -> iris mesh" runs as a pipeline,
+ *  one thread per stage. the render thread reads back the whole camera
+ *  frame once, and each stage crops its network input from that frame on
+ *  the CPU. (the GL context is bound to the render thread.)
+ */
+#define FRAME_SIZE      512
+
+typedef struct _iris_packet_t
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
+    int                     frame_id;
+    int                     detected;       /* 1: ROIs from the face detector, 0: tracked */
+    face_detect_result_t    face;
+    face_landmark_result_t  mesh[MAX_FACE_NUM];
+    irismesh_result_t       iris[MAX_FACE_NUM][2];
+    /* followed by the RGBA frame (FRAME_SIZE x FRAME_SIZE) */
+} iris_packet_t;
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+#define PACKET_FRAME(pkt)   ((uint8_t *)((iris_packet_t *)(pkt) + 1))
 
-    buf_ui8 = pui8;
+/* face ROIs tracked by the face mesh stage, looped back to the detection stage */
+static struct {
+    pthread_mutex_t         mutex;
+    face_detect_result_t    track;
+    int                     num_lost;
+} s_loopback = {PTHREAD_MUTEX_INITIALIZER};
 
-    draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
+static int s_detect_interval = 30;
+static int s_last_detect     = 0;
 
-    glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
-    float mean = 128.0f;
-    float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+/* read back the camera frame. (top row first) */
+static void
+feed_frame_image (texture_2d_t *srctex, int win_w, int win_h, uint8_t *buf_ui8)
+{
+    draw_2d_texture_ex (srctex, 0, win_h - FRAME_SIZE, FRAME_SIZE, FRAME_SIZE, 1);
 
-    return;
+    glPixelStorei (GL_PACK_ALIGNMENT, 4);
+    glReadPixels (0, 0, FRAME_SIZE, FRAME_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 }
 
-void
-feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
+/* resize image to DNN network input size and convert to fp32. */
+static void
+feed_face_detect_image (iris_packet_t *pkt)
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
-
-    float texcoord[] = { 0.0f, 1.0f,
-                         0.0f, 0.0f,
-                         1.0f, 1.0f,
-                         1.0f, 0.0f };
-
-    if (detection->num > face_id)
-    {
-        face_t *face = &(detection->faces[face_id]);
-        float x0 = face->face_pos[0].x;
-        float y0 = face->face_pos[0].y;
-        float x1 = face->face_pos[1].x; //    0--------1
-        float y1 = face->face_pos[1].y; //    |        |
-        float x2 = face->face_pos[2].x; //    |        |
-        float y2 = face->face_pos[2].y; //    3--------2
-        float x3 = face->face_pos[3].x;
-        float y3 = face->face_pos[3].y;
-        texcoord[0] = x3;   texcoord[1] = y3;
-        texcoord[2] = x0;   texcoord[3] = y0;
-        texcoord[4] = x2;   texcoord[5] = y2;
-        texcoord[6] = x1;   texcoord[7] = y1;
-    }
+    int w, h;
+    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
 
-    draw_2d_texture_ex_texcoord (srctex, 0, win_h - h, w, h, texcoord);
+    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
+    image_resize_rgba_to_fp32 (PACKET_FRAME (pkt), FRAME_SIZE, FRAME_SIZE,
+                               buf_fp32, w, h, 128.0f, 128.0f);
+}
 
-    glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+static void
+feed_face_landmark_image (iris_packet_t *pkt, int face_id)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
+    face_t *face = &pkt->face.faces[face_id];
+    float quad[4][2];
 
-    /* convert UI8 [0, 255] ==> FP32 [0, 1] */
-    float mean = 0.0f;
-    float std  = 255.0f;
-    for (y = 0; y < h; y ++)
+    for (int i = 0; i < 4; i ++)
     {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
+        quad[i][0] = face->face_pos[i].x;
+        quad[i][1] = face->face_pos[i].y;
     }
 
-    return;
+    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
+    image_crop_rgba_to_fp32 (PACKET_FRAME (pkt), FRAME_SIZE, FRAME_SIZE, quad,
+                             buf_fp32, w, h, 128.0f, 128.0f);
 }
 
-
-void
-feed_iris_landmark_image(texture_2d_t *srctex, int win_w, int win_h, 
-                         face_t *face, face_landmark_result_t *facemesh, int eye_id)
+/* eye region (face mesh coordinates) ==> image coordinates */
+static void
+compute_eye_quad (face_t *face, face_landmark_result_t *facemesh, int eye_id, float vec[4][2])
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_irismesh_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
-
-    float texcoord[8];
-
     float scale_x = face->face_w;
     float scale_y = face->face_h;
     float pivot_x = face->face_cx;
     float pivot_y = face->face_cy;
     float rotation= face->rotation;
-    
-    float x0 = facemesh->eye_pos[eye_id][0].x;
-    float y0 = facemesh->eye_pos[eye_id][0].y;
-    float x1 = facemesh->eye_pos[eye_id][1].x; //    0--------1
-    float y1 = facemesh->eye_pos[eye_id][1].y; //    |        |
-    float x2 = facemesh->eye_pos[eye_id][2].x; //    |        |
-    float y2 = facemesh->eye_pos[eye_id][2].y; //    3--------2
-    float x3 = facemesh->eye_pos[eye_id][3].x;
-    float y3 = facemesh->eye_pos[eye_id][3].y;
-
     float mat[16];
-    float vec[4][2] = {{x0, y0}, {x1, y1}, {x2, y2}, {x3, y3}};
+
+    //    0--------1
+    //    |        |
+    //    |        |
+    //    3--------2
+    for (int i = 0; i < 4; i ++)
+    {
+        vec[i][0] = facemesh->eye_pos[eye_id][i].x;
+        vec[i][1] = facemesh->eye_pos[eye_id][i].y;
+    }
+
     matrix_identity (mat);
-    
     matrix_translate (mat, pivot_x, pivot_y, 0);
     matrix_rotate (mat, RAD_TO_DEG(rotation), 0, 0, 1);
     matrix_scale (mat, scale_x, scale_y, 1.0f);
     matrix_translate (mat, -0.5f, -0.5f, 0);
 
-    matrix_multvec2 (mat, vec[0], vec[0]);
-    matrix_multvec2 (mat, vec[1], vec[1]);
-    matrix_multvec2 (mat, vec[2], vec[2]);
-    matrix_multvec2 (mat, vec[3], vec[3]);
-
-    x0 = vec[0][0];  y0 = vec[0][1];
-    x1 = vec[1][0];  y1 = vec[1][1];
-    x2 = vec[2][0];  y2 = vec[2][1];
-    x3 = vec[3][0];  y3 = vec[3][1];
-
-    /* Upside down */
-    if (eye_id == 0)
-    {
-        texcoord[0] = x3;   texcoord[1] = y3;
-        texcoord[2] = x0;   texcoord[3] = y0;
-        texcoord[4] = x2;   texcoord[5] = y2;
-        texcoord[6] = x1;   texcoord[7] = y1;
-    }
-    else /* need to horizontal flip for right eye */
-    {
-        texcoord[0] = x2;   texcoord[1] = y2;
-        texcoord[2] = x1;   texcoord[3] = y1;
-        texcoord[4] = x3;   texcoord[5] = y3;
-        texcoord[6] = x0;   texcoord[7] = y0;
-    }
+    for (int i = 0; i < 4; i ++)
+        matrix_multvec2 (mat, vec[i], vec[i]);
+}
 
-    draw_2d_texture_ex_texcoord (srctex, 0, win_h - h, w, h, texcoord);
+static void
+feed_iris_landmark_image (iris_packet_t *pkt, int face_id, int eye_id)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_irismesh_landmark_input_buf (&w, &h);
+    float vec[4][2], quad[4][2];
 
-    glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+    compute_eye_quad (&pkt->face.faces[face_id], &pkt->mesh[face_id], eye_id, vec);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
-    float mean = 0.0f;
-    float std  = 255.0f;
-    for (y = 0; y < h; y ++)
+    for (int i = 0; i < 4; i ++)
     {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
+        /* need to horizontal flip for right eye: 0<->1, 3<->2 */
+        int src = (eye_id == 0) ? i : (i ^ 1);
+        quad[i][0] = vec[src][0];
+        quad[i][1] = vec[src][1];
     }
 
-    return;
+    /* convert UI8 [0, 255] ==> FP32 [0, 1] */
+    image_crop_rgba_to_fp32 (PACKET_FRAME (pkt), FRAME_SIZE, FRAME_SIZE, quad,
+                             buf_fp32, w, h, 0.0f, 255.0f);
 }
 
 
@@ -240,7 +180,7 @@ render_detect_region (int ofstx, int ofsty, int texw, int texh,
 
         /* detect score */
         char buf[512];
-        sprintf (buf, "%d", (int)(score * 100));
+        sprintf (buf, "%d (id:%d)", (int)(score * 100), face->track_id);
         draw_dbgstr_ex (buf, x1, y1, 1.0f, col_white, col_red);
 
         /* key points */
@@ -289,45 +229,14 @@ render_cropped_eye_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw,
                            face_t *face, face_landmark_result_t *facemesh, int eye_id)
 {
     float texcoord[8];
+    float vec[4][2];
 
-    float scale_x = face->face_w;
-    float scale_y = face->face_h;
-    float pivot_x = face->face_cx;
-    float pivot_y = face->face_cy;
-    float rotation= face->rotation;
-    
-    float x0 = facemesh->eye_pos[eye_id][0].x;
-    float y0 = facemesh->eye_pos[eye_id][0].y;
-    float x1 = facemesh->eye_pos[eye_id][1].x; //    0--------1
-    float y1 = facemesh->eye_pos[eye_id][1].y; //    |        |
-    float x2 = facemesh->eye_pos[eye_id][2].x; //    |        |
-    float y2 = facemesh->eye_pos[eye_id][2].y; //    3--------2
-    float x3 = facemesh->eye_pos[eye_id][3].x;
-    float y3 = facemesh->eye_pos[eye_id][3].y;
+    compute_eye_quad (face, facemesh, eye_id, vec);
 
-    float mat[16];
-    float vec[4][2] = {{x0, y0}, {x1, y1}, {x2, y2}, {x3, y3}};
-    matrix_identity (mat);
-    
-    matrix_translate (mat, pivot_x, pivot_y, 0);
-    matrix_rotate (mat, RAD_TO_DEG(rotation), 0, 0, 1);
-    matrix_scale (mat, scale_x, scale_y, 1.0f);
-    matrix_translate (mat, -0.5f, -0.5f, 0);
-
-    matrix_multvec2 (mat, vec[0], vec[0]);
-    matrix_multvec2 (mat, vec[1], vec[1]);
-    matrix_multvec2 (mat, vec[2], vec[2]);
-    matrix_multvec2 (mat, vec[3], vec[3]);
-
-    x0 = vec[0][0];  y0 = vec[0][1];
-    x1 = vec[1][0];  y1 = vec[1][1];
-    x2 = vec[2][0];  y2 = vec[2][1];
-    x3 = vec[3][0];  y3 = vec[3][1];
-
-    texcoord[0] = x0;   texcoord[1] = y0;
-    texcoord[2] = x3;   texcoord[3] = y3;
-    texcoord[4] = x1;   texcoord[5] = y1;
-    texcoord[6] = x2;   texcoord[7] = y2;
+    texcoord[0] = vec[0][0];   texcoord[1] = vec[0][1];
+    texcoord[2] = vec[3][0];   texcoord[3] = vec[3][1];
+    texcoord[4] = vec[1][0];   texcoord[5] = vec[1][1];
+    texcoord[6] = vec[2][0];   texcoord[7] = vec[2][1];
 
     draw_2d_texture_ex_texcoord (srctex, ofstx, ofsty, texw, texh, texcoord);
 }
@@ -609,6 +518,100 @@ flip_horizontal_iris_landmark (irismesh_result_t *irismesh)
 }
 
 
+/* -------------------------------------------------- *
+ *  pipeline stages. each runs on its own thread.
+ * -------------------------------------------------- */
+
+/*
+ *  face detection (only at intervals or when a face is lost.
+ *  otherwise reuse the face ROI tracked by the face mesh stage.)
+ */
+static int
+run_face_detect_stage (void *packet, void *usrdata)
+{
+    iris_packet_t *pkt = (iris_packet_t *)packet;
+    face_detect_result_t track;
+    int num_lost;
+
+    pthread_mutex_lock (&s_loopback.mutex);
+    track    = s_loopback.track;
+    num_lost = s_loopback.num_lost;
+    pthread_mutex_unlock (&s_loopback.mutex);
+
+    if (track.num == 0 || num_lost > 0 || pkt->frame_id - s_last_detect >= s_detect_interval)
+    {
+        PMETER_SCOPE_BEGIN ("feed_face_detect_image");
+        feed_face_detect_image (pkt);
+        PMETER_SCOPE_END ();
+        PMETER_SCOPE_BEGIN ("invoke_face_detect");
+        invoke_face_detect (&pkt->face);
+        PMETER_SCOPE_END ();
+
+        assign_face_track_id (&pkt->face, &track);
+        s_last_detect = pkt->frame_id;
+        pkt->detected = 1;
+    }
+    else
+    {
+        pkt->face     = track;
+        pkt->detected = 0;
+    }
+
+    return 0;
+}
+
+static int
+run_face_landmark_stage (void *packet, void *usrdata)
+{
+    iris_packet_t *pkt = (iris_packet_t *)packet;
+    face_detect_result_t track;
+    int num_lost;
+
+    for (int face_id = 0; face_id < pkt->face.num; face_id ++)
+    {
+        PMETER_SCOPE_BEGIN ("feed_face_landmark_image");
+        feed_face_landmark_image (pkt, face_id);
+        PMETER_SCOPE_END ();
+        PMETER_SCOPE_BEGIN ("invoke_facemesh_landmark");
+        invoke_facemesh_landmark (&pkt->mesh[face_id]);
+        PMETER_SCOPE_END ();
+    }
+
+    /* face ROI of the following frames */
+    num_lost = track_face_roi (&track, &pkt->face, pkt->mesh, 0.5f);
+
+    pthread_mutex_lock (&s_loopback.mutex);
+    s_loopback.track    = track;
+    s_loopback.num_lost = num_lost;
+    pthread_mutex_unlock (&s_loopback.mutex);
+
+    return 0;
+}
+
+static int
+run_iris_landmark_stage (void *packet, void *usrdata)
+{
+    iris_packet_t *pkt = (iris_packet_t *)packet;
+
+    for (int face_id = 0; face_id < pkt->face.num; face_id ++)
+    {
+        for (int eye_id = 0; eye_id < 2; eye_id ++)
+        {
+            PMETER_SCOPE_BEGIN ("feed_iris_landmark_image");
+            feed_iris_landmark_image (pkt, face_id, eye_id);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("invoke_irismesh_landmark");
+            invoke_irismesh_landmark (&pkt->iris[face_id][eye_id]);
+            PMETER_SCOPE_END ();
+        }
+        /* need to horizontal flip for right eye */
+        flip_horizontal_iris_landmark (&pkt->iris[face_id][1]);
+    }
+
+    return 0;
+}
+
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -666,30 +669,50 @@ main(int argc, char *argv[])
     int win_h = 900;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms0 = 0, invoke_ms1 = 0, invoke_ms2 = 0;
+    double ttime[10] = {0}, interval;
     int use_quantized_tflite = 0;
     int enable_video = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    int result_frame = -1;
+    pipeline_t pipeline;
+    iris_packet_t *cur_packet = NULL;
+    static iris_packet_t empty_packet;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int enable_pipeline = 0;    /* the GPU delegate must be invoked on the GL thread */
+#else
+    int enable_pipeline = 1;
+#endif
     UNUSED (argc);
     UNUSED (*argv);
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "i:qsv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'i':
+                s_detect_interval = atoi (optarg);
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 's':
+                enable_pipeline = 0;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -706,20 +729,15 @@ main(int argc, char *argv[])
         }
     }
 
+    /* the models are loaded in the background while the GL resources are created */
+    start_init_tflite_facemesh (use_quantized_tflite);
+
     egl_init_with_platform_window_surface (2, 0, 0, 0, win_w * 2, win_h);
 
     init_2d_renderer (win_w, win_h);
     init_pmeter (win_w, win_h, 500);
     init_dbgstr (win_w, win_h);
 
-    init_tflite_facemesh (use_quantized_tflite);
-
-#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
-    /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
-    glBindFramebuffer (GL_FRAMEBUFFER, 0);
-    glViewport (0, 0, win_w, win_h);
-#endif
-
 #if defined (USE_INPUT_VIDEO_DECODE)
     /* initialize FFmpeg video decode */
     if (enable_video && init_video_decode () == 0)
@@ -752,23 +770,41 @@ main(int argc, char *argv[])
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
+    init_tflite_facemesh (use_quantized_tflite);
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+    glViewport (0, 0, win_w, win_h);
+#endif
 
     glClearColor (0.5f, 0.5f, 0.5f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
     glClear (GL_COLOR_BUFFER_BIT);
     glViewport (0, 0, win_w, win_h);
 
+    /* --------------------------------------- *
+     *  face detect -> face mesh -> iris mesh
+     * --------------------------------------- */
+    pipeline_init (&pipeline, sizeof (iris_packet_t) + FRAME_SIZE * FRAME_SIZE * 4, 1,
+                   enable_pipeline ? 0 : PIPELINE_SYNC);
+    pipeline_add_stage (&pipeline, "detect",  run_face_detect_stage,   NULL, PIPELINE_DROP_OLDEST);
+    pipeline_add_stage (&pipeline, "facemesh",run_face_landmark_stage, NULL, PIPELINE_BLOCK);
+    pipeline_add_stage (&pipeline, "iris",    run_iris_landmark_stage, NULL, PIPELINE_BLOCK);
+    pipeline_start (&pipeline);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        face_detect_result_t    face_detect_ret = {0};
-        face_landmark_result_t  face_mesh_ret[MAX_FACE_NUM] = {0};
-        irismesh_result_t       iris_mesh_ret[MAX_FACE_NUM][2] = {0};
-        char strbuf[512];
+        char strbuf[1024];
+        int  len;
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -782,59 +818,63 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
-         *  face detection
-         * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
-
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_face_detect (&face_detect_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
-
-        /* --------------------------------------- *
-         *  face landmark
+         *  feed the camera frame to the pipeline.
+         *  keep at most one frame waiting for the detection stage,
+         *  so the frames in flight are as new as possible.
+         *  (a frame which has already been fed is not fed again)
          * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        int changed = 0;
+        if (pipeline_get_queue_depth (&pipeline, 0) == 0 &&
+            frame_seq_is_new (&fseq, captex.frame_seq))
         {
-            feed_face_landmark_image (&captex, win_w, win_h, &face_detect_ret, face_id);
-
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_facemesh_landmark (&face_mesh_ret[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            iris_packet_t *pkt = (iris_packet_t *)pipeline_acquire_packet (&pipeline);
+            if (pkt)
+            {
+                pkt->frame_id = count;
+                PMETER_SCOPE_BEGIN ("feed_frame_image");
+                feed_frame_image (&captex, win_w, win_h, PACKET_FRAME (pkt));
+                PMETER_SCOPE_END ();
+                pipeline_submit (&pipeline, pkt, count);
+            }
+            else
+            {
+                frame_seq_invalidate (&fseq);   /* retry on the next loop */
+            }
         }
 
-        /* --------------------------------------- *
-         *  Iris landmark
-         * --------------------------------------- */
-        invoke_ms2 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        /* the latest frame which has passed all the stages */
         {
-            for (int eye_id = 0; eye_id < 2; eye_id ++)
+            iris_packet_t *pkt = (iris_packet_t *)pipeline_get_result (&pipeline, &result_frame);
+            if (pkt)
             {
-                feed_iris_landmark_image (&captex, win_w, win_h, &face_detect_ret.faces[face_id], &face_mesh_ret[face_id], eye_id);
-
-                ttime[6] = pmeter_get_time_ms ();
-                invoke_irismesh_landmark (&iris_mesh_ret[face_id][eye_id]);
-                ttime[7] = pmeter_get_time_ms ();
-                invoke_ms2 += ttime[7] - ttime[6];
+                pipeline_release_packet (&pipeline, cur_packet);
+                cur_packet = pkt;
+                changed = 1;
             }
-            /* need to horizontal flip for right eye */
-            flip_horizontal_iris_landmark (&iris_mesh_ret[face_id][1]);
         }
 
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, changed))
+            continue;
+
+        iris_packet_t *ret = cur_packet ? cur_packet : &empty_packet;
+        face_detect_result_t    *face_detect_ret = &ret->face;
+        face_landmark_result_t  *face_mesh_ret   = ret->mesh;
+        irismesh_result_t      (*iris_mesh_ret)[2] = ret->iris;
 
         /* --------------------------------------- *
          *  render scene (left half)
@@ -843,12 +883,16 @@ main(int argc, char *argv[])
 
         /* visualize the face pose estimation results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
-        render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_detect_ret);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
+        render_detect_region (draw_x, draw_y, draw_w, draw_h, face_detect_ret);
+        PMETER_SCOPE_END ();
 
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
         {
-            render_iris_landmark_on_main (draw_x, draw_y, draw_w, draw_h, &face_detect_ret.faces[face_id],
+            PMETER_SCOPE_BEGIN ("render_iris_landmark_on_main");
+            render_iris_landmark_on_main (draw_x, draw_y, draw_w, draw_h, &face_detect_ret->faces[face_id],
                                           &face_mesh_ret[face_id], iris_mesh_ret[face_id]);
+            PMETER_SCOPE_END ();
         }
 
         /* --------------------------------------- *
@@ -857,7 +901,7 @@ main(int argc, char *argv[])
         glViewport (win_w, 0, win_w, win_h);
 
         /* draw cropped image of the face area */
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
         {
             float w = 300;
             float h = 300;
@@ -865,14 +909,18 @@ main(int argc, char *argv[])
             float y = h * face_id;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-            render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+            PMETER_SCOPE_BEGIN ("render_cropped_face_image");
+            render_cropped_face_image (&captex, x, y, w, h, face_detect_ret, face_id);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("render_iris_landmark_on_face");
             render_iris_landmark_on_face (x, y, w, h, &face_mesh_ret[face_id], iris_mesh_ret[face_id]);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
         
         /* draw cropped image of the eye area */
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        for (int face_id = 0; face_id < face_detect_ret->num; face_id ++)
         {
             float w = 300;
             float h = 300;
@@ -880,13 +928,21 @@ main(int argc, char *argv[])
             float y = h * face_id;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-            render_cropped_eye_image (&captex, x, y, w, h, &face_detect_ret.faces[face_id], &face_mesh_ret[face_id], 0);
+            PMETER_SCOPE_BEGIN ("render_cropped_eye_image");
+            render_cropped_eye_image (&captex, x, y, w, h, &face_detect_ret->faces[face_id], &face_mesh_ret[face_id], 0);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("render_iris_landmark");
             render_iris_landmark (x, y, w, h, &iris_mesh_ret[face_id][0]);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
 
             x += w;
-            render_cropped_eye_image (&captex, x, y, w, h, &face_detect_ret.faces[face_id], &face_mesh_ret[face_id], 1);
+            PMETER_SCOPE_BEGIN ("render_cropped_eye_image");
+            render_cropped_eye_image (&captex, x, y, w, h, &face_detect_ret->faces[face_id], &face_mesh_ret[face_id], 1);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("render_iris_landmark");
             render_iris_landmark (x, y, w, h, &iris_mesh_ret[face_id][1]);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -897,11 +953,14 @@ main(int argc, char *argv[])
         glViewport (0, 0, win_w, win_h);
         draw_pmeter (0, 40);
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]\nTFLite2 :%5.1f [ms]",
-            interval, invoke_ms0, invoke_ms1, invoke_ms2);
+        len  = sprintf (strbuf, "Interval:%5.1f [ms]\nFrameLag:%3d\n",
+                        interval, (result_frame >= 0) ? count - result_frame : 0);
+        pipeline_format_stats (&pipeline, strbuf + len, sizeof (strbuf) - len);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
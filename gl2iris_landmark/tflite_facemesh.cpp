@@ -3,8 +3,12 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
+#include "util_tflite_loader.h"
 #include "tflite_facemesh.h"
 #include <list>
+#include <float.h>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/models/face_detection_front.tflite
@@ -33,8 +37,12 @@ static tflite_tensor_t      s_iris_tensor_input;
 static tflite_tensor_t      s_iris_tensor_iris;
 static tflite_tensor_t      s_iris_tensor_eye;
 
+static tflite_loader_t      s_loader;
+
 static std::list<fvec2> s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * determine where the anchor points are scatterd.
  *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
@@ -79,7 +87,7 @@ create_blazeface_anchors(int input_w, int input_h)
  *  Create TFLite Interpreter
  * -------------------------------------------------- */
 int
-init_tflite_facemesh (int use_quantized_tflite)
+start_init_tflite_facemesh (int use_quantized_tflite)
 {
     const char *detect_model;
     const char *mesh_model;
@@ -98,20 +106,44 @@ init_tflite_facemesh (int use_quantized_tflite)
         iris_model   = IRIS_LANDMARK_MODEL_PATH;
     }
 
+    /* the interpreters are built on the loader threads */
+    tflite_loader_start (&s_loader, 3);
+    tflite_loader_add (&s_loader, &s_detect_interpreter, detect_model);
+    tflite_loader_add (&s_loader, &s_mesh_interpreter,   mesh_model);
+    tflite_loader_add (&s_loader, &s_iris_interpreter,   iris_model);
+
+    return 0;
+}
+
+/*
+ *  wait for the interpreters started by start_init_tflite_facemesh(),
+ *  (or build them here if not started yet) and bind the tensors.
+ */
+int
+init_tflite_facemesh (int use_quantized_tflite)
+{
+    if (!s_loader.started)
+        start_init_tflite_facemesh (use_quantized_tflite);
+
+    if (tflite_loader_wait (&s_loader) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
     /* Face detect */
-    tflite_create_interpreter_from_file (&s_detect_interpreter, detect_model);
     tflite_get_tensor_by_name (&s_detect_interpreter, 0, "input",          &s_detect_tensor_input);
     tflite_get_tensor_by_name (&s_detect_interpreter, 1, "regressors",     &s_detect_tensor_bboxes);
     tflite_get_tensor_by_name (&s_detect_interpreter, 1, "classificators", &s_detect_tensor_scores);
 
     /* Facemesh Landmark */
-    tflite_create_interpreter_from_file (&s_mesh_interpreter, mesh_model);
+    tflite_enable_idle_release (&s_mesh_interpreter);
     tflite_get_tensor_by_name (&s_mesh_interpreter, 0, "input_1",   &s_mesh_tensor_input);
     tflite_get_tensor_by_name (&s_mesh_interpreter, 1, "conv2d_20", &s_mesh_tensor_landmark);
     tflite_get_tensor_by_name (&s_mesh_interpreter, 1, "conv2d_30", &s_mesh_tensor_score);
 
     /* Iris Landmark */
-    tflite_create_interpreter_from_file (&s_iris_interpreter, iris_model);
+    tflite_enable_idle_release (&s_iris_interpreter);
     tflite_get_tensor_by_name (&s_iris_interpreter, 0, "input_1",                        &s_iris_tensor_input);
     tflite_get_tensor_by_name (&s_iris_interpreter, 1, "output_eyes_contours_and_brows", &s_iris_tensor_eye);
     tflite_get_tensor_by_name (&s_iris_interpreter, 1, "output_iris",                    &s_iris_tensor_iris);
@@ -120,6 +152,8 @@ init_tflite_facemesh (int use_quantized_tflite)
     int det_input_h = s_detect_tensor_input.dims[1];
     create_blazeface_anchors (det_input_w, det_input_h);
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -136,6 +170,7 @@ get_facemesh_landmark_input_buf (int *w, int *h)
 {
     *w = s_mesh_tensor_input.dims[2];
     *h = s_mesh_tensor_input.dims[1];
+    tflite_begin_use (&s_mesh_interpreter);      /* allocate the arena again if released */
     return s_mesh_tensor_input.ptr;
 }
 
@@ -144,6 +179,7 @@ get_irismesh_landmark_input_buf (int *w, int *h)
 {
     *w = s_iris_tensor_input.dims[2];
     *h = s_iris_tensor_input.dims[1];
+    tflite_begin_use (&s_iris_interpreter);      /* allocate the arena again if released */
     return s_iris_tensor_input.ptr;
 }
 
@@ -194,7 +230,7 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
@@ -305,7 +341,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -434,7 +470,7 @@ sort_right_major (face_t &v1, face_t &v2)
 }
 
 static void
-pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_list)
+pack_face_result (face_detect_result_t *facedet_result, arena_list<face_t> &face_list)
 {
     face_list.sort (sort_right_major);
 
@@ -463,15 +499,21 @@ int
 invoke_face_detect (face_detect_result_t *facedet_result)
 {
     //capture_to_img ("detect", s_detect_tensor_input.dims[2], s_detect_tensor_input.dims[1], (float *)s_detect_tensor_input.ptr);
+    /* a frame per face detection, for the idle release of the other models */
+    tflite_idle_next_frame ();
+
     if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = 0.75f;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
@@ -480,7 +522,7 @@ invoke_face_detect (face_detect_result_t *facedet_result)
 
 #if 1 /* USE NMS */
     float iou_thresh = 0.3f;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (facedet_result, face_nms_list);
@@ -488,10 +530,148 @@ invoke_face_detect (face_detect_result_t *facedet_result)
     pack_face_result (facedet_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_face_detect");
+    frame_arena_end ();
+
     return 0;
 }
 
- 
+
+
+/* -------------------------------------------------- *
+ *  Track face ROI from the mesh landmarks
+ *
+ *  the ROI of the next frame is computed from the 468
+ *  landmarks of the current frame, so that the face
+ *  detector is needed only at intervals or on loss.
+ *  (mediapipe/modules/face_landmark/face_landmark_landmarks_to_roi.pbtxt)
+ * -------------------------------------------------- */
+#define FACE_TRACK_IOU_THRESH   0.3f
+
+/* facemesh index for each BlazeFace keypoint */
+static const int s_face_key_joint[kFaceKeyNum] = {
+    33,     /* kRightEye (outer corner) */
+    263,    /* kLeftEye  (outer corner) */
+    1,      /* kNose     */
+    13,     /* kMouth    */
+    234,    /* kRightEar */
+    454,    /* kLeftEar  */
+};
+
+static int s_next_track_id = 0;
+
+/* landmark (normalized to the ROI) ==> image coordinate */
+static fvec2
+landmark_to_image (face_t &roi, fvec3 &joint)
+{
+    fvec2 pos;
+    pos.x = (joint.x - 0.5f) * roi.face_w;
+    pos.y = (joint.y - 0.5f) * roi.face_h;
+
+    rot_vec (pos, roi.rotation);
+    pos.x += roi.face_cx;
+    pos.y += roi.face_cy;
+    return pos;
+}
+
+static void
+compute_face_roi_from_landmark (face_t &face, face_landmark_result_t *facemesh)
+{
+    face_t roi = face;
+    float x_min = FLT_MAX, x_max = -FLT_MAX;
+    float y_min = FLT_MAX, y_max = -FLT_MAX;
+
+    for (int i = 0; i < FACE_KEY_NUM; i ++)
+    {
+        fvec2 p = landmark_to_image (roi, facemesh->joint[i]);
+        x_min = std::min (x_min, p.x);  x_max = std::max (x_max, p.x);
+        y_min = std::min (y_min, p.y);  y_max = std::max (y_max, p.y);
+    }
+
+    for (int i = 0; i < kFaceKeyNum; i ++)
+        face.keys[i] = landmark_to_image (roi, facemesh->joint[s_face_key_joint[i]]);
+
+    face.topleft.x  = x_min;
+    face.topleft.y  = y_min;
+    face.btmright.x = x_max;
+    face.btmright.y = y_max;
+
+    /* rotation from the eye corners, then the same expansion as the detector */
+    compute_rotation (face);
+    compute_face_rect (face);
+}
+
+/*
+ *  inherit the track ID of the previous face which overlaps most,
+ *  otherwise assign a new one.
+ */
+void
+assign_face_track_id (face_detect_result_t *facedet_result, face_detect_result_t *prev_result)
+{
+    int used[MAX_FACE_NUM] = {0};
+
+    for (int i = 0; i < facedet_result->num; i ++)
+    {
+        face_t &face = facedet_result->faces[i];
+        float max_iou = FACE_TRACK_IOU_THRESH;
+        int   max_id  = -1;
+
+        for (int j = 0; j < prev_result->num; j ++)
+        {
+            if (used[j])
+                continue;
+
+            float iou = calc_intersection_over_union (face, prev_result->faces[j]);
+            if (iou >= max_iou)
+            {
+                max_iou = iou;
+                max_id  = j;
+            }
+        }
+
+        if (max_id >= 0)
+        {
+            used[max_id]  = 1;
+            face.track_id = prev_result->faces[max_id].track_id;
+        }
+        else
+        {
+            face.track_id = s_next_track_id ++;
+        }
+    }
+}
+
+/*
+ *  compute the ROIs of the next frame into (track_result).
+ *  returns the number of faces lost in this frame.
+ */
+int
+track_face_roi (face_detect_result_t *track_result, face_detect_result_t *facedet_result,
+                face_landmark_result_t *facemesh_result, float score_thresh)
+{
+    int num_lost = 0;
+
+    track_result->num = 0;
+    for (int i = 0; i < facedet_result->num; i ++)
+    {
+        /* the face flag is a logit */
+        float presence = 1.0f / (1.0f + std::exp (-facemesh_result[i].score));
+        if (presence < score_thresh)
+        {
+            num_lost ++;
+            continue;
+        }
+
+        face_t &face = track_result->faces[track_result->num ++];
+        face = facedet_result->faces[i];
+        face.score = presence;
+        compute_face_roi_from_landmark (face, &facemesh_result[i]);
+    }
+
+    return num_lost;
+}
+
+
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite (Facemesh landmark)
  * -------------------------------------------------- */
@@ -557,6 +737,7 @@ invoke_facemesh_landmark (face_landmark_result_t *facemesh_result)
     if (s_mesh_interpreter.interpreter->Invoke() != kTfLiteOk)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        tflite_end_use (&s_mesh_interpreter);
         return -1;
     }
 
@@ -579,6 +760,7 @@ invoke_facemesh_landmark (face_landmark_result_t *facemesh_result)
 
     compute_eye_roi (facemesh_result);
 
+    tflite_end_use (&s_mesh_interpreter);
     return 0;
 }
 
@@ -597,6 +779,7 @@ invoke_irismesh_landmark (irismesh_result_t *irismesh_result)
     if (s_iris_interpreter.interpreter->Invoke() != kTfLiteOk)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        tflite_end_use (&s_iris_interpreter);
         return -1;
     }
 
@@ -623,6 +806,7 @@ invoke_irismesh_landmark (irismesh_result_t *irismesh_result)
         //    landmark_ptr[3 * i + 0], landmark_ptr[3 * i + 1], landmark_ptr[3 * i + 2]);
     }
 
+    tflite_end_use (&s_iris_interpreter);
     return 0;
 }
 
@@ -47,6 +47,8 @@ typedef struct _face_t
     float face_w;
     float face_h;
     fvec2 face_pos[4];
+
+    int   track_id;
 } face_t;
 
 typedef struct _face_detect_result_t
@@ -87,11 +89,16 @@ typedef struct _irismesh_result_t
 } irismesh_result_t;
 
 
+int  start_init_tflite_facemesh (int use_quantized_tflite);
 int  init_tflite_facemesh (int use_quantized_tflite);
 
 void *get_face_detect_input_buf (int *w, int *h);
 int  invoke_face_detect (face_detect_result_t *facedet_result);
 
+void assign_face_track_id (face_detect_result_t *facedet_result, face_detect_result_t *prev_result);
+int  track_face_roi (face_detect_result_t *track_result, face_detect_result_t *facedet_result,
+                     face_landmark_result_t *facemesh_result, float score_thresh);
+
 void *get_facemesh_landmark_input_buf (int *w, int *h);
 int  invoke_facemesh_landmark (face_landmark_result_t *facemesh_result);
 
@@ -19,6 +19,9 @@
 
 
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
+#include "util_heatmap.h"
 #include "tflite_objectron.h"
 #include <list>
 #include "Eigen/Dense"
@@ -43,6 +46,8 @@ static tflite_tensor_t      s_detect_tensor_heatmap;
 
 static int s_need_post_logistic = 0;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * https://github.com/google/mediapipe/tree/master/mediapipe/graphs/object_detection_3d/calculators/tflite_tensors_to_objects_calculator.cc
  */
@@ -82,6 +87,8 @@ init_tflite_objectron (int use_quantized_tflite)
          0.0f, 1.0f, -1.0f, 1.0f,  0.0f, 1.0f, 1.0f, -1.0f, -2.0f,  1.0f,  1.0f,
          1.0f;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -121,77 +128,36 @@ get_heatmap_val (int x, int y)
     return val;
 }
 
-static float
-get_max_value (int cx, int cy, int hmp_w, int hmp_h, int kern_size)
-{
-    int sx = cx - (kern_size / 2);
-    int ex = cx + (kern_size / 2) + 1;
-    int sy = cy - (kern_size / 2);
-    int ey = cy + (kern_size / 2) + 1;
-
-    sx = std::max (sx, 0);
-    ex = std::min (ex, hmp_w);
-    sy = std::max (sy, 0);
-    ey = std::min (ey, hmp_h);
-
-    float max_val = 0;
-    for (int y = sy; y < ey; y ++)
-    {
-        for (int x = sx; x < ex; x ++)
-        {
-            float val = get_heatmap_val (x, y);
-            max_val = std::max (val, max_val);
-        }
-    }
-
-    return max_val;
-}
-
-static void
-dilate_heatmap (float *dst_hmp, int hmp_w, int hmp_h, int kern_size)
-{
-    for (int y = 0; y < hmp_h; y ++)
-    {
-        for (int x = 0; x < hmp_w; x ++)
-        {
-            dst_hmp[hmp_w * y + x] = get_max_value (x, y, hmp_w, hmp_h, kern_size);
-        }
-    }
-}
-
 static void
-extract_center_keypoints (std::list<fvec2> &center_points)
+extract_center_keypoints (arena_list<fvec2> &center_points)
 {
-    int hmp_w = s_detect_tensor_heatmap.dims[2];
-    int hmp_h = s_detect_tensor_heatmap.dims[1];
-
-    float *max_filtered_heatmap = (float *)malloc (hmp_w * hmp_h * sizeof (float));
+    heatmap_peak_t peaks[MAX_OBJECT_NUM * 4];
+
+    heatmap_t hmp;
+    hmp.ptr = (const float *)s_detect_tensor_heatmap.ptr;
+    hmp.w   = s_detect_tensor_heatmap.dims[2];
+    hmp.h   = s_detect_tensor_heatmap.dims[1];
+    hmp.ch  = 1;
+
+    /*
+     * the quantized model outputs logits. the logistic function is
+     * monotonic, so threshold and local-max test can run on raw values.
+     */
+    float heatmap_threshold = 0.6f;
+    if (s_need_post_logistic)
+        heatmap_threshold = std::log (heatmap_threshold / (1.0f - heatmap_threshold));
 
-    /* apply (5x5) MAX filter */
+    /* local maxima in (5x5) window */
     int local_max_distance = 2;
-    int kernel_size = static_cast<int>(local_max_distance * 2 + 1 + 0.5f);
-    dilate_heatmap (max_filtered_heatmap, hmp_w, hmp_h, kernel_size);
-
-    float heatmap_threshold = 0.6f;
-    for (int y = 0; y < hmp_h; y ++)
+    int num = heatmap_find_local_max (&hmp, 0, local_max_distance, heatmap_threshold,
+                                      peaks, sizeof (peaks) / sizeof (peaks[0]));
+    for (int i = 0; i < num; i ++)
     {
-        for (int x = 0; x < hmp_w; x ++)
-        {
-            float center_hmp_val = get_heatmap_val (x, y);
-            float max_hmp_val    = max_filtered_heatmap[hmp_w * y + x];
-
-            if ((center_hmp_val >= heatmap_threshold) &&
-                (center_hmp_val >= max_hmp_val))
-            {
-                fvec2 locations;
-                locations.x = x;
-                locations.y = y;
-                center_points.push_back (locations);
-            }
-        }
+        fvec2 locations;
+        locations.x = peaks[i].pos_x;
+        locations.y = peaks[i].pos_y;
+        center_points.push_back (locations);
     }
-
-    free (max_filtered_heatmap);
 }
 
 /*
@@ -206,7 +172,7 @@ decode_by_voting (int cx, int cy, float offset_scale_x, float offset_scale_y, ob
     float *center_offset = &offsetmap[16 * ((cy * map_w) + cx)];
 
     /* transform BBOX offsetmap. (relative offset) --> (absolute offset) */
-    float *center_votes = (float *)malloc (16 * map_w * map_h * sizeof (float));
+    float center_votes[16];
     for (int i = 0; i < 8; i ++)
     {
         center_votes[2 * i    ] = cx + center_offset[2 * i    ] * offset_scale_x;
@@ -259,8 +225,6 @@ decode_by_voting (int cx, int cy, float offset_scale_x, float offset_scale_y, ob
         obj->bbox[i].x = x_sum / votes;
         obj->bbox[i].y = y_sum / votes;
     }
-
-    free (center_votes);
 }
 
 
@@ -282,7 +246,7 @@ IsIdentical (const object_t& box_1, const object_t& box_2)
 
 
 static bool
-IsNewBox (std::list<object_t> *obj_list, object_t *obj_item)
+IsNewBox (arena_list<object_t> *obj_list, object_t *obj_item)
 {
     for (auto& b : *obj_list)
     {
@@ -359,7 +323,7 @@ Lift2DTo3D(
     // only! If you use other Eigen Solvers, it's not guaranteed to be in
     // increasing order. Here, we just take the eigen vector corresponding
     // to first/smallest eigen value, since we used SelfAdjointEigenSolver.
-    Eigen::VectorXf eigen_vec = eigen_solver.eigenvectors().col(0);
+    Eigen::Matrix<float, 12, 1> eigen_vec = eigen_solver.eigenvectors().col(0);   /* fixed size: no heap */
     Eigen::Map<Eigen::Matrix<float, 4, 3, Eigen::RowMajor>> control_matrix(
         eigen_vec.data());
     if (control_matrix(0, 2) > 0) {
@@ -419,7 +383,7 @@ Project3DTo2D (bool portrait, object_t *object)
 
 
 static void
-pack_objectron_result (objectron_result_t *objectron_result, std::list<object_t> &bbox_list)
+pack_objectron_result (objectron_result_t *objectron_result, arena_list<object_t> &bbox_list)
 {
     int num_obj = 0;
     for (auto itr = bbox_list.begin(); itr != bbox_list.end(); itr ++)
@@ -459,10 +423,13 @@ invoke_objectron (objectron_result_t *objectron_result)
     float offset_scaley = ofstmap_h;
 #endif
 
-    std::list<fvec2> center_points;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<fvec2> center_points;
     extract_center_keypoints (center_points);
 
-    std::list<object_t> obj_list;
+    arena_list<object_t> obj_list;
     for (auto &center_point : center_points)
     {
         int cx = static_cast<int>(std::round(center_point.x));
@@ -494,5 +461,8 @@ invoke_objectron (objectron_result_t *objectron_result)
 
     pack_objectron_result (objectron_result, obj_list);
 
+    ALLOC_CHECK_END ("invoke_objectron");
+    frame_arena_end ();
+
     return 0;
 }
@@ -3,8 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_heatmap.h"
 #include "tflite_pose3d.h"
-#include <float.h>
 
 #define POSENET_MODEL_PATH          "./model/human_pose_estimation_3d_0001_256x448_float.tflite"
 
@@ -61,53 +61,6 @@ get_pose3d_input_buf (int *w, int *h)
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite
  * -------------------------------------------------- */
-static float
-get_heatmap_score (int idx_y, int idx_x, int key_id)
-{
-    int idx = (idx_y * s_hmp_w * kPoseKeyNum) + (idx_x * kPoseKeyNum) + key_id;
-    float *heatmap_ptr = (float *)s_tensor_heatmap.ptr;
-    return heatmap_ptr[idx];
-}
-
-static void
-get_offset_vector (float *ofst_x, float *ofst_y, float *ofst_z, int idx_y, int idx_x, int pose_id_)
-{
-    int map_id_to_panoptic[] = {1, 0,  9, 10, 11, 3, 4, 5, 12, 13, 14, 6, 7, 8, 15, 16, 17, 18, 2};
-    int pose_id = map_id_to_panoptic[pose_id_];
-
-    int idx0 = (idx_y * s_hmp_w * kPoseKeyNum*3) + (idx_x * kPoseKeyNum*3) + (3 * pose_id + 0);
-    int idx1 = (idx_y * s_hmp_w * kPoseKeyNum*3) + (idx_x * kPoseKeyNum*3) + (3 * pose_id + 1);
-    int idx2 = (idx_y * s_hmp_w * kPoseKeyNum*3) + (idx_x * kPoseKeyNum*3) + (3 * pose_id + 2);
-
-    float *offsets_ptr = (float *)s_tensor_offsets.ptr;
-
-    *ofst_x = offsets_ptr[idx0];
-    *ofst_y = offsets_ptr[idx1];
-    *ofst_z = offsets_ptr[idx2];
-}
-
-
-
-
-static void
-get_index_to_pos (int idx_x, int idx_y, int key_id, fvec2 *pos2d, fvec3 *pos3d)
-{
-    float ofst_x, ofst_y, ofst_z;
-    get_offset_vector (&ofst_x, &ofst_y, &ofst_z, idx_y, idx_x, key_id);
-
-    /* pos 2D */
-    pos2d->x = (float)idx_x / (float)(s_hmp_w -1);
-    pos2d->y = (float)idx_y / (float)(s_hmp_h -1);
-
-    /* pos 3D */
-    pos3d->x = ofst_x;
-    pos3d->y = ofst_y;
-    pos3d->z = ofst_z;
-}
-
-
-
-
 static void
 decode_multiple_poses (posenet_result_t *pose_result)
 {
@@ -117,68 +70,40 @@ decode_multiple_poses (posenet_result_t *pose_result)
 static void
 decode_single_pose (posenet_result_t *pose_result)
 {
-    int   max_block_idx[kPoseKeyNum][2] = {0};
-    float max_block_cnf[kPoseKeyNum]    = {0};
+    static const int map_id_to_panoptic[] = {1, 0,  9, 10, 11, 3, 4, 5, 12, 13, 14, 6, 7, 8, 15, 16, 17, 18, 2};
+    heatmap_peak_t peaks[kPoseKeyNum];
+
+    heatmap_t hmp;
+    hmp.ptr = (const float *)s_tensor_heatmap.ptr;
+    hmp.w   = s_hmp_w;
+    hmp.h   = s_hmp_h;
+    hmp.ch  = kPoseKeyNum;
+
+    /* offsets are (x, y, z) interleaved, in panoptic keypoint order. */
+    heatmap_offset_t ofst;
+    ofst.ptr          = (const float *)s_tensor_offsets.ptr;
+    ofst.ch           = kPoseKeyNum * 3;
+    ofst.key_stride   = 3;
+    ofst.comp_ofst[0] = 0;
+    ofst.comp_ofst[1] = 1;
+    ofst.comp_ofst[2] = 2;
+    ofst.key_remap    = map_id_to_panoptic;
+
+    /* find the highest heatmap block and its offset vector for each key */
+    heatmap_decode_keypoints (&hmp, &ofst, 0, peaks);
 
-    /* find the highest heatmap block for each key */
-    for (int i = 0; i < kPoseKeyNum; i ++)
+    for (int i = 0; i < kPoseKeyNum;i ++ )
     {
-        float max_confidence = -FLT_MAX;
-        for (int y = 0; y < s_hmp_h; y ++)
-        {
-            for (int x = 0; x < s_hmp_w; x ++)
-            {
-                float confidence = get_heatmap_score (y, x, i);
-                if (confidence > max_confidence)
-                {
-                    max_confidence = confidence;
-                    max_block_cnf[i] = confidence;
-                    max_block_idx[i][0] = x;
-                    max_block_idx[i][1] = y;
-                }
-            }
-        }
-    }
+        heatmap_peak_t *peak = &peaks[i];
 
-#if 0
-    for (int i = 0; i < kPoseKeyNum; i ++)
-    {
-        fprintf (stderr, "---------[%d] --------\n", i);
-        for (int y = 0; y < s_hmp_h; y ++)
-        {
-            fprintf (stderr, "[%d] ", y);
-            for (int x = 0; x < s_hmp_w; x ++)
-            {
-                float confidence = get_heatmap_score (y, x, i);
-                fprintf (stderr, "%6.3f ", confidence);
-
-                if (x == max_block_idx[i][0] && y == max_block_idx[i][1])
-                    fprintf (stderr, "#");
-                else
-                    fprintf (stderr, " ");
-            }
-            fprintf (stderr, "\n");
-        }
-    }
-#endif
+        pose_result->pose[0].key[i].x     = peak->pos_x / (float)(s_hmp_w -1);
+        pose_result->pose[0].key[i].y     = peak->pos_y / (float)(s_hmp_h -1);
+        pose_result->pose[0].key[i].score = peak->score;
 
-    /* find the offset vector and calculate the keypoint coordinates. */
-    for (int i = 0; i < kPoseKeyNum;i ++ )
-    {
-        int idx_x = max_block_idx[i][0];
-        int idx_y = max_block_idx[i][1];
-        fvec2 pos2d;
-        fvec3 pos3d;
-        get_index_to_pos (idx_x, idx_y, i, &pos2d, &pos3d);
-
-        pose_result->pose[0].key[i].x     = pos2d.x;
-        pose_result->pose[0].key[i].y     = pos2d.y;
-        pose_result->pose[0].key[i].score = max_block_cnf[i];
-
-        pose_result->pose[0].key3d[i].x   = pos3d.x;
-        pose_result->pose[0].key3d[i].y   = pos3d.y;
-        pose_result->pose[0].key3d[i].z   = pos3d.z;
-        pose_result->pose[0].key3d[i].score = max_block_cnf[i];
+        pose_result->pose[0].key3d[i].x   = peak->ofst[0];
+        pose_result->pose[0].key3d[i].y   = peak->ofst[1];
+        pose_result->pose[0].key3d[i].z   = peak->ofst[2];
+        pose_result->pose[0].key3d[i].score = peak->score;
     }
     pose_result->num = 1;
     pose_result->pose[0].pose_score = 1.0f;
@@ -3,10 +3,12 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
+#include "util_heatmap.h"
 #include "tflite_posenet.h"
 #include "ssbo_tensor.h"
 #include <list>
-#include <float.h>
 
 /* 
  * [float]
@@ -34,6 +36,8 @@ static int     s_hmp_w = 0;
 static int     s_hmp_h = 0;
 static int     s_edge_num = 0;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 typedef struct part_score_t {
     float score;
     int   idx_x;
@@ -110,6 +114,8 @@ init_tflite_posenet(int use_quantized_tflite, ssbo_t *ssbo)
     /* displacement forward vector dimention */
     s_edge_num = s_tensor_fw_disp.dims[3] / 2;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -153,9 +159,9 @@ get_offset_vector (float *ofst_x, float *ofst_y, int idx_y, int idx_x, int pose_
 
 /* enqueue an item in descending order. */
 static void
-enqueue_score (std::list<part_score_t> &queue, int x, int y, int key, float score)
+enqueue_score (arena_list<part_score_t> &queue, int x, int y, int key, float score)
 {
-    std::list<part_score_t>::iterator itr;
+    arena_list<part_score_t>::iterator itr;
     for (itr = queue.begin(); itr != queue.end(); itr++)
     {
         if (itr->score < score)
@@ -203,7 +209,7 @@ score_is_max_in_local_window (int key, float score, int idx_y, int idx_x, int ma
 }
 
 static void
-build_score_queue (std::list<part_score_t> &queue, float thresh, int max_rad)
+build_score_queue (arena_list<part_score_t> &queue, float thresh, int max_rad)
 {
     for (int y = 0; y < s_hmp_h; y ++)
     {
@@ -410,7 +416,10 @@ regist_detected_pose (posenet_result_t *pose_result, keypoint_t *keys, float sco
 static void
 decode_multiple_poses (posenet_result_t *pose_result)
 {
-    std::list<part_score_t> queue;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<part_score_t> queue;
 
     float score_thresh  = 0.5f;
     int   local_max_rad = 1;
@@ -439,67 +448,45 @@ decode_multiple_poses (posenet_result_t *pose_result)
 
         queue.pop_front();
     }
+
+    ALLOC_CHECK_END ("decode_multiple_poses");
+    frame_arena_end ();
 }
 
 static void
 decode_single_pose (posenet_result_t *pose_result)
 {
-    int   max_block_idx[kPoseKeyNum][2] = {0};
-    float max_block_cnf[kPoseKeyNum]    = {0};
-
-    /* find the highest heatmap block for each key */
-    for (int i = 0; i < kPoseKeyNum; i ++)
-    {
-        float max_confidence = -FLT_MAX;
-        for (int y = 0; y < s_hmp_h; y ++)
-        {
-            for (int x = 0; x < s_hmp_w; x ++)
-            {
-                float confidence = get_heatmap_score (y, x, i);
-                if (confidence > max_confidence)
-                {
-                    max_confidence = confidence;
-                    max_block_cnf[i] = confidence;
-                    max_block_idx[i][0] = x;
-                    max_block_idx[i][1] = y;
-                }
-            }
-        }
-    }
-
-#if 0
-    for (int i = 0; i < kPoseKeyNum; i ++)
-    {
-        fprintf (stderr, "---------[%d] --------\n", i);
-        for (int y = 0; y < s_hmp_h; y ++)
-        {
-            fprintf (stderr, "[%d] ", y);
-            for (int x = 0; x < s_hmp_w; x ++)
-            {
-                float confidence = get_heatmap_score (y, x, i);
-                fprintf (stderr, "%6.3f ", confidence);
-
-                if (x == max_block_idx[i][0] && y == max_block_idx[i][1])
-                    fprintf (stderr, "#");
-                else
-                    fprintf (stderr, " ");
-            }
-            fprintf (stderr, "\n");
-        }
-    }
-#endif
-
-    /* find the offset vector and calculate the keypoint coordinates. */
+    heatmap_peak_t peaks[kPoseKeyNum];
+
+    heatmap_t hmp;
+    hmp.ptr = (const float *)s_tensor_heatmap.ptr;
+    hmp.w   = s_hmp_w;
+    hmp.h   = s_hmp_h;
+    hmp.ch  = kPoseKeyNum;
+
+    /* offsets are [y0, y1, ..., x0, x1, ...] for each block. */
+    heatmap_offset_t ofst;
+    ofst.ptr          = (const float *)s_tensor_offsets.ptr;
+    ofst.ch           = kPoseKeyNum * 2;
+    ofst.key_stride   = 1;
+    ofst.comp_ofst[0] = kPoseKeyNum;
+    ofst.comp_ofst[1] = 0;
+    ofst.comp_ofst[2] = -1;
+    ofst.key_remap    = NULL;
+
+    /* find the highest heatmap block and its offset vector for each key */
+    heatmap_decode_keypoints (&hmp, &ofst, 0, peaks);
+
+    /* calculate the keypoint coordinates. */
     for (int i = 0; i < kPoseKeyNum;i ++ )
     {
-        int idx_x = max_block_idx[i][0];
-        int idx_y = max_block_idx[i][1];
-        float key_posex, key_posey;
-        get_index_to_pos (idx_x, idx_y, i, &key_posex, &key_posey);
+        heatmap_peak_t *peak = &peaks[i];
+        float key_posex = peak->pos_x / (float)(s_hmp_w -1) * s_img_w + peak->ofst[0];
+        float key_posey = peak->pos_y / (float)(s_hmp_h -1) * s_img_h + peak->ofst[1];
 
         pose_result->pose[0].key[i].x     = key_posex / (float)s_img_w;
         pose_result->pose[0].key[i].y     = key_posey / (float)s_img_h;
-        pose_result->pose[0].key[i].score = max_block_cnf[i];
+        pose_result->pose[0].key[i].score = peak->score;
     }
     pose_result->num = 1;
     pose_result->pose[0].pose_score = 1.0f;
@@ -11,9 +11,12 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_segmap.h"
 #include "tflite_deeplab.h"
+#include "util_frame_seq.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
@@ -33,7 +36,10 @@ feed_deeplab_image(texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_deeplab_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -71,50 +77,35 @@ render_deeplab_result (int ofstx, int ofsty, int draw_w, int draw_h,
     int segmap_w  = deeplab_ret->segmentmap_dims[0];
     int segmap_h  = deeplab_ret->segmentmap_dims[1];
     int segmap_c  = deeplab_ret->segmentmap_dims[2];
-    int x, y, c;
-    unsigned int imgbuf[segmap_h][segmap_w];
+    int c;
+    static uint8_t      *s_labels = NULL;
+    static texture_2d_t s_labeltex = {0};
+    static texture_2d_t s_palettetex = {0};
 
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
+    if (s_labels == NULL)
     {
-        for (x = 0; x < segmap_w; x ++)
+        uint8_t palette[(MAX_DETECT_CLASS + 1) * 4];
+        for (c = 0; c < MAX_DETECT_CLASS + 1; c ++)
         {
-            int max_id;
-            float conf_max = 0;
-            for (c = 0; c < 21; c ++)
-            {
-                float confidence = segmap[(y * segmap_w * segmap_c)+ (x * segmap_c) + c];
-                if (c == 0 || confidence > conf_max)
-                {
-                    conf_max = confidence;
-                    max_id = c;
-                }
-            }
-            float *col = get_deeplab_class_color (max_id);
-            unsigned char r = ((int)(col[0] * 255)) & 0xff;
-            unsigned char g = ((int)(col[1] * 255)) & 0xff;
-            unsigned char b = ((int)(col[2] * 255)) & 0xff;
-            unsigned char a = ((int)(col[3] * 255)) & 0xff;
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
+            float *col = get_deeplab_class_color (c);
+            palette[4 * c + 0] = (uint8_t)(col[0] * 255);
+            palette[4 * c + 1] = (uint8_t)(col[1] * 255);
+            palette[4 * c + 2] = (uint8_t)(col[2] * 255);
+            palette[4 * c + 3] = (uint8_t)(col[3] * 255);
         }
-    }
-    
-    GLuint texid;
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
+        create_2d_palette_texture (&s_palettetex, palette, MAX_DETECT_CLASS + 1);
 
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+        s_labels = (uint8_t *)malloc (segmap_w * segmap_h);
+        mem_register_buffer ("labels", s_labels, segmap_w * segmap_h);
+        create_2d_label_texture (&s_labeltex, NULL, segmap_w, segmap_h);
+    }
 
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,
-        segmap_w, segmap_h, 0, GL_RGBA,
-        GL_UNSIGNED_BYTE, imgbuf);
+    /* find the most confident class for each pixel. */
+    segmap_argmax_u8 (segmap, segmap_w, segmap_h, segmap_c, s_labels);
 
-    draw_2d_texture (texid, ofstx, ofsty, draw_w, draw_h, 0);
+    /* class id --> color conversion is done by the fragment shader. */
+    update_2d_label_texture (&s_labeltex, s_labels);
+    draw_2d_labelmap (s_labeltex.texid, s_palettetex.texid, ofstx, ofsty, draw_w, draw_h, 1.0f, 0);
 
     /* class name */
     for (c = 0; c < 21; c ++)
@@ -126,8 +117,6 @@ render_deeplab_result (int ofstx, int ofsty, int draw_w, int draw_h,
         sprintf (buf, "%2d:%s", c, name);
         draw_dbgstr_ex (buf, ofstx, ofsty + c * 22 * 0.7, 0.7f, col_str, col);
     }
-
-    glDeleteTextures (1, &texid);
 }
 
 void
@@ -202,6 +191,22 @@ render_deeplab_heatmap (int ofstx, int ofsty, int draw_w, int draw_h, deeplab_re
 }
 
 
+/*
+ *  motion gating (-m option).
+ *  return 1 if the scene has changed enough to run the inference.
+ */
+static int
+check_motion (int enable_motion, float *score)
+{
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    if (enable_motion)
+        return check_capture_motion (score);
+#endif
+    *score = 1.0f;
+    return 1;
+}
+
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -260,8 +265,14 @@ main(int argc, char *argv[])
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    int enable_motion = 0;
+    float motion_thresh = 0.002f, motion_score = 1.0f;
+    int motion_max_skip = 30;
+    frame_seq_t fseq;
+    deeplab_result_t deeplab_result;
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -270,18 +281,25 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "v:x";
+        const char *optstring = "m:v:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'm':
+                sscanf (optarg, "%f,%d", &motion_thresh, &motion_max_skip);
+                enable_motion = 1;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -325,8 +343,11 @@ main(int argc, char *argv[])
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
     /* initialize V4L2 capture function */
-    if (enable_camera && init_capture (0) == 0)
+    if (enable_camera && init_capture (enable_motion ? CAPTURE_MOTION_DETECT : 0) == 0)
     {
+        if (set_capture_motion_config (24, motion_thresh, motion_max_skip) < 0)
+            enable_motion = 0;
+
         create_capture_texture (&captex);
         texw = captex.width;
         texh = captex.height;
@@ -340,20 +361,24 @@ main(int argc, char *argv[])
         captex.height = texh;
         captex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
         enable_camera = 0;
+        enable_motion = 0;
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+
+    mem_print_startup_report ();
 
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
     for (count = 0; ; count ++)
     {
-        deeplab_result_t deeplab_result;
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -367,25 +392,41 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  semantic segmentation
+         *  (the last result is reused while the frame is unchanged)
          * --------------------------------------- */
-        feed_deeplab_image (&captex, win_w, win_h);
+        if (frame_seq_is_new (&fseq, captex.frame_seq) &&
+            check_motion (enable_motion, &motion_score))
+        {
+            PMETER_SCOPE_BEGIN ("feed_deeplab_image");
+            feed_deeplab_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
+
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_deeplab");
+            invoke_deeplab (&deeplab_result);
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            invoke_ms = ttime[3] - ttime[2];
+        }
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_deeplab (&deeplab_result);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms = ttime[3] - ttime[2];
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
 
         /* --------------------------------------- *
          *  render scene
@@ -396,7 +437,9 @@ main(int argc, char *argv[])
         /* visualize the segmentation results. */
         glViewport (win_w, 0, win_w, win_h);
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_deeplab_result");
         render_deeplab_result (draw_x, draw_y, draw_w, draw_h, &deeplab_result);
+        PMETER_SCOPE_END ();
 
 #if 0
         render_deeplab_heatmap (draw_x, draw_y, draw_w, draw_h, &deeplab_result);
@@ -408,10 +451,12 @@ main(int argc, char *argv[])
         glViewport (0, 0, win_w, win_h);
         draw_pmeter (0, 40);
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]", interval, invoke_ms);
+        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]\nMotion  :%5.3f", interval, invoke_ms, motion_score);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
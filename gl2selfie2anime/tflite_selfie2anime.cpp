@@ -3,6 +3,8 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "tflite_selfie2anime.h"
 #include <list>
 
@@ -25,6 +27,8 @@ static tflite_tensor_t      s_tensor_segment;
 
 static std::list<fvec2> s_anchors;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * determine where the anchor points are scatterd.
  *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
@@ -77,6 +81,7 @@ init_tflite_selfie2anime()
 
     /* Selfie2Anime */
     tflite_create_interpreter_from_file (&s_interpreter, SELFIE2ANIME_MODEL_PATH);
+    tflite_enable_idle_release (&s_interpreter);
     tflite_get_tensor_by_name (&s_interpreter, 0, "test_domain_A",  &s_tensor_input);
     tflite_get_tensor_by_name (&s_interpreter, 1, "generator_B/Tanh",  &s_tensor_segment);
 
@@ -84,6 +89,8 @@ init_tflite_selfie2anime()
     int det_input_h = s_detect_tensor_input.dims[1];
     create_blazeface_anchors (det_input_w, det_input_h);
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -109,6 +116,7 @@ get_selfie2anime_input_buf (int *w, int *h)
 {
     *w = s_tensor_input.dims[2];
     *h = s_tensor_input.dims[1];
+    tflite_begin_use (&s_interpreter);      /* allocate the arena again if released */
     return s_tensor_input.ptr;
 }
 
@@ -126,7 +134,7 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
@@ -237,7 +245,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -359,7 +367,7 @@ compute_face_rect (face_t &face)
 
 
 static void
-pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_list)
+pack_face_result (face_detect_result_t *facedet_result, arena_list<face_t> &face_list)
 {
     int num_faces = 0;
     for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
@@ -385,15 +393,21 @@ pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_
 int
 invoke_face_detect (face_detect_result_t *facedet_result)
 {
+    /* a frame per face detection, for the idle release of the other models */
+    tflite_idle_next_frame ();
+
     if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = 0.75f;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
@@ -402,7 +416,7 @@ invoke_face_detect (face_detect_result_t *facedet_result)
 
 #if 1 /* USE NMS */
     float iou_thresh = 0.3f;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (facedet_result, face_nms_list);
@@ -410,6 +424,9 @@ invoke_face_detect (face_detect_result_t *facedet_result)
     pack_face_result (facedet_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_face_detect");
+    frame_arena_end ();
+
     return 0;
 }
 
@@ -420,6 +437,7 @@ invoke_selfie2anime (selfie2anime_result_t *selfie2anime_result)
     if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        tflite_end_use (&s_interpreter);
         return -1;
     }
 
@@ -441,6 +459,7 @@ invoke_selfie2anime (selfie2anime_result_t *selfie2anime_result)
     selfie2anime_result->segmentmap_dims[1] = s_tensor_segment.dims[1];
     selfie2anime_result->segmentmap_dims[2] = s_tensor_segment.dims[3];
 
+    tflite_end_use (&s_interpreter);
     return 0;
 }
 
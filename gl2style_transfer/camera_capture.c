@@ -9,6 +9,7 @@
 #include "util_v4l2.h"
 #include "util_debug.h"
 #include "util_texture.h"
+#include "util_memory.h"
 
 //#define USE_YUYV_TO_RGB_CONVERSION
 
@@ -19,6 +20,7 @@ static capture_dev_t *s_cap_dev;
 static int          s_capture_w, s_capture_h;
 static int          s_capcrop_w, s_capcrop_h;
 static unsigned int s_capture_fmt;
+static volatile uint32_t s_capture_seq = 0;  /* incremented for every captured frame */
 
 #define _max(A, B)    ((A) > (B) ? (A) : (B))
 #define _min(A, B)    ((A) < (B) ? (A) : (B))
@@ -33,6 +35,7 @@ convert_to_rgba8888 (void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsi
     if (s_capture_buf == NULL)
     {
         s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 4);
+        mem_register_buffer ("capture", s_capture_buf, cap_w * cap_h * 4);
     }
 
     if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V'))
@@ -101,6 +104,7 @@ copy_yuyv_image (void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsigned
     if (s_capture_buf == NULL)
     {
         s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 2);
+        mem_register_buffer ("capture", s_capture_buf, cap_w * cap_h * 2);
     }
 
     if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V'))
@@ -146,6 +150,7 @@ capture_thread_main ()
         copy_yuyv_image (frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
 #endif
         v4l2_release_capture_frame (s_cap_dev, frame);
+        s_capture_seq ++;
     }
     return 0;
 }
@@ -217,6 +222,13 @@ get_capture_buffer (void ** buf)
     return 0;
 }
 
+/* 0 until the first frame is captured */
+uint32_t
+get_capture_frame_seq ()
+{
+    return s_capture_seq;
+}
+
 int
 start_capture ()
 {
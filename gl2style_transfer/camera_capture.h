@@ -11,6 +11,7 @@ int init_capture ();
 int get_capture_dimension (int *width, int *height);
 int get_capture_pixformat (uint32_t *pixformat);
 int get_capture_buffer (void ** buf);
+uint32_t get_capture_frame_seq ();
 
 int start_capture ();
 
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -11,22 +12,44 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "tflite_style_transfer.h"
+#include "util_async_infer.h"
+#include "util_frame_seq.h"
 #include "camera_capture.h"
 #include "video_decode.h"
 
 #define UNUSED(x) (void)(x)
 
+/*
+ *  a request to the style transfer worker:
+ *      [content image (w * h * 3)][style parameter (style_size)]
+ *  and its result:
+ *      [style_transfer_out_t][transfered image (w * h * 3)]
+ */
+typedef struct _style_transfer_out_t
+{
+    int w, h;
+} style_transfer_out_t;
+
+static async_infer_t s_transfer_runner;
+static int s_content_size;
+static int s_style_size;
+static int s_output_size;
 
 #if defined (USE_INPUT_CAMERA_CAPTURE)
-static void
+static int
 update_capture_texture (texture_2d_t *captex)
 {
     int      cap_w, cap_h;
     uint32_t cap_fmt;
     void     *cap_buf;
+    uint32_t cap_seq = get_capture_frame_seq ();
+
+    if (cap_seq == captex->frame_seq)
+        return 0;
 
     get_capture_dimension (&cap_w, &cap_h);
     get_capture_pixformat (&cap_fmt);
@@ -47,7 +70,10 @@ update_capture_texture (texture_2d_t *captex)
 
         glBindTexture (GL_TEXTURE_2D, captex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, cap_buf);
+        captex->frame_seq = cap_seq;
+        return 1;
     }
+    return 0;
 }
 
 static int
@@ -68,12 +94,16 @@ init_capture_texture (texture_2d_t *captex)
 #endif
 
 #if defined (USE_INPUT_VIDEO_DECODE)
-static void
+static int
 update_video_texture (texture_2d_t *captex)
 {
     int   video_w, video_h;
     uint32_t video_fmt;
     void *video_buf;
+    uint32_t video_seq = get_video_frame_seq ();
+
+    if (video_seq == captex->frame_seq)
+        return 0;
 
     get_video_dimension (&video_w, &video_h);
     get_video_pixformat (&video_fmt);
@@ -95,7 +125,10 @@ update_video_texture (texture_2d_t *captex)
 
         glBindTexture (GL_TEXTURE_2D, captex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, video_buf);
+        captex->frame_seq = video_seq;
+        return 1;
     }
+    return 0;
 }
 
 static int
@@ -119,7 +152,7 @@ init_video_texture (texture_2d_t *captex, const char *fname)
 
 /* resize image to DNN network input size and convert to fp32. */
 void
-feed_style_transfer_image(int is_predict, texture_2d_t *srctex, int win_w, int win_h)
+feed_style_transfer_image(int is_predict, texture_2d_t *srctex, int win_w, int win_h, void *dstbuf)
 {
     int x, y, w, h;
     float *buf_fp32;
@@ -132,11 +165,18 @@ feed_style_transfer_image(int is_predict, texture_2d_t *srctex, int win_w, int w
     else
         buf_fp32 = (float *)get_style_transfer_content_input_buf (&w, &h);
 
+    if (dstbuf)
+        buf_fp32 = (float *)dstbuf;
+
     if (buf_w != w || buf_h != h)
     {
         if (pui8)
+        {
+            mem_unregister_buffer (pui8);
             free (pui8);
+        }
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_style_transfer_image", pui8, w * h * 4);
         buf_w = w;
         buf_h = h;
     }
@@ -184,13 +224,16 @@ store_style_predict (style_predict_t *style)
 }
 
 void
-feed_blend_style (style_predict_t *style0, style_predict_t *style1, float ratio)
+feed_blend_style (style_predict_t *style0, style_predict_t *style1, float ratio, void *dstbuf)
 {
     int size;
     float *s0 = style0->param;
     float *s1 = style1->param;
     float *d = get_style_transfer_style_input_buf (&size);
 
+    if (dstbuf)
+        d = (float *)dstbuf;
+
     if (style0->size != size || style1->size != size)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
@@ -210,6 +253,53 @@ feed_blend_style (style_predict_t *style0, style_predict_t *style1, float ratio)
 }
 
 
+/* -------------------------------------------------- *
+ *  style transfer on the worker thread (util_async_infer)
+ * -------------------------------------------------- */
+static int
+run_style_transfer (void *input, void *output, void *usrdata)
+{
+    style_transfer_t transfer;
+    style_transfer_out_t *out = (style_transfer_out_t *)output;
+    int w, h, size, ret;
+
+    memcpy (get_style_transfer_content_input_buf (&w, &h), input, s_content_size);
+    memcpy (get_style_transfer_style_input_buf (&size), (char *)input + s_content_size, s_style_size);
+
+    PMETER_SCOPE_BEGIN ("invoke_style_transfer");
+    ret = invoke_style_transfer (&transfer);
+    PMETER_SCOPE_END ();
+    if (ret != 0)
+        return -1;
+
+    out->w = transfer.w;
+    out->h = transfer.h;
+    memcpy (out + 1, transfer.img, s_output_size);
+
+    return 0;
+}
+
+static int
+init_style_transfer_runner (int enable_async)
+{
+    int w, h, size;
+    int flags = enable_async ? 0 : ASYNC_INFER_SYNC;
+
+    get_style_transfer_content_input_buf (&w, &h);
+    s_content_size = w * h * 3 * sizeof (float);
+
+    get_style_transfer_style_input_buf (&size);
+    s_style_size = size * sizeof (float);
+
+    get_style_transfer_output_dims (&w, &h);
+    s_output_size = w * h * 3 * sizeof (float);
+
+    return async_infer_init (&s_transfer_runner, s_content_size + s_style_size,
+                             sizeof (style_transfer_out_t) + s_output_size,
+                             run_style_transfer, NULL, flags);
+}
+
+
 /* upload style transfered image to OpenGLES texture */
 static int
 update_style_transfered_texture (style_transfer_t *transfer)
@@ -311,8 +401,19 @@ main(int argc, char *argv[])
     texture_2d_t captex = {0};
     texture_2d_t styletex = {0};
     float style_ratio = -0.1f;
-    double ttime[10] = {0}, interval, invoke_ms;
+    float last_style_ratio = style_ratio;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    int result_frame = -1;
+    int transfered_texid = 0;
+    style_transfer_out_t *transfered_out;
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    int enable_async = 0;   /* the GPU delegate must be invoked on the GL thread */
+#else
+    int enable_async = 1;
+#endif
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -322,7 +423,7 @@ main(int argc, char *argv[])
     /* gl2style_transfer [content_file_name] [style_file_name] */
     {
         int c;
-        const char *optstring = "v:x";
+        const char *optstring = "sv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -334,6 +435,12 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 's':
+                enable_async = 0;
+                break;
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -355,20 +462,15 @@ main(int argc, char *argv[])
     if (input_style_name == NULL)
         input_style_name = input_style_name_default;
 
+    /* the models are loaded in the background while the GL resources are created */
+    start_init_tflite_style_transfer ();
+
     egl_init_with_platform_window_surface (2, 0, 0, 0, win_w, win_h);
 
     init_2d_renderer (win_w, win_h);
     init_pmeter (win_w, win_h, 500);
     init_dbgstr (win_w, win_h);
 
-    init_tflite_style_transfer ();
-
-#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
-    /* we need to recover framebuffer because GPU Delegate changes the context */
-    glBindFramebuffer (GL_FRAMEBUFFER, 0);
-    glViewport (0, 0, win_w, win_h);
-#endif
-
 #if defined (USE_INPUT_VIDEO_DECODE)
     /* initialize FFmpeg video decode */
     if (enable_video && init_video_decode () == 0)
@@ -399,7 +501,16 @@ main(int argc, char *argv[])
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
+    init_tflite_style_transfer ();
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* we need to recover framebuffer because GPU Delegate changes the context */
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+    glViewport (0, 0, win_w, win_h);
+#endif
+
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
 
     /* --------------------------------------- *
      *  Style prediction
@@ -415,26 +526,39 @@ main(int argc, char *argv[])
 
         /* predict style of original image */
         glClear (GL_COLOR_BUFFER_BIT);
-        feed_style_transfer_image (1, &captex, win_w, win_h);
+        PMETER_SCOPE_BEGIN ("feed_style_transfer_image");
+        feed_style_transfer_image (1, &captex, win_w, win_h, NULL);
+        PMETER_SCOPE_END ();
+        PMETER_SCOPE_BEGIN ("invoke_style_predict");
         invoke_style_predict (&style_predict[0]);
+        PMETER_SCOPE_END ();
         store_style_predict (&style_predict[0]);
 
         /* predict style of target image */
         glClear (GL_COLOR_BUFFER_BIT);
-        feed_style_transfer_image (1, &styletex, win_w, win_h);
+        PMETER_SCOPE_BEGIN ("feed_style_transfer_image");
+        feed_style_transfer_image (1, &styletex, win_w, win_h, NULL);
+        PMETER_SCOPE_END ();
+        PMETER_SCOPE_BEGIN ("invoke_style_predict");
         invoke_style_predict (&style_predict[1]);
+        PMETER_SCOPE_END ();
         store_style_predict (&style_predict[1]);
     }
 
+    init_style_transfer_runner (enable_async);
+    transfered_out = (style_transfer_out_t *)calloc (1, s_transfer_runner.output_size);
+
     /* --------------------------------------- *
      *  Style transfer
      * --------------------------------------- */
+    mem_print_startup_report ();
+
     for (count = 0; ; count ++)
     {
-        style_transfer_t style_transfered = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -447,13 +571,17 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
@@ -469,20 +597,48 @@ main(int argc, char *argv[])
 #else
         style_ratio = 1.0f;
 #endif
+        if (style_ratio != last_style_ratio)
+        {
+            last_style_ratio = style_ratio;
+            frame_seq_invalidate (&fseq);
+        }
+
+        /*
+         *  feed style parameter and original image.
+         *  the style transfer runs on the worker thread. a new frame is
+         *  fed only when it is idle, so the render loop never waits.
+         *  (the same frame with the same style is not fed again)
+         */
+        int changed = 0;
+        if (!async_infer_is_busy (&s_transfer_runner) &&
+            frame_seq_is_new (&fseq, captex.frame_seq))
+        {
+            char *req = (char *)async_infer_get_input_buf (&s_transfer_runner);
+            PMETER_SCOPE_BEGIN ("feed_blend_style");
+            feed_blend_style (&style_predict[0], &style_predict[1], style_ratio, req + s_content_size);
+            PMETER_SCOPE_END ();
+            PMETER_SCOPE_BEGIN ("feed_style_transfer_image");
+            feed_style_transfer_image (0, &captex, win_w, win_h, req);
+            PMETER_SCOPE_END ();
+            async_infer_submit (&s_transfer_runner, count);
+        }
 
-        /* feed style parameter and original image */
-        feed_blend_style (&style_predict[0], &style_predict[1], style_ratio);
-        feed_style_transfer_image (0, &captex, win_w, win_h);
+        /* upload the transfered image only when a new one has arrived */
+        if (async_infer_get_result (&s_transfer_runner, transfered_out, &result_frame, &invoke_ms) > 0)
+        {
+            style_transfer_t style_transfered;
+            style_transfered.w   = transfered_out->w;
+            style_transfered.h   = transfered_out->h;
+            style_transfered.img = transfered_out + 1;
+            transfered_texid = update_style_transfered_texture (&style_transfered);
+            changed = 1;
+        }
 
-        /* invoke pose estimation using TensorflowLite */
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_style_transfer (&style_transfered);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms = ttime[3] - ttime[2];
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, changed))
+            continue;
 
         /* visualize the style transform results. */
         glClear (GL_COLOR_BUFFER_BIT);
-        int transfered_texid = update_style_transfered_texture (&style_transfered);
 #if 0
         if (style_ratio < 0.0f)     /* render original content image */
             draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
@@ -490,7 +646,8 @@ main(int argc, char *argv[])
             draw_2d_texture (transfered_texid,  draw_x, draw_y, draw_w, draw_h, 0);
 #else
         draw_2d_texture_ex (&captex, 0, 0, 750, 540, 0);
-        draw_2d_texture (transfered_texid, 720, 0, 720, 540, 0);
+        if (transfered_texid)
+            draw_2d_texture (transfered_texid, 720, 0, 720, 540, 0);
 #endif        
         /* render the target style image */
         {
@@ -501,11 +658,13 @@ main(int argc, char *argv[])
 
         draw_pmeter (0, 40);
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]\nstyle_ratio=%.1f", 
-                                interval, invoke_ms, style_ratio);
+        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]\nFrameLag:%3d\nstyle_ratio=%.1f", 
+                                interval, invoke_ms, (result_frame >= 0) ? count - result_frame : 0, style_ratio);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -3,6 +3,7 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_tflite_loader.h"
 #include "tflite_style_transfer.h"
 #include <list>
 
@@ -26,21 +27,45 @@ static tflite_tensor_t      s_transfer_tensor_content_in;
 static tflite_tensor_t      s_transfer_tensor_style_in;
 static tflite_tensor_t      s_transfer_tensor_output;
 
+static tflite_loader_t      s_loader;
 
+
+int
+start_init_tflite_style_transfer ()
+{
+    /* the interpreters are built on the loader threads */
+    tflite_loader_start (&s_loader, 2);
+    tflite_loader_add (&s_loader, &s_interpreter_style_predict,  STYLE_PREDICT_MODEL_PATH);
+    tflite_loader_add (&s_loader, &s_interpreter_style_transfer, STYLE_TRANSFER_MODEL_PATH);
+
+    return 0;
+}
+
+/*
+ *  wait for the interpreters started by start_init_tflite_style_transfer(),
+ *  (or build them here if not started yet) and bind the tensors.
+ */
 int
 init_tflite_style_transfer ()
 {
     tflite_interpreter_t *p;
 
+    if (!s_loader.started)
+        start_init_tflite_style_transfer ();
+
+    if (tflite_loader_wait (&s_loader) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
     /* predict */
     p = &s_interpreter_style_predict;
-    tflite_create_interpreter_from_file (p, STYLE_PREDICT_MODEL_PATH);
     tflite_get_tensor_by_name (p, 0, "style_image",                 &s_predict_tensor_input);
     tflite_get_tensor_by_name (p, 1, "mobilenet_conv/Conv/BiasAdd", &s_predict_tensor_output);
 
     /* transfeer */
     p = &s_interpreter_style_transfer;
-    tflite_create_interpreter_from_file (p, STYLE_TRANSFER_MODEL_PATH);
     tflite_get_tensor_by_name (p, 0, "content_image",               &s_transfer_tensor_content_in);
     tflite_get_tensor_by_name (p, 0, "mobilenet_conv/Conv/BiasAdd", &s_transfer_tensor_style_in);
     tflite_get_tensor_by_name (p, 1, "transformer/expand/conv3/conv/Sigmoid", &s_transfer_tensor_output);
@@ -71,6 +96,13 @@ get_style_transfer_content_input_buf (int *w, int *h)
     return (float *)s_transfer_tensor_content_in.ptr;
 }
 
+void
+get_style_transfer_output_dims (int *w, int *h)
+{
+    *w = s_transfer_tensor_output.dims[2];
+    *h = s_transfer_tensor_output.dims[1];
+}
+
 
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite
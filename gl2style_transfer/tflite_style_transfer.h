@@ -23,10 +23,12 @@ typedef struct _style_transfer_t
 } style_transfer_t;
 
 
+int start_init_tflite_style_transfer ();
 int init_tflite_style_transfer ();
 void  *get_style_predict_input_buf (int *w, int *h);
 void  *get_style_transfer_style_input_buf (int *size);
 void  *get_style_transfer_content_input_buf (int *w, int *h);
+void   get_style_transfer_output_dims (int *w, int *h);
 
 int invoke_style_predict (style_predict_t  *predict_result);
 int invoke_style_transfer(style_transfer_t *transfer_result);
@@ -9,6 +9,7 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include "util_texture.h"
+#include "util_memory.h"
 
 static pthread_t        s_decode_thread;
 static AVFormatContext  *s_fmt_ctx;
@@ -21,6 +22,7 @@ static unsigned int     s_video_fmt;
 static int64_t          s_duration_base;
 
 static void             *s_decode_buf = NULL;
+static volatile uint32_t s_decode_seq = 0;      /* incremented for every decoded frame */
 
 int
 init_video_decode ()
@@ -136,6 +138,13 @@ get_video_buffer (void ** buf)
     return 0;
 }
 
+/* 0 until the first frame is decoded */
+uint32_t
+get_video_frame_seq ()
+{
+    return s_decode_seq;
+}
+
 static int 
 save_to_ppm (AVFrame *frame, int width, int height, int icnt)
 {
@@ -167,6 +176,7 @@ convert_to_rgba8888 (AVFrame *frame, int ofstx, int ofsty, int width, int height
     if (s_decode_buf == NULL)
     {
         s_decode_buf = (unsigned char *)malloc (width * height * 4);
+        mem_register_buffer ("decode", s_decode_buf, width * height * 4);
     }
 
     for (int y = 0; y < height; y ++)
@@ -201,6 +211,7 @@ on_frame_decoded (AVFrame *frame)
     }
 
     convert_to_rgba8888 (frame, ofstx, ofsty, s_crop_w, s_crop_h);
+    s_decode_seq ++;
 
     return 0;
 }
@@ -10,6 +10,7 @@ int open_video_file (const char *fname);
 int get_video_dimension (int *width, int *height);
 int get_video_pixformat (uint32_t *pixformat);
 int get_video_buffer (void ** buf);
+uint32_t get_video_frame_seq ();
 
 int start_video_decode ();
 
@@ -19,6 +19,7 @@ static capture_dev_t *s_cap_dev;
 static int          s_capture_w, s_capture_h;
 static int          s_capcrop_w, s_capcrop_h;
 static unsigned int s_capture_fmt;
+static volatile uint32_t s_capture_seq = 0;  /* incremented for every captured frame */
 
 #define _max(A, B)    ((A) > (B) ? (A) : (B))
 #define _min(A, B)    ((A) < (B) ? (A) : (B))
@@ -146,6 +147,7 @@ capture_thread_main ()
         copy_yuyv_image (frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
 #endif
         v4l2_release_capture_frame (s_cap_dev, frame);
+        s_capture_seq ++;
     }
     return 0;
 }
@@ -211,6 +213,13 @@ get_capture_buffer (void ** buf)
     return 0;
 }
 
+/* 0 until the first frame is captured */
+uint32_t
+get_capture_frame_seq ()
+{
+    return s_capture_seq;
+}
+
 int
 start_capture ()
 {
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -11,10 +12,12 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "util_matrix.h"
 #include "tflite_textdet.h"
+#include "util_frame_seq.h"
 #include "camera_capture.h"
 #include "video_decode.h"
 #include "render_imgui.h"
@@ -23,12 +26,16 @@
 
 
 #if defined (USE_INPUT_CAMERA_CAPTURE)
-static void
+static int
 update_capture_texture (texture_2d_t *captex)
 {
     int      cap_w, cap_h;
     uint32_t cap_fmt;
     void     *cap_buf;
+    uint32_t cap_seq = get_capture_frame_seq ();
+
+    if (cap_seq == captex->frame_seq)
+        return 0;
 
     get_capture_dimension (&cap_w, &cap_h);
     get_capture_pixformat (&cap_fmt);
@@ -49,7 +56,10 @@ update_capture_texture (texture_2d_t *captex)
 
         glBindTexture (GL_TEXTURE_2D, captex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, cap_buf);
+        captex->frame_seq = cap_seq;
+        return 1;
     }
+    return 0;
 }
 
 static int
@@ -70,12 +80,16 @@ init_capture_texture (texture_2d_t *captex)
 #endif
 
 #if defined (USE_INPUT_VIDEO_DECODE)
-static void
+static int
 update_video_texture (texture_2d_t *captex)
 {
     int   video_w, video_h;
     uint32_t video_fmt;
     void *video_buf;
+    uint32_t video_seq = get_video_frame_seq ();
+
+    if (video_seq == captex->frame_seq)
+        return 0;
 
     get_video_dimension (&video_w, &video_h);
     get_video_pixformat (&video_fmt);
@@ -97,7 +111,10 @@ update_video_texture (texture_2d_t *captex)
 
         glBindTexture (GL_TEXTURE_2D, captex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, video_buf);
+        captex->frame_seq = video_seq;
+        return 1;
     }
+    return 0;
 }
 
 static int
@@ -129,7 +146,10 @@ feed_textdet_image(texture_2d_t *srctex, int win_w, int win_h)
     static unsigned char *pui8 = NULL;
 
     if (pui8 == NULL)
+    {
         pui8 = (unsigned char *)malloc(w * h * 4);
+        mem_register_buffer ("feed_textdet_image", pui8, w * h * 4);
+    }
 
     buf_ui8 = pui8;
 
@@ -294,9 +314,14 @@ main(int argc, char *argv[])
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    double ttime[10] = {0}, interval, invoke_ms;
+    double ttime[10] = {0}, interval, invoke_ms = 0;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int enable_idle = 0;
+    frame_seq_t fseq;
+    detect_result_t detect_ret = {0};
+    detect_config_t last_config;
+    int benchmark_iter = 0;
     imgui_data_t imgui_data = {0};
     UNUSED (argc);
     UNUSED (*argv);
@@ -306,12 +331,15 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "b:qv:wx";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'b':
+                benchmark_iter = atoi (optarg);
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
@@ -321,6 +349,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'w':
+                enable_idle = 1;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -384,13 +415,17 @@ main(int argc, char *argv[])
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
+    frame_seq_init (&fseq, enable_idle);
+    last_config = imgui_data.detect_config;
+
+    mem_print_startup_report ();
 
     for (count = 0; ; count ++)
     {
-        detect_result_t detect_ret = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -403,29 +438,61 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
-        /* invoke pose estimation using TensorflowLite */
-        feed_textdet_image (&captex, win_w, win_h);
+        /* the last result is reused while the frame and the config are unchanged */
+        if (memcmp (&last_config, &imgui_data.detect_config, sizeof (last_config)) != 0)
+        {
+            last_config = imgui_data.detect_config;
+            frame_seq_invalidate (&fseq);
+        }
+
+        if (frame_seq_is_new (&fseq, captex.frame_seq))
+        {
+            /* invoke pose estimation using TensorflowLite */
+            PMETER_SCOPE_BEGIN ("feed_textdet_image");
+            feed_textdet_image (&captex, win_w, win_h);
+            PMETER_SCOPE_END ();
+
+            /* measure the post-process on this frame, then exit. */
+            if (benchmark_iter > 0)
+            {
+                benchmark_textdet (&imgui_data.detect_config, benchmark_iter);
+                break;
+            }
+
+            memset (&detect_ret, 0, sizeof (detect_ret));
+
+            ttime[2] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_textdet");
+            invoke_textdet (&detect_ret, &imgui_data.detect_config);
+            PMETER_SCOPE_END ();
+            ttime[3] = pmeter_get_time_ms ();
+            invoke_ms = ttime[3] - ttime[2];
+        }
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_textdet (&detect_ret, &imgui_data.detect_config);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms = ttime[3] - ttime[2];
+        if (!frame_seq_need_render (&fseq, captex.frame_seq, 0))
+            continue;
 
         glClear (GL_COLOR_BUFFER_BIT);
 
         /* visualize the object detection results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
         render_detect_region (draw_x, draw_y, draw_w, draw_h, &detect_ret, &imgui_data);
+        PMETER_SCOPE_END ();
 
         draw_pmeter (0, 40);
 
@@ -433,9 +500,13 @@ main(int argc, char *argv[])
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&imgui_data);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
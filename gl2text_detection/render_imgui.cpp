@@ -51,6 +51,11 @@ render_gui (imgui_data_t *imgui_data)
 
     ImGui::SliderFloat("Score thresh", &imgui_data->detect_config.score_thresh, 0.0f, 1.0f);
     ImGui::SliderFloat("IOU   thresh", &imgui_data->detect_config.iou_thresh,   0.0f, 1.0f);
+    {
+        bool use_lanms = imgui_data->detect_config.use_lanms;
+        ImGui::Checkbox("Locality-Aware NMS", &use_lanms);
+        imgui_data->detect_config.use_lanms = use_lanms;
+    }
 
     ImVec4 frame_color;
     frame_color.x = imgui_data->frame_color[0];
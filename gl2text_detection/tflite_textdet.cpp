@@ -3,8 +3,19 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_heatmap.h"
 #include "tflite_textdet.h"
-#include <list>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#include <arm_neon.h>
+#define TEXTDET_USE_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define TEXTDET_USE_SSE2
+#endif
 
 /* 
  * https://tfhub.dev/sayakpaul/lite-model/east-text-detector/int8/1
@@ -55,6 +66,7 @@ init_tflite_textdet(int use_quantized_tflite, detect_config_t *config)
 
     config->score_thresh = 0.75f;
     config->iou_thresh   = 0.3f;
+    config->use_lanms    = 1;
 
     return 0;
 }
@@ -107,124 +119,371 @@ get_angle_ptr (int x, int y)
     }
 }
 
+/*
+ *  rotated text box.
+ *
+ *  (px, py) is the pivot (bottom-right corner before rotation) and
+ *  the box spans (px - w, py - h) ... (px, py), rotated by -angle
+ *  around the pivot. this is the same convention as the renderer.
+ */
+typedef struct _text_box_t
+{
+    float px, py;
+    float w, h;
+    float angle;
+    float score;        /* max score of merged boxes (displayed) */
+    float weight;       /* sum of scores of merged boxes (NMS order) */
+    fvec2 quad[4];      /* corners in input image pixels */
+} text_box_t;
+
+static void
+update_box_quad (text_box_t *box)
+{
+    float c = cosf (box->angle);
+    float s = sinf (box->angle);
+    float dx[4] = {-box->w,       0, 0, -box->w};
+    float dy[4] = {-box->h, -box->h, 0,       0};
+
+    for (int i = 0; i < 4; i ++)
+    {
+        box->quad[i].x = box->px + c * dx[i] + s * dy[i];
+        box->quad[i].y = box->py - s * dx[i] + c * dy[i];
+    }
+}
+
 /*
  * https://colab.research.google.com/github/sayakpaul/Adventures-in-TensorFlow-Lite/blob/master/EAST_TFLite.ipynb
+ *
+ * the geometry of one row of candidates is decoded at once into
+ * flat arrays (cos/sin evaluated once per cell), so the loop has
+ * no branches and no per-candidate allocation.
+ */
+#define MAX_ROW_CANDIDATES  1024
+
+/*
+ *  sin/cos of 4 angles by polynomials of degree 9/10 (Taylor),
+ *  accurate to ~1e-6 in |angle| <= pi/2. EAST angles are in +-pi/4.
  */
+#define SINCOS_RANGE    1.5707963f
+
+#define SIN_C3  -1.6666667e-1f
+#define SIN_C5   8.3333333e-3f
+#define SIN_C7  -1.9841270e-4f
+#define SIN_C9   2.7557319e-6f
+#define COS_C2  -5.0000000e-1f
+#define COS_C4   4.1666667e-2f
+#define COS_C6  -1.3888889e-3f
+#define COS_C8   2.4801587e-5f
+#define COS_C10 -2.7557319e-7f
+
+/*
+ *  (px, py) = (x, y) * 4 + rotate (d1, d2) of (num) candidates.
+ *  (in_range) 0: some angle is out of SINCOS_RANGE, decode with sinf/cosf.
+ */
+static void
+decode_geometry (int num, int y, const int *cand_x, const float *d1, const float *d2,
+                 const float *an, int in_range, float *px, float *py)
+{
+    int i = 0;
+
+#if defined (TEXTDET_USE_NEON)
+    float32x4_t oy = vdupq_n_f32 (y * 4.0f);
+    for (; in_range && i + 4 <= num; i += 4)
+    {
+        float32x4_t a  = vld1q_f32 (&an[i]);
+        float32x4_t a2 = vmulq_f32 (a, a);
+        float32x4_t s, c;
+
+        s = vmlaq_f32 (vdupq_n_f32 (SIN_C7), a2, vdupq_n_f32 (SIN_C9));
+        s = vmlaq_f32 (vdupq_n_f32 (SIN_C5), a2, s);
+        s = vmlaq_f32 (vdupq_n_f32 (SIN_C3), a2, s);
+        s = vmlaq_f32 (vdupq_n_f32 (1.0f),   a2, s);
+        s = vmulq_f32 (a, s);
+
+        c = vmlaq_f32 (vdupq_n_f32 (COS_C8), a2, vdupq_n_f32 (COS_C10));
+        c = vmlaq_f32 (vdupq_n_f32 (COS_C6), a2, c);
+        c = vmlaq_f32 (vdupq_n_f32 (COS_C4), a2, c);
+        c = vmlaq_f32 (vdupq_n_f32 (COS_C2), a2, c);
+        c = vmlaq_f32 (vdupq_n_f32 (1.0f),   a2, c);
+
+        float32x4_t v1 = vld1q_f32 (&d1[i]);
+        float32x4_t v2 = vld1q_f32 (&d2[i]);
+        float32x4_t ox = vmulq_n_f32 (vcvtq_f32_s32 (vld1q_s32 (&cand_x[i])), 4.0f);
+
+        vst1q_f32 (&px[i], vmlaq_f32 (vmlaq_f32 (ox, c, v1), s, v2));
+        vst1q_f32 (&py[i], vmlaq_f32 (vmlsq_f32 (oy, s, v1), c, v2));
+    }
+#elif defined (TEXTDET_USE_SSE2)
+    __m128 oy = _mm_set1_ps (y * 4.0f);
+    for (; in_range && i + 4 <= num; i += 4)
+    {
+        __m128 a  = _mm_loadu_ps (&an[i]);
+        __m128 a2 = _mm_mul_ps (a, a);
+        __m128 s, c;
+
+        s = _mm_add_ps (_mm_mul_ps (a2, _mm_set1_ps (SIN_C9)), _mm_set1_ps (SIN_C7));
+        s = _mm_add_ps (_mm_mul_ps (a2, s), _mm_set1_ps (SIN_C5));
+        s = _mm_add_ps (_mm_mul_ps (a2, s), _mm_set1_ps (SIN_C3));
+        s = _mm_add_ps (_mm_mul_ps (a2, s), _mm_set1_ps (1.0f));
+        s = _mm_mul_ps (a, s);
+
+        c = _mm_add_ps (_mm_mul_ps (a2, _mm_set1_ps (COS_C10)), _mm_set1_ps (COS_C8));
+        c = _mm_add_ps (_mm_mul_ps (a2, c), _mm_set1_ps (COS_C6));
+        c = _mm_add_ps (_mm_mul_ps (a2, c), _mm_set1_ps (COS_C4));
+        c = _mm_add_ps (_mm_mul_ps (a2, c), _mm_set1_ps (COS_C2));
+        c = _mm_add_ps (_mm_mul_ps (a2, c), _mm_set1_ps (1.0f));
+
+        __m128 v1 = _mm_loadu_ps (&d1[i]);
+        __m128 v2 = _mm_loadu_ps (&d2[i]);
+        __m128 ox = _mm_mul_ps (_mm_cvtepi32_ps (_mm_loadu_si128 ((const __m128i *)&cand_x[i])),
+                                _mm_set1_ps (4.0f));
+
+        _mm_storeu_ps (&px[i], _mm_add_ps (ox, _mm_add_ps (_mm_mul_ps (c, v1), _mm_mul_ps (s, v2))));
+        _mm_storeu_ps (&py[i], _mm_add_ps (oy, _mm_sub_ps (_mm_mul_ps (c, v2), _mm_mul_ps (s, v1))));
+    }
+#endif
+
+    /* the remainder, or no SIMD */
+    for (; i < num; i ++)
+    {
+        float c = cosf (an[i]);
+        float s = sinf (an[i]);
+
+        px[i] = cand_x[i] * 4 + c * d1[i] + s * d2[i];
+        py[i] = y * 4         - s * d1[i] + c * d2[i];
+    }
+}
+
 static int
-decode_bounds (std::list<detect_region_t> &detect_list, float score_thresh, int input_img_w, int input_img_h)
+decode_row (int y, float score_thresh, text_box_t *row_boxes)
 {
-    detect_region_t detect_item;
-    float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
-    float img_w = (float)s_detect_tensor_input.dims[2];
-    float img_h = (float)s_detect_tensor_input.dims[1];
-    int score_w = s_detect_tensor_scores.dims[2];
-    int score_h = s_detect_tensor_scores.dims[1];
+    float *scores_ptr = (float *)s_detect_tensor_scores.ptr;
+    int   score_w = s_detect_tensor_scores.dims[2];
+    float *row    = &scores_ptr[score_w * y];
+
+    int   cand_x[MAX_ROW_CANDIDATES];
+    float d0[MAX_ROW_CANDIDATES], d1[MAX_ROW_CANDIDATES];
+    float d2[MAX_ROW_CANDIDATES], d3[MAX_ROW_CANDIDATES];
+    float an[MAX_ROW_CANDIDATES];
+    float px[MAX_ROW_CANDIDATES], py[MAX_ROW_CANDIDATES];
+    int   num = 0;
+    int   in_range = 1;
+
+    /* gather above-threshold cells of this row. */
+    int x = 0;
+    while ((x = heatmap_find_next_above (row, x, score_w, score_thresh)) < score_w)
+    {
+        float *geom_ptr  = get_geometry_ptr (x, y);
+        float *angle_ptr = get_angle_ptr (x, y);
+
+        cand_x[num] = x;
+        d0[num] = geom_ptr[0];
+        d1[num] = geom_ptr[1];
+        d2[num] = geom_ptr[2];
+        d3[num] = geom_ptr[3];
+        an[num] = angle_ptr[0];
+        in_range &= (fabsf (an[num]) <= SINCOS_RANGE);
+        num ++;
+        x ++;
+
+        if (num >= MAX_ROW_CANDIDATES)
+            break;
+    }
 
-    for (int y = 0; y < score_h; y ++) 
+    decode_geometry (num, y, cand_x, d1, d2, an, in_range, px, py);
+
+    for (int i = 0; i < num; i ++)
     {
-        for (int x = 0; x < score_w; x ++)
-        {
-            float score = scores_ptr[score_w * y + x];
+        text_box_t *box = &row_boxes[i];
+
+        box->px     = px[i];
+        box->py     = py[i];
+        box->w      = d1[i] + d3[i];
+        box->h      = d0[i] + d2[i];
+        box->angle  = an[i];
+        box->score  = row[cand_x[i]];
+        box->weight = box->score;
+    }
 
-            if (score < score_thresh)
-                continue;
+    return num;
+}
 
-            float *geom_ptr  = get_geometry_ptr (x, y);
-            float *angle_ptr = get_angle_ptr (x, y);
 
-            float offset_x = x * 4;
-            float offset_y = y * 4;
-            float angle = angle_ptr[0];
-            float h = geom_ptr[0] + geom_ptr[2];
-            float w = geom_ptr[1] + geom_ptr[3];
+/* -------------------------------------------------- *
+ *  IoU of rotated boxes.
+ *  clip quad0 by quad1 (Sutherland-Hodgman) and measure
+ *  the area of the intersection polygon.
+ * -------------------------------------------------- */
+static float
+calc_polygon_area (const fvec2 *pts, int num)
+{
+    float area = 0.0f;
+    for (int i = 0; i < num; i ++)
+    {
+        const fvec2 &p0 = pts[i];
+        const fvec2 &p1 = pts[(i + 1) % num];
+        area += p0.x * p1.y - p1.x * p0.y;
+    }
+    return area * 0.5f;
+}
 
-            float end_x = offset_x + cos(angle) * geom_ptr[1] + sin(angle) * geom_ptr[2];
-            float end_y = offset_y - sin(angle) * geom_ptr[1] + cos(angle) * geom_ptr[2];
-            float start_x = end_x - w;
-            float start_y = end_y - h;
+static float
+calc_cross (const fvec2 &a, const fvec2 &b, const fvec2 &p)
+{
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
 
-            fvec2 topleft, btmright;
-            topleft.x  = start_x / img_w;
-            topleft.y  = start_y / img_h;
-            btmright.x = end_x   / img_w;
-            btmright.y = end_y   / img_h;
+static int
+clip_polygon (const fvec2 *src, int num_src, const fvec2 &a, const fvec2 &b, float orient, fvec2 *dst)
+{
+    int num_dst = 0;
+
+    for (int i = 0; i < num_src; i ++)
+    {
+        const fvec2 &p0 = src[i];
+        const fvec2 &p1 = src[(i + 1) % num_src];
+        float c0 = orient * calc_cross (a, b, p0);
+        float c1 = orient * calc_cross (a, b, p1);
 
-            detect_item.score    = score;
-            detect_item.topleft  = topleft;
-            detect_item.btmright = btmright;
-            detect_item.angle    = angle;
+        if (c0 >= 0.0f)
+            dst[num_dst ++] = p0;
 
-            detect_list.push_back (detect_item);
+        if ((c0 >= 0.0f) != (c1 >= 0.0f))
+        {
+            float t = c0 / (c0 - c1);
+            dst[num_dst].x = p0.x + t * (p1.x - p0.x);
+            dst[num_dst].y = p0.y + t * (p1.y - p0.y);
+            num_dst ++;
         }
     }
-    return 0;
+    return num_dst;
 }
 
-/* -------------------------------------------------- *
- *  Apply NonMaxSuppression:
- *      https://github.com/tensorflow/tfjs/blob/master/tfjs-core/src/ops/image_ops.ts
- * -------------------------------------------------- */
 static float
-calc_intersection_over_union (detect_region_t &region0, detect_region_t &region1)
+calc_rotated_iou (const text_box_t &box0, const text_box_t &box1)
 {
-    float sx0 = region0.topleft.x;
-    float sy0 = region0.topleft.y;
-    float ex0 = region0.btmright.x;
-    float ey0 = region0.btmright.y;
-    float sx1 = region1.topleft.x;
-    float sy1 = region1.topleft.y;
-    float ex1 = region1.btmright.x;
-    float ey1 = region1.btmright.y;
-    
-    float xmin0 = std::min (sx0, ex0);
-    float ymin0 = std::min (sy0, ey0);
-    float xmax0 = std::max (sx0, ex0);
-    float ymax0 = std::max (sy0, ey0);
-    float xmin1 = std::min (sx1, ex1);
-    float ymin1 = std::min (sy1, ey1);
-    float xmax1 = std::max (sx1, ex1);
-    float ymax1 = std::max (sy1, ey1);
-    
-    float area0 = (ymax0 - ymin0) * (xmax0 - xmin0);
-    float area1 = (ymax1 - ymin1) * (xmax1 - xmin1);
+    /* reject by bounding box first: most pairs do not overlap. */
+    float min0x = box0.quad[0].x, max0x = min0x, min0y = box0.quad[0].y, max0y = min0y;
+    float min1x = box1.quad[0].x, max1x = min1x, min1y = box1.quad[0].y, max1y = min1y;
+    for (int i = 1; i < 4; i ++)
+    {
+        min0x = std::min (min0x, box0.quad[i].x);  max0x = std::max (max0x, box0.quad[i].x);
+        min0y = std::min (min0y, box0.quad[i].y);  max0y = std::max (max0y, box0.quad[i].y);
+        min1x = std::min (min1x, box1.quad[i].x);  max1x = std::max (max1x, box1.quad[i].x);
+        min1y = std::min (min1y, box1.quad[i].y);  max1y = std::max (max1y, box1.quad[i].y);
+    }
+    if (min0x >= max1x || min1x >= max0x || min0y >= max1y || min1y >= max0y)
+        return 0.0f;
+
+    float area0 = std::fabs (calc_polygon_area (box0.quad, 4));
+    float area1 = std::fabs (calc_polygon_area (box1.quad, 4));
     if (area0 <= 0 || area1 <= 0)
         return 0.0f;
 
-    float intersect_xmin = std::max (xmin0, xmin1);
-    float intersect_ymin = std::max (ymin0, ymin1);
-    float intersect_xmax = std::min (xmax0, xmax1);
-    float intersect_ymax = std::min (ymax0, ymax1);
+    fvec2 buf0[16], buf1[16];
+    fvec2 *src = buf0;
+    fvec2 *dst = buf1;
+    int   num  = 4;
+    float orient = (calc_polygon_area (box1.quad, 4) > 0.0f) ? 1.0f : -1.0f;
+
+    memcpy (src, box0.quad, sizeof (box0.quad));
+    for (int i = 0; i < 4 && num > 0; i ++)
+    {
+        num = clip_polygon (src, num, box1.quad[i], box1.quad[(i + 1) % 4], orient, dst);
+        std::swap (src, dst);
+    }
+
+    float intersect_area = (num > 2) ? std::fabs (calc_polygon_area (src, num)) : 0.0f;
 
-    float intersect_area = std::max (intersect_ymax - intersect_ymin, 0.0f) *
-                           std::max (intersect_xmax - intersect_xmin, 0.0f);
-    
     return intersect_area / (area0 + area1 - intersect_area);
 }
 
+
+/* -------------------------------------------------- *
+ *  Locality-Aware NMS (EAST, Zhou et al. 2017):
+ *    candidates come in raster order, so neighbours in a row
+ *    are merged first by score-weighted averaging. regular NMS
+ *    then runs on the (much smaller) merged set.
+ * -------------------------------------------------- */
+static void
+merge_box (text_box_t *dst, const text_box_t *src)
+{
+    float w0 = dst->weight;
+    float w1 = src->weight;
+    float k  = 1.0f / (w0 + w1);
+
+    dst->px     = (dst->px    * w0 + src->px    * w1) * k;
+    dst->py     = (dst->py    * w0 + src->py    * w1) * k;
+    dst->w      = (dst->w     * w0 + src->w     * w1) * k;
+    dst->h      = (dst->h     * w0 + src->h     * w1) * k;
+    dst->angle  = (dst->angle * w0 + src->angle * w1) * k;
+    dst->score  = std::max (dst->score, src->score);
+    dst->weight = w0 + w1;
+    update_box_quad (dst);
+}
+
+static int
+decode_bounds (std::vector<text_box_t> &box_list, float score_thresh, float merge_thresh, int use_lanms)
+{
+    int score_h = s_detect_tensor_scores.dims[1];
+    static text_box_t row_boxes[MAX_ROW_CANDIDATES];
+    text_box_t last;
+    bool       has_last = false;
+
+    for (int y = 0; y < score_h; y ++)
+    {
+        int num = decode_row (y, score_thresh, row_boxes);
+
+        for (int i = 0; i < num; i ++)
+        {
+            text_box_t *box = &row_boxes[i];
+            update_box_quad (box);
+
+            if (!use_lanms)
+            {
+                box_list.push_back (*box);
+                continue;
+            }
+
+            if (has_last && calc_rotated_iou (last, *box) > merge_thresh)
+            {
+                merge_box (&last, box);
+            }
+            else
+            {
+                if (has_last)
+                    box_list.push_back (last);
+                last = *box;
+                has_last = true;
+            }
+        }
+    }
+
+    if (has_last)
+        box_list.push_back (last);
+
+    return 0;
+}
+
 static bool
-compare (detect_region_t &v1, detect_region_t &v2)
+compare (const text_box_t &v1, const text_box_t &v2)
 {
-    if (v1.score > v2.score)
-        return true;
-    else
-        return false;
+    return (v1.weight > v2.weight);
 }
 
 static int
-non_max_suppression (std::list<detect_region_t> &detect_list, std::list<detect_region_t> &detect_sel_list, float iou_thresh)
+non_max_suppression (std::vector<text_box_t> &box_list, std::vector<text_box_t> &box_sel_list, float iou_thresh)
 {
-    detect_list.sort (compare);
+    std::stable_sort (box_list.begin(), box_list.end(), compare);
 
-    for (auto itr = detect_list.begin(); itr != detect_list.end(); itr ++)
+    for (auto itr = box_list.begin(); itr != box_list.end(); itr ++)
     {
-        detect_region_t detect_candidate = *itr;
+        text_box_t &box_candidate = *itr;
 
         int ignore_candidate = false;
-        for (auto itr_sel = detect_sel_list.rbegin(); itr_sel != detect_sel_list.rend(); itr_sel ++)
+        for (auto itr_sel = box_sel_list.rbegin(); itr_sel != box_sel_list.rend(); itr_sel ++)
         {
-            detect_region_t detect_sel = *itr_sel;
-
-            float iou = calc_intersection_over_union (detect_candidate, detect_sel);
+            float iou = calc_rotated_iou (box_candidate, *itr_sel);
             if (iou >= iou_thresh)
             {
                 ignore_candidate = true;
@@ -234,8 +493,8 @@ non_max_suppression (std::list<detect_region_t> &detect_list, std::list<detect_r
 
         if (!ignore_candidate)
         {
-            detect_sel_list.push_back(detect_candidate);
-            if (detect_sel_list.size() >= MAX_TEXT_NUM)
+            box_sel_list.push_back (box_candidate);
+            if (box_sel_list.size() >= MAX_TEXT_NUM)
                 break;
         }
     }
@@ -244,13 +503,24 @@ non_max_suppression (std::list<detect_region_t> &detect_list, std::list<detect_r
 }
 
 static void
-pack_detect_result (detect_result_t *detect_result, std::list<detect_region_t> &detect_list)
+pack_detect_result (detect_result_t *detect_result, std::vector<text_box_t> &box_list)
 {
+    float img_w = (float)s_detect_tensor_input.dims[2];
+    float img_h = (float)s_detect_tensor_input.dims[1];
     int num_detects = 0;
-    for (auto itr = detect_list.begin(); itr != detect_list.end(); itr ++)
+
+    for (auto itr = box_list.begin(); itr != box_list.end(); itr ++)
     {
-        detect_region_t detect = *itr;
-        memcpy (&detect_result->texts[num_detects], &detect, sizeof (detect));
+        text_box_t &box = *itr;
+        detect_region_t *detect = &detect_result->texts[num_detects];
+
+        detect->score      = box.score;
+        detect->topleft.x  = (box.px - box.w) / img_w;
+        detect->topleft.y  = (box.py - box.h) / img_h;
+        detect->btmright.x = box.px / img_w;
+        detect->btmright.y = box.py / img_h;
+        detect->angle      = box.angle;
+
         num_detects ++;
         detect_result->num = num_detects;
 
@@ -259,6 +529,32 @@ pack_detect_result (detect_result_t *detect_result, std::list<detect_region_t> &
     }
 }
 
+static void
+postprocess_textdet (detect_result_t *detect_result, detect_config_t *config, int *num_candidates)
+{
+    /* keep the capacity across frames. */
+    static std::vector<text_box_t> s_box_list;
+    static std::vector<text_box_t> s_box_nms_list;
+
+    s_box_list.clear ();
+    s_box_nms_list.clear ();
+
+    /* decode boundary box and landmark keypoints */
+    float score_thresh = config->score_thresh;
+    float iou_thresh   = config->iou_thresh;
+    decode_bounds (s_box_list, score_thresh, iou_thresh, config->use_lanms);
+
+    if (num_candidates)
+        *num_candidates = s_box_list.size();
+
+#if 1 /* USE NMS */
+    non_max_suppression (s_box_list, s_box_nms_list, iou_thresh);
+    pack_detect_result (detect_result, s_box_nms_list);
+#else
+    pack_detect_result (detect_result, s_box_list);
+#endif
+}
+
 
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite
@@ -272,24 +568,69 @@ invoke_textdet (detect_result_t *detect_result, detect_config_t *config)
         return -1;
     }
 
-    /* decode boundary box and landmark keypoints */
-    float score_thresh = config->score_thresh;
-    std::list<detect_region_t> detect_list;
+    detect_result->num = 0;
+    postprocess_textdet (detect_result, config, NULL);
 
-    int input_img_w = s_detect_tensor_input.dims[2];
-    int input_img_h = s_detect_tensor_input.dims[1];
-    decode_bounds (detect_list, score_thresh, input_img_w, input_img_h);
+    return 0;
+}
 
-#if 1 /* USE NMS */
-    float iou_thresh = config->iou_thresh;
-    std::list<detect_region_t> detect_nms_list;
 
-    non_max_suppression (detect_list, detect_nms_list, iou_thresh);
-    pack_detect_result (detect_result, detect_nms_list);
-#else
-    pack_detect_result (detect_result, detect_list);
-#endif
 
-    return 0;
+/* -------------------------------------------------- *
+ *  Benchmark of the post-process (decode + NMS).
+ *    runs the model once on the current input, then
+ *    times the post-process with regular NMS and with
+ *    locality-aware NMS on the same output tensors.
+ * -------------------------------------------------- */
+static double
+get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000 + (double)tv.tv_nsec / 1000000.0);
 }
 
+int
+benchmark_textdet (detect_config_t *config, int num_iter)
+{
+    static detect_result_t detect_result;
+    detect_config_t bench_config = *config;
+    const char *mode_name[] = {"NMS", "LANMS"};
+
+    double ttime0 = get_time_ms ();
+    if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    double invoke_ms = get_time_ms () - ttime0;
+
+    fprintf (stderr, "-----------------------------------------------------\n");
+    fprintf (stderr, " EAST post-process benchmark (%d iterations)\n", num_iter);
+    fprintf (stderr, "   score_thresh=%.2f, iou_thresh=%.2f\n", config->score_thresh, config->iou_thresh);
+    fprintf (stderr, "   invoke: %8.3f [ms]\n", invoke_ms);
+    fprintf (stderr, "-----------------------------------------------------\n");
+
+    for (int mode = 0; mode < 2; mode ++)
+    {
+        int num_candidates = 0;
+        bench_config.use_lanms = mode;
+
+        /* warm up (reserve vector capacity) */
+        postprocess_textdet (&detect_result, &bench_config, &num_candidates);
+
+        double t0 = get_time_ms ();
+        for (int i = 0; i < num_iter; i ++)
+        {
+            detect_result.num = 0;
+            postprocess_textdet (&detect_result, &bench_config, &num_candidates);
+        }
+        double t1 = get_time_ms ();
+
+        fprintf (stderr, " %-6s: %8.3f [ms/frame]  candidates to NMS:%5d  detected:%3d\n",
+                 mode_name[mode], (t1 - t0) / num_iter, num_candidates, detect_result.num);
+    }
+    fprintf (stderr, "-----------------------------------------------------\n");
+
+    return 0;
+}
@@ -34,12 +34,14 @@ typedef struct _detect_config_t
 {
     float score_thresh;
     float iou_thresh;
+    int   use_lanms;        /* locality-aware NMS */
 } detect_config_t;
 
 extern int init_tflite_textdet (int use_quantized_tflite, detect_config_t *config);
 extern void  *get_textdet_input_buf (int *w, int *h);
 
 extern int invoke_textdet (detect_result_t *detect_result, detect_config_t *config);
+extern int benchmark_textdet (detect_config_t *config, int num_iter);
     
 #ifdef __cplusplus
 }
@@ -21,6 +21,7 @@ static unsigned int     s_video_fmt;
 static int64_t          s_duration_base;
 
 static void             *s_decode_buf = NULL;
+static volatile uint32_t s_decode_seq = 0;      /* incremented for every decoded frame */
 
 int
 init_video_decode ()
@@ -131,6 +132,13 @@ get_video_buffer (void ** buf)
     return 0;
 }
 
+/* 0 until the first frame is decoded */
+uint32_t
+get_video_frame_seq ()
+{
+    return s_decode_seq;
+}
+
 static int 
 save_to_ppm (AVFrame *frame, int width, int height, int icnt)
 {
@@ -196,6 +204,7 @@ on_frame_decoded (AVFrame *frame)
     }
 
     convert_to_rgba8888 (frame, ofstx, ofsty, s_crop_w, s_crop_h);
+    s_decode_seq ++;
 
     return 0;
 }
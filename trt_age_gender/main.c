@@ -11,6 +11,7 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "trt_age_gender.h"
@@ -484,6 +485,8 @@ main(int argc, char *argv[])
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
 
+    mem_print_startup_report ();
+
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
@@ -494,6 +497,7 @@ main(int argc, char *argv[])
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -506,23 +510,31 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  Face detection
          * --------------------------------------- */
+        PMETER_SCOPE_BEGIN ("feed_face_detect_image");
         feed_face_detect_image (&captex, win_w, win_h);
+        PMETER_SCOPE_END ();
 
         ttime[2] = pmeter_get_time_ms ();
+        PMETER_SCOPE_BEGIN ("invoke_face_detect");
         invoke_face_detect (&face_detect_ret, &imgui_data.facedet_config);
+        PMETER_SCOPE_END ();
         ttime[3] = pmeter_get_time_ms ();
         invoke_ms0 = ttime[3] - ttime[2];
 
@@ -532,10 +544,14 @@ main(int argc, char *argv[])
         invoke_ms1 = 0;
         for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
         {
+            PMETER_SCOPE_BEGIN ("feed_age_gender_image");
             feed_age_gender_image (&captex, win_w, win_h, &face_detect_ret, face_id);
+            PMETER_SCOPE_END ();
 
             ttime[4] = pmeter_get_time_ms ();
+            PMETER_SCOPE_BEGIN ("invoke_age_gender");
             invoke_age_gender (&age_gender_ret[face_id]);
+            PMETER_SCOPE_END ();
             ttime[5] = pmeter_get_time_ms ();
             invoke_ms1 += ttime[5] - ttime[4];
         }
@@ -545,7 +561,9 @@ main(int argc, char *argv[])
          * --------------------------------------- */
         glClear (GL_COLOR_BUFFER_BIT);
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
         render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_detect_ret, age_gender_ret);
+        PMETER_SCOPE_END ();
 
         /* visualize the segmentation results. */
         /* draw cropped image of the face area */
@@ -557,7 +575,9 @@ main(int argc, char *argv[])
             float y = h * face_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
+            PMETER_SCOPE_BEGIN ("render_cropped_face_image");
             render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+            PMETER_SCOPE_END ();
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -571,9 +591,13 @@ main(int argc, char *argv[])
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&imgui_data);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
@@ -3,6 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_trt.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "trt_age_gender.h"
 #include <unistd.h>
 
@@ -29,6 +31,8 @@ static trt_tensor_t         s_tensor_age;
 static trt_tensor_t         s_tensor_gender;
 static std::vector<void *>  s_gpu_buffers;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 
 /* -------------------------------------------------- *
  *  create cuda engine
@@ -130,6 +134,8 @@ init_trt_age_gender (face_detect_config_t *config)
     config->score_thresh = 0.3f;
     config->iou_thresh   = 0.3f;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -185,7 +191,7 @@ _exp (float v)
 
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh)
+decode_bounds (arena_list<face_t> &face_list, float score_thresh)
 {
     face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_hm.cpu_mem;
@@ -289,7 +295,7 @@ compare (face_t &v1, face_t &v2)
 }
 
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (arena_list<face_t> &face_list, arena_list<face_t> &face_sel_list, float iou_thresh)
 {
     face_list.sort (compare);
 
@@ -411,7 +417,7 @@ compute_face_rect (face_t &face)
 
 
 static void
-pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_list)
+pack_face_result (face_detect_result_t *facedet_result, arena_list<face_t> &face_list)
 {
     int num_faces = 0;
     for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
@@ -450,15 +456,18 @@ invoke_face_detect (face_detect_result_t *facedet_result, face_detect_config_t *
     trt_copy_tensor_from_gpu (s_detect_tensor_landmark);
 
 
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<face_t> face_list;
+    arena_list<face_t> face_list;
 
     decode_bounds (face_list, score_thresh);
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<face_t> face_nms_list;
+    arena_list<face_t> face_nms_list;
 
     non_max_suppression (face_list, face_nms_list, iou_thresh);
     pack_face_result (facedet_result, face_nms_list);
@@ -466,6 +475,9 @@ invoke_face_detect (face_detect_result_t *facedet_result, face_detect_config_t *
     pack_face_result (facedet_result, face_list);
 #endif
 
+    ALLOC_CHECK_END ("invoke_face_detect");
+    frame_arena_end ();
+
     return 0;
 }
 
@@ -480,7 +492,7 @@ compare_age (age_t &v1, age_t &v2)
 }
 
 static void
-decode_ages (std::list<age_t> &age_list)
+decode_ages (arena_list<age_t> &age_list)
 {
     age_t age_item;
     float *ages_ptr = (float *)s_tensor_age.cpu_mem;
@@ -509,7 +521,10 @@ invoke_age_gender (age_gender_result_t *age_gender_result)
     trt_copy_tensor_from_gpu (s_tensor_age);
     trt_copy_tensor_from_gpu (s_tensor_gender);
 
-    std::list<age_t> age_list;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<age_t> age_list;
     decode_ages (age_list);
 
     //for (auto itr = age_list.begin(); itr != age_list.end(); itr ++)
@@ -528,6 +543,10 @@ invoke_age_gender (age_gender_result_t *age_gender_result)
     age_gender_result->age.score = age_item.score;
     age_gender_result->gender.score_m = score_m;
     age_gender_result->gender.score_f = score_f;
+
+    ALLOC_CHECK_END ("invoke_age_gender");
+    frame_arena_end ();
+
     return 0;
 }
 
@@ -11,6 +11,7 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "trt_classification.h"
@@ -321,12 +322,15 @@ main(int argc, char *argv[])
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
 
+    mem_print_startup_report ();
+
     for (count = 0; ; count ++)
     {
         classification_result_t class_ret = {0};
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -339,21 +343,29 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* invoke pose estimation using TensorflowLite */
+        PMETER_SCOPE_BEGIN ("feed_classification_image");
         feed_classification_image (&captex, win_w, win_h);
+        PMETER_SCOPE_END ();
 
         ttime[2] = pmeter_get_time_ms ();
+        PMETER_SCOPE_BEGIN ("invoke_classification");
         invoke_classification (&class_ret);
+        PMETER_SCOPE_END ();
         ttime[3] = pmeter_get_time_ms ();
         invoke_ms = ttime[3] - ttime[2];
 
@@ -361,14 +373,18 @@ main(int argc, char *argv[])
 
         /* visualize the object detection results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_classification_result");
         render_classification_result (draw_x, draw_y, draw_w, draw_h, &class_ret);
+        PMETER_SCOPE_END ();
 
         draw_pmeter (0, 40);
 
         sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]", interval, invoke_ms);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
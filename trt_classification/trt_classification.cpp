@@ -3,6 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_trt.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "trt_classification.h"
 
 
@@ -17,6 +19,8 @@ static std::vector<void *>  s_gpu_buffers;
 
 static char                 s_class_name [MAX_CLASS_NUM][64];
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 
 /* -------------------------------------------------- *
  *  load class labels
@@ -120,6 +124,8 @@ init_trt_classification ()
 
     load_label_map ();
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -144,7 +150,7 @@ get_scoreval (int class_id)
 }
 
 static int
-push_listitem (std::list<classify_t> &class_list, classify_t &item, size_t topn)
+push_listitem (arena_list<classify_t> &class_list, classify_t &item, size_t topn)
 {
     size_t idx = 0;
 
@@ -192,7 +198,10 @@ invoke_classification (classification_result_t *class_ret)
     trt_copy_tensor_from_gpu (s_tensor_output);
 
 
-    std::list<classify_t> classify_list;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<classify_t> classify_list;
     for (int i = 0; i < MAX_CLASS_NUM; i ++)
     {
         classify_t item;
@@ -215,5 +224,8 @@ invoke_classification (classification_result_t *class_ret)
         class_ret->num = count;
     }
 
+    ALLOC_CHECK_END ("invoke_classification");
+    frame_arena_end ();
+
     return 0;
 }
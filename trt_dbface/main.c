@@ -11,6 +11,7 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "trt_dbface.h"
@@ -375,6 +376,8 @@ main(int argc, char *argv[])
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
 
+    mem_print_startup_report ();
+
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
@@ -384,6 +387,7 @@ main(int argc, char *argv[])
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -396,23 +400,31 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  Face detection
          * --------------------------------------- */
+        PMETER_SCOPE_BEGIN ("feed_dbface_image");
         feed_dbface_image (&captex, win_w, win_h);
+        PMETER_SCOPE_END ();
 
         ttime[2] = pmeter_get_time_ms ();
+        PMETER_SCOPE_BEGIN ("invoke_dbface");
         invoke_dbface (&face_ret, &imgui_data.dbface_config);
+        PMETER_SCOPE_END ();
         ttime[3] = pmeter_get_time_ms ();
         invoke_ms = ttime[3] - ttime[2];
 
@@ -423,7 +435,9 @@ main(int argc, char *argv[])
 
         /* visualize the object detection results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        PMETER_SCOPE_BEGIN ("render_detect_region");
         render_detect_region (draw_x, draw_y, draw_w, draw_h, &face_ret, &imgui_data);
+        PMETER_SCOPE_END ();
 
         /* --------------------------------------- *
          *  post process
@@ -434,9 +448,13 @@ main(int argc, char *argv[])
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
+        PMETER_SCOPE_BEGIN ("invoke_imgui");
         invoke_imgui (&imgui_data);
+        PMETER_SCOPE_END ();
 #endif
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
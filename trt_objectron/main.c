@@ -11,6 +11,7 @@
 #include "util_egl.h"
 #include "util_debugstr.h"
 #include "util_pmeter.h"
+#include "util_memory.h"
 #include "util_texture.h"
 #include "util_render2d.h"
 #include "trt_objectron.h"
@@ -375,6 +376,8 @@ main(int argc, char *argv[])
 
     glClearColor (0.f, 0.f, 0.f, 1.0f);
 
+    mem_print_startup_report ();
+
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
@@ -385,6 +388,7 @@ main(int argc, char *argv[])
         char strbuf[512];
 
         PMETER_RESET_LAP ();
+        PMETER_SET_FRAME (count);
         PMETER_SET_LAP ();
 
         ttime[1] = pmeter_get_time_ms ();
@@ -398,23 +402,31 @@ main(int argc, char *argv[])
         /* initialize FFmpeg video decode */
         if (enable_video)
         {
+            PMETER_SCOPE_BEGIN ("update_video_texture");
             update_video_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
         if (enable_camera)
         {
+            PMETER_SCOPE_BEGIN ("update_capture_texture");
             update_capture_texture (&captex);
+            PMETER_SCOPE_END ();
         }
 #endif
 
         /* --------------------------------------- *
          *  3D object detection
          * --------------------------------------- */
+        PMETER_SCOPE_BEGIN ("feed_objectron_image");
         feed_objectron_image (&captex, win_w, win_h);
+        PMETER_SCOPE_END ();
 
         ttime[2] = pmeter_get_time_ms ();
+        PMETER_SCOPE_BEGIN ("invoke_objectron");
         invoke_objectron (&objectron_ret);
+        PMETER_SCOPE_END ();
         ttime[3] = pmeter_get_time_ms ();
         invoke_ms = ttime[3] - ttime[2];
 
@@ -426,7 +438,9 @@ main(int argc, char *argv[])
         /* visualize the 3d object detection results. */
         draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
 
+        PMETER_SCOPE_BEGIN ("render_detect_region");
         render_detect_region (draw_x, draw_y, draw_w, draw_h, &objectron_ret);
+        PMETER_SCOPE_END ();
 
         /* --------------------------------------- *
          *  post process
@@ -437,7 +451,9 @@ main(int argc, char *argv[])
         sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]", interval, invoke_ms);
         draw_dbgstr (strbuf, 10, 10);
 
+        PMETER_SCOPE_BEGIN ("egl_swap");
         egl_swap();
+        PMETER_SCOPE_END ();
     }
 
     return 0;
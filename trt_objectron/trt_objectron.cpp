@@ -19,6 +19,8 @@
 
 
 #include "util_trt.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "trt_objectron.h"
 #include <unistd.h>
 #include "Eigen/Dense"
@@ -37,6 +39,8 @@ static std::vector<void *>  s_gpu_buffers;
 
 static int s_need_post_logistic = 0;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 /*
  * https://github.com/google/mediapipe/tree/master/mediapipe/graphs/object_detection_3d/calculators/tflite_tensors_to_objects_calculator.cc
  */
@@ -135,6 +139,8 @@ init_trt_objectron ()
          0.0f, 1.0f, -1.0f, 1.0f,  0.0f, 1.0f, 1.0f, -1.0f, -2.0f,  1.0f,  1.0f,
          1.0f;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -213,17 +219,17 @@ dilate_heatmap (float *dst_hmp, int hmp_w, int hmp_h, int kern_size)
 }
 
 static void
-extract_center_keypoints (std::list<fvec2> &center_points)
+extract_center_keypoints (arena_list<fvec2> &center_points)
 {
     int hmp_w = s_tensor_heatmap.dims.d[1];
     int hmp_h = s_tensor_heatmap.dims.d[0];
 
-    float *max_filtered_heatmap = (float *)malloc (hmp_w * hmp_h * sizeof (float));
+    arena_vector<float> max_filtered_heatmap (hmp_w * hmp_h);
 
     /* apply (5x5) MAX filter */
     int local_max_distance = 2;
     int kernel_size = static_cast<int>(local_max_distance * 2 + 1 + 0.5f);
-    dilate_heatmap (max_filtered_heatmap, hmp_w, hmp_h, kernel_size);
+    dilate_heatmap (max_filtered_heatmap.data (), hmp_w, hmp_h, kernel_size);
 
     float heatmap_threshold = 0.6f;
     for (int y = 0; y < hmp_h; y ++)
@@ -243,8 +249,6 @@ extract_center_keypoints (std::list<fvec2> &center_points)
             }
         }
     }
-
-    free (max_filtered_heatmap);
 }
 
 /*
@@ -259,7 +263,7 @@ decode_by_voting (int cx, int cy, float offset_scale_x, float offset_scale_y, ob
     float *center_offset = &offsetmap[16 * ((cy * map_w) + cx)];
 
     /* transform BBOX offsetmap. (relative offset) --> (absolute offset) */
-    float *center_votes = (float *)malloc (16 * map_w * map_h * sizeof (float));
+    float center_votes[16];
     for (int i = 0; i < 8; i ++)
     {
         center_votes[2 * i    ] = cx + center_offset[2 * i    ] * offset_scale_x;
@@ -312,8 +316,6 @@ decode_by_voting (int cx, int cy, float offset_scale_x, float offset_scale_y, ob
         obj->bbox[i].x = x_sum / votes;
         obj->bbox[i].y = y_sum / votes;
     }
-
-    free (center_votes);
 }
 
 
@@ -335,7 +337,7 @@ IsIdentical (const object_t& box_1, const object_t& box_2)
 
 
 static bool
-IsNewBox (std::list<object_t> *obj_list, object_t *obj_item)
+IsNewBox (arena_list<object_t> *obj_list, object_t *obj_item)
 {
     for (auto& b : *obj_list)
     {
@@ -412,7 +414,7 @@ Lift2DTo3D(
     // only! If you use other Eigen Solvers, it's not guaranteed to be in
     // increasing order. Here, we just take the eigen vector corresponding
     // to first/smallest eigen value, since we used SelfAdjointEigenSolver.
-    Eigen::VectorXf eigen_vec = eigen_solver.eigenvectors().col(0);
+    Eigen::Matrix<float, 12, 1> eigen_vec = eigen_solver.eigenvectors().col(0);   /* fixed size: no heap */
     Eigen::Map<Eigen::Matrix<float, 4, 3, Eigen::RowMajor>> control_matrix(
         eigen_vec.data());
     if (control_matrix(0, 2) > 0) {
@@ -472,7 +474,7 @@ Project3DTo2D (bool portrait, object_t *object)
 
 
 static void
-pack_objectron_result (objectron_result_t *objectron_result, std::list<object_t> &bbox_list)
+pack_objectron_result (objectron_result_t *objectron_result, arena_list<object_t> &bbox_list)
 {
     int num_obj = 0;
     for (auto itr = bbox_list.begin(); itr != bbox_list.end(); itr ++)
@@ -518,10 +520,13 @@ invoke_objectron (objectron_result_t *objectron_result)
     float offset_scaley = ofstmap_h;
 #endif
 
-    std::list<fvec2> center_points;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<fvec2> center_points;
     extract_center_keypoints (center_points);
 
-    std::list<object_t> obj_list;
+    arena_list<object_t> obj_list;
     for (auto &center_point : center_points)
     {
         int cx = static_cast<int>(std::round(center_point.x));
@@ -553,5 +558,8 @@ invoke_objectron (objectron_result_t *objectron_result)
 
     pack_objectron_result (objectron_result, obj_list);
 
+    ALLOC_CHECK_END ("invoke_objectron");
+    frame_arena_end ();
+
     return 0;
 }
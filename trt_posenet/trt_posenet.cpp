@@ -3,6 +3,8 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_trt.h"
+#include "util_frame_arena.h"
+#include "util_alloc_check.h"
 #include "trt_posenet.h"
 #include <unistd.h>
 #include <float.h>
@@ -24,6 +26,8 @@ static int     s_hmp_w = 0;
 static int     s_hmp_h = 0;
 static int     s_edge_num = 0;
 
+static frame_arena_t        s_frame_arena;      /* scratch of the post-process */
+
 typedef struct part_score_t {
     float score;
     int   idx_x;
@@ -161,6 +165,8 @@ init_trt_posenet ()
     /* displacement forward vector dimention */
     s_edge_num = s_tensor_fw_disp.dims.d[2] / 2;
 
+    frame_arena_init (&s_frame_arena, "post-process arena", 64 * 1024);
+
     return 0;
 }
 
@@ -204,9 +210,9 @@ get_offset_vector (float *ofst_x, float *ofst_y, int idx_y, int idx_x, int pose_
 
 /* enqueue an item in descending order. */
 static void
-enqueue_score (std::list<part_score_t> &queue, int x, int y, int key, float score)
+enqueue_score (arena_list<part_score_t> &queue, int x, int y, int key, float score)
 {
-    std::list<part_score_t>::iterator itr;
+    arena_list<part_score_t>::iterator itr;
     for (itr = queue.begin(); itr != queue.end(); itr++)
     {
         if (itr->score < score)
@@ -254,7 +260,7 @@ score_is_max_in_local_window (int key, float score, int idx_y, int idx_x, int ma
 }
 
 static void
-build_score_queue (std::list<part_score_t> &queue, float thresh, int max_rad)
+build_score_queue (arena_list<part_score_t> &queue, float thresh, int max_rad)
 {
     for (int y = 0; y < s_hmp_h; y ++)
     {
@@ -461,7 +467,10 @@ regist_detected_pose (posenet_result_t *pose_result, keypoint_t *keys, float sco
 static void
 decode_multiple_poses (posenet_result_t *pose_result)
 {
-    std::list<part_score_t> queue;
+    frame_arena_begin (&s_frame_arena);
+    ALLOC_CHECK_BEGIN ();
+
+    arena_list<part_score_t> queue;
 
     float score_thresh  = 0.5f;
     int   local_max_rad = 1;
@@ -490,6 +499,9 @@ decode_multiple_poses (posenet_result_t *pose_result)
 
         queue.pop_front();
     }
+
+    ALLOC_CHECK_END ("decode_multiple_poses");
+    frame_arena_end ();
 }
 
 static void